@@ -0,0 +1,86 @@
+//===--- ObjectEmitter.h - Ahead-of-time native code ------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the ObjectEmitter interface, which compiles generated
+//  Modules to native object files, and what links those into executables
+//  and shared objects.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_OBJECTEMITTER_H
+#define LLVM_PY_OBJECTEMITTER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+
+namespace llvm {
+  class Module;
+  class TargetMachine;
+  class raw_ostream;
+}
+
+namespace py {
+
+/// ObjectEmitter - Compiles Modules to object files for one target.
+///
+/// The code is position independent, so the same object file can go into
+/// an executable or a shared object.
+class ObjectEmitter {
+  llvm::OwningPtr<llvm::TargetMachine> TM;
+  unsigned OptLevel;
+
+  ObjectEmitter(llvm::TargetMachine *TM, unsigned OptLevel);
+  ObjectEmitter(const ObjectEmitter&); // DO NOT IMPLEMENT
+  void operator=(const ObjectEmitter&); // DO NOT IMPLEMENT
+
+public:
+  /// create - Return an emitter for Triple (empty for the host) and CPU
+  /// (empty for the generic one), optimizing code generation at OptLevel
+  /// (0 to 3), or null with Err set if LLVM can't generate code for it.
+  static ObjectEmitter *create(llvm::StringRef Triple, llvm::StringRef CPU,
+                               unsigned OptLevel, std::string &Err);
+  ~ObjectEmitter();
+
+  /// setTarget - Set the target triple and data layout of M to the
+  /// emitter's. Call it before generating code into M: the code emitted
+  /// for small ints, and the passes run over it, depend on the layout.
+  void setTarget(llvm::Module &M) const;
+
+  /// emit - Write M, which must be valid, to OS as an object file. Sets the
+  /// target of M, if it wasn't already. Returns false with Err set if the
+  /// target can't emit object files.
+  bool emit(llvm::Module &M, llvm::raw_ostream &OS, std::string &Err);
+};
+
+/// addMainFunction - Add to M the C entry point of an executable: a main
+/// that calls the function Entry of M, which must take no arguments,
+/// releases what it returns, and returns 0. If Entry is itself called
+/// "main" it is renamed first. Returns false with Err set if there is no
+/// such function.
+bool addMainFunction(llvm::Module &M, llvm::StringRef Entry,
+                     std::string &Err);
+
+/// linkNative - Link the object files Objects into Output with Linker, a
+/// C++ compiler driver, looked for in PATH if it isn't a path.
+///
+/// An executable gets the runtime library RuntimeLib linked into it. A
+/// shared object (if Shared) doesn't: it leaves the runtime functions to
+/// the process that loads it, such as py-run -load, so that every module
+/// loaded into a process shares the one runtime.
+///
+/// Returns false with Err set if the link failed.
+bool linkNative(llvm::StringRef Linker, llvm::ArrayRef<std::string> Objects,
+                llvm::StringRef RuntimeLib, llvm::StringRef Output,
+                bool Shared, std::string &Err);
+
+}
+
+#endif
@@ -0,0 +1,82 @@
+//===--- BitcodeCache.h - On-disk cache of compiled modules -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the BitcodeCache interface, which keeps the Modules
+//  generated from source files in a directory, keyed by what they were
+//  generated from.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_BITCODECACHE_H
+#define LLVM_PY_BITCODECACHE_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/system_error.h"
+#include <string>
+
+namespace llvm {
+  class LLVMContext;
+  class Module;
+}
+
+namespace py {
+
+class LangFeatures;
+
+/// CacheKey - A 128-bit digest of everything a Module is generated from.
+struct CacheKey {
+  uint64_t Hi, Lo;
+
+  CacheKey() : Hi(0), Lo(0) {}
+  CacheKey(uint64_t Hi, uint64_t Lo) : Hi(Hi), Lo(Lo) {}
+
+  /// str - Return the key as 32 hex digits.
+  std::string str() const;
+
+  bool operator==(const CacheKey &O) const { return Hi == O.Hi && Lo == O.Lo; }
+  bool operator!=(const CacheKey &O) const { return !(*this == O); }
+};
+
+/// BitcodeCache - A directory of bitcode files, one per CacheKey.
+///
+/// Entries are only ever added, and each is written to a temporary file and
+/// renamed into place, so any number of processes and threads can share a
+/// directory without locking: a reader sees a whole entry or none.
+class BitcodeCache {
+  std::string Dir;
+
+public:
+  explicit BitcodeCache(llvm::StringRef Dir) : Dir(Dir.str()) {}
+
+  llvm::StringRef getDirectory() const { return Dir; }
+
+  /// getKey - Return the key of the Module generated from Source with
+  /// features F by this build of the compiler. Entries written by a build
+  /// from different sources never match.
+  static CacheKey getKey(llvm::StringRef Source, const LangFeatures &F);
+
+  /// getPath - Return the file holding the entry for K.
+  std::string getPath(const CacheKey &K) const;
+
+  /// contains - Return true if there is an entry for K.
+  bool contains(const CacheKey &K) const;
+
+  /// load - Read the entry for K into a new Module in C named ModuleID.
+  /// Returns null if there is no entry or it can't be read.
+  llvm::Module *load(const CacheKey &K, llvm::StringRef ModuleID,
+                     llvm::LLVMContext &C) const;
+
+  /// store - Make M the entry for K, creating the directory if needed.
+  llvm::error_code store(const CacheKey &K, const llvm::Module &M) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,224 @@
+//===--- Scheduler.h - Pipelined multi-module compilation -------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the Scheduler interface, which compiles many modules at
+//  once on a pool of worker threads.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_SCHEDULER_H
+#define LLVM_PY_SCHEDULER_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/TimeValue.h"
+#include "py/LangFeatures.h"
+#include "py/Support/Parallel.h"
+#include "py/Transforms/Pipeline.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class Module;
+  class SourceMgr;
+  class raw_ostream;
+}
+
+namespace py {
+
+class BitcodeCache;
+class Lexer;
+class Parser;
+
+/// CompileStage - The stages every module goes through, in order.
+enum CompileStage {
+  LexStage,      ///< Load the file and tokenize it. Needs no LLVMContext.
+  ParseStage,    ///< Parse the tokens into a new Module.
+  OptimizeStage, ///< Verify and optimize the Module, and hand it over.
+  NumCompileStages
+};
+
+/// getCompileStageName - Return the name of stage S, e.g. "lex".
+const char *getCompileStageName(CompileStage S);
+
+/// StageStats - Counters for one stage of a Scheduler run.
+struct StageStats {
+  /// Number of tasks of this stage that have run.
+  uint64_t Tasks;
+  /// Number of those that a worker took from another worker's queue.
+  uint64_t Steals;
+  /// Number of those that started while a task of another stage was
+  /// running, e.g. files lexed while others were being optimized.
+  uint64_t Overlapped;
+  /// Number of tasks of this stage queued right now, and the most there
+  /// have been at once. Files not yet lexed count as queued lex tasks.
+  unsigned Depth;
+  unsigned MaxDepth;
+  /// Total time tasks spent queued, and running.
+  double WaitSeconds;
+  double RunSeconds;
+
+  StageStats() : Tasks(0), Steals(0), Overlapped(0), Depth(0), MaxDepth(0),
+                 WaitSeconds(0), RunSeconds(0) {}
+};
+
+/// CompileJob - One input file on its way through a Scheduler.
+struct CompileJob {
+  std::string Filename;
+  /// Everything reported about the file: diagnostics and whatever the
+  /// CompileClient writes. Kept per job so that it can be printed in input
+  /// order however the jobs were scheduled.
+  std::string Output;
+  /// What the CompileClient made of the file for the tool's own output, such
+  /// as a printed Module. Kept apart from the diagnostics in Output.
+  std::string Result;
+  /// Set if the file couldn't be loaded or an error was reported.
+  bool Failed;
+
+  explicit CompileJob(llvm::StringRef Filename)
+    : Filename(Filename.str()), Failed(false) {}
+};
+
+/// CompileClient - What a Scheduler calls back into. Callbacks for a job run
+/// on the worker that owns the job's LLVMContext, one at a time, but
+/// callbacks for different jobs run concurrently.
+class CompileClient {
+public:
+  virtual ~CompileClient();
+
+  /// getTreeStream - Return the stream the Parser of Job should dump its
+  /// tree to. OS collects the job's output.
+  virtual llvm::raw_ostream &getTreeStream(CompileJob &Job,
+                                           llvm::raw_ostream &OS);
+
+  /// parse - Parse Job with P, which reads from L. Diagnostics left in L and
+  /// P afterwards are reported by the Scheduler. Returns the Parser's result.
+  virtual bool parse(CompileJob &Job, Lexer &L, Parser &P,
+                     llvm::SourceMgr &SrcMgr, llvm::raw_ostream &OS);
+
+  /// finished - Called with the Module of Job once it has been optimized,
+  /// just before it is freed.
+  virtual void finished(CompileJob &Job, llvm::Module &M,
+                        llvm::raw_ostream &OS);
+};
+
+/// Scheduler - Compiles a list of files on a work-stealing pool of workers,
+/// fed by lexer threads.
+///
+/// Lexing needs no LLVMContext, so it runs on threads of its own, one for
+/// every four workers. They lex the files in input order, at most two per
+/// worker ahead of the parsers, and queue the parse task of each on a
+/// worker. So the next files are lexed while the workers parse and optimize
+/// earlier ones. A worker with nothing else to do lexes the next file
+/// itself.
+///
+/// Each worker owns one LLVMContext and Runtime for the whole run, and a
+/// queue of tasks. A task is one stage of one job. An idle worker steals the
+/// oldest parse task of another, before any IR exists. From then on the job
+/// is pinned to the worker whose context holds its Module, which optimizes
+/// it before parsing anything else. A thread with nothing to do sleeps until
+/// a task is queued, a parse starts or the last job finishes.
+///
+/// With a BitcodeCache, the lex stage of a file whose Module is cached does
+/// nothing but hash it, and its parse stage loads the Module instead.
+class Scheduler {
+  struct Worker;
+  struct JobState;
+
+  LangFeatures Features;
+  unsigned NumWorkers;
+  Pipeline Passes;
+  CompileClient &Client;
+  BitcodeCache *Cache;
+
+  std::vector<CompileJob> Jobs;
+  std::vector<JobState*> States;
+  std::vector<Worker*> Workers;
+
+  /// Jobs that haven't finished their last stage yet.
+  volatile llvm::sys::cas_flag Remaining;
+  /// The next job to lex, and the jobs lexed whose parse hasn't started.
+  volatile llvm::sys::cas_flag NextLex;
+  volatile llvm::sys::cas_flag Unparsed;
+  /// Lexers wait while Unparsed is this high.
+  unsigned MaxUnparsed;
+  /// Notified when a task that can be stolen is queued, when a parse
+  /// starts, and when Remaining drops to 0.
+  EventCount WorkChanged;
+
+  /// Modules loaded from, and not found in, the cache.
+  volatile llvm::sys::cas_flag CacheHits;
+  volatile llvm::sys::cas_flag CacheMisses;
+
+  mutable llvm::sys::Mutex StatsLock;
+  StageStats Stats[NumCompileStages];
+  /// Tasks of each stage running right now, and when the run started.
+  unsigned Running[NumCompileStages];
+  llvm::sys::TimeValue Started;
+
+  Scheduler(const Scheduler&);      // DO NOT IMPLEMENT
+  void operator=(const Scheduler&); // DO NOT IMPLEMENT
+
+public:
+  /// Scheduler constructor - Compile with language features F on NumWorkers
+  /// threads (0 means one per CPU), running the passes of P.
+  Scheduler(const LangFeatures &F, unsigned NumWorkers, const Pipeline &P,
+            CompileClient &Client);
+  ~Scheduler();
+
+  /// setCache - Load Modules from C when they are there, and store the ones
+  /// that are parsed without errors. Call it before run.
+  void setCache(BitcodeCache *C) { Cache = C; }
+
+  /// addFile - Queue Filename ("-" for stdin) for compilation.
+  void addFile(llvm::StringRef Filename);
+
+  /// run - Compile every file added. Call it once. Returns false if any
+  /// job failed.
+  bool run();
+
+  unsigned getNumJobs() const { return Jobs.size(); }
+  CompileJob &getJob(unsigned I) { return Jobs[I]; }
+
+  /// getStats - Return the counters of stage S. Safe to call while running.
+  StageStats getStats(CompileStage S) const;
+
+  unsigned getNumCacheHits() const { return CacheHits; }
+  unsigned getNumCacheMisses() const { return CacheMisses; }
+
+  /// printStats - Print the counters of every stage as a table, and those
+  /// of the cache if there is one.
+  void printStats(llvm::raw_ostream &OS) const;
+
+private:
+  static void RunThread(void *Ctx, unsigned Idx);
+  void runWorker(unsigned Self);
+  void runLexer();
+  bool lexNext(unsigned To);
+  void push(unsigned Self, unsigned Job, CompileStage Stage, bool Pinned);
+  bool pop(unsigned Self, unsigned &Job, CompileStage &Stage);
+  void runTask(unsigned Self, unsigned Job, CompileStage Stage);
+  void finishJob(unsigned Job);
+
+  void tokenize(JobState &S);
+  void lex(unsigned To, unsigned Job);
+  void parse(unsigned Self, unsigned Job);
+  void optimize(unsigned Self, unsigned Job);
+};
+
+/// EmitDiagnostics - Print and clear the diagnostics of L and P to OS. Sets
+/// Errors if any of them is an error.
+void EmitDiagnostics(Lexer &L, Parser &P, llvm::SourceMgr &SrcMgr,
+                     llvm::raw_ostream &OS, bool &Errors);
+
+}
+
+#endif
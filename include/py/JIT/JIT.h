@@ -0,0 +1,112 @@
+//===--- JIT.h - Run generated modules in process ---------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the JIT interface, which compiles a generated Module to
+//  native code a function at a time and runs it.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_JIT_H
+#define LLVM_PY_JIT_H
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/GenericValue.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+
+namespace llvm {
+  class ExecutionEngine;
+  class Function;
+  class Module;
+}
+
+namespace py {
+
+/// JITStats - What running a Module cost.
+struct JITStats {
+  /// Time spent setting up the engine and resolving symbols.
+  double SetupSeconds;
+  /// Time spent generating code for the entry point.
+  double CompileSeconds;
+  /// Time spent running the entry point, which includes compiling the
+  /// functions it calls the first time they are called.
+  double RunSeconds;
+  /// Functions with a body in the Module, and how many of those were
+  /// compiled, taking up CodeBytes.
+  unsigned FunctionsDefined;
+  unsigned FunctionsCompiled;
+  uint64_t CodeBytes;
+
+  JITStats() : SetupSeconds(0), CompileSeconds(0), RunSeconds(0),
+               FunctionsDefined(0), FunctionsCompiled(0), CodeBytes(0) {}
+};
+
+/// JIT - Owns a Module and runs functions of it.
+///
+/// Only the function asked for is compiled up front. A call to any other
+/// function of the Module goes through a stub that compiles the callee the
+/// first time it runs, so code that never runs is never compiled.
+class JIT {
+  class Listener;
+
+  llvm::OwningPtr<llvm::ExecutionEngine> EE;
+  llvm::OwningPtr<Listener> Events;
+  llvm::Module *M;
+  /// Addresses of runtime functions, by the name the IR calls them.
+  llvm::StringMap<void*> Symbols;
+  bool Resolved;
+  JITStats Stats;
+
+  JIT(llvm::Module *M);
+  JIT(const JIT&);            // DO NOT IMPLEMENT
+  void operator=(const JIT&); // DO NOT IMPLEMENT
+
+  bool resolve(std::string &Err);
+  llvm::Function *getDefinition(llvm::StringRef Name, std::string &Err);
+
+public:
+  /// create - Return a JIT that owns M, or null with Err set (and M deleted)
+  /// if there is no JIT for the host. The LLVMContext of M must outlive the
+  /// JIT.
+  static JIT *create(llvm::Module *M, std::string &Err);
+  ~JIT();
+
+  /// addSymbol - Make calls to the function Name go to Address. Functions
+  /// declared in the Module and not added are looked up in the process.
+  void addSymbol(llvm::StringRef Name, void *Address);
+
+  /// run - Compile and call the function Entry, which must take no
+  /// arguments, and put what it returns in Result. Returns false with Err
+  /// set if there is no such function or a declaration can't be resolved.
+  bool run(llvm::StringRef Entry, llvm::GenericValue &Result,
+           std::string &Err);
+
+  /// getFunctionAddress - Compile the function Name and return its address,
+  /// for the caller to cast to the right type and call. Returns null with
+  /// Err set if there is no such function or a declaration can't be
+  /// resolved.
+  void *getFunctionAddress(llvm::StringRef Name, std::string &Err);
+
+  /// getGlobalAddress - Return the address of the global variable Name,
+  /// emitting it if it hasn't been, or null with Err set if there is no
+  /// such variable.
+  void *getGlobalAddress(llvm::StringRef Name, std::string &Err);
+
+  /// getModule - The Module, to which functions may be added for calls to
+  /// compile later.
+  llvm::Module &getModule() const { return *M; }
+
+  const JITStats &getStats() const { return Stats; }
+};
+
+}
+
+#endif
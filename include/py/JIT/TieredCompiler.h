@@ -0,0 +1,130 @@
+//===--- TieredCompiler.h - Profile-guided recompilation --------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the TieredCompiler interface, which runs the functions
+//  of a JIT's Module in a profiling tier until they are hot, then
+//  recompiles them for the types the profile saw.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_TIEREDCOMPILER_H
+#define LLVM_PY_TIEREDCOMPILER_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/DataTypes.h"
+#include <vector>
+
+namespace llvm {
+  class BranchInst;
+  class CallInst;
+  class Function;
+  class GlobalVariable;
+}
+
+namespace py {
+
+class JIT;
+class Runtime;
+
+/// TieringStats - What tiering has done so far.
+struct TieringStats {
+  unsigned FunctionsTiered;
+  /// Optimized tiers compiled, and the sites and branches they specialized.
+  unsigned Recompiles;
+  unsigned SitesSpecialized;
+  unsigned BranchesWeighted;
+  /// Type guards that failed, and optimized tiers given up because of them.
+  unsigned Deopts;
+  unsigned Invalidations;
+
+  TieringStats() : FunctionsTiered(0), Recompiles(0), SitesSpecialized(0),
+                   BranchesWeighted(0), Deopts(0), Invalidations(0) {}
+};
+
+/// TieredCompiler - Runs the functions of a JIT's Module in two tiers.
+///
+/// Tiering a function F splits it into:
+///  - F itself, which calls whichever tier is current through the slot
+///    F.tier, so its callers need not know about tiers;
+///  - F.profile, the profiling tier: F's code, instrumented inline to count
+///    calls to F, record which types reach each int arithmetic and py_cmp
+///    site (small ints, or anything else), and count which way each
+///    conditional branch goes, all into F.profile.data;
+///  - F.base, F's code as it was, which optimized tiers are cloned from.
+///
+/// Once F has been called HotCalls times, F.profile calls py_tier_up, and
+/// F.opt is made from F.base: each site that only ever saw small ints is
+/// done inline behind a type guard, each branch is weighted as the profile
+/// saw it go, and the scalar optimizations run over it. Later calls to F
+/// run F.opt.
+///
+/// A guard that fails calls py_deopt and carries on with the generic code
+/// of its site, so the call in progress still finishes in F.opt; there is
+/// no on-stack replacement. Small ints whose result overflows pass the
+/// guard, and go to the generic code without deoptimizing. After MaxDeopts failures, F goes back to the
+/// profiling tier, with the sites that failed marked as having seen other
+/// types, until it is hot again. The last of MaxRecompiles optimized tiers
+/// has no guards.
+///
+/// There is one tier hook per process, so only one TieredCompiler may
+/// exist at a time.
+class TieredCompiler {
+  /// Tiered - The tiers of one function.
+  struct Tiered {
+    llvm::Function *Base, *Profile;
+    llvm::GlobalVariable *Slot, *Data;
+    unsigned NumSites, NumBranches;
+    /// Where the JIT put Slot and Data, once known.
+    void **SlotAddress;
+    uint64_t *Counters;
+    bool Optimized;
+    unsigned Recompiles, Deopts;
+  };
+
+  JIT &J;
+  Runtime &R;
+  unsigned HotCalls, MaxDeopts, MaxRecompiles;
+  std::vector<Tiered> Functions;
+  /// The Counters of each function, as the key its code passes the hook.
+  llvm::DenseMap<void*, unsigned> ByKey;
+  TieringStats Stats;
+
+  TieredCompiler(const TieredCompiler&); // DO NOT IMPLEMENT
+  void operator=(const TieredCompiler&); // DO NOT IMPLEMENT
+
+  static void findSites(llvm::Function *F, Runtime &R,
+                        llvm::SmallVectorImpl<llvm::CallInst*> &Sites,
+                        llvm::SmallVectorImpl<llvm::BranchInst*> &Branches);
+  void instrument(Tiered &T);
+  llvm::Function *specialize(Tiered &T, bool Guards);
+  Tiered *lookup(void *Key);
+  void tierUp(Tiered &T);
+  void deopt(Tiered &T, unsigned Site);
+
+  /// The runtime's tier hook, which calls tierUp and deopt.
+  friend struct TierHook;
+
+public:
+  /// Tiers functions of the Module of J, which R emitted.
+  TieredCompiler(JIT &J, Runtime &R, unsigned HotCalls = 1000,
+                 unsigned MaxDeopts = 16, unsigned MaxRecompiles = 4);
+  ~TieredCompiler();
+
+  /// addFunction - Tier F, which must not have been compiled yet.
+  void addFunction(llvm::Function *F);
+  /// addAllFunctions - Tier every function defined in the Module.
+  void addAllFunctions();
+
+  const TieringStats &getStats() const { return Stats; }
+};
+
+}
+
+#endif
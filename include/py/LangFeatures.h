@@ -29,6 +29,9 @@ class LangFeatures {
       AllowImportAs = 1<<3UL,       ///< 'import ... as ...' is allowed.
       AllowExceptAs = 1<<4UL,       ///< 'except ... as ...' is allowed.
       AllowSetComp = 1<<5UL,        ///< set comprehensions are allowed.
+      SpecialExec = 1<<6UL,         ///< exec is a statement and is not parsed
+                                    ///  as a normal function.
+      BoolKeywords = 1<<7UL,        ///< True and False are keywords.
       FeaturesEnd
     };
 
@@ -37,6 +40,12 @@ public:
         Flags(0) {
     }
 
+    /// getFlags - Return every feature as one bit set, e.g. to tell whether
+    /// two sets of features would lex and parse a buffer the same way.
+    unsigned getFlags() const {
+        return Flags;
+    }
+
 #define X(x) inline bool has##x() {             \
     return Flags & x;                           \
   }                                             \
@@ -50,6 +59,8 @@ X(SpecialPrint)
 X(AllowWith)
 X(AllowImportAs)
 X(AllowExceptAs)
+X(SpecialExec)
+X(BoolKeywords)
 #undef X
 };
 
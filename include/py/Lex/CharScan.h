@@ -0,0 +1,67 @@
+//===--- CharScan.h - Bulk character classification -------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the routines the Lexer uses to skip over runs of
+//  identifier characters, indentation and comment bodies. Each routine has a
+//  scalar implementation and, on x86, SSE2 and AVX2 implementations that
+//  classify 16 or 32 bytes at a time. The implementation is picked at runtime
+//  from the capabilities of the host CPU.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_CHARSCAN_H
+#define LLVM_PY_CHARSCAN_H
+
+namespace py {
+namespace charscan {
+
+/// The available scanner implementations.
+enum Implementation {
+  Auto,    ///< Pick the fastest implementation the host supports.
+  Table,   ///< One byte at a time, looked up in a table. Never picked by
+           ///< Auto; it is the baseline the others are measured against.
+  Scalar,  ///< One byte at a time, by range checks.
+  SSE2,    ///< 16 bytes at a time.
+  AVX2     ///< 32 bytes at a time.
+};
+
+/// isSupported - Return true if the host CPU can run implementation I.
+bool isSupported(Implementation I);
+
+/// select - Use implementation I for all subsequent scans. Returns false
+/// (and leaves the current selection alone) if the host does not support it.
+/// Without a call, the first scan selects Auto. select() is setup: call it
+/// before any other thread scans (makes a Lexer, say), never alongside one.
+bool select(Implementation I);
+
+/// getSelected - Return the implementation currently in use. Never returns
+/// Auto.
+Implementation getSelected();
+
+/// getName - Return a human readable name for I.
+const char *getName(Implementation I);
+
+/// skipIdentifierBody - Return a pointer to the first character at or after
+/// P that is not in [A-Za-z0-9_]. End must point to the buffer's terminating
+/// NUL; no byte beyond it is ever read.
+const char *skipIdentifierBody(const char *P, const char *End);
+
+/// skipIndentation - Return a pointer to the first character at or after P
+/// that is neither ' ' nor '\t'. The number of spaces and tabs skipped are
+/// returned in Spaces and Tabs.
+const char *skipIndentation(const char *P, const char *End,
+                            unsigned &Spaces, unsigned &Tabs);
+
+/// findEndOfLine - Return a pointer to the first '\n' or '\0' at or after P.
+const char *findEndOfLine(const char *P, const char *End);
+
+}
+}
+
+#endif
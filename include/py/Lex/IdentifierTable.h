@@ -0,0 +1,81 @@
+//===--- IdentifierTable.h - Interned identifiers and literals --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the Identifier and IdentifierTable interfaces, which
+//  give every distinct identifier and string literal of a module a single
+//  pointer-sized handle.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_IDENTIFIERTABLE_H
+#define LLVM_PY_IDENTIFIERTABLE_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+
+namespace py {
+
+/// Identifier - An interned string. Identifiers from the same table are
+/// equal exactly when their strings are, so they can be compared, ordered
+/// and hashed as pointers.
+class Identifier {
+  typedef llvm::StringMapEntry<llvm::StringRef> EntryTy;
+  const EntryTy *Entry;
+
+  explicit Identifier(const EntryTy *E) : Entry(E) {}
+  friend class IdentifierTable;
+
+public:
+  Identifier() : Entry(0) {}
+
+  bool isValid() const { return Entry != 0; }
+
+  /// str - Return the string. It lives as long as the table (or, for a
+  /// string interned as stable, as long as the memory it was interned from).
+  llvm::StringRef str() const {
+    assert(Entry && "Invalid identifier!");
+    return Entry->getValue();
+  }
+
+  const void *getOpaqueValue() const { return Entry; }
+
+  bool operator==(Identifier O) const { return Entry == O.Entry; }
+  bool operator!=(Identifier O) const { return Entry != O.Entry; }
+  bool operator<(Identifier O) const { return Entry < O.Entry; }
+};
+
+/// IdentifierTable - The table Identifiers are interned in. A table is not
+/// thread safe; give each thread that lexes or parses its own.
+class IdentifierTable {
+  llvm::StringMap<llvm::StringRef, llvm::BumpPtrAllocator> Table;
+
+  IdentifierTable(const IdentifierTable&); // DO NOT IMPLEMENT
+  void operator=(const IdentifierTable&);  // DO NOT IMPLEMENT
+
+public:
+  IdentifierTable() {}
+
+  /// get - Return the Identifier for S. If S is stable (it outlives the
+  /// table, e.g. it is a slice of a source buffer) and is new to the table,
+  /// str() will return S itself rather than the table's copy.
+  Identifier get(llvm::StringRef S, bool IsStable = false) {
+    llvm::StringMapEntry<llvm::StringRef> &E = Table.GetOrCreateValue(S);
+    // A new entry has no value yet.
+    if (!E.getValue().data())
+      E.setValue(IsStable ? S : E.getKey());
+    return Identifier(&E);
+  }
+
+  unsigned size() const { return Table.size(); }
+};
+
+}
+
+#endif
@@ -20,6 +20,7 @@
 #include "py/LangFeatures.h"
 #include "py/Diagnostic.h"
 #include "Token.h"
+#include <vector>
 
 /// Maximum extent of the indent stack.
 #define INDENT_STACK_MAX 256
@@ -30,6 +31,19 @@
 
 namespace py {
 
+class TokenStream;
+
+/// EditRange - An edit to a buffer: OldLength bytes at Offset were replaced
+/// by NewLength bytes.
+struct EditRange {
+  unsigned Offset;
+  unsigned OldLength;
+  unsigned NewLength;
+
+  EditRange(unsigned Offset, unsigned OldLength, unsigned NewLength) :
+    Offset(Offset), OldLength(OldLength), NewLength(NewLength) {}
+};
+
 /// Lexer - This provides a simple interface that turns a text buffer into a
 /// stream of tokens.  This provides no support for file reading or buffering,
 /// or buffering/seeking of tokens, only forward lexing is supported.
@@ -66,6 +80,27 @@ class Lexer {
   bool PeekTokenSuccess;
   bool PeekTokenValid;
 
+public:
+  /// IndentEvent - A line start seen while indentation is deferred. Start
+  /// and End are buffer offsets of the leading whitespace (or, for a line at
+  /// column zero, both are the offset of its first token).
+  struct IndentEvent {
+    unsigned Start;
+    unsigned End;
+    unsigned Width;
+  };
+
+private:
+  bool DeferIndentation;
+  std::vector<IndentEvent> IndentEvents;
+
+  /// Table identifier tokens are interned in, or null.
+  IdentifierTable *Idents;
+
+  /// Tokens to return instead of lexing, or null; see replay().
+  const TokenStream *Replay;
+  unsigned ReplayIdx;
+
   Lexer(const Lexer&);          // DO NOT IMPLEMENT
   void operator=(const Lexer&); // DO NOT IMPLEMENT
 
@@ -78,6 +113,8 @@ public:
   /// getFeatures - 
   const LangFeatures &getFeatures() const { return Features; }
 
+  const llvm::MemoryBuffer *getBuffer() const { return Buffer; }
+
   /// Lex - Return the next token in the file.  If this is the end of file, it
   /// return the tok::eof token.  Return false if an error occurred and
   /// compilation should terminate, true if normal.
@@ -91,14 +128,61 @@ public:
     return Diagnostics;
   }
 
+  /// setDeferIndentation - If D is true, don't track indentation. Instead,
+  /// record an IndentEvent at each line start and let a later pass turn them
+  /// into indent and dedent tokens. This lets independent pieces of a buffer
+  /// be lexed without knowing the indent stack they start with.
+  void setDeferIndentation(bool D) { DeferIndentation = D; }
+
+  const std::vector<IndentEvent> &getIndentEvents() const {
+    return IndentEvents;
+  }
+
+  /// setIdentifierTable - Intern every identifier token in T, so that
+  /// Token::getIdentifier returns its Identifier; null stops interning. The
+  /// caller owns T, which must stay alive while the Lexer lexes with it, and
+  /// which no other thread may use meanwhile.
+  void setIdentifierTable(IdentifierTable *T) { Idents = T; }
+
+  IdentifierTable *getIdentifierTable() const { return Idents; }
+
+  /// replay - Make Lex return the tokens of S, which was tokenized from this
+  /// Lexer's buffer, instead of lexing the buffer again, and take over its
+  /// diagnostics. This lets a buffer be lexed ahead of time, on another
+  /// thread, and parsed later. The Lexer must not have lexed anything yet.
+  /// Lex only returns false for the eof ending a stream that hit an error,
+  /// where lexing would have returned false for the offending token.
+  void replay(const TokenStream &S);
+
+  /// getReplay - The stream given to replay(), or null.
+  const TokenStream *getReplay() const { return Replay; }
+
+  /// relex - Fill Result with the tokens of this Lexer's buffer, which is the
+  /// buffer of Old after Edit. Lexing restarts at the last checkpoint of Old
+  /// before the edit and stops at the first checkpoint after it where the
+  /// indent stack agrees; everything else is copied from Old. The Lexer must
+  /// not have lexed anything yet. Returns false if an error stopped lexing,
+  /// like TokenStream::tokenize. If NumLexed is non-null, it is set to the
+  /// number of tokens that were lexed rather than copied.
+  bool relex(const TokenStream &Old, const EditRange &Edit,
+             TokenStream &Result, unsigned *NumLexed = 0);
+
+  /// resumeAt - Start lexing at P, where a newline token starts, in the
+  /// state of a Lexer that lexed everything before P and has the indent
+  /// stack Widths (NumWidths widths, without the outermost zero). At a
+  /// newline token the brace stack is empty and nothing is pending, so that
+  /// is all of its state. The Lexer must not have lexed anything yet.
+  void resumeAt(const char *P, const unsigned *Widths = 0,
+                unsigned NumWidths = 0);
+
 private:
 
   void MakeToken(Token &Result, tok::TokenKind Kind) {
     unsigned TokLen = Ptr-TokStart;
     Result.setLength(TokLen);
-    Result.setLocation(llvm::SMLoc::getFromPointer(TokStart));
     Result.setContent(TokStart);
     Result.setKind(Kind);
+    Result.setIdentifier(Identifier());
     TokStart = Ptr;
   }
 
@@ -118,6 +202,10 @@ private:
   bool LexPossibleIndent     (Token &Result, unsigned indent, bool *error);
 
   unsigned CountWhitespace(char C);
+
+  /// LookupKeyword - Return the keyword kind of the L-character identifier at
+  /// T under the current language features, or tok::identifier.
+  tok::TokenKind LookupKeyword(const char *T, unsigned L);
   // void LexStringLiteral      (Token &Result, const char *CurPtr,
   //                             tok::TokenKind Kind);
   // bool LexEndOfFile          (Token &Result, const char *CurPtr);
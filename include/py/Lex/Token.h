@@ -14,7 +14,9 @@
 #ifndef LLVM_PY_TOKEN_H
 #define LLVM_PY_TOKEN_H
 
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/SourceMgr.h"
+#include "py/Lex/IdentifierTable.h"
 #include "py/Lex/TokenKind.h"
 
 namespace py {
@@ -27,11 +29,9 @@ public:
   void setLength(unsigned len) {
     Length = len;
   }
+  /// getLocation - Where the token starts, which is where its content is.
   llvm::SMLoc getLocation() {
-    return Loc;
-  }
-  void setLocation(llvm::SMLoc loc) {
-    Loc = loc;
+    return llvm::SMLoc::getFromPointer(Content);
   }
   tok::TokenKind getKind() {
     return Kind;
@@ -51,12 +51,24 @@ public:
   std::string getString() {
     return std::string(Content, Length);
   }
+  /// getSpelling - The token's text, without copying it.
+  llvm::StringRef getSpelling() {
+    return llvm::StringRef(Content, Length);
+  }
+  /// getIdentifier - The interned name of an identifier token, if it was
+  /// lexed with an IdentifierTable; invalid otherwise.
+  Identifier getIdentifier() {
+    return Ident;
+  }
+  void setIdentifier(Identifier I) {
+    Ident = I;
+  }
 
 private:
   unsigned Length;
-  llvm::SMLoc Loc;
   tok::TokenKind Kind;
   char *Content;
+  Identifier Ident;
 };
 
 }
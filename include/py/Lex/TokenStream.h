@@ -0,0 +1,224 @@
+//===--- TokenStream.h - Whole-buffer token storage -------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the TokenStream interface, which holds every token of a
+//  buffer in a compact struct-of-arrays form.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_TOKENSTREAM_H
+#define LLVM_PY_TOKENSTREAM_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "py/Diagnostic.h"
+#include "py/LangFeatures.h"
+#include "py/Lex/Token.h"
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace py {
+
+class Lexer;
+
+/// TokenStream - All of the tokens of one buffer, lexed in a single pass.
+///
+/// Each token costs seven bytes: a one byte kind, a four byte offset from the
+/// start of the buffer and a two byte length. Tokens longer than 64K (only
+/// ever very large string literals) are stored out of line. The stream always
+/// ends with a tok::eof token, so any index below size() is valid, and a
+/// consumer may look as far ahead as it likes. A stream filled by a Lexer
+/// with an IdentifierTable also keeps each token's Identifier, at the cost
+/// of a pointer per token.
+class TokenStream {
+  /// The buffer the offsets are relative to.
+  const llvm::MemoryBuffer *Buffer;
+
+  std::vector<uint8_t> Kinds;
+  std::vector<uint32_t> Offsets;
+  std::vector<uint16_t> Lengths;
+
+  /// (token index, length) for tokens whose length is LongLength or more,
+  /// sorted by token index.
+  std::vector<std::pair<unsigned, unsigned> > LongLengths;
+
+  /// The Identifier of each of the first Identifiers.size() tokens, invalid
+  /// for all but identifier tokens. Filled by tokenize() from a Lexer that
+  /// interns; the Identifiers belong to that Lexer's table.
+  std::vector<Identifier> Identifiers;
+
+  llvm::SmallVector<Diagnostic, 5> Diagnostics;
+
+  /// Did lexing stop early because of an error?
+  bool HadErrors;
+
+  /// Checkpoint - A newline token (so the brace stack is empty) where a
+  /// Lexer can restart given only the indent stack, which is
+  /// CheckpointStacks[StackBegin, StackBegin+StackSize).
+  struct Checkpoint {
+    unsigned Token;
+    unsigned StackBegin;
+    unsigned StackSize;
+  };
+
+  /// Checkpoints, sorted by token index, at most one every
+  /// CHECKPOINT_INTERVAL tokens.
+  std::vector<Checkpoint> Checkpoints;
+
+  /// Indent stacks of the checkpoints, without the implicit outermost zero.
+  /// Checkpoints with the same stack share it.
+  std::vector<unsigned> CheckpointStacks;
+
+  /// The indent stack after the last token, kept up to date by push_back.
+  llvm::SmallVector<unsigned, 16> IndentWidths;
+
+  enum { LongLength = 0xFFFF };
+
+public:
+  enum { DefaultChunkSize = 1 << 20 };
+
+  /// TokenStream constructor - Create an empty stream for tokens of Buf.
+  explicit TokenStream(const llvm::MemoryBuffer *Buf);
+
+  /// tokenize - Lex from L until the end of its buffer or until the first
+  /// error. L must have been created on the same buffer as this stream.
+  /// Returns false if an error stopped lexing; the stream is still terminated
+  /// by an eof token in that case.
+  bool tokenize(Lexer &L);
+
+  /// ParallelStats - What tokenizeParallel did.
+  struct ParallelStats {
+    /// The number of chunks the buffer was cut into, or 1 if it wasn't.
+    unsigned Chunks;
+    /// The number of chunks that began inside a string, brackets or a
+    /// joined line, so that their start was lexed again on the calling
+    /// thread.
+    unsigned Relexed;
+    /// Whether an error made the whole buffer be lexed again sequentially.
+    bool Sequential;
+  };
+
+  /// tokenizeParallel - Lex the whole buffer, splitting it into chunks of
+  /// about ChunkSize bytes that are lexed on up to NumThreads threads.
+  /// Buffers smaller than two chunks are lexed sequentially. The result is
+  /// identical to tokenize() on a Lexer with the same features, including
+  /// indent/dedent tokens and the order of diagnostics. If Stats is
+  /// non-null, it is filled in.
+  bool tokenizeParallel(LangFeatures Features, unsigned NumThreads,
+                        unsigned ChunkSize = DefaultChunkSize,
+                        ParallelStats *Stats = 0);
+
+  /// isEquivalentTo - Return true if Other holds the same tokens and
+  /// diagnostics (relative to its own buffer). If not, and Why is non-null,
+  /// describe the first difference to it.
+  bool isEquivalentTo(TokenStream &Other, llvm::raw_ostream *Why = 0);
+
+  /// hasNewError - Return true if any diagnostic after the first N is an
+  /// error.
+  static bool hasNewError(llvm::SmallVectorImpl<Diagnostic> &Diags,
+                          unsigned N);
+
+  /// push_back - Append a token.
+  void push_back(tok::TokenKind Kind, unsigned Offset, unsigned Length);
+
+  /// push_back - Append a token made by a Lexer on this stream's buffer.
+  void push_back(Token &T) {
+    push_back(T.getKind(), T.getContent() - Buffer->getBufferStart(),
+              T.getLength());
+  }
+
+  unsigned size() const { return Kinds.size(); }
+  bool empty() const { return Kinds.empty(); }
+
+  tok::TokenKind getKind(unsigned I) const {
+    assert(I < size() && "Token index out of range!");
+    return (tok::TokenKind)Kinds[I];
+  }
+  unsigned getOffset(unsigned I) const {
+    assert(I < size() && "Token index out of range!");
+    return Offsets[I];
+  }
+  unsigned getLength(unsigned I) const {
+    assert(I < size() && "Token index out of range!");
+    if (Lengths[I] != LongLength)
+      return Lengths[I];
+    return getLongLength(I);
+  }
+
+  const char *getContent(unsigned I) const {
+    return Buffer->getBufferStart() + getOffset(I);
+  }
+  llvm::SMLoc getLocation(unsigned I) const {
+    return llvm::SMLoc::getFromPointer(getContent(I));
+  }
+  llvm::StringRef getSpelling(unsigned I) const {
+    return llvm::StringRef(getContent(I), getLength(I));
+  }
+
+  /// getIdentifier - The interned name of token I, or an invalid Identifier
+  /// if it isn't an identifier or the stream wasn't lexed with a table.
+  Identifier getIdentifier(unsigned I) const {
+    assert(I < size() && "Token index out of range!");
+    return I < Identifiers.size() ? Identifiers[I] : Identifier();
+  }
+
+  /// getToken - Fill in T with token I, in the form Lexer::Lex produces.
+  void getToken(unsigned I, Token &T) const;
+
+  const llvm::MemoryBuffer *getBuffer() const { return Buffer; }
+
+  bool hasErrors() const { return HadErrors; }
+
+  llvm::SmallVector<Diagnostic, 5> &getDiagnostics() {
+    return Diagnostics;
+  }
+  const llvm::SmallVector<Diagnostic, 5> &getDiagnostics() const {
+    return Diagnostics;
+  }
+
+private:
+  unsigned getLongLength(unsigned I) const;
+  void clear();
+
+  void addCheckpoint(unsigned Token, const unsigned *Stack, unsigned Size);
+
+  const unsigned *getCheckpointStack(const Checkpoint &C) const {
+    return C.StackSize ? &CheckpointStacks[C.StackBegin] : 0;
+  }
+
+  /// findCheckpointBefore - Return the last checkpoint whose newline is
+  /// before Offset, or null if there is none.
+  const Checkpoint *findCheckpointBefore(unsigned Offset) const;
+
+  /// findCheckpointAt - Return the checkpoint whose newline is at Offset, or
+  /// null if there is none.
+  const Checkpoint *findCheckpointAt(unsigned Offset) const;
+
+  /// appendTokens - Append tokens [Begin, End) of Src, moving their offsets
+  /// by Delta, along with the checkpoints among them.
+  void appendTokens(const TokenStream &Src, unsigned Begin, unsigned End,
+                    int Delta);
+
+  /// appendDiagnostics - Append the diagnostics of Src located in
+  /// [Begin, End) of its buffer, moved by Delta onto this stream's buffer.
+  void appendDiagnostics(const TokenStream &Src, unsigned Begin, unsigned End,
+                         int Delta);
+
+  friend class Lexer;
+};
+
+}
+
+#endif
@@ -1,4 +1,4 @@
-//===--- AST.g - Abstract Syntax Tree ---------------------------*- C++ -*-===//
+//===--- AST.h - Abstract Syntax Tree ---------------------------*- C++ -*-===//
 //
 //                     The LLVM Compiler Infrastructure
 //
@@ -9,21 +9,1043 @@
 //
 //  This file defines the AST.
 //
+//  Every node is allocated from the module's ASTContext by a static Get
+//  method, and every array of children is copied into the same arena. Nodes
+//  have no virtual functions and nothing to destroy: the tree is freed when
+//  its ASTContext is. Use isa<>/cast<>/dyn_cast<> to look at a node's kind.
+//
 //===----------------------------------------------------------------------===//
 
 #ifndef LLVM_PY_AST_H
 #define LLVM_PY_AST_H
 
+#include "py/Parse/ASTContext.h"
+#include "py/Lex/IdentifierTable.h"
+#include "py/Lex/TokenKind.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/SourceMgr.h"
+
+namespace llvm {
+  class raw_ostream;
+}
+
 namespace py {
 namespace ast {
 
+class Stmt;
+
+/// Node - The base of every AST node.
 class Node {
 public:
+  enum NodeKind {
+#define NODE(X) X##Kind,
+#include "py/Parse/ASTNodes.def"
+    FirstTestKind = NameKind,
+    LastTestKind = ReprKind,
+    FirstStmtKind = ExprStmtKind,
+    LastStmtKind = ClassDefKind
+  };
+
+private:
+  unsigned char Kind;
+  llvm::SMLoc Loc;
+
+  void *operator new(size_t);    // DO NOT IMPLEMENT
+  void operator delete(void *);  // DO NOT IMPLEMENT
+
+protected:
+  Node(NodeKind K, llvm::SMLoc Loc) : Kind(K), Loc(Loc) {}
+
+  void *operator new(size_t Bytes, ASTContext &C) {
+    return C.Allocate(Bytes);
+  }
+  void operator delete(void *, ASTContext &) {}
+
+public:
+  NodeKind GetKind() const { return (NodeKind)Kind; }
+  llvm::SMLoc GetLoc() const { return Loc; }
+
+  /// GetKindName - Return the lower case name used when printing the node.
+  const char *GetKindName() const;
+
+  /// print - Print the tree rooted at this node as an S-expression.
+  void print(llvm::raw_ostream &OS) const;
+  void dump() const;
+
+  static bool classof(const Node *) { return true; }
+};
+
+/// Test - The base of every expression.
+class Test : public Node {
+protected:
+  Test(NodeKind K, llvm::SMLoc Loc) : Node(K, Loc) {}
+public:
+  static bool classof(const Test *) { return true; }
+  static bool classof(const Node *N) {
+    return N->GetKind() >= FirstTestKind && N->GetKind() <= LastTestKind;
+  }
+};
+
+/// Stmt - The base of every statement.
+class Stmt : public Node {
+protected:
+  Stmt(NodeKind K, llvm::SMLoc Loc) : Node(K, Loc) {}
+public:
+  static bool classof(const Stmt *) { return true; }
+  static bool classof(const Node *N) {
+    return N->GetKind() >= FirstStmtKind && N->GetKind() <= LastStmtKind;
+  }
+};
+
+#define AST_CLASSOF(X)                                          \
+  static bool classof(const X *) { return true; }               \
+  static bool classof(const Node *N) {                          \
+    return N->GetKind() == X##Kind;                             \
+  }
+
+//===----------------------------------------------------------------------===//
+// Expressions
+//===----------------------------------------------------------------------===//
+
+/// Name - An identifier.
+class Name : public Test {
+  Identifier Id;
+
+  Name(llvm::SMLoc Loc, Identifier Id) : Test(NameKind, Loc), Id(Id) {}
+public:
+  static Name *Get(ASTContext &C, llvm::SMLoc Loc, Identifier Id) {
+    return new (C) Name(Loc, Id);
+  }
+
+  Identifier GetId() const { return Id; }
+
+  AST_CLASSOF(Name)
+};
+
+/// Number - An integer or floating point literal.
+class Number : public Test {
+  bool IsFloat;
+  union {
+    int64_t IntValue;
+    double FloatValue;
+  };
+
+  Number(llvm::SMLoc Loc, bool IsFloat) : Test(NumberKind, Loc),
+                                          IsFloat(IsFloat) {}
+public:
+  static Number *GetInt(ASTContext &C, llvm::SMLoc Loc, int64_t V) {
+    Number *N = new (C) Number(Loc, false);
+    N->IntValue = V;
+    return N;
+  }
+  static Number *GetFloat(ASTContext &C, llvm::SMLoc Loc, double V) {
+    Number *N = new (C) Number(Loc, true);
+    N->FloatValue = V;
+    return N;
+  }
+
+  bool IsFloatingPoint() const { return IsFloat; }
+  int64_t GetIntValue() const {
+    assert(!IsFloat && "Not an integer!");
+    return IntValue;
+  }
+  double GetFloatValue() const {
+    assert(IsFloat && "Not a float!");
+    return FloatValue;
+  }
+
+  AST_CLASSOF(Number)
+};
+
+/// Str - A string literal, with quotes removed and escapes decoded.
+class Str : public Test {
+  llvm::StringRef Value;
+  bool IsUnicode;
+
+  Str(llvm::SMLoc Loc, llvm::StringRef Value, bool IsUnicode) :
+    Test(StrKind, Loc), Value(Value), IsUnicode(IsUnicode) {}
+public:
+  /// Get - Value must live as long as the tree; either it points into the
+  /// source buffer or it has been copied into C.
+  static Str *Get(ASTContext &C, llvm::SMLoc Loc, llvm::StringRef Value,
+                  bool IsUnicode = false) {
+    return new (C) Str(Loc, Value, IsUnicode);
+  }
+
+  llvm::StringRef GetValue() const { return Value; }
+  bool IsUnicodeString() const { return IsUnicode; }
+
+  AST_CLASSOF(Str)
+};
+
+/// TestList - A comma separated list of expressions; a tuple.
+class TestList : public Test {
+  llvm::ArrayRef<Test*> Elts;
+
+  TestList(llvm::SMLoc Loc, llvm::ArrayRef<Test*> Elts) :
+    Test(TestListKind, Loc), Elts(Elts) {}
+public:
+  static TestList *Get(ASTContext &C, llvm::SMLoc Loc,
+                       llvm::ArrayRef<Test*> Elts) {
+    return new (C) TestList(Loc, C.CopyArray(Elts));
+  }
+
+  llvm::ArrayRef<Test*> GetElements() const { return Elts; }
+
+  AST_CLASSOF(TestList)
+};
+
+/// List - A list display, [a, b].
+class List : public Test {
+  llvm::ArrayRef<Test*> Elts;
+
+  List(llvm::SMLoc Loc, llvm::ArrayRef<Test*> Elts) :
+    Test(ListKind, Loc), Elts(Elts) {}
+public:
+  static List *Get(ASTContext &C, llvm::SMLoc Loc,
+                   llvm::ArrayRef<Test*> Elts) {
+    return new (C) List(Loc, C.CopyArray(Elts));
+  }
+
+  llvm::ArrayRef<Test*> GetElements() const { return Elts; }
+
+  AST_CLASSOF(List)
+};
+
+/// Set - A set display, {a, b}.
+class Set : public Test {
+  llvm::ArrayRef<Test*> Elts;
+
+  Set(llvm::SMLoc Loc, llvm::ArrayRef<Test*> Elts) :
+    Test(SetKind, Loc), Elts(Elts) {}
+public:
+  static Set *Get(ASTContext &C, llvm::SMLoc Loc,
+                  llvm::ArrayRef<Test*> Elts) {
+    return new (C) Set(Loc, C.CopyArray(Elts));
+  }
+
+  llvm::ArrayRef<Test*> GetElements() const { return Elts; }
+
+  AST_CLASSOF(Set)
+};
+
+/// Dict - A dict display, {k: v}. Keys and values are parallel arrays.
+class Dict : public Test {
+  llvm::ArrayRef<Test*> Keys;
+  llvm::ArrayRef<Test*> Values;
+
+  Dict(llvm::SMLoc Loc, llvm::ArrayRef<Test*> Keys,
+       llvm::ArrayRef<Test*> Values) :
+    Test(DictKind, Loc), Keys(Keys), Values(Values) {}
+public:
+  static Dict *Get(ASTContext &C, llvm::SMLoc Loc, llvm::ArrayRef<Test*> Keys,
+                   llvm::ArrayRef<Test*> Values) {
+    assert(Keys.size() == Values.size() && "Unbalanced dict display!");
+    return new (C) Dict(Loc, C.CopyArray(Keys), C.CopyArray(Values));
+  }
+
+  llvm::ArrayRef<Test*> GetKeys() const { return Keys; }
+  llvm::ArrayRef<Test*> GetValues() const { return Values; }
+
+  AST_CLASSOF(Dict)
 };
 
-class Yield {
+/// Yield - 'yield' [testlist]. Value is null for a bare yield.
+class Yield : public Test {
+  TestList *Value;
+
+  Yield(llvm::SMLoc Loc, TestList *Value) : Test(YieldKind, Loc),
+                                            Value(Value) {}
 public:
+  static Yield *Get(ASTContext &C, llvm::SMLoc Loc, TestList *Value) {
+    return new (C) Yield(Loc, Value);
+  }
+
+  TestList *GetValue() const { return Value; }
+
+  AST_CLASSOF(Yield)
+};
+
+/// Comprehension - Element 'for' Target 'in' Iter ['if' Predicate]. Nested
+/// 'for's are represented by an Element that is itself a Comprehension.
+class Comprehension : public Test {
+  Node *Element;
+  Node *Target;
+  Node *Iter;
+  Test *Predicate;
+
+  Comprehension(llvm::SMLoc Loc, Node *Element, Node *Target, Node *Iter) :
+    Test(ComprehensionKind, Loc), Element(Element), Target(Target),
+    Iter(Iter), Predicate(0) {}
+public:
+  static Comprehension *Get(ASTContext &C, llvm::SMLoc Loc, Node *Element,
+                            Node *Target, Node *Iter) {
+    return new (C) Comprehension(Loc, Element, Target, Iter);
+  }
+
+  Node *GetElement() const { return Element; }
+  Node *GetTarget() const { return Target; }
+  Node *GetIter() const { return Iter; }
+  Test *GetPredicate() const { return Predicate; }
+  void SetPredicate(Test *P) { Predicate = P; }
+
+  AST_CLASSOF(Comprehension)
+};
+
+/// UnaryOp - Op Operand, where Op is tok::plus, tok::minus, tok::tilde or
+/// tok::kw_not.
+class UnaryOp : public Test {
+  tok::TokenKind Op;
+  Test *Operand;
+
+  UnaryOp(llvm::SMLoc Loc, tok::TokenKind Op, Test *Operand) :
+    Test(UnaryOpKind, Loc), Op(Op), Operand(Operand) {}
+public:
+  static UnaryOp *Get(ASTContext &C, llvm::SMLoc Loc, tok::TokenKind Op,
+                      Test *Operand) {
+    return new (C) UnaryOp(Loc, Op, Operand);
+  }
+
+  tok::TokenKind GetOp() const { return Op; }
+  Test *GetOperand() const { return Operand; }
+
+  AST_CLASSOF(UnaryOp)
+};
+
+/// BinaryOp - LHS Op RHS, where Op is the operator's token kind.
+class BinaryOp : public Test {
+  tok::TokenKind Op;
+  Test *LHS, *RHS;
+
+  BinaryOp(llvm::SMLoc Loc, tok::TokenKind Op, Test *LHS, Test *RHS) :
+    Test(BinaryOpKind, Loc), Op(Op), LHS(LHS), RHS(RHS) {}
+public:
+  static BinaryOp *Get(ASTContext &C, llvm::SMLoc Loc, tok::TokenKind Op,
+                       Test *LHS, Test *RHS) {
+    return new (C) BinaryOp(Loc, Op, LHS, RHS);
+  }
+
+  tok::TokenKind GetOp() const { return Op; }
+  Test *GetLHS() const { return LHS; }
+  Test *GetRHS() const { return RHS; }
+
+  AST_CLASSOF(BinaryOp)
+};
+
+/// BoolOp - A chain of 'and' or of 'or', which short-circuits.
+class BoolOp : public Test {
+  tok::TokenKind Op;
+  llvm::ArrayRef<Test*> Operands;
+
+  BoolOp(llvm::SMLoc Loc, tok::TokenKind Op, llvm::ArrayRef<Test*> Operands) :
+    Test(BoolOpKind, Loc), Op(Op), Operands(Operands) {}
+public:
+  static BoolOp *Get(ASTContext &C, llvm::SMLoc Loc, tok::TokenKind Op,
+                     llvm::ArrayRef<Test*> Operands) {
+    assert((Op == tok::kw_and || Op == tok::kw_or) && "Not a bool op!");
+    return new (C) BoolOp(Loc, Op, C.CopyArray(Operands));
+  }
+
+  tok::TokenKind GetOp() const { return Op; }
+  llvm::ArrayRef<Test*> GetOperands() const { return Operands; }
+
+  AST_CLASSOF(BoolOp)
+};
+
+/// Compare - A chained comparison, Operands[0] Ops[0] Operands[1] ...
+class Compare : public Test {
+public:
+  enum CmpOp {
+    Lt, Gt, Eq, GtE, LtE, NotEq, In, NotIn, Is, IsNot
+  };
+
+private:
+  llvm::ArrayRef<CmpOp> Ops;
+  llvm::ArrayRef<Test*> Operands;
+
+  Compare(llvm::SMLoc Loc, llvm::ArrayRef<CmpOp> Ops,
+          llvm::ArrayRef<Test*> Operands) :
+    Test(CompareKind, Loc), Ops(Ops), Operands(Operands) {}
+public:
+  static Compare *Get(ASTContext &C, llvm::SMLoc Loc,
+                      llvm::ArrayRef<CmpOp> Ops,
+                      llvm::ArrayRef<Test*> Operands) {
+    assert(Ops.size() + 1 == Operands.size() && "Bad comparison chain!");
+    return new (C) Compare(Loc, C.CopyArray(Ops), C.CopyArray(Operands));
+  }
+
+  llvm::ArrayRef<CmpOp> GetOps() const { return Ops; }
+  llvm::ArrayRef<Test*> GetOperands() const { return Operands; }
+
+  static const char *GetOpSpelling(CmpOp Op);
+
+  AST_CLASSOF(Compare)
+};
+
+/// IfExp - Then 'if' Cond 'else' Else.
+class IfExp : public Test {
+  Test *Cond, *Then, *Else;
+
+  IfExp(llvm::SMLoc Loc, Test *Cond, Test *Then, Test *Else) :
+    Test(IfExpKind, Loc), Cond(Cond), Then(Then), Else(Else) {}
+public:
+  static IfExp *Get(ASTContext &C, llvm::SMLoc Loc, Test *Cond, Test *Then,
+                    Test *Else) {
+    return new (C) IfExp(Loc, Cond, Then, Else);
+  }
+
+  Test *GetCond() const { return Cond; }
+  Test *GetThen() const { return Then; }
+  Test *GetElse() const { return Else; }
+
+  AST_CLASSOF(IfExp)
+};
+
+/// Arguments - The parameters of a function or lambda. Params are Names or,
+/// for unpacked tuple parameters, TestLists; the last Defaults.size() of
+/// them have defaults. VarArg and KwArg are empty when absent.
+struct Arguments {
+  llvm::ArrayRef<Test*> Params;
+  llvm::ArrayRef<Test*> Defaults;
+  llvm::StringRef VarArg;
+  llvm::StringRef KwArg;
+};
+
+/// Lambda - 'lambda' Args ':' Body.
+class Lambda : public Test {
+  Arguments Args;
+  Test *Body;
+
+  Lambda(llvm::SMLoc Loc, const Arguments &Args, Test *Body) :
+    Test(LambdaKind, Loc), Args(Args), Body(Body) {}
+public:
+  static Lambda *Get(ASTContext &C, llvm::SMLoc Loc, const Arguments &Args,
+                     Test *Body);
+
+  const Arguments &GetArgs() const { return Args; }
+  Test *GetBody() const { return Body; }
+
+  AST_CLASSOF(Lambda)
+};
+
+/// Keyword - A Name=Value argument of a call.
+struct Keyword {
+  llvm::StringRef Name;
+  Test *Value;
+};
+
+/// Call - Func(Args, Keywords, *StarArgs, **KwArgs).
+class Call : public Test {
+  Test *Func;
+  llvm::ArrayRef<Test*> Args;
+  llvm::ArrayRef<Keyword> Keywords;
+  Test *StarArgs;
+  Test *KwArgs;
+
+  Call(llvm::SMLoc Loc, Test *Func, llvm::ArrayRef<Test*> Args,
+       llvm::ArrayRef<Keyword> Keywords, Test *StarArgs, Test *KwArgs) :
+    Test(CallKind, Loc), Func(Func), Args(Args), Keywords(Keywords),
+    StarArgs(StarArgs), KwArgs(KwArgs) {}
+public:
+  static Call *Get(ASTContext &C, llvm::SMLoc Loc, Test *Func,
+                   llvm::ArrayRef<Test*> Args,
+                   llvm::ArrayRef<Keyword> Keywords = llvm::ArrayRef<Keyword>(),
+                   Test *StarArgs = 0, Test *KwArgs = 0) {
+    return new (C) Call(Loc, Func, C.CopyArray(Args), C.CopyArray(Keywords),
+                        StarArgs, KwArgs);
+  }
+
+  Test *GetFunc() const { return Func; }
+  llvm::ArrayRef<Test*> GetArgs() const { return Args; }
+  llvm::ArrayRef<Keyword> GetKeywords() const { return Keywords; }
+  Test *GetStarArgs() const { return StarArgs; }
+  Test *GetKwArgs() const { return KwArgs; }
+
+  AST_CLASSOF(Call)
+};
+
+/// Attribute - Value '.' Attr.
+class Attribute : public Test {
+  Test *Value;
+  Identifier Attr;
+
+  Attribute(llvm::SMLoc Loc, Test *Value, Identifier Attr) :
+    Test(AttributeKind, Loc), Value(Value), Attr(Attr) {}
+public:
+  static Attribute *Get(ASTContext &C, llvm::SMLoc Loc, Test *Value,
+                        Identifier Attr) {
+    return new (C) Attribute(Loc, Value, Attr);
+  }
+
+  Test *GetValue() const { return Value; }
+  Identifier GetAttr() const { return Attr; }
+
+  AST_CLASSOF(Attribute)
+};
+
+/// Subscript - Value '[' Index ']'. A subscript list is a TestList index.
+class Subscript : public Test {
+  Test *Value;
+  Test *Index;
+
+  Subscript(llvm::SMLoc Loc, Test *Value, Test *Index) :
+    Test(SubscriptKind, Loc), Value(Value), Index(Index) {}
+public:
+  static Subscript *Get(ASTContext &C, llvm::SMLoc Loc, Test *Value,
+                        Test *Index) {
+    return new (C) Subscript(Loc, Value, Index);
+  }
+
+  Test *GetValue() const { return Value; }
+  Test *GetIndex() const { return Index; }
+
+  AST_CLASSOF(Subscript)
+};
+
+/// Slice - [Lower] ':' [Upper] [':' [Step]], inside a subscript.
+class Slice : public Test {
+  Test *Lower, *Upper, *Step;
+
+  Slice(llvm::SMLoc Loc, Test *Lower, Test *Upper, Test *Step) :
+    Test(SliceKind, Loc), Lower(Lower), Upper(Upper), Step(Step) {}
+public:
+  static Slice *Get(ASTContext &C, llvm::SMLoc Loc, Test *Lower, Test *Upper,
+                    Test *Step) {
+    return new (C) Slice(Loc, Lower, Upper, Step);
+  }
+
+  Test *GetLower() const { return Lower; }
+  Test *GetUpper() const { return Upper; }
+  Test *GetStep() const { return Step; }
+
+  AST_CLASSOF(Slice)
+};
+
+/// Ellipsis - '...' inside a subscript.
+class Ellipsis : public Test {
+  Ellipsis(llvm::SMLoc Loc) : Test(EllipsisKind, Loc) {}
+public:
+  static Ellipsis *Get(ASTContext &C, llvm::SMLoc Loc) {
+    return new (C) Ellipsis(Loc);
+  }
+
+  AST_CLASSOF(Ellipsis)
+};
+
+/// Repr - '`' Value '`'.
+class Repr : public Test {
+  Test *Value;
+
+  Repr(llvm::SMLoc Loc, Test *Value) : Test(ReprKind, Loc), Value(Value) {}
+public:
+  static Repr *Get(ASTContext &C, llvm::SMLoc Loc, Test *Value) {
+    return new (C) Repr(Loc, Value);
+  }
+
+  Test *GetValue() const { return Value; }
+
+  AST_CLASSOF(Repr)
+};
+
+//===----------------------------------------------------------------------===//
+// Statements
+//===----------------------------------------------------------------------===//
+
+/// ExprStmt - An expression evaluated for its side effects.
+class ExprStmt : public Stmt {
+  Test *Value;
+
+  ExprStmt(llvm::SMLoc Loc, Test *Value) : Stmt(ExprStmtKind, Loc),
+                                           Value(Value) {}
+public:
+  static ExprStmt *Get(ASTContext &C, llvm::SMLoc Loc, Test *Value) {
+    return new (C) ExprStmt(Loc, Value);
+  }
+
+  Test *GetValue() const { return Value; }
+
+  AST_CLASSOF(ExprStmt)
+};
+
+/// Assign - Targets[0] = Targets[1] = ... = Value.
+class Assign : public Stmt {
+  llvm::ArrayRef<Test*> Targets;
+  Test *Value;
+
+  Assign(llvm::SMLoc Loc, llvm::ArrayRef<Test*> Targets, Test *Value) :
+    Stmt(AssignKind, Loc), Targets(Targets), Value(Value) {}
+public:
+  static Assign *Get(ASTContext &C, llvm::SMLoc Loc,
+                     llvm::ArrayRef<Test*> Targets, Test *Value) {
+    return new (C) Assign(Loc, C.CopyArray(Targets), Value);
+  }
+
+  llvm::ArrayRef<Test*> GetTargets() const { return Targets; }
+  Test *GetValue() const { return Value; }
+
+  AST_CLASSOF(Assign)
+};
+
+/// AugAssign - Target Op Value, where Op is e.g. tok::plusequal.
+class AugAssign : public Stmt {
+  Test *Target;
+  tok::TokenKind Op;
+  Test *Value;
+
+  AugAssign(llvm::SMLoc Loc, Test *Target, tok::TokenKind Op, Test *Value) :
+    Stmt(AugAssignKind, Loc), Target(Target), Op(Op), Value(Value) {}
+public:
+  static AugAssign *Get(ASTContext &C, llvm::SMLoc Loc, Test *Target,
+                        tok::TokenKind Op, Test *Value) {
+    return new (C) AugAssign(Loc, Target, Op, Value);
+  }
+
+  Test *GetTarget() const { return Target; }
+  tok::TokenKind GetOp() const { return Op; }
+  Test *GetValue() const { return Value; }
+
+  AST_CLASSOF(AugAssign)
+};
+
+/// Print - 'print' ['>>' Dest ','] Values, without a trailing newline if
+/// the statement ended in a comma.
+class Print : public Stmt {
+  Test *Dest;
+  llvm::ArrayRef<Test*> Values;
+  bool NewLine;
+
+  Print(llvm::SMLoc Loc, Test *Dest, llvm::ArrayRef<Test*> Values,
+        bool NewLine) :
+    Stmt(PrintKind, Loc), Dest(Dest), Values(Values), NewLine(NewLine) {}
+public:
+  static Print *Get(ASTContext &C, llvm::SMLoc Loc, Test *Dest,
+                    llvm::ArrayRef<Test*> Values, bool NewLine) {
+    return new (C) Print(Loc, Dest, C.CopyArray(Values), NewLine);
+  }
+
+  Test *GetDest() const { return Dest; }
+  llvm::ArrayRef<Test*> GetValues() const { return Values; }
+  bool HasNewLine() const { return NewLine; }
+
+  AST_CLASSOF(Print)
+};
+
+/// Del - 'del' Targets.
+class Del : public Stmt {
+  llvm::ArrayRef<Test*> Targets;
+
+  Del(llvm::SMLoc Loc, llvm::ArrayRef<Test*> Targets) :
+    Stmt(DelKind, Loc), Targets(Targets) {}
+public:
+  static Del *Get(ASTContext &C, llvm::SMLoc Loc,
+                  llvm::ArrayRef<Test*> Targets) {
+    return new (C) Del(Loc, C.CopyArray(Targets));
+  }
+
+  llvm::ArrayRef<Test*> GetTargets() const { return Targets; }
+
+  AST_CLASSOF(Del)
+};
+
+/// Pass - 'pass'.
+class Pass : public Stmt {
+  Pass(llvm::SMLoc Loc) : Stmt(PassKind, Loc) {}
+public:
+  static Pass *Get(ASTContext &C, llvm::SMLoc Loc) {
+    return new (C) Pass(Loc);
+  }
+
+  AST_CLASSOF(Pass)
+};
+
+/// Break - 'break'.
+class Break : public Stmt {
+  Break(llvm::SMLoc Loc) : Stmt(BreakKind, Loc) {}
+public:
+  static Break *Get(ASTContext &C, llvm::SMLoc Loc) {
+    return new (C) Break(Loc);
+  }
+
+  AST_CLASSOF(Break)
+};
+
+/// Continue - 'continue'.
+class Continue : public Stmt {
+  Continue(llvm::SMLoc Loc) : Stmt(ContinueKind, Loc) {}
+public:
+  static Continue *Get(ASTContext &C, llvm::SMLoc Loc) {
+    return new (C) Continue(Loc);
+  }
+
+  AST_CLASSOF(Continue)
+};
+
+/// Return - 'return' [Value].
+class Return : public Stmt {
+  Test *Value;
+
+  Return(llvm::SMLoc Loc, Test *Value) : Stmt(ReturnKind, Loc),
+                                         Value(Value) {}
+public:
+  static Return *Get(ASTContext &C, llvm::SMLoc Loc, Test *Value) {
+    return new (C) Return(Loc, Value);
+  }
+
+  Test *GetValue() const { return Value; }
+
+  AST_CLASSOF(Return)
+};
+
+/// Raise - 'raise' [Type [',' Inst [',' TBack]]].
+class Raise : public Stmt {
+  Test *Type, *Inst, *TBack;
+
+  Raise(llvm::SMLoc Loc, Test *Type, Test *Inst, Test *TBack) :
+    Stmt(RaiseKind, Loc), Type(Type), Inst(Inst), TBack(TBack) {}
+public:
+  static Raise *Get(ASTContext &C, llvm::SMLoc Loc, Test *Type, Test *Inst,
+                    Test *TBack) {
+    return new (C) Raise(Loc, Type, Inst, TBack);
+  }
+
+  Test *GetType() const { return Type; }
+  Test *GetInst() const { return Inst; }
+  Test *GetTBack() const { return TBack; }
+
+  AST_CLASSOF(Raise)
+};
+
+/// Global - 'global' Names.
+class Global : public Stmt {
+  llvm::ArrayRef<Identifier> Names;
+
+  Global(llvm::SMLoc Loc, llvm::ArrayRef<Identifier> Names) :
+    Stmt(GlobalKind, Loc), Names(Names) {}
+public:
+  static Global *Get(ASTContext &C, llvm::SMLoc Loc,
+                     llvm::ArrayRef<Identifier> Names) {
+    return new (C) Global(Loc, C.CopyArray(Names));
+  }
+
+  llvm::ArrayRef<Identifier> GetNames() const { return Names; }
+
+  AST_CLASSOF(Global)
+};
+
+/// Exec - 'exec' Body ['in' Globals [',' Locals]].
+class Exec : public Stmt {
+  Test *Body, *Globals, *Locals;
+
+  Exec(llvm::SMLoc Loc, Test *Body, Test *Globals, Test *Locals) :
+    Stmt(ExecKind, Loc), Body(Body), Globals(Globals), Locals(Locals) {}
+public:
+  static Exec *Get(ASTContext &C, llvm::SMLoc Loc, Test *Body, Test *Globals,
+                   Test *Locals) {
+    return new (C) Exec(Loc, Body, Globals, Locals);
+  }
+
+  Test *GetBody() const { return Body; }
+  Test *GetGlobals() const { return Globals; }
+  Test *GetLocals() const { return Locals; }
+
+  AST_CLASSOF(Exec)
+};
+
+/// Assert - 'assert' Cond [',' Msg].
+class Assert : public Stmt {
+  Test *Cond, *Msg;
+
+  Assert(llvm::SMLoc Loc, Test *Cond, Test *Msg) :
+    Stmt(AssertKind, Loc), Cond(Cond), Msg(Msg) {}
+public:
+  static Assert *Get(ASTContext &C, llvm::SMLoc Loc, Test *Cond, Test *Msg) {
+    return new (C) Assert(Loc, Cond, Msg);
+  }
+
+  Test *GetCond() const { return Cond; }
+  Test *GetMsg() const { return Msg; }
+
+  AST_CLASSOF(Assert)
+};
+
+/// Alias - Name ['as' AsName] in an import. Name may be dotted; AsName is
+/// empty when absent.
+struct Alias {
+  llvm::StringRef Name;
+  llvm::StringRef AsName;
+};
+
+/// Import - 'import' Names.
+class Import : public Stmt {
+  llvm::ArrayRef<Alias> Names;
+
+  Import(llvm::SMLoc Loc, llvm::ArrayRef<Alias> Names) :
+    Stmt(ImportKind, Loc), Names(Names) {}
+public:
+  static Import *Get(ASTContext &C, llvm::SMLoc Loc,
+                     llvm::ArrayRef<Alias> Names) {
+    return new (C) Import(Loc, C.CopyArray(Names));
+  }
+
+  llvm::ArrayRef<Alias> GetNames() const { return Names; }
+
+  AST_CLASSOF(Import)
+};
+
+/// ImportFrom - 'from' ('.' * Level) Module 'import' Names. An empty Names
+/// means 'import *'.
+class ImportFrom : public Stmt {
+  llvm::StringRef Module;
+  unsigned Level;
+  llvm::ArrayRef<Alias> Names;
+
+  ImportFrom(llvm::SMLoc Loc, llvm::StringRef Module, unsigned Level,
+             llvm::ArrayRef<Alias> Names) :
+    Stmt(ImportFromKind, Loc), Module(Module), Level(Level), Names(Names) {}
+public:
+  static ImportFrom *Get(ASTContext &C, llvm::SMLoc Loc,
+                         llvm::StringRef Module, unsigned Level,
+                         llvm::ArrayRef<Alias> Names) {
+    return new (C) ImportFrom(Loc, Module, Level, C.CopyArray(Names));
+  }
+
+  llvm::StringRef GetModule() const { return Module; }
+  unsigned GetLevel() const { return Level; }
+  llvm::ArrayRef<Alias> GetNames() const { return Names; }
+
+  AST_CLASSOF(ImportFrom)
+};
+
+/// If - 'if' Cond ':' Body ['else' ':' OrElse]. 'elif' is an If alone in
+/// OrElse.
+class If : public Stmt {
+  Test *Cond;
+  llvm::ArrayRef<Stmt*> Body;
+  llvm::ArrayRef<Stmt*> OrElse;
+
+  If(llvm::SMLoc Loc, Test *Cond, llvm::ArrayRef<Stmt*> Body,
+     llvm::ArrayRef<Stmt*> OrElse) :
+    Stmt(IfKind, Loc), Cond(Cond), Body(Body), OrElse(OrElse) {}
+public:
+  static If *Get(ASTContext &C, llvm::SMLoc Loc, Test *Cond,
+                 llvm::ArrayRef<Stmt*> Body, llvm::ArrayRef<Stmt*> OrElse) {
+    return new (C) If(Loc, Cond, C.CopyArray(Body), C.CopyArray(OrElse));
+  }
+
+  Test *GetCond() const { return Cond; }
+  llvm::ArrayRef<Stmt*> GetBody() const { return Body; }
+  llvm::ArrayRef<Stmt*> GetOrElse() const { return OrElse; }
+
+  AST_CLASSOF(If)
+};
+
+/// While - 'while' Cond ':' Body ['else' ':' OrElse].
+class While : public Stmt {
+  Test *Cond;
+  llvm::ArrayRef<Stmt*> Body;
+  llvm::ArrayRef<Stmt*> OrElse;
+
+  While(llvm::SMLoc Loc, Test *Cond, llvm::ArrayRef<Stmt*> Body,
+        llvm::ArrayRef<Stmt*> OrElse) :
+    Stmt(WhileKind, Loc), Cond(Cond), Body(Body), OrElse(OrElse) {}
+public:
+  static While *Get(ASTContext &C, llvm::SMLoc Loc, Test *Cond,
+                    llvm::ArrayRef<Stmt*> Body, llvm::ArrayRef<Stmt*> OrElse) {
+    return new (C) While(Loc, Cond, C.CopyArray(Body), C.CopyArray(OrElse));
+  }
+
+  Test *GetCond() const { return Cond; }
+  llvm::ArrayRef<Stmt*> GetBody() const { return Body; }
+  llvm::ArrayRef<Stmt*> GetOrElse() const { return OrElse; }
+
+  AST_CLASSOF(While)
+};
+
+/// For - 'for' Target 'in' Iter ':' Body ['else' ':' OrElse].
+class For : public Stmt {
+  Test *Target;
+  Test *Iter;
+  llvm::ArrayRef<Stmt*> Body;
+  llvm::ArrayRef<Stmt*> OrElse;
+
+  For(llvm::SMLoc Loc, Test *Target, Test *Iter, llvm::ArrayRef<Stmt*> Body,
+      llvm::ArrayRef<Stmt*> OrElse) :
+    Stmt(ForKind, Loc), Target(Target), Iter(Iter), Body(Body),
+    OrElse(OrElse) {}
+public:
+  static For *Get(ASTContext &C, llvm::SMLoc Loc, Test *Target, Test *Iter,
+                  llvm::ArrayRef<Stmt*> Body, llvm::ArrayRef<Stmt*> OrElse) {
+    return new (C) For(Loc, Target, Iter, C.CopyArray(Body),
+                       C.CopyArray(OrElse));
+  }
+
+  Test *GetTarget() const { return Target; }
+  Test *GetIter() const { return Iter; }
+  llvm::ArrayRef<Stmt*> GetBody() const { return Body; }
+  llvm::ArrayRef<Stmt*> GetOrElse() const { return OrElse; }
+
+  AST_CLASSOF(For)
+};
+
+/// ExceptHandler - 'except' [Type [',' Target]] ':' Body.
+struct ExceptHandler {
+  llvm::SMLoc Loc;
+  Test *Type;
+  Test *Target;
+  llvm::ArrayRef<Stmt*> Body;
+};
+
+/// TryExcept - 'try' ':' Body Handlers ['else' ':' OrElse]. A try with a
+/// 'finally' as well is a TryExcept inside a TryFinally.
+class TryExcept : public Stmt {
+  llvm::ArrayRef<Stmt*> Body;
+  llvm::ArrayRef<ExceptHandler> Handlers;
+  llvm::ArrayRef<Stmt*> OrElse;
+
+  TryExcept(llvm::SMLoc Loc, llvm::ArrayRef<Stmt*> Body,
+            llvm::ArrayRef<ExceptHandler> Handlers,
+            llvm::ArrayRef<Stmt*> OrElse) :
+    Stmt(TryExceptKind, Loc), Body(Body), Handlers(Handlers),
+    OrElse(OrElse) {}
+public:
+  /// Get - The handlers' bodies must already be in C.
+  static TryExcept *Get(ASTContext &C, llvm::SMLoc Loc,
+                        llvm::ArrayRef<Stmt*> Body,
+                        llvm::ArrayRef<ExceptHandler> Handlers,
+                        llvm::ArrayRef<Stmt*> OrElse) {
+    return new (C) TryExcept(Loc, C.CopyArray(Body), C.CopyArray(Handlers),
+                             C.CopyArray(OrElse));
+  }
+
+  llvm::ArrayRef<Stmt*> GetBody() const { return Body; }
+  llvm::ArrayRef<ExceptHandler> GetHandlers() const { return Handlers; }
+  llvm::ArrayRef<Stmt*> GetOrElse() const { return OrElse; }
+
+  AST_CLASSOF(TryExcept)
+};
+
+/// TryFinally - 'try' ':' Body 'finally' ':' FinalBody.
+class TryFinally : public Stmt {
+  llvm::ArrayRef<Stmt*> Body;
+  llvm::ArrayRef<Stmt*> FinalBody;
+
+  TryFinally(llvm::SMLoc Loc, llvm::ArrayRef<Stmt*> Body,
+             llvm::ArrayRef<Stmt*> FinalBody) :
+    Stmt(TryFinallyKind, Loc), Body(Body), FinalBody(FinalBody) {}
+public:
+  static TryFinally *Get(ASTContext &C, llvm::SMLoc Loc,
+                         llvm::ArrayRef<Stmt*> Body,
+                         llvm::ArrayRef<Stmt*> FinalBody) {
+    return new (C) TryFinally(Loc, C.CopyArray(Body), C.CopyArray(FinalBody));
+  }
+
+  llvm::ArrayRef<Stmt*> GetBody() const { return Body; }
+  llvm::ArrayRef<Stmt*> GetFinalBody() const { return FinalBody; }
+
+  AST_CLASSOF(TryFinally)
+};
+
+/// With - 'with' ContextExpr ['as' Vars] ':' Body. Several items are nested
+/// Withs.
+class With : public Stmt {
+  Test *ContextExpr;
+  Test *Vars;
+  llvm::ArrayRef<Stmt*> Body;
+
+  With(llvm::SMLoc Loc, Test *ContextExpr, Test *Vars,
+       llvm::ArrayRef<Stmt*> Body) :
+    Stmt(WithKind, Loc), ContextExpr(ContextExpr), Vars(Vars), Body(Body) {}
+public:
+  static With *Get(ASTContext &C, llvm::SMLoc Loc, Test *ContextExpr,
+                   Test *Vars, llvm::ArrayRef<Stmt*> Body) {
+    return new (C) With(Loc, ContextExpr, Vars, C.CopyArray(Body));
+  }
+
+  Test *GetContextExpr() const { return ContextExpr; }
+  Test *GetVars() const { return Vars; }
+  llvm::ArrayRef<Stmt*> GetBody() const { return Body; }
+
+  AST_CLASSOF(With)
+};
+
+/// FunctionDef - Decorators 'def' Name '(' Args ')' ':' Body.
+class FunctionDef : public Stmt {
+  llvm::StringRef Name;
+  Arguments Args;
+  llvm::ArrayRef<Stmt*> Body;
+  llvm::ArrayRef<Test*> Decorators;
+
+  FunctionDef(llvm::SMLoc Loc, llvm::StringRef Name, const Arguments &Args,
+              llvm::ArrayRef<Stmt*> Body, llvm::ArrayRef<Test*> Decorators) :
+    Stmt(FunctionDefKind, Loc), Name(Name), Args(Args), Body(Body),
+    Decorators(Decorators) {}
+public:
+  static FunctionDef *Get(ASTContext &C, llvm::SMLoc Loc,
+                          llvm::StringRef Name, const Arguments &Args,
+                          llvm::ArrayRef<Stmt*> Body,
+                          llvm::ArrayRef<Test*> Decorators);
+
+  llvm::StringRef GetName() const { return Name; }
+  const Arguments &GetArgs() const { return Args; }
+  llvm::ArrayRef<Stmt*> GetBody() const { return Body; }
+  llvm::ArrayRef<Test*> GetDecorators() const { return Decorators; }
+
+  AST_CLASSOF(FunctionDef)
+};
+
+/// ClassDef - Decorators 'class' Name ['(' Bases ')'] ':' Body.
+class ClassDef : public Stmt {
+  llvm::StringRef Name;
+  llvm::ArrayRef<Test*> Bases;
+  llvm::ArrayRef<Stmt*> Body;
+  llvm::ArrayRef<Test*> Decorators;
+
+  ClassDef(llvm::SMLoc Loc, llvm::StringRef Name, llvm::ArrayRef<Test*> Bases,
+           llvm::ArrayRef<Stmt*> Body, llvm::ArrayRef<Test*> Decorators) :
+    Stmt(ClassDefKind, Loc), Name(Name), Bases(Bases), Body(Body),
+    Decorators(Decorators) {}
+public:
+  static ClassDef *Get(ASTContext &C, llvm::SMLoc Loc, llvm::StringRef Name,
+                       llvm::ArrayRef<Test*> Bases,
+                       llvm::ArrayRef<Stmt*> Body,
+                       llvm::ArrayRef<Test*> Decorators) {
+    return new (C) ClassDef(Loc, Name, C.CopyArray(Bases), C.CopyArray(Body),
+                            C.CopyArray(Decorators));
+  }
+
+  llvm::StringRef GetName() const { return Name; }
+  llvm::ArrayRef<Test*> GetBases() const { return Bases; }
+  llvm::ArrayRef<Stmt*> GetBody() const { return Body; }
+  llvm::ArrayRef<Test*> GetDecorators() const { return Decorators; }
+
+  AST_CLASSOF(ClassDef)
+};
+
+//===----------------------------------------------------------------------===//
+// Modules
+//===----------------------------------------------------------------------===//
+
+/// Module - The statements of one file.
+class Module : public Node {
+  llvm::ArrayRef<Stmt*> Body;
+
+  Module(llvm::SMLoc Loc, llvm::ArrayRef<Stmt*> Body) :
+    Node(ModuleKind, Loc), Body(Body) {}
+public:
+  static Module *Get(ASTContext &C, llvm::SMLoc Loc,
+                     llvm::ArrayRef<Stmt*> Body) {
+    return new (C) Module(Loc, C.CopyArray(Body));
+  }
+
+  llvm::ArrayRef<Stmt*> GetBody() const { return Body; }
+
+  AST_CLASSOF(Module)
+};
 
+#undef AST_CLASSOF
 
 }
 }
@@ -0,0 +1,70 @@
+//===--- ASTContext.h - Storage for one module's AST ------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the ASTContext interface, the arena that every node and
+//  child array of a module's AST is allocated from.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_ASTCONTEXT_H
+#define LLVM_PY_ASTCONTEXT_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include <cstring>
+#include <memory>
+
+namespace py {
+namespace ast {
+
+/// ASTContext - Owns the memory of one module's AST. Nodes are bump
+/// allocated and never destroyed individually; they have no destructors to
+/// run, so the whole tree goes away at once when the ASTContext does.
+class ASTContext {
+  llvm::BumpPtrAllocator Allocator;
+
+  ASTContext(const ASTContext&);     // DO NOT IMPLEMENT
+  void operator=(const ASTContext&); // DO NOT IMPLEMENT
+
+public:
+  ASTContext() {}
+
+  void *Allocate(size_t Size, unsigned Align = 8) {
+    return Allocator.Allocate(Size, Align);
+  }
+
+  /// CopyArray - Copy A into the arena. Elements must not need destroying.
+  template <typename T>
+  llvm::ArrayRef<T> CopyArray(llvm::ArrayRef<T> A) {
+    if (A.empty())
+      return llvm::ArrayRef<T>();
+    T *Mem = Allocator.Allocate<T>(A.size());
+    std::uninitialized_copy(A.begin(), A.end(), Mem);
+    return llvm::ArrayRef<T>(Mem, A.size());
+  }
+
+  /// CopyString - Copy S into the arena, so it outlives the buffer it came
+  /// from.
+  llvm::StringRef CopyString(llvm::StringRef S) {
+    if (S.empty())
+      return llvm::StringRef();
+    char *Mem = Allocator.Allocate<char>(S.size());
+    memcpy(Mem, S.data(), S.size());
+    return llvm::StringRef(Mem, S.size());
+  }
+
+  /// getTotalMemory - Return the number of bytes the arena has allocated.
+  size_t getTotalMemory() const { return Allocator.getTotalMemory(); }
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,70 @@
+//===--- ConstantFolder.h - Fold constant expressions -----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the ConstantFolder, which replaces expressions over
+//  literals with the literal they evaluate to as the AST is built.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_CONSTANTFOLDER_H
+#define LLVM_PY_CONSTANTFOLDER_H
+
+#include "py/Parse/AST.h"
+
+namespace py {
+namespace ast {
+
+/// ConstantFolder - Folds arithmetic on numbers, concatenation and
+/// repetition of strings, and tuples of literals.
+///
+/// An expression is only folded if evaluating it can't fail and gives the
+/// same result every time: overflow, division by zero and negative shifts
+/// are left for the runtime to report, and strings are only built up to
+/// MaxStringSize bytes. New nodes are allocated from the ASTContext; the
+/// old ones are simply dropped.
+class ConstantFolder {
+  ASTContext &C;
+  unsigned NumFolded;
+
+public:
+  /// The longest string repetition will build.
+  static const size_t MaxStringSize = 4096;
+
+  explicit ConstantFolder(ASTContext &C) : C(C), NumFolded(0) {}
+
+  /// Fold - Return the literal T evaluates to, or T if it can't be folded.
+  /// Meant to be called on each expression as the parser builds it, so
+  /// that children are folded first, but UnaryOp, BinaryOp and TestList
+  /// operands are folded here as well.
+  Test *Fold(Test *T);
+
+  /// Concat - Join adjacent string literals, STRING+ in the grammar, into
+  /// one at the location of the first.
+  Str *Concat(llvm::ArrayRef<Str*> Strs);
+
+  /// IsConstant - Return true if T is a literal: a number, a string, or a
+  /// tuple of literals.
+  static bool IsConstant(const Test *T);
+
+  /// GetNumFolded - Return how many expressions have been folded.
+  unsigned GetNumFolded() const { return NumFolded; }
+
+private:
+  Test *FoldUnaryOp(UnaryOp *U);
+  Test *FoldBinaryOp(BinaryOp *B);
+  Test *FoldTestList(TestList *L);
+  Test *FoldNumbers(BinaryOp *B, Number *X, Number *Y);
+  Test *FoldStrings(BinaryOp *B, Test *X, Test *Y);
+  Str *Join(llvm::ArrayRef<Str*> Strs);
+};
+
+}
+}
+
+#endif
@@ -14,15 +14,20 @@
 #ifndef LLVM_PY_PARSER_H
 #define LLVM_PY_PARSER_H
 
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Module.h"
 #include "llvm/LLVMContext.h"
+#include "py/Lex/IdentifierTable.h"
 #include "py/Lex/Token.h"
+#include "py/Lex/TokenStream.h"
 #include "py/Diagnostic.h"
+#include "py/Parse/AST.h"
 #include "py/Parse/TreePrinter.h"
 
 namespace llvm {
   class Constant;
+  class GlobalVariable;
   class StringRef;
   class Twine;
   class raw_ostream;
@@ -38,10 +43,21 @@ class GroupBlock;
 
 /// Parser - This takes a Lexer and produces LLVM bitcode from it,
 /// with calls to Python intrinsics for complex behaviour.
+///
+/// The Parser doesn't call Lexer::Lex for each token. It reads the tokens
+/// of the whole buffer by index from a TokenStream: the one the Lexer was
+/// told to replay, or one it fills from the Lexer when it is created.
 class Parser {
-  /// The Lexer this Parser reads from.
+  /// The Lexer whose buffer this Parser reads.
   Lexer &L;
 
+  /// The tokens of the buffer: the Lexer's replay stream, or OwnTokens.
+  const TokenStream *Tokens;
+  TokenStream OwnTokens;
+
+  /// Index in Tokens of the next token Lex returns.
+  unsigned NextToken;
+
   /// Runtime to use.
   Runtime &R;
 
@@ -54,6 +70,19 @@ class Parser {
   /// Diagnostic array.
   llvm::SmallVector<Diagnostic, 5> Diagnostics;
 
+  /// Arena for the AST of the module being parsed.
+  ast::ASTContext ASTCtx;
+
+  /// Identifiers and decoded string literals of the module. This is the
+  /// Lexer's table if the caller gave it one, otherwise OwnIdents, which the
+  /// Lexer interns in until the Parser is destroyed.
+  IdentifierTable *Idents;
+  IdentifierTable OwnIdents;
+
+  /// Globals holding the string constants of Mod, by contents, so that each
+  /// is emitted once however many times it occurs.
+  llvm::StringMap<llvm::GlobalVariable*> StringPool;
+
   /// Output stream for dumping the tree structure to.
   /// FIXME: #ifdef DEBUG
   TreePrinter DebugStream;
@@ -86,6 +115,7 @@ public:
   /// stream to write debug info to (can be nulls()).
   Parser(Lexer &L, Runtime &R, llvm::LLVMContext &C, llvm::Module &M,
          llvm::raw_ostream &DS);
+  ~Parser();
 
   /// Main parse routine - lexes tokens until EOF. Continues
   /// if Warning diagnostics produced, stops on Errors.
@@ -97,10 +127,42 @@ public:
   /// at a particular rule (and takes a token input);
   bool ParseRule(std::string Rule, Token &T);
 
+  /// Lex - Fill T with the next token and move past it. Once the end of
+  /// the stream is reached, T is its eof token however often this is
+  /// called; a stream cut short by a lexer error also ends in eof.
+  void Lex(Token &T) {
+    Peek(T);
+    if (NextToken + 1 < Tokens->size())
+      ++NextToken;
+  }
+
+  /// Peek - Fill T with the next token, without moving past it. Any token
+  /// ahead can be looked at with getTokens().
+  void Peek(Token &T) const {
+    Tokens->getToken(NextToken, T);
+    // Names lexed ahead of time without the table are interned here.
+    if (T.getKind() == tok::identifier && !T.getIdentifier().isValid())
+      T.setIdentifier(Idents->get(T.getSpelling()));
+  }
+
+  const TokenStream &getTokens() const { return *Tokens; }
+
   llvm::SmallVector<Diagnostic, 5> &getDiagnostics() {
     return Diagnostics;
   }
 
+  /// getASTContext - Return the arena the AST is allocated from. The tree is
+  /// freed with the Parser.
+  ast::ASTContext &getASTContext() { return ASTCtx; }
+
+  /// getIdentifierTable - Return the table names and string literals are
+  /// interned in.
+  IdentifierTable &getIdentifierTable() { return *Idents; }
+
+  /// GetConstantString - Return a private unnamed_addr constant global of
+  /// the Module initialized to T. Equal strings share one global.
+  llvm::GlobalVariable *GetConstantString(const llvm::Twine &T);
+
 private:
   PNode ParseFileInput();
   PNode ParseStmt(Token &T);
@@ -143,18 +205,18 @@ private:
   /// Emits a diagnostic to the diagnostics list.
   void Diag(Token &T, const char *str, Diagnostic::Severity s);
 
-  /// Checks the Lexer object to see if any fatal errors have
-  /// occurred (or just warnings).
-  bool AreLexerErrors();
-
   /// Removes escapes from the string, and removes the surrounding
   /// quotes.
   ///
-  /// Encodes as UTF-8.
+  /// Encodes as UTF-8. A literal without escapes is returned as a slice of
+  /// S; one with escapes is decoded into memory owned by the Parser. Equal
+  /// literals return the same StringRef, so they can be compared by pointer.
   llvm::StringRef SanitizeString(llvm::StringRef S);
-  
-  /// Returns a ConstantArray initialized to T.
-  llvm::Constant *GetConstantString(const llvm::Twine &T);
+
+  /// Returns the interned copy of S from the IdentifierTable. If S is stable
+  /// (outlives the table) and hasn't been seen before, it becomes the
+  /// interned copy itself.
+  llvm::StringRef InternString(llvm::StringRef S, bool IsStable);
 
 };
 
@@ -0,0 +1,123 @@
+//===--- Scope.h - Name scopes ----------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines ScopeAnalysis, which works out where each name of a
+//  module is bound, following the rules of Python 2.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_SCOPE_H
+#define LLVM_PY_SCOPE_H
+
+#include "py/Parse/AST.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include <vector>
+
+namespace py {
+namespace ast {
+
+/// Scope - The names of a module, function (or lambda) or class body.
+class Scope {
+public:
+  enum ScopeKind { ModuleScope, FunctionScope, ClassScope };
+
+  enum Binding {
+    /// Bound in this scope, and used by no nested function. A class's
+    /// Local may also be passed on to nested functions; see IsFreeInClass.
+    Local,
+    /// The module's; declared global, or used and bound nowhere around.
+    Global,
+    /// Bound in this function scope and used by a nested one, so it is
+    /// kept in a cell the nested functions share.
+    Cell,
+    /// A Cell of an enclosing function.
+    Free
+  };
+
+private:
+  ScopeKind Kind;
+  const Node *N;
+  Scope *Parent;
+  llvm::SmallVector<Scope*, 4> Children;
+
+  /// What ScopeBuilder saw of each name: ScopeBuilder::FlagBits.
+  llvm::StringMap<unsigned> Flags;
+  llvm::StringMap<Binding> Bindings;
+  /// Names bound here, in the order they were first bound; parameters come
+  /// first.
+  std::vector<llvm::StringRef> Bound;
+  std::vector<llvm::StringRef> FreeNames;
+  bool Optimized;
+
+  friend class ScopeAnalysis;
+  friend class ScopeBuilder;
+
+  Scope(ScopeKind K, const Node *N, Scope *Parent) :
+    Kind(K), N(N), Parent(Parent), Optimized(K == FunctionScope) {}
+
+public:
+  ScopeKind GetKind() const { return Kind; }
+  /// GetNode - The Module, FunctionDef, Lambda or ClassDef of the scope.
+  const Node *GetNode() const { return N; }
+  Scope *GetParent() const { return Parent; }
+  llvm::ArrayRef<Scope*> GetChildren() const { return Children; }
+
+  /// Lookup - Return how Name is bound in this scope. Names the scope
+  /// doesn't mention are Global.
+  Binding Lookup(llvm::StringRef Name) const;
+
+  /// GetBoundNames - The names bound in this scope, Local or Cell,
+  /// parameters first.
+  llvm::ArrayRef<llvm::StringRef> GetBoundNames() const { return Bound; }
+
+  /// GetFreeNames - The Free names, and for a class the names it is free
+  /// in, in the order the cells are passed in the closure of the function.
+  llvm::ArrayRef<llvm::StringRef> GetFreeNames() const { return FreeNames; }
+
+  /// IsFreeInClass - Return true if Name is bound in this class scope, so
+  /// Local, but used by a nested function as a Free name of a function
+  /// around the class; the class passes that cell on all the same.
+  bool IsFreeInClass(llvm::StringRef Name) const;
+
+  /// IsOptimized - Return true if the Local names of the scope can be kept
+  /// out of a namespace dict. Only function scopes without 'import *' or
+  /// an unqualified exec are.
+  bool IsOptimized() const { return Optimized; }
+};
+
+/// ScopeAnalysis - The scopes of a module.
+///
+/// List comprehensions bind their targets in the scope around them, as in
+/// Python 2. The AST doesn't tell generator expressions from them, so
+/// those are treated the same way.
+class ScopeAnalysis {
+  std::vector<Scope*> Scopes;
+  llvm::DenseMap<const Node*, Scope*> ScopeOf;
+
+  ScopeAnalysis(const ScopeAnalysis&); // DO NOT IMPLEMENT
+  void operator=(const ScopeAnalysis&);  // DO NOT IMPLEMENT
+
+  friend class ScopeBuilder;
+
+public:
+  explicit ScopeAnalysis(const Module *M);
+  ~ScopeAnalysis();
+
+  Scope *GetModuleScope() const { return Scopes.front(); }
+  /// GetScope - Return the scope of the body of N, a Module, FunctionDef,
+  /// Lambda or ClassDef.
+  Scope *GetScope(const Node *N) const { return ScopeOf.lookup(N); }
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,116 @@
+//===--- Comprehension.h - Comprehension loop nests -------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines ComprehensionBuilder, which emits the for and if
+//  clauses of a comprehension as one loop nest.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef RUNTIME_COMPREHENSION_H
+#define RUNTIME_COMPREHENSION_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/DataTypes.h"
+
+namespace llvm {
+  class BasicBlock;
+  class Function;
+  class Module;
+  class Value;
+}
+
+namespace py {
+
+class Runtime;
+
+/// ComprehensionBuilder - Emits a comprehension's clauses, outermost first,
+/// as a nest of loops, with each if clause skipping to the next iteration
+/// of the loop it follows.
+///
+/// A loop over a range() or a tuple or list is a counted loop, with no
+/// iterator object and no call per iteration to advance it; anything else
+/// goes through the iteration protocol. The item of each loop is borrowed
+/// for one iteration.
+///
+/// The result list is sized up front from the outermost loop's trip count
+/// when that is known before the nest runs.
+///
+/// Sizes and indices are passed to the runtime as size_t, which is the
+/// Module's pointer-sized int, so its data layout must be set first.
+class ComprehensionBuilder {
+  Runtime &R;
+  llvm::Module &M;
+  llvm::Function *F;
+
+  /// Loop - One for clause.
+  struct Loop {
+    /// Where the next iteration starts, from the body or a failed if.
+    llvm::BasicBlock *Latch;
+  };
+  llvm::SmallVector<Loop, 4> Loops;
+
+  /// Where the nest starts, and the block after it.
+  llvm::BasicBlock *Preheader, *Exit;
+  /// Where the innermost clause continues.
+  llvm::BasicBlock *Body;
+
+  /// The outermost loop's trip count, if known before the nest runs.
+  llvm::Value *TripCount;
+  unsigned NumFilters;
+
+  ComprehensionBuilder(const ComprehensionBuilder&); // DO NOT IMPLEMENT
+  void operator=(const ComprehensionBuilder&);       // DO NOT IMPLEMENT
+
+  llvm::BasicBlock *GetOuterLatch() const;
+  llvm::Value *EmitCountedLoop(llvm::Value *Start, llvm::Value *Stop,
+                               int64_t Step, bool ReloadStop,
+                               llvm::Value *Seq);
+  llvm::Value *EmitSeqSize(llvm::BasicBlock *BB, llvm::Value *Seq);
+
+public:
+  /// Starts a nest at the end of BB.
+  ComprehensionBuilder(Runtime &R, llvm::Module &M, llvm::BasicBlock *BB);
+
+  /// Adds 'for x in range(Start, Stop, Step)', where Start and Stop are
+  /// i64s of small ints and Step is not zero. Returns x, as an i64.
+  llvm::Value *AddRange(llvm::Value *Start, llvm::Value *Stop, int64_t Step);
+
+  /// Adds 'for x in Seq', where Seq is known to be a tuple or list, and
+  /// returns x.
+  llvm::Value *AddSequence(llvm::Value *Seq);
+
+  /// Adds 'for x in Iterable', for anything else, and returns x.
+  llvm::Value *AddIterable(llvm::Value *Iterable);
+
+  /// Adds 'if Cond', where Cond is an i1.
+  void AddFilter(llvm::Value *Cond);
+
+  /// Returns the block the element is computed in, after every clause.
+  llvm::BasicBlock *GetBody() const { return Body; }
+  /// Sets the block the element computation ended in.
+  void SetBody(llvm::BasicBlock *BB) { Body = BB; }
+
+  /// Emits, before the nest, the list the comprehension builds, with room
+  /// for the outermost loop's trip count if it is known and no if clause
+  /// can drop items. Call it once every clause has been added.
+  llvm::Value *EmitNewList();
+  /// Emits the append of V to the list L at the end of the body.
+  void EmitAppend(llvm::Value *L, llvm::Value *V);
+  /// Emits, before the nest, the dict a dict comprehension builds.
+  llvm::Value *EmitNewDict();
+  /// Emits D[K] = V at the end of the body.
+  void EmitSetItem(llvm::Value *D, llvm::Value *K, llvm::Value *V);
+
+  /// Closes every loop, and returns the block after the nest.
+  llvm::BasicBlock *Finish();
+};
+
+}
+
+#endif
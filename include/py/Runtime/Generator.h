@@ -0,0 +1,122 @@
+//===--- Generator.h - Generators as state machines -------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines GeneratorBuilder, which compiles a generator into a
+//  resume function over a frame, rather than running it on a stack of its
+//  own through Runtime::Yield and Runtime::GeneratorFactory.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef RUNTIME_GENERATOR_H
+#define RUNTIME_GENERATOR_H
+
+#include "llvm/ADT/ArrayRef.h"
+
+namespace llvm {
+  class BasicBlock;
+  class Function;
+  class Module;
+  class StructType;
+  class SwitchInst;
+  class Twine;
+  class Type;
+  class Value;
+}
+
+namespace py {
+
+class Runtime;
+
+/// GeneratorBuilder - Builds a generator as a state machine.
+///
+/// The generator's body goes in a resume function, PythonObject *(i8*
+/// Frame), which switches on the state kept at the start of the frame to
+/// the block after the yield it last stopped at. Anything live across a
+/// yield must be kept in one of the frame's slots, whose types are given up
+/// front. Slots of object pointer type are owned by the frame: the destroy
+/// function releases the non-null ones, so code that releases one itself
+/// must null it.
+///
+/// Where the generator escapes, EmitHeapGenerator wraps the frame in a
+/// runtime generator object, which py_nextiteration resumes with a direct
+/// call. Where it doesn't, as when a comprehension feeds a for loop, the
+/// frame goes on the caller's stack and the caller calls the resume
+/// function itself, so nothing is allocated and, once the resume function
+/// is inlined, the frame is promoted to registers.
+class GeneratorBuilder {
+  Runtime &R;
+  llvm::Module &M;
+  llvm::StructType *FrameTy;
+  llvm::Function *Resume, *Destroy;
+  /// The frame, in the resume function.
+  llvm::Value *Frame;
+  llvm::BasicBlock *Body, *Done;
+  llvm::SwitchInst *Dispatch;
+  unsigned NumYields;
+
+  GeneratorBuilder(const GeneratorBuilder&); // DO NOT IMPLEMENT
+  void operator=(const GeneratorBuilder&);   // DO NOT IMPLEMENT
+
+  llvm::Function *CreateDestroy(const llvm::Twine &Name);
+
+public:
+  /// Creates the resume function, Name.resume, and destroy function,
+  /// Name.destroy, of a generator with the given frame slots, in M.
+  GeneratorBuilder(Runtime &R, llvm::Module &M, const llvm::Twine &Name,
+                   llvm::ArrayRef<llvm::Type*> Slots);
+
+  llvm::Function *GetResumeFunction() const { return Resume; }
+  /// Returns null if no slot holds an object.
+  llvm::Function *GetDestroyFunction() const { return Destroy; }
+  llvm::StructType *GetFrameType() const { return FrameTy; }
+
+  // Building the body.
+
+  /// Returns the block the body starts in, the first time it is resumed.
+  llvm::BasicBlock *GetBody() const { return Body; }
+
+  /// Emits, at the end of BB, a block of the body, the address of slot I.
+  llvm::Value *EmitSlot(llvm::BasicBlock *BB, unsigned I);
+
+  /// Emits a yield of V, a new reference, at the end of *BB, and updates
+  /// *BB to the block the next resume continues in.
+  void EmitYield(llvm::BasicBlock **BB, llvm::Value *V);
+
+  /// Emits the end of the generator at the end of BB. Resuming it again
+  /// returns null at once.
+  void EmitReturn(llvm::BasicBlock *BB);
+
+  // Using the generator, from another function of M.
+
+  /// Emits a frame on the stack of BB's function, zeroed at the end of BB,
+  /// and returns it as an i8*. The caller must call EmitDestroy on it when
+  /// it is done.
+  llvm::Value *EmitStackFrame(llvm::BasicBlock *BB);
+
+  /// Emits, at the end of BB, a runtime generator object around a new
+  /// frame, and returns it. *FrameOut is set to the frame, as an i8*, to
+  /// fill in slots with.
+  llvm::Value *EmitHeapGenerator(llvm::BasicBlock *BB,
+                                 llvm::Value **FrameOut);
+
+  /// Emits, at the end of BB, the address of slot I of Frame.
+  llvm::Value *EmitFrameSlot(llvm::BasicBlock *BB, llvm::Value *Frame,
+                             unsigned I);
+
+  /// Emits a direct resume of Frame at the end of BB, and returns the value
+  /// it yields, or null once it has finished.
+  llvm::Value *EmitResume(llvm::BasicBlock *BB, llvm::Value *Frame);
+
+  /// Emits the release of what a stack Frame holds at the end of BB.
+  void EmitDestroy(llvm::BasicBlock *BB, llvm::Value *Frame);
+};
+
+}
+
+#endif
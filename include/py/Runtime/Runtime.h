@@ -16,9 +16,15 @@
 #define RUNTIME_RUNTIME_H
 
 namespace llvm {
+    class BasicBlock;
+    class Constant;
     class LLVMContext;
     class Function;
+    class IntegerType;
+    class Module;
+    class StructType;
     class Type;
+    class Value;
 }
 
 namespace py {
@@ -38,6 +44,10 @@ public:
         SentinelOne, //< All functions above this take 1 argument.
 
         Bind,
+        IntAdd,
+        IntSub,
+        IntMul,
+        Cmp,
 
         SentinelTwo, //< All functions above this take 2 arguments.
 
@@ -55,6 +65,12 @@ public:
     /// support function.
     llvm::Function *Function(Fns Fn);
 
+    /// Returns the declaration of the given runtime support function in M.
+    llvm::Constant *GetFunction(llvm::Module &M, Fns Fn);
+
+    /// Returns the symbol of the given runtime support function.
+    static const char *GetFunctionName(Fns Fn);
+
     /// Returns the type of all python objects.
     llvm::Type *GetObjectTy() const {
         return ObjectTy;
@@ -68,12 +84,68 @@ public:
         return PtrVoidTy;
     }
 
+    /// Returns the int type as wide as a pointer in M, which small ints and
+    /// the runtime's size_t are. It comes from M's data layout, so set that
+    /// before emitting code into M; a Module without one is taken to have
+    /// 64-bit pointers.
+    llvm::IntegerType *GetIntPtrTy(llvm::Module &M) const;
+
+    /// Emits a lookup of Key in the dict Dict at the end of *BB, a block
+    /// of a function of M. Returns the value, borrowed, or null if Key
+    /// isn't there.
+    llvm::Value *EmitLookup(llvm::Module &M, llvm::BasicBlock **BB,
+                            llvm::Value *Dict, llvm::Value *Key);
+
+    /// Like EmitLookup, but through an inline cache of the site's own,
+    /// for a site that always looks up the same Key. The dict's version
+    /// tag is compared with the one cached, and if they match the value
+    /// is loaded from the cached slot, with no hash probe and no call.
+    /// Otherwise the runtime tries the rest of the cache, which holds the
+    /// last few dicts the site saw, and refills it. Updates *BB to the
+    /// block the lookup ends in.
+    llvm::Value *EmitCachedLookup(llvm::Module &M, llvm::BasicBlock **BB,
+                                  llvm::Value *Dict, llvm::Value *Key);
+
+    /// Small ints are kept in the object pointer itself, as runtime/pyrt.h
+    /// describes: the value shifted left a bit, with the low bit set. Code
+    /// working on the encoding uses GetIntPtrTy, so that it overflows just
+    /// where the target's small ints do.
+
+    /// Emits, at the end of BB, a test of whether O is a small int.
+    /// Returns an i1.
+    llvm::Value *EmitIsSmallInt(llvm::BasicBlock *BB, llvm::Value *O);
+    /// Emits, at the end of BB, the value of the small int O as an i64.
+    llvm::Value *EmitUnboxSmallInt(llvm::BasicBlock *BB, llvm::Value *O);
+    /// Emits, at the end of BB, the small int of the i64 V, which must be
+    /// in the target's range; anything else needs py_int_new.
+    llvm::Value *EmitBoxSmallInt(llvm::BasicBlock *BB, llvm::Value *V);
+
+    /// Emits the int operation Op (IntAdd, IntSub or IntMul) on A and B at
+    /// the end of *BB, a block of a function of M, and returns the result
+    /// as a new reference. If both are small ints it is done inline, on
+    /// their encodings, and the runtime function Op is only called if
+    /// either isn't or the result overflows a small int. Updates *BB to
+    /// the block the operation ends in. If Slow isn't null, it is set to
+    /// the block that calls Op, for the caller to add to.
+    llvm::Value *EmitIntArith(llvm::Module &M, llvm::BasicBlock **BB, Fns Op,
+                              llvm::Value *A, llvm::Value *B,
+                              llvm::BasicBlock **Slow = 0);
+    /// Emits py_cmp(A, B) the same way: inline if both are small ints,
+    /// which compare as their encodings do.
+    llvm::Value *EmitCmp(llvm::Module &M, llvm::BasicBlock **BB,
+                         llvm::Value *A, llvm::Value *B,
+                         llvm::BasicBlock **Slow = 0);
+
 private:
     /// This array is lazily populated - an entry can be NULL.
     llvm::Function *Functions[SentinelEnd];
 
     llvm::Type *ObjectTy, *PtrObjectTy, *PtrVoidTy;
 
+    /// The runtime's dict, dict entry and py_lookup_cache layouts, which
+    /// inline caches read directly; see runtime/Object.h and pyrt.h.
+    llvm::StructType *DictTy, *DictEntryTy, *LookupCacheTy;
+
     llvm::LLVMContext &Context;
 };
 
@@ -0,0 +1,61 @@
+//===--- Parallel.h - Simple parallel loops ---------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines a minimal parallel-for used by the lexer and drivers,
+//  and an EventCount for threads that have to wait for work. When LLVM is
+//  built without thread support every task runs on the calling thread.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_PARALLEL_H
+#define LLVM_PY_PARALLEL_H
+
+namespace py {
+
+/// getHardwareConcurrency - Return the number of CPUs available to this
+/// process (at least 1).
+unsigned getHardwareConcurrency();
+
+/// RunParallel - Call Fn(Ctx, I) for every I in [0, NumTasks) using up to
+/// NumThreads threads, including the calling one. Tasks are handed out one
+/// at a time in increasing order, so uneven tasks balance themselves. Returns
+/// once every call has finished.
+void RunParallel(unsigned NumTasks, unsigned NumThreads,
+                 void (*Fn)(void *Ctx, unsigned Idx), void *Ctx);
+
+/// EventCount - Lets a thread that found nothing to do sleep until another
+/// thread changes something it was looking at. The waiter takes a key with
+/// prepareWait before it looks, and passes it to wait if it found nothing;
+/// wait returns at once if notifyAll was called since the key was taken, so
+/// a notification between the look and the wait is not lost.
+///
+/// Without thread support wait never blocks.
+class EventCount {
+  void *Impl;
+
+  EventCount(const EventCount&);     // DO NOT IMPLEMENT
+  void operator=(const EventCount&); // DO NOT IMPLEMENT
+
+public:
+  EventCount();
+  ~EventCount();
+
+  /// prepareWait - Return the key to pass to wait.
+  unsigned prepareWait();
+
+  /// wait - Block until notifyAll has been called since Key was taken.
+  void wait(unsigned Key);
+
+  /// notifyAll - Wake every thread in wait.
+  void notifyAll();
+};
+
+}
+
+#endif
@@ -0,0 +1,44 @@
+//===--- SourceFile.h - Loading source files for lexing ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines getSourceFile, which loads a file into a MemoryBuffer
+//  the Lexer can scan without the file ever being copied.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_SOURCEFILE_H
+#define LLVM_PY_SOURCEFILE_H
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/system_error.h"
+#include <string>
+#include <vector>
+
+namespace py {
+
+/// getSourceFile - Open Filename ("-" for stdin) as a NUL-terminated
+/// MemoryBuffer. A regular file is mapped read-only with at least one zero
+/// byte after its end: the tail of its last page, or a zero page mapped
+/// after it when the size is a multiple of the page size. Nothing is read or
+/// copied up front, and the mapping goes away with the buffer, so a process
+/// can lex any number of files one after another. Anything that can't be
+/// mapped is read the usual way.
+llvm::error_code getSourceFile(llvm::StringRef Filename,
+                               llvm::OwningPtr<llvm::MemoryBuffer> &Result);
+
+/// collectSourceFiles - Append Path to Files, or, if Path is a directory,
+/// every .py file under it, in sorted order so that runs are reproducible.
+llvm::error_code collectSourceFiles(llvm::StringRef Path,
+                                    std::vector<std::string> &Files);
+
+}
+
+#endif
@@ -0,0 +1,56 @@
+//===--- Passes.h - Python-specific optimizations ---------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file declares the passes that know what the runtime functions
+//  generated code calls do, which LLVM's own passes can't see through.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_PASSES_H
+#define LLVM_PY_PASSES_H
+
+namespace llvm {
+  class FunctionPass;
+  class Pass;
+  class PassRegistry;
+
+  void initializeNamespaceCallsPass(PassRegistry&);
+  void initializeHoistRuntimeCallsPass(PassRegistry&);
+  void initializeStackObjectsPass(PassRegistry&);
+}
+
+namespace py {
+
+/// createNamespaceCallsPass - Remove py_getlocals and py_getglobals calls
+/// that an earlier call of the same function dominates, and calls whose
+/// result is only released. Every call in one activation returns the same
+/// dict, which outlives it, so a later call can use the earlier result and
+/// drop its own reference, as long as it only lends that reference out
+/// (py-namespaces).
+llvm::FunctionPass *createNamespaceCallsPass();
+
+/// createHoistRuntimeCallsPass - Hoist loop-invariant runtime calls into
+/// the loop preheader: py_name with invariant arguments, and py_getlocals
+/// and py_getglobals, whose reference is then released once on each loop
+/// exit instead of once per iteration (py-licm).
+llvm::Pass *createHoistRuntimeCallsPass();
+
+/// createStackObjectsPass - Keep ints, tuples and lists that don't escape
+/// the function making them off the heap: replace them by what they hold
+/// where they are only read, and make the others in the function's frame
+/// with py_int_init, py_tuple_init and py_list_init (py-stack-objects).
+llvm::FunctionPass *createStackObjectsPass();
+
+/// initializePyPasses - Register the passes above, so that a pipeline can
+/// name them.
+void initializePyPasses(llvm::PassRegistry &Registry);
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+//===--- Pipeline.h - The passes run on generated code ----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines Pipeline, which says which passes the compile drivers
+//  run on each Module they generate.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PY_PIPELINE_H
+#define LLVM_PY_PIPELINE_H
+
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class Module;
+  class PassInfo;
+}
+
+namespace py {
+
+/// Pipeline - Either the standard passes of an optimization level, or a
+/// custom list of passes.
+///
+/// Level 0 runs nothing. Levels 1 to 3 run what PassManagerBuilder gives
+/// for the level, with the passes of py/Transforms/Passes.h where they pay
+/// off: py-namespaces first, and again once inlining has brought callers'
+/// and callees' calls together, py-licm after the loop passes, and
+/// py-stack-objects last, at the end of the scalar optimizations. Levels 2
+/// and 3 inline, as opt does; at level 1 nothing is inlined, so an object
+/// passed to another function of the module escapes.
+///
+/// A custom pipeline is a list of pass names, as opt takes them: any pass
+/// LLVM registers, and the Python passes. The passes run in the order
+/// given, once each, as one PassManager.
+///
+/// -time-passes, LLVM's own option, reports the time each pass took, summed
+/// over every Module, when the tool exits.
+class Pipeline {
+  unsigned OptLevel;
+  /// The passes of a custom pipeline; empty otherwise.
+  std::vector<const llvm::PassInfo*> Passes;
+
+public:
+  explicit Pipeline(unsigned OptLevel = 0) : OptLevel(OptLevel) {}
+
+  /// parse - Make this the custom pipeline Spec, pass names separated by
+  /// commas. Returns false, with Err set, if a name isn't that of a pass.
+  bool parse(llvm::StringRef Spec, std::string &Err);
+
+  unsigned getOptLevel() const { return OptLevel; }
+  bool isCustom() const { return !Passes.empty(); }
+  /// empty - Whether there is nothing to run.
+  bool empty() const { return !OptLevel && Passes.empty(); }
+
+  /// run - Run the pipeline over M, which must be valid. Safe to call on
+  /// several threads at once, for Modules of different contexts.
+  void run(llvm::Module &M) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,163 @@
+//===--- ObjectEmitter.cpp - Ahead-of-time native code --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements ObjectEmitter, and linking with the system's
+// compiler driver, which knows where the C++ library the runtime needs is.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/PassManager.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include "py/CodeGen/ObjectEmitter.h"
+
+#include <vector>
+
+using namespace llvm;
+using namespace py;
+
+ObjectEmitter::ObjectEmitter(TargetMachine *TM, unsigned OptLevel)
+  : TM(TM), OptLevel(OptLevel) {
+}
+
+ObjectEmitter::~ObjectEmitter() {
+}
+
+ObjectEmitter *ObjectEmitter::create(StringRef TripleName, StringRef CPU,
+                                     unsigned OptLevel, std::string &Err) {
+  // Every target LLVM was built with, so that -mtriple can cross compile.
+  InitializeAllTargets();
+  InitializeAllTargetMCs();
+  InitializeAllAsmPrinters();
+
+  std::string TheTriple = TripleName.empty() ? sys::getHostTriple()
+                                             : Triple::normalize(TripleName);
+  const Target *T = TargetRegistry::lookupTarget(TheTriple, Err);
+  if (!T)
+    return 0;
+  TargetMachine *TM = T->createTargetMachine(TheTriple, CPU, "",
+                                             Reloc::PIC_,
+                                             CodeModel::Default);
+  if (!TM) {
+    Err = "can't generate code for '" + TheTriple + "'";
+    return 0;
+  }
+  return new ObjectEmitter(TM, OptLevel);
+}
+
+void ObjectEmitter::setTarget(Module &M) const {
+  M.setTargetTriple(TM->getTargetTriple());
+  M.setDataLayout(TM->getTargetData()->getStringRepresentation());
+}
+
+bool ObjectEmitter::emit(Module &M, raw_ostream &OS, std::string &Err) {
+  const TargetData *TD = TM->getTargetData();
+  setTarget(M);
+
+  CodeGenOpt::Level Level = CodeGenOpt::Default;
+  switch (OptLevel) {
+  case 0: Level = CodeGenOpt::None; break;
+  case 1: Level = CodeGenOpt::Less; break;
+  case 2: Level = CodeGenOpt::Default; break;
+  default: Level = CodeGenOpt::Aggressive; break;
+  }
+
+  PassManager PM;
+  PM.add(new TargetData(*TD));
+  {
+    formatted_raw_ostream FOS(OS);
+    if (TM->addPassesToEmitFile(PM, FOS, TargetMachine::CGFT_ObjectFile,
+                                Level)) {
+      Err = ("target '" + Twine(TM->getTargetTriple()) +
+             "' can't emit object files").str();
+      return false;
+    }
+    PM.run(M);
+  }
+  return true;
+}
+
+bool py::addMainFunction(Module &M, StringRef Entry, std::string &Err) {
+  Function *F = M.getFunction(Entry);
+  if (!F || F->isDeclaration()) {
+    Err = "no function '" + Entry.str() + "' in module";
+    return false;
+  }
+  if (!F->arg_empty()) {
+    Err = "function '" + Entry.str() + "' takes arguments";
+    return false;
+  }
+  if (Function *Old = M.getFunction("main"))
+    Old->setName("py.main");
+
+  LLVMContext &C = M.getContext();
+  Type *Int32Ty = Type::getInt32Ty(C);
+  Type *Params[] = { Int32Ty, PointerType::getUnqual(Type::getInt8PtrTy(C)) };
+  Function *Main = Function::Create(FunctionType::get(Int32Ty, Params,
+                                                      false /*VarArg*/),
+                                    GlobalValue::ExternalLinkage, "main", &M);
+  IRBuilder<> IRB(BasicBlock::Create(C, "entry", Main));
+  Value *Result = IRB.CreateCall(F);
+  if (Result->getType()->isPointerTy()) {
+    Constant *XDecRef = M.getOrInsertFunction("py_xdecref", IRB.getVoidTy(),
+                                              Result->getType(), NULL);
+    IRB.CreateCall(XDecRef, Result);
+  }
+  IRB.CreateRet(IRB.getInt32(0));
+  return true;
+}
+
+bool py::linkNative(StringRef Linker, ArrayRef<std::string> Objects,
+                    StringRef RuntimeLib, StringRef Output, bool Shared,
+                    std::string &Err) {
+  sys::Path Program(Linker);
+  if (Linker.find('/') == StringRef::npos)
+    Program = sys::Program::FindProgramByName(Linker);
+  if (Program.isEmpty()) {
+    Err = "can't find the linker '" + Linker.str() + "'";
+    return false;
+  }
+
+  std::string OutputStr = Output.str(), RuntimeLibStr = RuntimeLib.str();
+  std::vector<const char*> Args;
+  Args.push_back(Program.c_str());
+  Args.push_back("-o");
+  Args.push_back(OutputStr.c_str());
+  if (Shared)
+    Args.push_back("-shared");
+  for (unsigned i = 0, e = Objects.size(); i != e; ++i)
+    Args.push_back(Objects[i].c_str());
+  if (!Shared)
+    Args.push_back(RuntimeLibStr.c_str());
+  Args.push_back(0);
+
+  int Status = sys::Program::ExecuteAndWait(Program, &Args[0], 0 /*env*/,
+                                            0 /*redirects*/,
+                                            0 /*secondsToWait*/,
+                                            0 /*memoryLimit*/, &Err);
+  if (Status == 0)
+    return true;
+  if (Err.empty())
+    Err = (Twine(Program.str()) + " failed with exit code " +
+           Twine(Status)).str();
+  return false;
+}
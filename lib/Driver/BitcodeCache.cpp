@@ -0,0 +1,177 @@
+//===--- BitcodeCache.cpp - On-disk cache of compiled modules -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the BitcodeCache interface.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Driver/BitcodeCache.h"
+#include "py/LangFeatures.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+/// PY_BUILD_ID - Identifies the build of the compiler, which is part of
+/// every key: the LLVM version and a hash of the compiler's sources.
+#include "BuildId.inc"
+
+using namespace py;
+using namespace llvm;
+
+//===----------------------------------------------------------------------===//
+// Hashing
+//===----------------------------------------------------------------------===//
+
+static inline uint64_t rotl64(uint64_t X, unsigned R) {
+  return (X << R) | (X >> (64 - R));
+}
+
+/// read64 - Read 8 bytes as a little-endian word, so keys are the same on
+/// every host.
+static inline uint64_t read64(const char *P) {
+  const unsigned char *U = reinterpret_cast<const unsigned char*>(P);
+  uint64_t V = 0;
+  for (unsigned i = 0; i != 8; ++i)
+    V |= uint64_t(U[i]) << (8 * i);
+  return V;
+}
+
+static inline uint64_t fmix64(uint64_t K) {
+  K ^= K >> 33;
+  K *= 0xff51afd7ed558ccdULL;
+  K ^= K >> 33;
+  K *= 0xc4ceb9fe1a85ec53ULL;
+  K ^= K >> 33;
+  return K;
+}
+
+/// hash128 - MurmurHash3 (x64, 128-bit) of Data.
+static CacheKey hash128(StringRef Data, uint64_t Seed) {
+  const uint64_t C1 = 0x87c37b91114253d5ULL;
+  const uint64_t C2 = 0x4cf5ad432745937fULL;
+  uint64_t H1 = Seed, H2 = Seed;
+
+  const char *P = Data.data();
+  size_t N = Data.size();
+  for (size_t i = 0, e = N / 16; i != e; ++i, P += 16) {
+    uint64_t K1 = read64(P), K2 = read64(P + 8);
+
+    K1 *= C1; K1 = rotl64(K1, 31); K1 *= C2; H1 ^= K1;
+    H1 = rotl64(H1, 27); H1 += H2; H1 = H1 * 5 + 0x52dce729;
+
+    K2 *= C2; K2 = rotl64(K2, 33); K2 *= C1; H2 ^= K2;
+    H2 = rotl64(H2, 31); H2 += H1; H2 = H2 * 5 + 0x38495ab5;
+  }
+
+  unsigned Tail = N & 15;
+  uint64_t K1 = 0, K2 = 0;
+  for (unsigned i = 0; i != Tail; ++i) {
+    uint64_t B = static_cast<unsigned char>(P[i]);
+    if (i < 8)
+      K1 |= B << (8 * i);
+    else
+      K2 |= B << (8 * (i - 8));
+  }
+  if (Tail > 8) {
+    K2 *= C2; K2 = rotl64(K2, 33); K2 *= C1; H2 ^= K2;
+  }
+  if (Tail > 0) {
+    K1 *= C1; K1 = rotl64(K1, 31); K1 *= C2; H1 ^= K1;
+  }
+
+  H1 ^= N; H2 ^= N;
+  H1 += H2; H2 += H1;
+  H1 = fmix64(H1); H2 = fmix64(H2);
+  H1 += H2; H2 += H1;
+  return CacheKey(H1, H2);
+}
+
+//===----------------------------------------------------------------------===//
+// BitcodeCache
+//===----------------------------------------------------------------------===//
+
+std::string CacheKey::str() const {
+  std::string S;
+  raw_string_ostream OS(S);
+  OS << format("%016llx%016llx", (unsigned long long)Hi, (unsigned long long)Lo);
+  return OS.str();
+}
+
+CacheKey BitcodeCache::getKey(StringRef Source, const LangFeatures &F) {
+  // Hash the source on its own, then the digest along with everything else,
+  // rather than copying the source to hash it in one go.
+  std::string Header;
+  raw_string_ostream OS(Header);
+  OS << "py-bitcode " << PY_BUILD_ID << ' ' << F.getFlags() << ' '
+     << hash128(Source, 0).str();
+  return hash128(OS.str(), 0);
+}
+
+std::string BitcodeCache::getPath(const CacheKey &K) const {
+  return (Twine(Dir) + "/" + K.str() + ".bc").str();
+}
+
+bool BitcodeCache::contains(const CacheKey &K) const {
+  bool Exists;
+  return !sys::fs::exists(getPath(K), Exists) && Exists;
+}
+
+Module *BitcodeCache::load(const CacheKey &K, StringRef ModuleID,
+                           LLVMContext &C) const {
+  OwningPtr<MemoryBuffer> Buffer;
+  if (MemoryBuffer::getFile(getPath(K), Buffer))
+    return 0;
+
+  // An entry that doesn't parse, e.g. one written by a different LLVM, is
+  // treated as missing; storing the Module again will replace it.
+  std::string Err;
+  Module *M = ParseBitcodeFile(Buffer.get(), C, &Err);
+  if (!M)
+    return 0;
+  M->setModuleIdentifier(ModuleID);
+  return M;
+}
+
+error_code BitcodeCache::store(const CacheKey &K, const Module &M) const {
+  bool Existed;
+  if (error_code ec = sys::fs::create_directories(Dir, Existed))
+    return ec;
+
+  // Write the whole entry under a name of its own, next to where it goes,
+  // then rename it into place. Writers of the same entry write the same
+  // bytes, so it doesn't matter whose rename wins.
+  int FD;
+  SmallString<128> TmpPath;
+  if (error_code ec = sys::fs::unique_file(Twine(Dir) + "/" + K.str() +
+                                           "-%%%%%%%%.tmp", FD, TmpPath))
+    return ec;
+
+  bool Failed;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    WriteBitcodeToFile(&M, OS);
+    OS.close();
+    Failed = OS.has_error();
+    OS.clear_error();
+  }
+
+  error_code ec = Failed ? make_error_code(errc::io_error) :
+                           sys::fs::rename(TmpPath.str(), getPath(K));
+  if (ec) {
+    bool Removed;
+    sys::fs::remove(TmpPath.str(), Removed);
+  }
+  return ec;
+}
@@ -0,0 +1,36 @@
+# GetBuildId.cmake - Write OUTPUT, a header defining PY_BUILD_ID.
+#
+# PY_BUILD_ID is the LLVM version and a SHA1 of every source file of the
+# compiler under SOURCE_DIR, so it changes with any change to the code that
+# could change the IR generated for a file. The header is only rewritten when
+# the ID changes, so that what includes it is only rebuilt then.
+#
+# Usage: cmake -DSOURCE_DIR=<dir> -DOUTPUT=<file> -DLLVM_VERSION=<version>
+#              -P GetBuildId.cmake
+
+file(GLOB_RECURSE sources
+  ${SOURCE_DIR}/include/py/*
+  ${SOURCE_DIR}/lib/*.cpp
+  ${SOURCE_DIR}/lib/*.h
+  ${SOURCE_DIR}/lib/*.def
+  ${SOURCE_DIR}/runtime/*.cpp
+  ${SOURCE_DIR}/runtime/*.h
+  )
+list(SORT sources)
+
+set(digests "${LLVM_VERSION}")
+foreach(source ${sources})
+  file(SHA1 ${source} digest)
+  file(RELATIVE_PATH name ${SOURCE_DIR} ${source})
+  set(digests "${digests} ${name}=${digest}")
+endforeach()
+string(SHA1 id "${digests}")
+
+set(contents "#define PY_BUILD_ID \"${LLVM_VERSION}-${id}\"\n")
+set(old "")
+if(EXISTS ${OUTPUT})
+  file(READ ${OUTPUT} old)
+endif()
+if(NOT old STREQUAL contents)
+  file(WRITE ${OUTPUT} "${contents}")
+endif()
@@ -0,0 +1,505 @@
+//===--- Scheduler.cpp - Pipelined multi-module compilation ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the Scheduler.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Driver/Scheduler.h"
+#include "py/Driver/BitcodeCache.h"
+#include "py/Lex/Lexer.h"
+#include "py/Lex/TokenStream.h"
+#include "py/Parse/Parser.h"
+#include "py/Runtime/Runtime.h"
+#include "py/Support/Parallel.h"
+#include "py/Support/SourceFile.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include <deque>
+
+using namespace py;
+using namespace llvm;
+
+const char *py::getCompileStageName(CompileStage S) {
+  switch (S) {
+  case LexStage: return "lex";
+  case ParseStage: return "parse";
+  case OptimizeStage: return "optimize";
+  case NumCompileStages: break;
+  }
+  return "unknown";
+}
+
+//===----------------------------------------------------------------------===//
+// CompileClient
+//===----------------------------------------------------------------------===//
+
+CompileClient::~CompileClient() {
+}
+
+raw_ostream &CompileClient::getTreeStream(CompileJob &Job, raw_ostream &OS) {
+  return nulls();
+}
+
+bool CompileClient::parse(CompileJob &Job, Lexer &L, Parser &P,
+                          SourceMgr &SrcMgr, raw_ostream &OS) {
+  return P.ParseFile();
+}
+
+void CompileClient::finished(CompileJob &Job, Module &M, raw_ostream &OS) {
+}
+
+void py::EmitDiagnostics(Lexer &L, Parser &P, SourceMgr &SrcMgr,
+                         raw_ostream &OS, bool &Errors) {
+  SmallVector<Diagnostic, 5> *Lists[] = {
+    &L.getDiagnostics(), &P.getDiagnostics()
+  };
+  for (unsigned i = 0; i != 2; ++i) {
+    for (SmallVector<Diagnostic, 5>::iterator it = Lists[i]->begin(),
+           end = Lists[i]->end();
+         it != end;
+         ++it) {
+      SrcMgr.GetMessage(it->getLoc(), it->getMessage(),
+                        it->getSeverityAsText()).Print(0, OS);
+      if (it->getSeverity() == Diagnostic::Error)
+        Errors = true;
+    }
+    Lists[i]->clear();
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Scheduler
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Task - One stage of one job, and when it was queued.
+struct Task {
+  unsigned Job;
+  CompileStage Stage;
+  sys::TimeValue Queued;
+
+  Task(unsigned Job, CompileStage Stage)
+    : Job(Job), Stage(Stage), Queued(sys::TimeValue::now()) {}
+};
+}
+
+/// NoWorker - Passed to lexNext by the lexers: queue the parse on the
+/// worker the file is dealt to.
+static const unsigned NoWorker = ~0U;
+
+/// Worker - A thread of the pool. Its LLVMContext and Runtime live on its
+/// stack for the length of the run.
+struct Scheduler::Worker {
+  /// Guards Queue, which other workers steal from.
+  sys::Mutex Lock;
+  /// Parse tasks any worker may run. The owner works at the back; thieves
+  /// take the oldest task, from the front.
+  std::deque<Task> Queue;
+  /// Tasks of jobs whose Module lives in this worker's context. Only the
+  /// owner touches these.
+  std::vector<Task> Pinned;
+
+  LLVMContext *Context;
+  Runtime *R;
+
+  Worker() : Context(0), R(0) {}
+};
+
+/// JobState - What a job carries from one stage to the next.
+struct Scheduler::JobState {
+  /// Owns the source buffer until the job is finished.
+  SourceMgr SrcMgr;
+  MemoryBuffer *Buffer;
+  OwningPtr<TokenStream> Tokens;
+  /// Allocated in the context of the worker that ran the parse stage.
+  OwningPtr<Module> Mod;
+  /// The job's cache entry, and whether the lex stage found it.
+  CacheKey Key;
+  bool Cached;
+
+  JobState() : Buffer(0), Cached(false) {}
+};
+
+Scheduler::Scheduler(const LangFeatures &F, unsigned NumWorkers,
+                     const Pipeline &P, CompileClient &Client)
+  : Features(F), NumWorkers(NumWorkers), Passes(P), Client(Client),
+    Cache(0), Remaining(0), NextLex(0), Unparsed(0),
+    MaxUnparsed(0), CacheHits(0), CacheMisses(0) {
+  for (unsigned i = 0; i != NumCompileStages; ++i)
+    Running[i] = 0;
+}
+
+Scheduler::~Scheduler() {
+  for (unsigned i = 0, e = States.size(); i != e; ++i)
+    delete States[i];
+}
+
+void Scheduler::addFile(StringRef Filename) {
+  Jobs.push_back(CompileJob(Filename));
+}
+
+bool Scheduler::run() {
+  if (Jobs.empty())
+    return true;
+  unsigned N = NumWorkers ? NumWorkers : getHardwareConcurrency();
+  if (N > Jobs.size())
+    N = Jobs.size();
+
+  States.resize(Jobs.size());
+  for (unsigned i = 0, e = Jobs.size(); i != e; ++i)
+    States[i] = new JobState();
+  for (unsigned i = 0; i != N; ++i)
+    Workers.push_back(new Worker());
+  Remaining = Jobs.size();
+  MaxUnparsed = 2 * N;
+
+  // Every file is waiting to be lexed.
+  Started = sys::TimeValue::now();
+  Stats[LexStage].Depth = Stats[LexStage].MaxDepth = Jobs.size();
+
+  // One lexer for every four workers.
+  unsigned NumThreads = N + (N + 3) / 4;
+  if (NumThreads > 1)
+    llvm_start_multithreaded();
+  RunParallel(NumThreads, NumThreads, RunThread, this);
+
+  for (unsigned i = 0; i != N; ++i)
+    delete Workers[i];
+  Workers.clear();
+
+  bool Success = true;
+  for (unsigned i = 0, e = Jobs.size(); i != e; ++i)
+    if (Jobs[i].Failed)
+      Success = false;
+  return Success;
+}
+
+void Scheduler::RunThread(void *Ctx, unsigned Idx) {
+  Scheduler *S = static_cast<Scheduler*>(Ctx);
+  // The first threads are the workers, the rest the lexers.
+  if (Idx < S->Workers.size())
+    S->runWorker(Idx);
+  else
+    S->runLexer();
+}
+
+void Scheduler::runWorker(unsigned Self) {
+  Worker &W = *Workers[Self];
+  LLVMContext Context;
+  Runtime R(Context);
+  W.Context = &Context;
+  W.R = &R;
+
+  unsigned Job;
+  CompileStage Stage;
+  while (Remaining != 0) {
+    unsigned Key = WorkChanged.prepareWait();
+    if (pop(Self, Job, Stage)) {
+      runTask(Self, Job, Stage);
+      continue;
+    }
+    // Nothing to parse or optimize here or to steal; help the lexers. This
+    // also keeps the run going if the lexer threads couldn't be started.
+    if (lexNext(Self))
+      continue;
+    // Everything left is running elsewhere, or pinned to another worker.
+    // Sleep until a task can be stolen or the last job finishes.
+    if (Remaining != 0)
+      WorkChanged.wait(Key);
+  }
+
+  W.Context = 0;
+  W.R = 0;
+}
+
+void Scheduler::runLexer() {
+  while (NextLex < Jobs.size()) {
+    unsigned Key = WorkChanged.prepareWait();
+    // Keep at most MaxUnparsed token streams waiting for the parsers.
+    if (Unparsed < MaxUnparsed)
+      lexNext(NoWorker);
+    else
+      WorkChanged.wait(Key);
+  }
+}
+
+/// lexNext - Lex the next file, if there is one left, and queue its parse
+/// on worker To (or, for NoWorker, the worker the file is dealt to).
+/// Returns false if every file has been taken.
+bool Scheduler::lexNext(unsigned To) {
+  if (NextLex >= Jobs.size())
+    return false;
+  unsigned Job = sys::AtomicIncrement(&NextLex) - 1;
+  if (Job >= Jobs.size())
+    return false;
+  if (To == NoWorker)
+    To = Job % Workers.size();
+
+  sys::TimeValue Waited = sys::TimeValue::now() - Started;
+  {
+    MutexGuard Guard(StatsLock);
+    StageStats &S = Stats[LexStage];
+    --S.Depth;
+    S.WaitSeconds += Waited.usec() / 1e6;
+  }
+  runTask(To, Job, LexStage);
+  return true;
+}
+
+void Scheduler::push(unsigned Self, unsigned Job, CompileStage Stage,
+                     bool Pinned) {
+  {
+    MutexGuard Guard(StatsLock);
+    StageStats &S = Stats[Stage];
+    if (++S.Depth > S.MaxDepth)
+      S.MaxDepth = S.Depth;
+  }
+
+  Worker &W = *Workers[Self];
+  if (Pinned) {
+    W.Pinned.push_back(Task(Job, Stage));
+    return;
+  }
+  {
+    MutexGuard Guard(W.Lock);
+    W.Queue.push_back(Task(Job, Stage));
+  }
+  WorkChanged.notifyAll();
+}
+
+bool Scheduler::pop(unsigned Self, unsigned &Job, CompileStage &Stage) {
+  Worker &W = *Workers[Self];
+  Task T(0, LexStage);
+  bool Found = false, Stolen = false;
+
+  // Finish the modules this worker holds before starting new ones, so that
+  // as few Modules as possible are alive at once.
+  if (!W.Pinned.empty()) {
+    T = W.Pinned.back();
+    W.Pinned.pop_back();
+    Found = true;
+  }
+
+  if (!Found) {
+    MutexGuard Guard(W.Lock);
+    if (!W.Queue.empty()) {
+      T = W.Queue.back();
+      W.Queue.pop_back();
+      Found = true;
+    }
+  }
+
+  for (unsigned i = 1, e = Workers.size(); !Found && i != e; ++i) {
+    Worker &Victim = *Workers[(Self + i) % e];
+    MutexGuard Guard(Victim.Lock);
+    if (!Victim.Queue.empty()) {
+      T = Victim.Queue.front();
+      Victim.Queue.pop_front();
+      Found = Stolen = true;
+    }
+  }
+
+  if (!Found)
+    return false;
+
+  sys::TimeValue Waited = sys::TimeValue::now() - T.Queued;
+  {
+    MutexGuard Guard(StatsLock);
+    StageStats &S = Stats[T.Stage];
+    --S.Depth;
+    S.WaitSeconds += Waited.usec() / 1e6;
+    if (Stolen)
+      ++S.Steals;
+  }
+
+  Job = T.Job;
+  Stage = T.Stage;
+  return true;
+}
+
+void Scheduler::runTask(unsigned Self, unsigned Job, CompileStage Stage) {
+  {
+    MutexGuard Guard(StatsLock);
+    for (unsigned i = 0; i != NumCompileStages; ++i)
+      if (i != unsigned(Stage) && Running[i]) {
+        ++Stats[Stage].Overlapped;
+        break;
+      }
+    ++Running[Stage];
+  }
+
+  sys::TimeValue Start = sys::TimeValue::now();
+  switch (Stage) {
+  case LexStage: lex(Self, Job); break;
+  case ParseStage: parse(Self, Job); break;
+  case OptimizeStage: optimize(Self, Job); break;
+  case NumCompileStages: llvm_unreachable("Not a stage!");
+  }
+  sys::TimeValue Ran = sys::TimeValue::now() - Start;
+
+  MutexGuard Guard(StatsLock);
+  --Running[Stage];
+  StageStats &S = Stats[Stage];
+  ++S.Tasks;
+  S.RunSeconds += Ran.usec() / 1e6;
+}
+
+void Scheduler::finishJob(unsigned Job) {
+  // Frees the source buffer; anything that referred to it has been printed.
+  delete States[Job];
+  States[Job] = 0;
+  if (sys::AtomicDecrement(&Remaining) == 0)
+    WorkChanged.notifyAll();
+}
+
+void Scheduler::lex(unsigned To, unsigned Job) {
+  CompileJob &J = Jobs[Job];
+  JobState &S = *States[Job];
+
+  OwningPtr<MemoryBuffer> BufferPtr;
+  if (error_code ec = getSourceFile(J.Filename, BufferPtr)) {
+    {
+      raw_string_ostream OS(J.Output);
+      OS << J.Filename << ": " << ec.message() << '\n';
+    }
+    J.Failed = true;
+    finishJob(Job);
+    return;
+  }
+  S.Buffer = BufferPtr.take();
+  S.SrcMgr.AddNewSourceBuffer(S.Buffer, SMLoc());
+
+  // A cached Module has to be loaded in the context it will live in, so
+  // leave that to the parse stage.
+  if (Cache) {
+    S.Key = BitcodeCache::getKey(S.Buffer->getBuffer(), Features);
+    S.Cached = Cache->contains(S.Key);
+  }
+  if (!S.Cached)
+    tokenize(S);
+
+  sys::AtomicIncrement(&Unparsed);
+  push(To, Job, ParseStage, /*Pinned=*/false);
+}
+
+void Scheduler::tokenize(JobState &S) {
+  // Lexer errors are replayed to the parse stage along with the tokens.
+  S.Tokens.reset(new TokenStream(S.Buffer));
+  Lexer L(S.Buffer, Features);
+  S.Tokens->tokenize(L);
+}
+
+void Scheduler::parse(unsigned Self, unsigned Job) {
+  Worker &W = *Workers[Self];
+  CompileJob &J = Jobs[Job];
+  JobState &S = *States[Job];
+
+  // Let a lexer that waited for the parsers catch up go on.
+  sys::AtomicDecrement(&Unparsed);
+  WorkChanged.notifyAll();
+
+  if (S.Cached) {
+    S.Mod.reset(Cache->load(S.Key, J.Filename, *W.Context));
+    if (S.Mod) {
+      sys::AtomicIncrement(&CacheHits);
+      push(Self, Job, OptimizeStage, /*Pinned=*/true);
+      return;
+    }
+    // The entry went bad after the lex stage looked; compile it after all.
+    tokenize(S);
+  }
+
+  {
+    raw_string_ostream OS(J.Output);
+    S.Mod.reset(new Module(J.Filename, *W.Context));
+
+    Lexer L(S.Buffer, Features);
+    L.replay(*S.Tokens);
+    Parser P(L, *W.R, *W.Context, *S.Mod, Client.getTreeStream(J, OS));
+    Client.parse(J, L, P, S.SrcMgr, OS);
+    EmitDiagnostics(L, P, S.SrcMgr, OS, J.Failed);
+  }
+  S.Tokens.reset();
+
+  if (J.Failed) {
+    S.Mod.reset();
+    finishJob(Job);
+    return;
+  }
+
+  // Cache the Module as parsed, so that it doesn't depend on the passes.
+  if (Cache) {
+    sys::AtomicIncrement(&CacheMisses);
+    if (error_code ec = Cache->store(S.Key, *S.Mod)) {
+      raw_string_ostream OS(J.Output);
+      OS << J.Filename << ": warning: can't write to the cache in '"
+         << Cache->getDirectory() << "': " << ec.message() << '\n';
+    }
+  }
+  push(Self, Job, OptimizeStage, /*Pinned=*/true);
+}
+
+void Scheduler::optimize(unsigned Self, unsigned Job) {
+  CompileJob &J = Jobs[Job];
+  JobState &S = *States[Job];
+  Module &M = *S.Mod;
+
+  {
+    raw_string_ostream OS(J.Output);
+    if (!Passes.empty()) {
+      // The passes assume valid IR.
+      std::string Err;
+      if (verifyModule(M, ReturnStatusAction, &Err)) {
+        OS << J.Filename << ": invalid module: " << Err << '\n';
+        J.Failed = true;
+      } else {
+        Passes.run(M);
+      }
+    }
+
+    if (!J.Failed)
+      Client.finished(J, M, OS);
+  }
+
+  // The Module has to go before its worker's context does.
+  S.Mod.reset();
+  finishJob(Job);
+}
+
+StageStats Scheduler::getStats(CompileStage S) const {
+  MutexGuard Guard(StatsLock);
+  return Stats[S];
+}
+
+void Scheduler::printStats(raw_ostream &OS) const {
+  OS << "stage         tasks   steals  overlap  max queue   wait (s)"
+        "    run (s)  latency (ms)\n";
+  for (unsigned i = 0; i != NumCompileStages; ++i) {
+    StageStats S = getStats(CompileStage(i));
+    double Latency = S.Tasks ?
+      (S.WaitSeconds + S.RunSeconds) * 1000 / S.Tasks : 0;
+    OS << format("%-10s %8llu %8llu %8llu %10u %10.3f %10.3f %13.3f\n",
+                 getCompileStageName(CompileStage(i)),
+                 (unsigned long long)S.Tasks, (unsigned long long)S.Steals,
+                 (unsigned long long)S.Overlapped, S.MaxDepth,
+                 S.WaitSeconds, S.RunSeconds, Latency);
+  }
+  if (Cache)
+    OS << "cache: " << CacheHits << " hits, " << CacheMisses << " misses\n";
+}
@@ -0,0 +1,160 @@
+//===--- JIT.cpp - Run generated modules in process -----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the JIT interface on LLVM's JIT.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/JIT/JIT.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/JIT.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/Function.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/Module.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/TimeValue.h"
+#include <vector>
+
+using namespace py;
+using namespace llvm;
+
+static double SecondsSince(sys::TimeValue Start) {
+  return (sys::TimeValue::now() - Start).usec() / 1e6;
+}
+
+/// Listener - Counts the functions the JIT emits, whenever it emits them.
+class JIT::Listener : public JITEventListener {
+  JITStats &Stats;
+
+public:
+  explicit Listener(JITStats &Stats) : Stats(Stats) {}
+
+  virtual void NotifyFunctionEmitted(const Function &F, void *Code,
+                                     size_t Size,
+                                     const EmittedFunctionDetails &Details) {
+    ++Stats.FunctionsCompiled;
+    Stats.CodeBytes += Size;
+  }
+};
+
+JIT::JIT(Module *M) : M(M), Resolved(false) {
+  for (Module::iterator F = M->begin(), E = M->end(); F != E; ++F)
+    if (!F->isDeclaration())
+      ++Stats.FunctionsDefined;
+}
+
+JIT *JIT::create(Module *M, std::string &Err) {
+  sys::TimeValue Start = sys::TimeValue::now();
+  InitializeNativeTarget();
+
+  OwningPtr<JIT> J(new JIT(M));
+  J->EE.reset(EngineBuilder(M).setEngineKind(EngineKind::JIT)
+                              .setErrorStr(&Err)
+                              .create());
+  if (!J->EE) {
+    delete M;
+    return 0;
+  }
+
+  // Compile a function only when it is first called.
+  J->EE->DisableLazyCompilation(false);
+  J->Events.reset(new Listener(J->Stats));
+  J->EE->RegisterJITEventListener(J->Events.get());
+
+  J->Stats.SetupSeconds = SecondsSince(Start);
+  return J.take();
+}
+
+JIT::~JIT() {
+  if (EE)
+    EE->UnregisterJITEventListener(Events.get());
+  // Deletes the Module.
+  EE.reset();
+}
+
+void JIT::addSymbol(StringRef Name, void *Address) {
+  Symbols[Name] = Address;
+}
+
+/// resolve - Point every function the Module declares at its definition:
+/// one added with addSymbol, or else one the process has.
+bool JIT::resolve(std::string &Err) {
+  sys::TimeValue Start = sys::TimeValue::now();
+  for (Module::iterator F = M->begin(), E = M->end(); F != E; ++F) {
+    if (!F->isDeclaration() || F->isIntrinsic())
+      continue;
+    StringMap<void*>::iterator I = Symbols.find(F->getName());
+    if (I != Symbols.end()) {
+      EE->addGlobalMapping(F, I->second);
+      continue;
+    }
+    if (!sys::DynamicLibrary::SearchForAddressOfSymbol(F->getName().str())) {
+      Err = "unresolved function '" + F->getName().str() + "'";
+      return false;
+    }
+  }
+  Resolved = true;
+  Stats.SetupSeconds += SecondsSince(Start);
+  return true;
+}
+
+/// getDefinition - Return the function Name, resolving the Module's
+/// declarations the first time, or null with Err set.
+Function *JIT::getDefinition(StringRef Name, std::string &Err) {
+  Function *F = M->getFunction(Name);
+  if (!F || F->isDeclaration()) {
+    Err = "no function '" + Name.str() + "' in module";
+    return 0;
+  }
+  if (!Resolved && !resolve(Err))
+    return 0;
+  return F;
+}
+
+void *JIT::getFunctionAddress(StringRef Name, std::string &Err) {
+  Function *F = getDefinition(Name, Err);
+  if (!F)
+    return 0;
+  sys::TimeValue Start = sys::TimeValue::now();
+  void *Address = EE->getPointerToFunction(F);
+  Stats.CompileSeconds += SecondsSince(Start);
+  return Address;
+}
+
+void *JIT::getGlobalAddress(StringRef Name, std::string &Err) {
+  GlobalVariable *GV = M->getNamedGlobal(Name);
+  if (!GV) {
+    Err = "no global '" + Name.str() + "' in module";
+    return 0;
+  }
+  if (!Resolved && !resolve(Err))
+    return 0;
+  return EE->getPointerToGlobal(GV);
+}
+
+bool JIT::run(StringRef Entry, GenericValue &Result, std::string &Err) {
+  Function *F = getDefinition(Entry, Err);
+  if (!F)
+    return false;
+  if (!F->arg_empty()) {
+    Err = "function '" + Entry.str() + "' takes arguments";
+    return false;
+  }
+
+  sys::TimeValue Start = sys::TimeValue::now();
+  EE->getPointerToFunction(F);
+  Stats.CompileSeconds += SecondsSince(Start);
+
+  Start = sys::TimeValue::now();
+  Result = EE->runFunction(F, std::vector<GenericValue>());
+  Stats.RunSeconds += SecondsSince(Start);
+  return true;
+}
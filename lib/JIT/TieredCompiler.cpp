@@ -0,0 +1,365 @@
+//===--- TieredCompiler.cpp - Profile-guided recompilation ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the TieredCompiler.
+//
+//  F.profile.data is an array of i64: the number of calls, then a word of
+//  SiteBits for each site, then two counts for each conditional branch, of
+//  the times it went to its first and its second successor. Sites and
+//  branches are numbered in the order they appear in F.base, which clones
+//  keep.
+//
+//===----------------------------------------------------------------------===//
+
+#include "pyrt.h"
+#include "py/JIT/JIT.h"
+#include "py/JIT/TieredCompiler.h"
+#include "py/Runtime/Runtime.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Metadata.h"
+#include "llvm/Module.h"
+#include "llvm/PassManager.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+using namespace py;
+using namespace llvm;
+
+/// SiteBits - What reached a site.
+enum {
+  SawSmallInts = 1 << 0,  ///< Two small ints.
+  SawOther = 1 << 1       ///< Anything else.
+};
+
+namespace py {
+struct TierHook {
+  static void run(void *Data, void *Key, py_tier_event Event, unsigned Site) {
+    TieredCompiler *TC = static_cast<TieredCompiler*>(Data);
+    TieredCompiler::Tiered *T = TC->lookup(Key);
+    if (!T)
+      return;
+    if (Event == PY_TIER_HOT)
+      TC->tierUp(*T);
+    else
+      TC->deopt(*T, Site);
+  }
+};
+}
+
+TieredCompiler::TieredCompiler(JIT &J, Runtime &R, unsigned HotCalls,
+                               unsigned MaxDeopts, unsigned MaxRecompiles)
+  : J(J), R(R), HotCalls(HotCalls), MaxDeopts(MaxDeopts),
+    MaxRecompiles(MaxRecompiles) {
+  assert(HotCalls && MaxRecompiles && "Nothing would be recompiled!");
+  // Declared now, so that the JIT resolves them with the rest.
+  Module &M = J.getModule();
+  Type *VoidTy = Type::getVoidTy(M.getContext());
+  M.getOrInsertFunction("py_tier_up", VoidTy, R.GetVoidTyPtr(), NULL);
+  M.getOrInsertFunction("py_deopt", VoidTy, R.GetVoidTyPtr(),
+                        Type::getInt32Ty(M.getContext()), NULL);
+  py_set_tier_hook(&TierHook::run, this);
+}
+
+TieredCompiler::~TieredCompiler() {
+  py_set_tier_hook(0, 0);
+}
+
+/// findSites - The int arithmetic and py_cmp calls of F, and its
+/// conditional branches, in order.
+void TieredCompiler::findSites(Function *F, Runtime &R,
+                               SmallVectorImpl<CallInst*> &Sites,
+                               SmallVectorImpl<BranchInst*> &Branches) {
+  Module &M = *F->getParent();
+  Value *Ops[] = { R.GetFunction(M, Runtime::IntAdd),
+                   R.GetFunction(M, Runtime::IntSub),
+                   R.GetFunction(M, Runtime::IntMul),
+                   R.GetFunction(M, Runtime::Cmp) };
+  for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+      if (CallInst *CI = dyn_cast<CallInst>(I)) {
+        Value *Callee = CI->getCalledValue();
+        for (unsigned i = 0; i != array_lengthof(Ops); ++i)
+          if (Callee == Ops[i])
+            Sites.push_back(CI);
+      } else if (BranchInst *BI = dyn_cast<BranchInst>(I)) {
+        if (BI->isConditional())
+          Branches.push_back(BI);
+      }
+    }
+}
+
+void TieredCompiler::addAllFunctions() {
+  // Tiering adds functions; take the ones there are now.
+  std::vector<Function*> Defined;
+  Module &M = J.getModule();
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    if (!F->isDeclaration())
+      Defined.push_back(F);
+  for (unsigned i = 0, e = Defined.size(); i != e; ++i)
+    addFunction(Defined[i]);
+}
+
+void TieredCompiler::addFunction(Function *F) {
+  if (F->isDeclaration() || F->isVarArg())
+    return;
+  Module &M = *F->getParent();
+  LLVMContext &C = M.getContext();
+  Tiered T;
+  T.SlotAddress = 0;
+  T.Counters = 0;
+  T.Optimized = false;
+  T.Recompiles = T.Deopts = 0;
+
+  // Move the body of F to F.base.
+  T.Base = Function::Create(F->getFunctionType(), GlobalValue::InternalLinkage,
+                            F->getName() + ".base", &M);
+  T.Base->setCallingConv(F->getCallingConv());
+  T.Base->setAttributes(F->getAttributes());
+  T.Base->getBasicBlockList().splice(T.Base->begin(), F->getBasicBlockList());
+  for (Function::arg_iterator A = F->arg_begin(), B = T.Base->arg_begin(),
+       E = F->arg_end(); A != E; ++A, ++B) {
+    A->replaceAllUsesWith(B);
+    B->takeName(A);
+  }
+
+  SmallVector<CallInst*, 16> Sites;
+  SmallVector<BranchInst*, 16> Branches;
+  findSites(T.Base, R, Sites, Branches);
+  T.NumSites = Sites.size();
+  T.NumBranches = Branches.size();
+  ArrayType *DataTy = ArrayType::get(Type::getInt64Ty(C),
+                                     1 + T.NumSites + 2 * T.NumBranches);
+  T.Data = new GlobalVariable(M, DataTy, false /*isConstant*/,
+                              GlobalValue::InternalLinkage,
+                              Constant::getNullValue(DataTy),
+                              F->getName() + ".profile.data");
+
+  ValueToValueMapTy VMap;
+  T.Profile = CloneFunction(T.Base, VMap, false /*ModuleLevelChanges*/);
+  T.Profile->setName(F->getName() + ".profile");
+  M.getFunctionList().push_back(T.Profile);
+  instrument(T);
+
+  PointerType *FnPtrTy = PointerType::getUnqual(F->getFunctionType());
+  T.Slot = new GlobalVariable(M, FnPtrTy, false /*isConstant*/,
+                              GlobalValue::InternalLinkage, T.Profile,
+                              F->getName() + ".tier");
+
+  // F calls the current tier.
+  IRBuilder<> IRB(BasicBlock::Create(C, "entry", F));
+  SmallVector<Value*, 8> Args;
+  for (Function::arg_iterator A = F->arg_begin(), E = F->arg_end(); A != E;
+       ++A)
+    Args.push_back(A);
+  CallInst *Call = IRB.CreateCall(IRB.CreateLoad(T.Slot, "tier"), Args);
+  Call->setCallingConv(F->getCallingConv());
+  Call->setTailCall();
+  if (F->getReturnType()->isVoidTy())
+    IRB.CreateRetVoid();
+  else
+    IRB.CreateRet(Call);
+
+  Functions.push_back(T);
+  ++Stats.FunctionsTiered;
+}
+
+/// instrument - Make T.Profile count into T.Data.
+void TieredCompiler::instrument(Tiered &T) {
+  Function *F = T.Profile;
+  LLVMContext &C = F->getContext();
+  SmallVector<CallInst*, 16> Sites;
+  SmallVector<BranchInst*, 16> Branches;
+  findSites(F, R, Sites, Branches);
+  Value *Key = ConstantExpr::getBitCast(T.Data, R.GetVoidTyPtr());
+
+  // Each site ors in SawSmallInts if the low bits of both operands are
+  // set, or SawOther if not: 2 - (A & B & 1).
+  for (unsigned i = 0, e = Sites.size(); i != e; ++i) {
+    CallInst *CI = Sites[i];
+    IRBuilder<> IRB(CI);
+    Type *I64 = IRB.getInt64Ty();
+    Value *Tags = IRB.CreateAnd(
+      IRB.CreateAnd(IRB.CreatePtrToInt(CI->getArgOperand(0), I64),
+                    IRB.CreatePtrToInt(CI->getArgOperand(1), I64)),
+      IRB.getInt64(1));
+    Value *Bits = IRB.CreateSub(IRB.getInt64(SawOther), Tags);
+    Value *P = IRB.CreateConstInBoundsGEP2_32(T.Data, 0, 1 + i, "site");
+    IRB.CreateStore(IRB.CreateOr(IRB.CreateLoad(P), Bits), P);
+  }
+
+  for (unsigned i = 0, e = Branches.size(); i != e; ++i) {
+    BranchInst *BI = Branches[i];
+    IRBuilder<> IRB(BI);
+    Value *Index = IRB.CreateAdd(
+      IRB.getInt64(1 + T.NumSites + 2 * i),
+      IRB.CreateZExt(IRB.CreateNot(BI->getCondition()), IRB.getInt64Ty()));
+    Value *Indices[] = { IRB.getInt64(0), Index };
+    Value *P = IRB.CreateInBoundsGEP(T.Data, Indices, "branch");
+    IRB.CreateStore(IRB.CreateAdd(IRB.CreateLoad(P), IRB.getInt64(1)), P);
+  }
+
+  // Count the call, after the allocas so that they stay in the entry block.
+  BasicBlock *Entry = &F->getEntryBlock();
+  BasicBlock::iterator IP = Entry->begin();
+  while (isa<AllocaInst>(IP))
+    ++IP;
+  BasicBlock *Body = Entry->splitBasicBlock(IP, "tier.body");
+  BasicBlock *Hot = BasicBlock::Create(C, "tier.hot", F, Body);
+  Entry->getTerminator()->eraseFromParent();
+  IRBuilder<> IRB(Entry);
+  Value *P = IRB.CreateConstInBoundsGEP2_32(T.Data, 0, 0, "calls");
+  Value *Calls = IRB.CreateAdd(IRB.CreateLoad(P), IRB.getInt64(1));
+  IRB.CreateStore(Calls, P);
+  IRB.CreateCondBr(IRB.CreateICmpEQ(Calls, IRB.getInt64(HotCalls)), Hot, Body);
+
+  IRB.SetInsertPoint(Hot);
+  IRB.CreateCall(F->getParent()->getFunction("py_tier_up"), Key);
+  IRB.CreateBr(Body);
+}
+
+/// specialize - Make an optimized tier of T from T.Base and the profile.
+/// Without Guards, no site is specialized, so it never deoptimizes.
+Function *TieredCompiler::specialize(Tiered &T, bool Guards) {
+  Module &M = *T.Base->getParent();
+  LLVMContext &C = M.getContext();
+  ValueToValueMapTy VMap;
+  Function *F = CloneFunction(T.Base, VMap, false /*ModuleLevelChanges*/);
+  StringRef Name = T.Base->getName();
+  F->setName(Name.substr(0, Name.size() - strlen(".base")) + ".opt");
+  M.getFunctionList().push_back(F);
+
+  SmallVector<CallInst*, 16> Sites;
+  SmallVector<BranchInst*, 16> Branches;
+  findSites(F, R, Sites, Branches);
+  const uint64_t *Counts = T.Counters + 1 + T.NumSites;
+
+  for (unsigned i = 0, e = Branches.size(); i != e; ++i) {
+    uint64_t Taken = Counts[2 * i], NotTaken = Counts[2 * i + 1];
+    if (!Taken && !NotTaken)
+      continue;
+    // Weights are 32 bits.
+    uint64_t Scale = std::max(Taken, NotTaken) / UINT32_MAX + 1;
+    Type *I32 = Type::getInt32Ty(C);
+    Value *Weights[] = {
+      MDString::get(C, "branch_weights"),
+      ConstantInt::get(I32, Taken / Scale),
+      ConstantInt::get(I32, NotTaken / Scale)
+    };
+    Branches[i]->setMetadata(LLVMContext::MD_prof, MDNode::get(C, Weights));
+    ++Stats.BranchesWeighted;
+  }
+
+  Constant *Deopt = M.getFunction("py_deopt");
+  Value *Key = ConstantExpr::getBitCast(T.Data, R.GetVoidTyPtr());
+  for (unsigned i = 0, e = Sites.size(); Guards && i != e; ++i) {
+    if (T.Counters[1 + i] != SawSmallInts)
+      continue;
+    CallInst *CI = Sites[i];
+    Value *A = CI->getArgOperand(0), *B = CI->getArgOperand(1);
+    BasicBlock *BB = CI->getParent();
+    BasicBlock *Done = BB->splitBasicBlock(CI, "site.done");
+    BB->getTerminator()->eraseFromParent();
+
+    // The type guard ends the block the site was in.
+    BasicBlock *Guard = BB, *Slow;
+    Value *V;
+    if (CI->getCalledValue() == R.GetFunction(M, Runtime::Cmp)) {
+      V = R.EmitCmp(M, &BB, A, B, &Slow);
+    } else {
+      Runtime::Fns Op =
+        CI->getCalledValue() == R.GetFunction(M, Runtime::IntAdd) ?
+          Runtime::IntAdd :
+        CI->getCalledValue() == R.GetFunction(M, Runtime::IntSub) ?
+          Runtime::IntSub : Runtime::IntMul;
+      V = R.EmitIntArith(M, &BB, Op, A, B, &Slow);
+    }
+    BranchInst::Create(Done, BB);
+
+    // Only a failed guard deoptimizes; an int op that overflows a small
+    // int goes straight to the generic code, as the profile expected.
+    BranchInst *GuardBr = cast<BranchInst>(Guard->getTerminator());
+    assert(GuardBr->getSuccessor(1) == Slow && "Not the type guard!");
+    BasicBlock *DeoptBB = BasicBlock::Create(C, "site.deopt", F, Slow);
+    IRBuilder<> IRB(DeoptBB);
+    IRB.CreateCall2(Deopt, Key, ConstantInt::get(Type::getInt32Ty(C), i));
+    IRB.CreateBr(Slow);
+    GuardBr->setSuccessor(1, DeoptBB);
+    CI->replaceAllUsesWith(V);
+    CI->eraseFromParent();
+    ++Stats.SitesSpecialized;
+  }
+
+  FunctionPassManager FPM(&M);
+  FPM.add(createPromoteMemoryToRegisterPass());
+  FPM.add(createInstructionCombiningPass());
+  FPM.add(createGVNPass());
+  FPM.add(createCFGSimplificationPass());
+  FPM.doInitialization();
+  FPM.run(*F);
+  FPM.doFinalization();
+  return F;
+}
+
+/// lookup - Return the function whose code passed Key to the tier hook.
+TieredCompiler::Tiered *TieredCompiler::lookup(void *Key) {
+  if (ByKey.empty()) {
+    // Everything has been emitted by the time any tier runs.
+    std::string Err;
+    for (unsigned i = 0, e = Functions.size(); i != e; ++i) {
+      Tiered &T = Functions[i];
+      T.Counters = static_cast<uint64_t*>(
+        J.getGlobalAddress(T.Data->getName(), Err));
+      T.SlotAddress = static_cast<void**>(
+        J.getGlobalAddress(T.Slot->getName(), Err));
+      ByKey[T.Counters] = i;
+    }
+  }
+  DenseMap<void*, unsigned>::iterator I = ByKey.find(Key);
+  return I == ByKey.end() ? 0 : &Functions[I->second];
+}
+
+void TieredCompiler::tierUp(Tiered &T) {
+  if (T.Optimized || T.Recompiles == MaxRecompiles)
+    return;
+  Function *F = specialize(T, T.Recompiles + 1 < MaxRecompiles);
+  std::string Err;
+  void *Code = J.getFunctionAddress(F->getName(), Err);
+  if (!Code)
+    return;
+  *T.SlotAddress = Code;
+  T.Optimized = true;
+  T.Deopts = 0;
+  ++T.Recompiles;
+  ++Stats.Recompiles;
+}
+
+void TieredCompiler::deopt(Tiered &T, unsigned Site) {
+  ++Stats.Deopts;
+  assert(Site < T.NumSites && "Deoptimizing a site that isn't there!");
+  T.Counters[1 + Site] |= SawOther;
+  if (!T.Optimized || ++T.Deopts < MaxDeopts)
+    return;
+
+  // Back to profiling, which counts up to HotCalls again. The optimized
+  // tier may still be running, so it stays.
+  std::string Err;
+  *T.SlotAddress = J.getFunctionAddress(T.Profile->getName(), Err);
+  T.Counters[0] = 0;
+  T.Optimized = false;
+  ++Stats.Invalidations;
+}
@@ -0,0 +1,429 @@
+//===--- CharScan.cpp - Bulk character classification ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the table, scalar, SSE2 and AVX2 character scanners
+//  used by the Lexer for identifier bodies, indentation and comments.
+//
+//  The vector loops only ever load whole blocks that end at or before the
+//  buffer's terminating NUL, and finish the remainder with the scalar loop, so
+//  they never read past the end of the buffer.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Lex/CharScan.h"
+#include "llvm/Support/MathExtras.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define PY_CHARSCAN_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#if defined(__x86_64__)
+#define PY_TARGET_SSE2
+#else
+#define PY_TARGET_SSE2 __attribute__((target("sse2")))
+#endif
+#define PY_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+using namespace py;
+using namespace llvm;
+
+//===----------------------------------------------------------------------===//
+// Scalar implementation.
+//===----------------------------------------------------------------------===//
+
+/// isIdentifierBody - [a-zA-Z0-9_].
+static inline bool isIdentifierBody(unsigned char C) {
+  return (unsigned)((C | 0x20) - 'a') < 26 ||
+         (unsigned)(C - '0') < 10 ||
+         C == '_';
+}
+
+static const char *skipIdentifierBodyScalar(const char *P, const char *End) {
+  while (isIdentifierBody(*P))
+    ++P;
+  return P;
+}
+
+static const char *skipIndentationScalar(const char *P, const char *End,
+                                         unsigned &Spaces, unsigned &Tabs) {
+  while (true) {
+    if (*P == ' ')
+      ++Spaces;
+    else if (*P == '\t')
+      ++Tabs;
+    else
+      return P;
+    ++P;
+  }
+}
+
+static const char *findEndOfLineScalar(const char *P, const char *End) {
+  while (*P != '\n' && *P != '\0')
+    ++P;
+  return P;
+}
+
+//===----------------------------------------------------------------------===//
+// Table implementation.
+//===----------------------------------------------------------------------===//
+
+// The Lexer's classification before the scanners above and below replaced
+// it: one load from a 256-entry table per byte. Kept as the baseline that
+// py-lex-bench compares the others with.
+enum { Id = 1, Sp = 2, Tb = 4, Nl = 8 };
+static const unsigned char CharClass[256] = {
+  Nl,  0,  0,  0,  0,  0,  0,  0,  0, Tb, Nl,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+  Sp,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+  Id, Id, Id, Id, Id, Id, Id, Id, Id, Id,  0,  0,  0,  0,  0,  0,
+   0, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id,
+  Id, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id,  0,  0,  0,  0, Id,
+   0, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id,
+  Id, Id, Id, Id, Id, Id, Id, Id, Id, Id, Id,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+static const char *skipIdentifierBodyTable(const char *P, const char *End) {
+  while (CharClass[(unsigned char)*P] & Id)
+    ++P;
+  return P;
+}
+
+static const char *skipIndentationTable(const char *P, const char *End,
+                                        unsigned &Spaces, unsigned &Tabs) {
+  while (unsigned C = CharClass[(unsigned char)*P] & (Sp | Tb)) {
+    if (C == Tb)
+      ++Tabs;
+    else
+      ++Spaces;
+    ++P;
+  }
+  return P;
+}
+
+static const char *findEndOfLineTable(const char *P, const char *End) {
+  while (!(CharClass[(unsigned char)*P] & Nl))
+    ++P;
+  return P;
+}
+
+#ifdef PY_CHARSCAN_X86
+
+//===----------------------------------------------------------------------===//
+// SSE2 implementation.
+//===----------------------------------------------------------------------===//
+
+// SSE2 only has signed byte compares, so "Lo <= C <= Hi" is computed by
+// biasing C so that Lo maps to -128 and checking the result is below
+// -128 + (Hi - Lo + 1).
+#define IN_RANGE_128(V, Lo, Hi)                                           \
+  _mm_cmplt_epi8(_mm_add_epi8((V), _mm_set1_epi8((char)(0x80 - (Lo)))),   \
+                 _mm_set1_epi8((char)(-128 + ((Hi) - (Lo) + 1))))
+
+PY_TARGET_SSE2
+static const char *skipIdentifierBodySSE2(const char *P, const char *End) {
+  const __m128i Lower = _mm_set1_epi8(0x20);
+  const __m128i Under = _mm_set1_epi8('_');
+  while (End - P >= 16) {
+    __m128i V = _mm_loadu_si128((const __m128i*)P);
+    __m128i Ident = _mm_or_si128(IN_RANGE_128(_mm_or_si128(V, Lower), 'a', 'z'),
+                                 IN_RANGE_128(V, '0', '9'));
+    Ident = _mm_or_si128(Ident, _mm_cmpeq_epi8(V, Under));
+    unsigned Mask = ~(unsigned)_mm_movemask_epi8(Ident) & 0xFFFF;
+    if (Mask)
+      return P + CountTrailingZeros_32(Mask);
+    P += 16;
+  }
+  return skipIdentifierBodyScalar(P, End);
+}
+
+PY_TARGET_SSE2
+static const char *skipIndentationSSE2(const char *P, const char *End,
+                                       unsigned &Spaces, unsigned &Tabs) {
+  const __m128i Space = _mm_set1_epi8(' ');
+  const __m128i Tab = _mm_set1_epi8('\t');
+  while (End - P >= 16) {
+    __m128i V = _mm_loadu_si128((const __m128i*)P);
+    unsigned TabMask = _mm_movemask_epi8(_mm_cmpeq_epi8(V, Tab));
+    unsigned WSMask = _mm_movemask_epi8(_mm_cmpeq_epi8(V, Space)) | TabMask;
+    unsigned Stop = ~WSMask & 0xFFFF;
+    unsigned N = Stop ? CountTrailingZeros_32(Stop) : 16;
+    unsigned NTabs = CountPopulation_32(TabMask & ((1U << N) - 1));
+    Tabs += NTabs;
+    Spaces += N - NTabs;
+    if (Stop)
+      return P + N;
+    P += 16;
+  }
+  return skipIndentationScalar(P, End, Spaces, Tabs);
+}
+
+PY_TARGET_SSE2
+static const char *findEndOfLineSSE2(const char *P, const char *End) {
+  const __m128i NL = _mm_set1_epi8('\n');
+  const __m128i Zero = _mm_setzero_si128();
+  while (End - P >= 16) {
+    __m128i V = _mm_loadu_si128((const __m128i*)P);
+    unsigned Mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(V, NL),
+                                                   _mm_cmpeq_epi8(V, Zero)));
+    if (Mask)
+      return P + CountTrailingZeros_32(Mask);
+    P += 16;
+  }
+  return findEndOfLineScalar(P, End);
+}
+
+#undef IN_RANGE_128
+
+//===----------------------------------------------------------------------===//
+// AVX2 implementation.
+//===----------------------------------------------------------------------===//
+
+#define IN_RANGE_256(V, Lo, Hi)                                                \
+  _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + ((Hi) - (Lo) + 1))),        \
+                    _mm256_add_epi8((V), _mm256_set1_epi8((char)(0x80 - (Lo)))))
+
+PY_TARGET_AVX2
+static const char *skipIdentifierBodyAVX2(const char *P, const char *End) {
+  const __m256i Lower = _mm256_set1_epi8(0x20);
+  const __m256i Under = _mm256_set1_epi8('_');
+  while (End - P >= 32) {
+    __m256i V = _mm256_loadu_si256((const __m256i*)P);
+    __m256i Ident =
+      _mm256_or_si256(IN_RANGE_256(_mm256_or_si256(V, Lower), 'a', 'z'),
+                      IN_RANGE_256(V, '0', '9'));
+    Ident = _mm256_or_si256(Ident, _mm256_cmpeq_epi8(V, Under));
+    unsigned Mask = ~(unsigned)_mm256_movemask_epi8(Ident);
+    if (Mask)
+      return P + CountTrailingZeros_32(Mask);
+    P += 32;
+  }
+  return skipIdentifierBodySSE2(P, End);
+}
+
+PY_TARGET_AVX2
+static const char *skipIndentationAVX2(const char *P, const char *End,
+                                       unsigned &Spaces, unsigned &Tabs) {
+  const __m256i Space = _mm256_set1_epi8(' ');
+  const __m256i Tab = _mm256_set1_epi8('\t');
+  while (End - P >= 32) {
+    __m256i V = _mm256_loadu_si256((const __m256i*)P);
+    unsigned TabMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(V, Tab));
+    unsigned WSMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(V, Space)) |
+                      TabMask;
+    unsigned Stop = ~WSMask;
+    if (!Stop) {
+      unsigned NTabs = CountPopulation_32(TabMask);
+      Tabs += NTabs;
+      Spaces += 32 - NTabs;
+      P += 32;
+      continue;
+    }
+    unsigned N = CountTrailingZeros_32(Stop);
+    unsigned NTabs = CountPopulation_32(TabMask & ((1U << N) - 1));
+    Tabs += NTabs;
+    Spaces += N - NTabs;
+    return P + N;
+  }
+  return skipIndentationSSE2(P, End, Spaces, Tabs);
+}
+
+PY_TARGET_AVX2
+static const char *findEndOfLineAVX2(const char *P, const char *End) {
+  const __m256i NL = _mm256_set1_epi8('\n');
+  const __m256i Zero = _mm256_setzero_si256();
+  while (End - P >= 32) {
+    __m256i V = _mm256_loadu_si256((const __m256i*)P);
+    unsigned Mask =
+      _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(V, NL),
+                                           _mm256_cmpeq_epi8(V, Zero)));
+    if (Mask)
+      return P + CountTrailingZeros_32(Mask);
+    P += 32;
+  }
+  return findEndOfLineSSE2(P, End);
+}
+
+#undef IN_RANGE_256
+
+//===----------------------------------------------------------------------===//
+// Host feature detection.
+//===----------------------------------------------------------------------===//
+
+static bool hostHasSSE2() {
+#if defined(__x86_64__)
+  return true;
+#else
+  unsigned EAX, EBX, ECX, EDX;
+  if (!__get_cpuid(1, &EAX, &EBX, &ECX, &EDX))
+    return false;
+  return EDX & (1 << 26);
+#endif
+}
+
+static bool hostHasAVX2() {
+  unsigned EAX, EBX, ECX, EDX;
+  if (!__get_cpuid(1, &EAX, &EBX, &ECX, &EDX))
+    return false;
+  // The OS must have enabled the YMM state (OSXSAVE + AVX, XCR0 bits 1-2).
+  if (!(ECX & (1 << 27)) || !(ECX & (1 << 28)))
+    return false;
+  unsigned XCR0Lo, XCR0Hi;
+  __asm__ ("xgetbv" : "=a"(XCR0Lo), "=d"(XCR0Hi) : "c"(0));
+  if ((XCR0Lo & 6) != 6)
+    return false;
+  if (__get_cpuid_max(0, 0) < 7)
+    return false;
+  __cpuid_count(7, 0, EAX, EBX, ECX, EDX);
+  return EBX & (1 << 5);
+}
+
+#endif // PY_CHARSCAN_X86
+
+//===----------------------------------------------------------------------===//
+// Dispatch.
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct ScanFns {
+  const char *(*SkipIdentifierBody)(const char *, const char *);
+  const char *(*SkipIndentation)(const char *, const char *,
+                                 unsigned &, unsigned &);
+  const char *(*FindEndOfLine)(const char *, const char *);
+};
+}
+
+static const ScanFns TableFns = {
+  skipIdentifierBodyTable, skipIndentationTable, findEndOfLineTable
+};
+static const ScanFns ScalarFns = {
+  skipIdentifierBodyScalar, skipIndentationScalar, findEndOfLineScalar
+};
+#ifdef PY_CHARSCAN_X86
+static const ScanFns SSE2Fns = {
+  skipIdentifierBodySSE2, skipIndentationSSE2, findEndOfLineSSE2
+};
+static const ScanFns AVX2Fns = {
+  skipIdentifierBodyAVX2, skipIndentationAVX2, findEndOfLineAVX2
+};
+#endif
+
+/// resolveImpl - Turn Auto into the fastest implementation the host has,
+/// and find I's scanners. Returns false if the host can't run I.
+static bool resolveImpl(charscan::Implementation &I, const ScanFns *&Fns) {
+  using namespace charscan;
+  if (I == Auto) {
+    if (isSupported(AVX2))
+      I = AVX2;
+    else if (isSupported(SSE2))
+      I = SSE2;
+    else
+      I = Scalar;
+  }
+  if (!isSupported(I))
+    return false;
+
+  switch (I) {
+#ifdef PY_CHARSCAN_X86
+  case SSE2:  Fns = &SSE2Fns; break;
+  case AVX2:  Fns = &AVX2Fns; break;
+#endif
+  case Table: Fns = &TableFns; break;
+  default:    Fns = &ScalarFns; break;
+  }
+  return true;
+}
+
+namespace {
+/// Selection - The scanners in use, and the implementation they belong to.
+struct Selection {
+  const ScanFns *Fns;
+  charscan::Implementation Impl;
+
+  Selection() : Impl(charscan::Auto) {
+    resolveImpl(Impl, Fns);
+  }
+};
+}
+
+/// getSelection - The selection, made Auto by the first scan. Scans run on
+/// several threads at once (ParallelLex, the Scheduler), and the guard the
+/// compiler puts around a function-local static both runs the constructor
+/// once and orders its writes before the reads of any thread that gets past
+/// it. Only select() writes it afterwards, and select() is setup, called
+/// before any other thread scans.
+static Selection &getSelection() {
+  static Selection S;
+  return S;
+}
+
+bool charscan::isSupported(Implementation I) {
+  switch (I) {
+  case Auto:
+  case Table:
+  case Scalar:
+    return true;
+#ifdef PY_CHARSCAN_X86
+  case SSE2: return hostHasSSE2();
+  case AVX2: return hostHasAVX2();
+#else
+  case SSE2:
+  case AVX2:
+    return false;
+#endif
+  }
+  return false;
+}
+
+bool charscan::select(Implementation I) {
+  const ScanFns *Fns;
+  if (!resolveImpl(I, Fns))
+    return false;
+  Selection &S = getSelection();
+  S.Fns = Fns;
+  S.Impl = I;
+  return true;
+}
+
+charscan::Implementation charscan::getSelected() {
+  return getSelection().Impl;
+}
+
+const char *charscan::getName(Implementation I) {
+  switch (I) {
+  case Auto:   return "auto";
+  case Table:  return "table";
+  case Scalar: return "scalar";
+  case SSE2:   return "sse2";
+  case AVX2:   return "avx2";
+  }
+  return "";
+}
+
+const char *charscan::skipIdentifierBody(const char *P, const char *End) {
+  return getSelection().Fns->SkipIdentifierBody(P, End);
+}
+
+const char *charscan::skipIndentation(const char *P, const char *End,
+                                      unsigned &Spaces, unsigned &Tabs) {
+  return getSelection().Fns->SkipIndentation(P, End, Spaces, Tabs);
+}
+
+const char *charscan::findEndOfLine(const char *P, const char *End) {
+  return getSelection().Fns->FindEndOfLine(P, End);
+}
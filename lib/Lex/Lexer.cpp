@@ -13,28 +13,36 @@
 //===----------------------------------------------------------------------===//
 
 #include "py/Lex/Lexer.h"
+#include "py/Lex/CharScan.h"
+#include "py/Lex/TokenStream.h"
 #include "py/Diagnostic.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Support/Compiler.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include <cstring>
 #include <iostream>
 using namespace py;
 using namespace llvm;
 
 static void InitCharacterInfo();
+static void InitKeywordTable();
 
 //===----------------------------------------------------------------------===//
 // Lexer Class Implementation
 //===----------------------------------------------------------------------===//
 
+/// A token at the start of a line at column zero may close indented blocks.
+/// The character is put back first so that any dedent tokens are zero-length
+/// and sit at the start of the token that follows them.
 #define INITIAL_INDENT()                                        \
-  if (AtLineStart && LexPossibleIndent(Result, 0, &error)) {    \
+  if (AtLineStart) {                                            \
     unget();                                                    \
-    return true;                                                \
-  }                                                             \
-  if (error) {                                                  \
-    unget();                                                    \
-    return false;                                               \
+    if (LexPossibleIndent(Result, 0, &error))                   \
+      return true;                                              \
+    if (error)                                                  \
+      return false;                                             \
+    getAscii();                                                 \
   }                                                             \
   AtLineStart = false;                                          \
 
@@ -59,8 +67,10 @@ Lexer::Lexer(const MemoryBuffer *InputBuffer, LangFeatures features) :
   Features(features), AtLineStart(true), IndentStackTop(0),
   BraceStackTop(0),
   NumDedents(0), LastCharLen(0),
-  PeekTokenSuccess(false), PeekTokenValid(false) {
+  PeekTokenSuccess(false), PeekTokenValid(false),
+  DeferIndentation(false), Idents(0), Replay(0), ReplayIdx(0) {
   InitCharacterInfo();
+  InitKeywordTable();
 
   IndentStack[IndentStackTop] = 0;
 
@@ -151,8 +161,6 @@ static const unsigned char CharInfo[256] =
 };
 
 static void InitCharacterInfo() {
-  static bool isInited = false;
-  if (isInited) return;
   // check the statically-initialized CharInfo table
   assert(CHAR_HORZ_WS == CharInfo[(int)' ']);
   assert(CHAR_HORZ_WS == CharInfo[(int)'\t']);
@@ -168,8 +176,6 @@ static void InitCharacterInfo() {
   }
   for (unsigned i = '0'; i <= '9'; ++i)
     assert(CHAR_NUMBER == CharInfo[i]);
-    
-  isInited = true;
 }
 
 
@@ -206,6 +212,82 @@ static inline bool isNumberBody(unsigned char c) {
 }
 
 
+//===----------------------------------------------------------------------===//
+// Keyword recognition.
+//===----------------------------------------------------------------------===//
+
+/// Flags from TokenKinds.def saying which LangFeatures make an identifier a
+/// keyword.
+enum {
+  KEYALL   = 0x00,  // Always a keyword.
+  KEYPRINT = 0x01,  // Only with SpecialPrint.
+  KEYWITH  = 0x02,  // Only with AllowWith.
+  KEYEXEC  = 0x04,  // Only with SpecialExec.
+  KEYBOOL  = 0x08   // Only with BoolKeywords.
+};
+
+/// Size of the keyword hash table; must be a power of two.
+#define KEYWORD_TABLE_SIZE 128
+
+struct KeywordInfo {
+  const char *Spelling;
+  unsigned char Length;
+  unsigned char Kind;
+  unsigned char Flags;
+};
+
+/// Open-addressed table of every KEYWORD() in TokenKinds.def, indexed by
+/// HashKeyword. The multipliers in HashKeyword were chosen so that no two
+/// keywords share a slot, so a lookup is one hash and one compare; the
+/// first Lexer stops the compiler if a change to them or to TokenKinds.def
+/// makes two keywords collide.
+static KeywordInfo KeywordTable[KEYWORD_TABLE_SIZE];
+
+/// HashKeyword - Hash an identifier of length L (which must be at least 2)
+/// into KeywordTable.
+static inline unsigned HashKeyword(const char *T, unsigned L) {
+  return (L + (unsigned char)T[0]*3 + (unsigned char)T[1] +
+          (unsigned char)T[L-1]*5) & (KEYWORD_TABLE_SIZE-1);
+}
+
+static void AddKeyword(const char *Spelling, tok::TokenKind Kind,
+                       unsigned Flags) {
+  // Checked in every build: a bad slot would lex a keyword as another
+  // keyword, or as an identifier, without a word.
+  unsigned L = strlen(Spelling);
+  if (L < 2)
+    report_fatal_error(Twine("keyword '") + Spelling +
+                       "' is too short for HashKeyword");
+  KeywordInfo &KI = KeywordTable[HashKeyword(Spelling, L)];
+  if (KI.Spelling && KI.Kind != Kind)
+    report_fatal_error(Twine("keywords '") + KI.Spelling + "' and '" +
+                       Spelling + "' hash to the same slot; pick new "
+                       "multipliers in HashKeyword");
+  KI.Spelling = Spelling;
+  KI.Length = L;
+  KI.Kind = Kind;
+  KI.Flags = Flags;
+}
+
+namespace {
+/// KeywordTableInit - Fills KeywordTable when constructed.
+struct KeywordTableInit {
+  KeywordTableInit() {
+#define KEYWORD(X,Y) AddKeyword(#X, tok::kw_ ## X, Y);
+#include "py/Lex/TokenKinds.def"
+  }
+};
+}
+
+static void InitKeywordTable() {
+  // Constructed by the first Lexer. Lexers are made on several threads at
+  // once (ParallelLex, the Scheduler), and the guard the compiler puts
+  // around a function-local static both runs the constructor once and
+  // orders its writes before the reads of any Lexer that gets past it.
+  static KeywordTableInit Init;
+  (void)Init;
+}
+
 //===----------------------------------------------------------------------===//
 // Helper methods for lexing.
 //===----------------------------------------------------------------------===//
@@ -243,27 +325,43 @@ void Lexer::Diag(const char *str, Diagnostic::Severity s) {
   Diagnostics.push_back(d);
 }              
 
-unsigned Lexer::CountWhitespace(char C) {
-  unsigned n = (C == '\t') ? TAB_WIDTH : 1;
+tok::TokenKind Lexer::LookupKeyword(const char *T, unsigned L) {
+  // Early exit - no keywords are 1 char long.
+  if (L < 2)
+    return tok::identifier;
 
-  while (true) {
-    C = getAscii();
-    switch (C) {
-    case ' ':
-      ++n;
-      break;
-    case '\t':
-      n += TAB_WIDTH;
-      break;
-    default:
-      // Not whitespace.
-      unget();
-      return n;
-    }
-  }
+  const KeywordInfo &KI = KeywordTable[HashKeyword(T, L)];
+  if (KI.Length != L || memcmp(KI.Spelling, T, L))
+    return tok::identifier;
+
+  // Contextual keywords depend on the language features.
+  if (((KI.Flags & KEYPRINT) && !Features.hasSpecialPrint()) ||
+      ((KI.Flags & KEYWITH) && !Features.hasAllowWith()) ||
+      ((KI.Flags & KEYEXEC) && !Features.hasSpecialExec()) ||
+      ((KI.Flags & KEYBOOL) && !Features.hasBoolKeywords()))
+    return tok::identifier;
+
+  return (tok::TokenKind)KI.Kind;
+}
+
+unsigned Lexer::CountWhitespace(char C) {
+  unsigned Spaces = (C == ' ') ? 1 : 0;
+  unsigned Tabs = (C == '\t') ? 1 : 0;
+  Ptr = charscan::skipIndentation(Ptr, Buffer->getBufferEnd(), Spaces, Tabs);
+  return Spaces + Tabs * TAB_WIDTH;
 }
 
 bool Lexer::LexPossibleIndent(Token &Result, unsigned indent, bool *error) {
+  if (DeferIndentation) {
+    IndentEvent E = {
+      unsigned(TokStart - Buffer->getBufferStart()),
+      unsigned(Ptr - Buffer->getBufferStart()),
+      indent
+    };
+    IndentEvents.push_back(E);
+    return false;
+  }
+
   unsigned tos = IndentStack[IndentStackTop];
   if (indent > tos) {
     IndentStack[++IndentStackTop] = indent;
@@ -296,298 +394,14 @@ bool Lexer::LexPossibleIndent(Token &Result, unsigned indent, bool *error) {
 
 bool Lexer::LexIdentifier(Token &Result) {
   // Match [_A-Za-z0-9]*, we have already matched [_A-Za-z$]        
-  char C;
-  while (isIdentifierBody(C = getAscii()))
-    ;
-
-  unget(); // Back up over the last character.
+  Ptr = charscan::skipIdentifierBody(Ptr, Buffer->getBufferEnd());
 
-  // Recognise special identifiers.
-  const char *T = TokStart;
+  // Recognise keywords.
   unsigned L = Ptr-TokStart;
-
-  // Early exit - no identifiers are 1 char long.
-  if (L == 1) {
-    MakeToken(Result, tok::identifier);
-    return true;
-   }
-
-  switch (*T++) {
-  case 'a':
-    if (L < 2) break;
-    switch (*T++) {
-    case 'n':
-      if (L == 3 && *T++ == 'd') {
-        MakeToken(Result, tok::kw_and);
-        return true;
-      }
-      break;
-    case 's':
-      if (L == 2) {
-        MakeToken(Result, tok::kw_as);
-        return true;
-      }
-      if (*T++ == 's' &&
-          !strncmp(T, "ert", 3) &&
-          L == 6) {
-        MakeToken(Result, tok::kw_assert);
-        return true;
-      }
-      break;
-    default:
-      break;
-    }
-    break;
-
-  case 'b':
-    if (L == 5 &&
-        !strncmp(T, "reak", 4)) {
-      MakeToken(Result, tok::kw_break);
-      return true;
-    }
-    break;
-
-  case 'c':
-    if (L < 5) break;
-    switch (*T++) {
-    case 'l':
-      if (L == 5 && 
-          !strncmp(T, "ass", 3)) {
-        MakeToken(Result, tok::kw_class);
-        return true;
-      }
-      break;
-    case 'o':
-      if (L == 8 &&
-          !strncmp(T, "ntinue", 6)) {
-        MakeToken(Result, tok::kw_continue);
-        return true;
-      }
-      break;
-    default:
-      break;
-    }
-    break;
-
-  case 'd':
-    if (*T++ != 'e' || L != 3)
-      break;
-    switch (*T++) {
-    case 'f':
-      MakeToken(Result, tok::kw_def);
-      return true;
-    case 'l':
-      MakeToken(Result, tok::kw_del);
-      return true;
-    default:
-      break;
-    }
-    break;
-  
-  case 'e':
-    if (L < 4) break;
-    switch (*T++) {
-    case 'l':
-      if (L != 4) break;
-      switch (*T++) {
-      case 'i':
-        if (*T++ == 'f') {
-          MakeToken(Result, tok::kw_elif);
-          return true;
-        }
-        break;
-      case 's':
-        if (*T++ == 'e') {
-          MakeToken(Result, tok::kw_else);
-          return true;
-        }
-        break;
-      default:
-        break;
-      }
-      break;
-    case 'x':
-      if (L == 4 && *T++ == 'e' && 
-          *T++ == 'c') {
-        MakeToken(Result, tok::kw_exec);
-        return true;
-      }
-      if (L == 6 && !strncmp(T, "cept", 4)) {
-        MakeToken(Result, tok::kw_except);
-        return true;
-      }
-      break;
-    default:
-      break;
-    }
-    break;
-
-  case 'f':
-    if (L < 3) break;
-    switch (*T++) {
-    case 'i':
-      if (L == 7 && !strncmp(T, "nally", 5)) {
-        MakeToken(Result, tok::kw_finally);
-        return true;
-      }
-      break;
-    case 'o':
-      if (L == 3 && *T == 'r') {
-        MakeToken(Result, tok::kw_for);
-        return true;
-      }
-      break;
-    case 'r':
-      if (L == 4 && *T++ == 'o' &&
-          *T == 'm') {
-        MakeToken(Result, tok::kw_from);
-        return true;
-      }
-      break;
-    default:
-      break;
-    }
-    break;
-
-  case 'g':
-    if (L == 6 && !strncmp(T, "lobal", 5)) {
-      MakeToken(Result, tok::kw_global);
-      return true;
-    }
-    break;
-
-  case 'i':
-    switch (*T++) {
-    case 'f':
-      if (L == 2) {
-        MakeToken(Result, tok::kw_if);
-        return true;
-      }
-      break;
-    case 'm':
-      if (L == 6 && !strncmp(T, "port", 4)) {
-        MakeToken(Result, tok::kw_import);
-        return true;
-      }
-      break;
-    case 'n':
-      if (L == 2) {
-        MakeToken(Result, tok::kw_in);
-        return true;
-      }
-      break;
-    case 's':
-      if (L == 2) {
-        MakeToken(Result, tok::kw_is);
-        return true;
-      }
-      break;
-    default:
-      break;
-    }
-
-  case 'l':
-    if (L == 6 && !strncmp(T, "ambda", 5)) {
-      MakeToken(Result, tok::kw_lambda);
-      return true;
-    }
-    break;
-
-  case 'n':
-    if (L == 3 && *T++ == 'o' && *T == 't') {
-      MakeToken(Result, tok::kw_not);
-      return true;
-    }
-    break;
-
-  case 'o':
-    if (L == 2 && *T == 'r') {
-      MakeToken(Result, tok::kw_or);
-      return true;
-    }
-    break;
-
-  case 'p':
-    if (L < 4) break;
-    switch (*T++) {
-    case 'a':
-      if (L == 4 && !strncmp(T, "ss", 2)) {
-        MakeToken(Result, tok::kw_pass);
-        return true;
-      }
-      break;
-    case 'r':
-      // FIXME: Check LangFeatures
-      if (L == 5 && !strncmp(T, "int", 3)) {
-        MakeToken(Result, tok::kw_print);
-        return true;
-      }
-      break;
-    default:
-      break;
-    }
-    break;
-
-  case 'r':
-    if (L < 5) break;
-    switch (*T++) {
-    case 'a':
-      if (L == 5 && !strncmp(T, "ise", 3)) {
-        MakeToken(Result, tok::kw_raise);
-        return true;
-      }
-      break;
-    case 'e':
-      if (L == 6 && !strncmp(T, "turn", 4)) {
-        MakeToken(Result, tok::kw_return);
-        return true;
-      }
-      break;
-    default:
-      break;
-    }
-    break;
-
-  case 't':
-    if (L == 3 && *T++ == 'r' && *T == 'y') {
-      MakeToken(Result, tok::kw_try);
-      return true;
-    }
-    break;
-
-  case 'w':
-    if (L < 4) break;
-    switch (*T++) {
-    case 'h':
-      if (L == 5 && !strncmp(T, "ile", 3)) {
-        MakeToken(Result, tok::kw_while);
-        return true;
-      }
-      break;
-    case 'i':
-      // FIXME: Check LangFeatures
-      if (L == 4 && *T++ == 't' && *T == 'h') {
-        MakeToken(Result, tok::kw_with);
-        return true;
-      }
-      break;
-    default:
-      break;
-    }
-    break;
-
-  case 'y':
-    if (L == 5 && !strncmp(T, "ield", 4)) {
-      MakeToken(Result, tok::kw_yield);
-      return true;
-    }
-    break;
-
-  default:
-    break;
-  }
-
-  MakeToken(Result, tok::identifier);
+  tok::TokenKind Kind = LookupKeyword(TokStart, L);
+  MakeToken(Result, Kind);
+  if (Kind == tok::identifier && Idents)
+    Result.setIdentifier(Idents->get(Result.getSpelling()));
   return true;
 }
 
@@ -681,6 +495,14 @@ bool Lexer::Peek(Token &Result) {
   return PeekTokenSuccess;
 }
 
+void Lexer::replay(const TokenStream &S) {
+  assert(S.getBuffer() == Buffer && "Tokens of a different buffer!");
+  assert(Ptr == Buffer->getBufferStart() && "Lexer has already lexed!");
+  Replay = &S;
+  ReplayIdx = 0;
+  Diagnostics.append(S.getDiagnostics().begin(), S.getDiagnostics().end());
+}
+
 bool Lexer::Lex(Token &Result) {
   if (PeekTokenValid) {
     Result = PeekToken;
@@ -688,7 +510,24 @@ bool Lexer::Lex(Token &Result) {
     return PeekTokenSuccess;
   }
 
+  if (Replay) {
+    // The stream ends in eof, which is returned for good once reached.
+    unsigned Last = Replay->size() - 1;
+    unsigned I = ReplayIdx < Last ? ReplayIdx++ : Last;
+    Replay->getToken(I, Result);
+    // A stream lexed ahead of time without a table (on another thread, say)
+    // carries no Identifiers; intern its names now.
+    if (Idents && Result.getKind() == tok::identifier &&
+        !Result.getIdentifier().isValid())
+      Result.setIdentifier(Idents->get(Result.getSpelling()));
+    // A stream cut short by an error ends in a synthesized eof; report it
+    // the way lexing the buffer would have.
+    return !(I == Last && Replay->hasErrors());
+  }
+
   if (NumDedents) {
+    // Pending dedents are zero-length tokens at the current position.
+    TokStart = Ptr;
     MakeToken(Result, tok::dedent);
     --NumDedents;
     return true;
@@ -711,7 +550,10 @@ bool Lexer::Lex(Token &Result) {
           Ptr = TokStart; // Reset back so we see the \0 again next time.
           return Lex(Result);
         }
-        Result.setKind(tok::eof);
+        // The eof token is zero-length at the terminating NUL; leave Ptr
+        // there so that lexing again returns eof again.
+        Ptr = TokStart;
+        MakeToken(Result, tok::eof);
         return true;
       }
       AtLineStart = false;
@@ -754,10 +596,11 @@ bool Lexer::Lex(Token &Result) {
       return LexNumericConstant(Result);
 
     case '#': {
-      // Comment - zap to end of line.
-      unsigned I = getUnicode();
-      while (I && I != (unsigned)'\n')
-        I = getUnicode();
+      // Comment - zap to end of line. Step over the newline, but never over
+      // the NUL terminating the buffer.
+      Ptr = charscan::findEndOfLine(Ptr, Buffer->getBufferEnd());
+      if (Ptr != Buffer->getBufferEnd())
+        ++Ptr;
       while (*Ptr == '\n' || *Ptr == '\r')
         ++Ptr;
       AtLineStart = BraceStackTop==0;
@@ -812,12 +655,15 @@ string_case:
       }
 
     case '\\':
-      if (getAscii() != '\n') {
+      // Line joining - the backslash should be the last thing on the line.
+      // If it isn't, warn and join anyway, without running off the end of
+      // the buffer.
+      if (*Ptr != '\n') {
         Diag("Spurious characters after line joining backslash", Diagnostic::Warning);
-        while (getAscii() != '\n')
-          ;
-        return false;
+        Ptr = charscan::findEndOfLine(Ptr, Buffer->getBufferEnd());
       }
+      if (*Ptr == '\n')
+        ++Ptr;
       continue;
 
     case '(':
@@ -1060,7 +906,7 @@ string_case:
       // Fall through;
 
     default:
-      assert(0 && "Unhandled character!");
+      Diag("Unexpected character", Diagnostic::Error);
       return false;
     }
   }
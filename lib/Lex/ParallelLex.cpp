@@ -0,0 +1,281 @@
+//===--- ParallelLex.cpp - Lex large buffers on several threads -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements TokenStream::tokenizeParallel.
+//
+//  The buffer is cut at newlines about ChunkSize bytes apart, and each chunk
+//  is lexed in place, on its own thread, by a Lexer resumed at its first
+//  newline with indentation deferred. A chunk runs on past its end to the
+//  first newline token there, and stops.
+//
+//  At a newline token the only state a Lexer has is its indent stack, which
+//  is why indentation is deferred. So where the Lexer of one chunk stops,
+//  the Lexer of the next one agrees with it from then on if it too made a
+//  newline token at that point. Usually that is the newline it started at.
+//  If the cut was inside a string, brackets or a joined line, it is a later
+//  one. If the two never agree, the stretch is lexed again on the calling
+//  thread, starting where the first chunk stopped. A sequential pass then
+//  replays the recorded line starts against the real indent stack to make
+//  the indent and dedent tokens.
+//
+//  Anything the merge can't reproduce exactly makes the whole buffer be
+//  lexed again sequentially, so the result always matches Lexer::Lex. That
+//  covers any error, including "Unexpected indent".
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Lex/TokenStream.h"
+#include "py/Lex/CharScan.h"
+#include "py/Lex/Lexer.h"
+#include "py/Support/Parallel.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/ErrorHandling.h"
+
+using namespace py;
+using namespace llvm;
+
+/// FindSplitPoints - Append to Splits a newline at or after every ChunkSize
+/// bytes of [Start, End), backed up to the start of its run of newlines,
+/// which is where the Lexer would start a newline token. Only the text near
+/// each one is looked at; whether it really ends a logical line is left to
+/// MergeChunks.
+static void FindSplitPoints(const char *Start, const char *End,
+                            size_t ChunkSize,
+                            std::vector<const char*> &Splits) {
+  const char *Target = Start + ChunkSize;
+  while (Target < End) {
+    const char *NL = charscan::findEndOfLine(Target, End);
+    if (NL == End)
+      break;
+    if (*NL == '\n') {
+      const char *P = NL;
+      while (P > Splits.back() && (P[-1] == '\n' || P[-1] == '\r'))
+        --P;
+      if (P > Splits.back())
+        Splits.push_back(P);
+    }
+    Target = NL + (*NL == '\n' ? ChunkSize : 1);
+  }
+}
+
+namespace {
+/// ChunkResult - The output of lexing one stretch of the buffer.
+struct ChunkResult {
+  /// The tokens, up to but not including the newline token at End.
+  OwningPtr<TokenStream> Tokens;
+  std::vector<Lexer::IndentEvent> Events;
+  /// The offset of the newline token the stretch stopped at, or of its eof.
+  unsigned End;
+  /// Did it reach the end of the buffer?
+  bool AtEOF;
+  /// Did it stop at an error?
+  bool Failed;
+};
+
+struct ParallelLexState {
+  const MemoryBuffer *Buffer;
+  LangFeatures Features;
+  /// Chunk I starts at Splits[I] and stops around Splits[I+1].
+  std::vector<const char*> Splits;
+  ChunkResult *Chunks;
+};
+}
+
+/// LexRange - Lex the buffer of S into R with indentation deferred, starting
+/// at Start, which is either 0 or where a newline token starts. Stop before
+/// the first newline token after Start that starts at or after Stop, or
+/// after the eof token, or at the first error.
+static void LexRange(const ParallelLexState &S, unsigned Start,
+                     unsigned Stop, ChunkResult &R) {
+  const char *BufStart = S.Buffer->getBufferStart();
+  Lexer L(S.Buffer, S.Features);
+  L.setDeferIndentation(true);
+  if (Start)
+    L.resumeAt(BufStart + Start);
+
+  R.Tokens.reset(new TokenStream(S.Buffer));
+  R.AtEOF = R.Failed = false;
+  Token T;
+  while (true) {
+    unsigned NumDiags = L.getDiagnostics().size();
+    if (!L.Lex(T) && TokenStream::hasNewError(L.getDiagnostics(), NumDiags)) {
+      R.Failed = true;
+      R.End = S.Buffer->getBufferSize();
+      break;
+    }
+    unsigned Offset = T.getContent() - BufStart;
+    if (T.getKind() == tok::newline && Offset >= Stop && Offset > Start) {
+      R.End = Offset;
+      break;
+    }
+    R.Tokens->push_back(T);
+    if (T.getKind() == tok::eof) {
+      R.End = Offset;
+      R.AtEOF = true;
+      break;
+    }
+  }
+
+  R.Events = L.getIndentEvents();
+  R.Tokens->getDiagnostics().append(L.getDiagnostics().begin(),
+                                    L.getDiagnostics().end());
+}
+
+/// getStop - Where chunk Idx of S should stop.
+static unsigned getStop(const ParallelLexState &S, unsigned Idx) {
+  if (Idx + 2 == S.Splits.size())
+    return ~0U;
+  return S.Splits[Idx+1] - S.Buffer->getBufferStart();
+}
+
+static void LexChunk(void *Ctx, unsigned Idx) {
+  ParallelLexState &S = *static_cast<ParallelLexState*>(Ctx);
+  LexRange(S, S.Splits[Idx] - S.Buffer->getBufferStart(), getStop(S, Idx),
+           S.Chunks[Idx]);
+}
+
+/// ReplayIndent - Apply line start E to Stack, appending the tokens
+/// Lexer::LexPossibleIndent would produce to Out. Returns false where
+/// Lexer::LexPossibleIndent would report an error.
+static bool ReplayIndent(const Lexer::IndentEvent &E,
+                         std::vector<unsigned> &Stack, TokenStream &Out) {
+  if (E.Width > Stack.back()) {
+    Stack.push_back(E.Width);
+    Out.push_back(tok::indent, E.Start, E.End - E.Start);
+    return true;
+  }
+
+  unsigned Dedents = 0;
+  while (E.Width < Stack.back()) {
+    Stack.pop_back();
+    ++Dedents;
+  }
+  if (E.Width != Stack.back())
+    return false; // Unexpected indent.
+
+  // The first dedent covers the whitespace; the rest are zero-length after
+  // it.
+  if (Dedents)
+    Out.push_back(tok::dedent, E.Start, E.End - E.Start);
+  for (unsigned i = 1; i < Dedents; ++i)
+    Out.push_back(tok::dedent, E.End, 0);
+  return true;
+}
+
+/// MergeChunks - Append the tokens and diagnostics of every chunk to Out,
+/// lexing again where a chunk doesn't pick up where the one before it
+/// stopped. Returns false if the chunks can't reproduce a sequential lex.
+static bool MergeChunks(ParallelLexState &S, TokenStream &Out,
+                        unsigned &NumRelexed) {
+  std::vector<unsigned> Stack(1, 0);
+  const char *BufStart = S.Buffer->getBufferStart();
+  unsigned NumChunks = S.Splits.size() - 1;
+  ChunkResult Relexed;
+
+  // Everything before Resume is in Out. Resume is 0 or the start of a newline
+  // token, where any Lexer that makes that token is in the right state.
+  unsigned Resume = 0;
+  for (unsigned c = 0; c != NumChunks; ++c) {
+    ChunkResult *R = &S.Chunks[c];
+    unsigned First = 0;
+    if (c) {
+      TokenStream &T = *R->Tokens;
+      while (First != T.size() && T.getOffset(First) < Resume)
+        ++First;
+      if (First == T.size() || T.getOffset(First) != Resume ||
+          T.getKind(First) != tok::newline) {
+        LexRange(S, Resume, getStop(S, c), Relexed);
+        R = &Relexed;
+        First = 0;
+        ++NumRelexed;
+      }
+    }
+    if (R->Failed)
+      return false;
+
+    TokenStream &T = *R->Tokens;
+    unsigned E = 0, NumEvents = R->Events.size();
+    while (E != NumEvents && R->Events[E].Start < Resume)
+      ++E;
+
+    for (unsigned i = First, e = T.size(); i != e; ++i) {
+      unsigned Offset = T.getOffset(i);
+      for (; E != NumEvents && R->Events[E].Start <= Offset; ++E)
+        if (!ReplayIndent(R->Events[E], Stack, Out))
+          return false;
+
+      if (T.getKind(i) == tok::eof) {
+        // Only the real eof closes any open blocks.
+        for (unsigned d = 1, de = Stack.size(); d != de; ++d)
+          Out.push_back(tok::dedent, Offset, 0);
+      }
+      Out.push_back(T.getKind(i), Offset, T.getLength(i));
+    }
+    // A line can start with whitespace and a line join, and end up holding
+    // nothing but the newline the next stretch starts with.
+    for (; !R->AtEOF && E != NumEvents && R->Events[E].Start < R->End; ++E)
+      if (!ReplayIndent(R->Events[E], Stack, Out))
+        return false;
+
+    for (unsigned d = 0, de = T.getDiagnostics().size(); d != de; ++d) {
+      Diagnostic &D = T.getDiagnostics()[d];
+      unsigned Offset = D.getLoc().getPointer() - BufStart;
+      if (Offset >= Resume && (Offset < R->End || R->AtEOF))
+        Out.getDiagnostics().push_back(D);
+    }
+
+    if (R->AtEOF)
+      return true;
+    Resume = R->End;
+  }
+  llvm_unreachable("The last chunk stops at eof!");
+}
+
+bool TokenStream::tokenizeParallel(LangFeatures Features, unsigned NumThreads,
+                                   unsigned ChunkSize, ParallelStats *Stats) {
+  assert(empty() && "tokenizeParallel needs an empty stream!");
+  const char *Start = Buffer->getBufferStart();
+  const char *End = Buffer->getBufferEnd();
+
+  ParallelLexState S;
+  S.Buffer = Buffer;
+  S.Features = Features;
+  S.Chunks = 0;
+
+  if (NumThreads > 1 && ChunkSize && (size_t)(End - Start) >= 2 * ChunkSize) {
+    S.Splits.push_back(Start);
+    FindSplitPoints(Start, End, ChunkSize, S.Splits);
+    S.Splits.push_back(End);
+  }
+
+  unsigned NumChunks = S.Splits.size() > 2 ? S.Splits.size() - 1 : 1;
+  unsigned NumRelexed = 0;
+  if (Stats) {
+    Stats->Chunks = NumChunks;
+    Stats->Relexed = 0;
+    Stats->Sequential = false;
+  }
+
+  if (NumChunks > 1) {
+    OwningArrayPtr<ChunkResult> Chunks(new ChunkResult[NumChunks]);
+    S.Chunks = Chunks.get();
+    RunParallel(NumChunks, NumThreads, LexChunk, &S);
+    bool Merged = MergeChunks(S, *this, NumRelexed);
+    if (Stats) {
+      Stats->Relexed = NumRelexed;
+      Stats->Sequential = !Merged;
+    }
+    if (Merged)
+      return true;
+    clear();
+  }
+
+  Lexer L(Buffer, Features);
+  return tokenize(L);
+}
@@ -0,0 +1,115 @@
+//===--- Relex.cpp - Incremental relexing after an edit -------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements Lexer::relex and Lexer::resumeAt.
+//
+//  At a newline token the brace stack is empty and no dedents are pending,
+//  so the whole state of the Lexer is its position and its indent stack.
+//  TokenStream records that stack at checkpoints, which is enough to restart
+//  in front of an edit, and to notice after it that the new lex is in the
+//  same state as the old one was at the same text, so the rest of the old
+//  stream can be reused.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Lex/Lexer.h"
+#include "py/Lex/TokenStream.h"
+#include <algorithm>
+
+using namespace py;
+using namespace llvm;
+
+void Lexer::resumeAt(const char *P, const unsigned *Widths,
+                     unsigned NumWidths) {
+  assert(TokStart == Buffer->getBufferStart() && IndentStackTop == 0 &&
+         "resumeAt needs a fresh Lexer!");
+  assert(P >= Buffer->getBufferStart() && P < Buffer->getBufferEnd() &&
+         (*P == '\n' || *P == '\r') && "Not at a newline!");
+  assert(NumWidths < INDENT_STACK_MAX && "Indent stack too deep!");
+  TokStart = Ptr = P;
+  AtLineStart = false;
+  IndentStackTop = NumWidths;
+  std::copy(Widths, Widths + NumWidths, &IndentStack[1]);
+}
+
+bool Lexer::relex(const TokenStream &Old, const EditRange &Edit,
+                  TokenStream &Result, unsigned *NumLexed) {
+  assert(Result.getBuffer() == Buffer && Result.empty() &&
+         "relex needs an empty stream on this Lexer's buffer!");
+  assert(TokStart == Buffer->getBufferStart() && IndentStackTop == 0 &&
+         "relex needs a fresh Lexer!");
+  assert(Edit.Offset + Edit.OldLength <= Old.getBuffer()->getBufferSize() &&
+         Edit.Offset + Edit.NewLength <= Buffer->getBufferSize() &&
+         "Edit outside the buffers!");
+
+  int Delta = int(Edit.NewLength) - int(Edit.OldLength);
+  unsigned EditEnd = Edit.Offset + Edit.NewLength;
+
+  // Everything up to the last checkpoint before the edit is unchanged. The
+  // newline token at the checkpoint is lexed again, which also means a
+  // token ending right at the edit is lexed again.
+  unsigned RestartOffset = 0;
+  if (const TokenStream::Checkpoint *C =
+        Old.findCheckpointBefore(Edit.Offset)) {
+    RestartOffset = Old.getOffset(C->Token);
+    Result.appendTokens(Old, 0, C->Token, 0);
+    Result.IndentWidths.assign(Old.getCheckpointStack(*C),
+                               Old.getCheckpointStack(*C) + C->StackSize);
+
+    resumeAt(Buffer->getBufferStart() + RestartOffset,
+             Old.getCheckpointStack(*C), C->StackSize);
+  }
+  Result.appendDiagnostics(Old, 0, RestartOffset, 0);
+
+  unsigned FirstDiag = Diagnostics.size();
+  unsigned FirstLexed = Result.size();
+  Token T;
+  while (true) {
+    unsigned NumDiags = Diagnostics.size();
+    if (!Lex(T) && TokenStream::hasNewError(Diagnostics, NumDiags)) {
+      Result.HadErrors = true;
+      Result.push_back(tok::eof, Buffer->getBufferSize(), 0);
+      break;
+    }
+    Result.push_back(T);
+    if (T.getKind() == tok::eof)
+      break;
+
+    // Only a newline at or after the end of the edit, on text that was there
+    // before, can line up with the old stream again.
+    if (T.getKind() != tok::newline)
+      continue;
+    unsigned Offset = T.getContent() - Buffer->getBufferStart();
+    if (Offset < EditEnd)
+      continue;
+    const TokenStream::Checkpoint *C = Old.findCheckpointAt(Offset - Delta);
+    if (!C || C->StackSize != unsigned(IndentStackTop) ||
+        !std::equal(&IndentStack[1], &IndentStack[1] + IndentStackTop,
+                    Old.getCheckpointStack(*C)))
+      continue;
+
+    // Same text, same state: the rest of the old stream is still right.
+    if (NumLexed)
+      *NumLexed = Result.size() - FirstLexed;
+    Result.Diagnostics.append(Diagnostics.begin() + FirstDiag,
+                              Diagnostics.end());
+    Result.appendTokens(Old, C->Token + 1, Old.size(), Delta);
+    Result.appendDiagnostics(Old, Offset - Delta + 1,
+                             Old.getBuffer()->getBufferSize() + 1, Delta);
+    Result.IndentWidths = Old.IndentWidths;
+    Result.HadErrors = Old.HadErrors;
+    return !Result.HadErrors;
+  }
+
+  if (NumLexed)
+    *NumLexed = Result.size() - FirstLexed;
+  Result.Diagnostics.append(Diagnostics.begin() + FirstDiag,
+                            Diagnostics.end());
+  return !Result.HadErrors;
+}
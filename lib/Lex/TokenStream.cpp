@@ -0,0 +1,273 @@
+//===--- TokenStream.cpp - Whole-buffer token storage ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the TokenStream interface.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Lex/TokenStream.h"
+#include "py/Lex/Lexer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace py;
+using namespace llvm;
+
+/// Rough average number of source bytes per token, used to size the arrays
+/// up front.
+#define BYTES_PER_TOKEN_ESTIMATE 4
+
+/// Minimum number of tokens between two checkpoints. Smaller values make
+/// relexing start closer to an edit and resynchronize sooner, at the cost of
+/// memory.
+#define CHECKPOINT_INTERVAL 64
+
+TokenStream::TokenStream(const MemoryBuffer *Buf) :
+  Buffer(Buf), HadErrors(false) {
+  assert(Buf->getBufferSize() <= 0xFFFFFFFFULL &&
+         "Buffer too large for 32-bit token offsets!");
+}
+
+void TokenStream::push_back(tok::TokenKind Kind, unsigned Offset,
+                            unsigned Length) {
+  assert(Kind < 256 && "Token kind does not fit in a byte!");
+  assert(Offset <= Buffer->getBufferSize() && "Token outside the buffer!");
+  Kinds.push_back(Kind);
+  Offsets.push_back(Offset);
+  if (Length >= LongLength) {
+    LongLengths.push_back(std::make_pair(size() - 1, Length));
+    Lengths.push_back(LongLength);
+  } else {
+    Lengths.push_back(Length);
+  }
+
+  // Track the indent stack so that checkpoints can record it.
+  switch (Kind) {
+  case tok::indent: {
+    const char *P = Buffer->getBufferStart() + Offset;
+    unsigned Width = 0;
+    for (unsigned i = 0; i != Length; ++i)
+      Width += P[i] == '\t' ? TAB_WIDTH : 1;
+    IndentWidths.push_back(Width);
+    break;
+  }
+  case tok::dedent:
+    if (!IndentWidths.empty())
+      IndentWidths.pop_back();
+    break;
+  case tok::newline:
+    if (Checkpoints.empty() ||
+        size() - Checkpoints.back().Token > CHECKPOINT_INTERVAL)
+      addCheckpoint(size() - 1, IndentWidths.begin(), IndentWidths.size());
+    break;
+  default:
+    break;
+  }
+}
+
+void TokenStream::addCheckpoint(unsigned Token, const unsigned *Stack,
+                                unsigned Size) {
+  Checkpoint C = { Token, unsigned(CheckpointStacks.size()), Size };
+  // Indentation changes rarely compared to the checkpoint interval, so most
+  // checkpoints can share the previous one's stack.
+  if (!Checkpoints.empty()) {
+    const Checkpoint &Prev = Checkpoints.back();
+    if (Prev.StackSize == Size &&
+        std::equal(Stack, Stack + Size, getCheckpointStack(Prev)))
+      C.StackBegin = Prev.StackBegin;
+  }
+  if (C.StackBegin == CheckpointStacks.size())
+    CheckpointStacks.insert(CheckpointStacks.end(), Stack, Stack + Size);
+  Checkpoints.push_back(C);
+}
+
+const TokenStream::Checkpoint *
+TokenStream::findCheckpointBefore(unsigned Offset) const {
+  // Binary search for the first checkpoint at or after Offset.
+  unsigned Lo = 0, Hi = Checkpoints.size();
+  while (Lo != Hi) {
+    unsigned Mid = Lo + (Hi - Lo) / 2;
+    if (Offsets[Checkpoints[Mid].Token] < Offset)
+      Lo = Mid + 1;
+    else
+      Hi = Mid;
+  }
+  return Lo ? &Checkpoints[Lo - 1] : 0;
+}
+
+const TokenStream::Checkpoint *
+TokenStream::findCheckpointAt(unsigned Offset) const {
+  const Checkpoint *C = findCheckpointBefore(Offset + 1);
+  if (C && Offsets[C->Token] == Offset)
+    return C;
+  return 0;
+}
+
+void TokenStream::appendTokens(const TokenStream &Src, unsigned Begin,
+                               unsigned End, int Delta) {
+  assert(Begin <= End && End <= Src.size() && "Bad token range!");
+  unsigned Shift = size() - Begin;
+
+  Kinds.insert(Kinds.end(), Src.Kinds.begin() + Begin,
+               Src.Kinds.begin() + End);
+  Lengths.insert(Lengths.end(), Src.Lengths.begin() + Begin,
+                 Src.Lengths.begin() + End);
+  Offsets.reserve(Offsets.size() + (End - Begin));
+  for (unsigned i = Begin; i != End; ++i)
+    Offsets.push_back(Src.Offsets[i] + Delta);
+
+  for (unsigned i = 0, e = Src.LongLengths.size(); i != e; ++i) {
+    unsigned I = Src.LongLengths[i].first;
+    if (I >= Begin && I < End)
+      LongLengths.push_back(std::make_pair(I + Shift,
+                                           Src.LongLengths[i].second));
+  }
+
+  for (unsigned i = 0, e = Src.Checkpoints.size(); i != e; ++i) {
+    const Checkpoint &C = Src.Checkpoints[i];
+    if (C.Token < Begin || C.Token >= End)
+      continue;
+    if (!Checkpoints.empty() && Checkpoints.back().Token >= C.Token + Shift)
+      continue;
+    addCheckpoint(C.Token + Shift, Src.getCheckpointStack(C), C.StackSize);
+  }
+}
+
+void TokenStream::appendDiagnostics(const TokenStream &Src, unsigned Begin,
+                                    unsigned End, int Delta) {
+  const char *SrcStart = Src.Buffer->getBufferStart();
+  for (unsigned i = 0, e = Src.Diagnostics.size(); i != e; ++i) {
+    Diagnostic D = Src.Diagnostics[i];
+    unsigned Offset = D.getLoc().getPointer() - SrcStart;
+    if (Offset < Begin || Offset >= End)
+      continue;
+    const char *Loc = Buffer->getBufferStart() + Offset + Delta;
+    Diagnostics.push_back(Diagnostic(SMLoc::getFromPointer(Loc),
+                                     D.getSeverity(), D.getMessage()));
+  }
+}
+
+unsigned TokenStream::getLongLength(unsigned I) const {
+  std::vector<std::pair<unsigned, unsigned> >::const_iterator It =
+    std::lower_bound(LongLengths.begin(), LongLengths.end(),
+                     std::make_pair(I, 0U));
+  assert(It != LongLengths.end() && It->first == I &&
+         "Long token length missing!");
+  return It->second;
+}
+
+void TokenStream::getToken(unsigned I, Token &T) const {
+  T.setKind(getKind(I));
+  T.setContent(getContent(I));
+  T.setLength(getLength(I));
+  T.setIdentifier(getIdentifier(I));
+}
+
+bool TokenStream::hasNewError(SmallVectorImpl<Diagnostic> &Diags,
+                              unsigned N) {
+  for (unsigned i = N, e = Diags.size(); i != e; ++i)
+    if (Diags[i].getSeverity() == Diagnostic::Error)
+      return true;
+  return false;
+}
+
+bool TokenStream::tokenize(Lexer &L) {
+  size_t Estimate = Buffer->getBufferSize() / BYTES_PER_TOKEN_ESTIMATE + 1;
+  Kinds.reserve(size() + Estimate);
+  Offsets.reserve(size() + Estimate);
+  Lengths.reserve(size() + Estimate);
+  // Keep the Lexer's Identifiers, unless earlier tokens came without them.
+  bool Interned = L.getIdentifierTable() && Identifiers.size() == size();
+  if (Interned)
+    Identifiers.reserve(size() + Estimate);
+
+  Token T;
+  while (true) {
+    unsigned NumDiags = L.getDiagnostics().size();
+    if (!L.Lex(T) && hasNewError(L.getDiagnostics(), NumDiags)) {
+      HadErrors = true;
+      push_back(tok::eof, Buffer->getBufferSize(), 0);
+      if (Interned)
+        Identifiers.push_back(Identifier());
+      break;
+    }
+    push_back(T);
+    if (Interned)
+      Identifiers.push_back(T.getIdentifier());
+    if (T.getKind() == tok::eof)
+      break;
+  }
+
+  Diagnostics.append(L.getDiagnostics().begin(), L.getDiagnostics().end());
+  return !HadErrors;
+}
+
+void TokenStream::clear() {
+  Kinds.clear();
+  Offsets.clear();
+  Lengths.clear();
+  LongLengths.clear();
+  Identifiers.clear();
+  Checkpoints.clear();
+  CheckpointStacks.clear();
+  IndentWidths.clear();
+  Diagnostics.clear();
+  HadErrors = false;
+}
+
+bool TokenStream::isEquivalentTo(TokenStream &Other, raw_ostream *Why) {
+  unsigned N = std::min(size(), Other.size());
+  for (unsigned i = 0; i != N; ++i) {
+    if (getKind(i) == Other.getKind(i) &&
+        getOffset(i) == Other.getOffset(i) &&
+        getLength(i) == Other.getLength(i))
+      continue;
+    if (Why)
+      *Why << "token " << i << " differs: kind " << getKind(i) << " vs "
+           << Other.getKind(i) << ", offset " << getOffset(i) << " vs "
+           << Other.getOffset(i) << ", length " << getLength(i) << " vs "
+           << Other.getLength(i) << "\n";
+    return false;
+  }
+  if (size() != Other.size()) {
+    if (Why)
+      *Why << "token counts differ: " << size() << " vs " << Other.size()
+           << "\n";
+    return false;
+  }
+  if (hasErrors() != Other.hasErrors()) {
+    if (Why)
+      *Why << "only one stream stopped on an error\n";
+    return false;
+  }
+
+  SmallVectorImpl<Diagnostic> &D1 = getDiagnostics();
+  SmallVectorImpl<Diagnostic> &D2 = Other.getDiagnostics();
+  if (D1.size() != D2.size()) {
+    if (Why)
+      *Why << "diagnostic counts differ: " << D1.size() << " vs "
+           << D2.size() << "\n";
+    return false;
+  }
+  const char *Start1 = getBuffer()->getBufferStart();
+  const char *Start2 = Other.getBuffer()->getBufferStart();
+  for (unsigned i = 0, e = D1.size(); i != e; ++i) {
+    if (D1[i].getSeverity() == D2[i].getSeverity() &&
+        !strcmp(D1[i].getMessage(), D2[i].getMessage()) &&
+        D1[i].getLoc().getPointer() - Start1 ==
+          D2[i].getLoc().getPointer() - Start2)
+      continue;
+    if (Why)
+      *Why << "diagnostic " << i << " differs: '" << D1[i].getMessage()
+           << "' vs '" << D2[i].getMessage() << "'\n";
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,423 @@
+//===--- AST.cpp - Abstract Syntax Tree -----------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the out of line parts of the AST, chiefly printing
+//  it as S-expressions in the form the parser tests check for.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Parse/AST.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace py;
+using namespace py::ast;
+using namespace llvm;
+
+/// CopyArguments - Copy the arrays of A into C.
+static Arguments CopyArguments(ASTContext &C, const Arguments &A) {
+  Arguments Copy = A;
+  Copy.Params = C.CopyArray(A.Params);
+  Copy.Defaults = C.CopyArray(A.Defaults);
+  return Copy;
+}
+
+Lambda *Lambda::Get(ASTContext &C, SMLoc Loc, const Arguments &Args,
+                    Test *Body) {
+  return new (C) Lambda(Loc, CopyArguments(C, Args), Body);
+}
+
+FunctionDef *FunctionDef::Get(ASTContext &C, SMLoc Loc, StringRef Name,
+                              const Arguments &Args, ArrayRef<Stmt*> Body,
+                              ArrayRef<Test*> Decorators) {
+  return new (C) FunctionDef(Loc, Name, CopyArguments(C, Args),
+                             C.CopyArray(Body), C.CopyArray(Decorators));
+}
+
+const char *Compare::GetOpSpelling(CmpOp Op) {
+  switch (Op) {
+  case Lt:    return "<";
+  case Gt:    return ">";
+  case Eq:    return "==";
+  case GtE:   return ">=";
+  case LtE:   return "<=";
+  case NotEq: return "!=";
+  case In:    return "in";
+  case NotIn: return "not in";
+  case Is:    return "is";
+  case IsNot: return "is not";
+  }
+  return "?";
+}
+
+const char *Node::GetKindName() const {
+  switch (GetKind()) {
+  case NameKind:          return "name";
+  case NumberKind:        return "number";
+  case StrKind:           return "string";
+  case TestListKind:      return "testlist";
+  case ListKind:          return "list";
+  case SetKind:           return "set";
+  case DictKind:          return "dict";
+  case YieldKind:         return "yield";
+  case ComprehensionKind: return "comprehension";
+  case UnaryOpKind:       return "unary";
+  case BinaryOpKind:      return "binary";
+  case BoolOpKind:        return "bool";
+  case CompareKind:       return "compare";
+  case IfExpKind:         return "ifexp";
+  case LambdaKind:        return "lambda";
+  case CallKind:          return "call";
+  case AttributeKind:     return "attribute";
+  case SubscriptKind:     return "subscript";
+  case SliceKind:         return "slice";
+  case EllipsisKind:      return "ellipsis";
+  case ReprKind:          return "repr";
+  case ExprStmtKind:      return "expr";
+  case AssignKind:        return "assign";
+  case AugAssignKind:     return "augassign";
+  case PrintKind:         return "print";
+  case DelKind:           return "del";
+  case PassKind:          return "pass";
+  case BreakKind:         return "break";
+  case ContinueKind:      return "continue";
+  case ReturnKind:        return "return";
+  case RaiseKind:         return "raise";
+  case GlobalKind:        return "global";
+  case ExecKind:          return "exec";
+  case AssertKind:        return "assert";
+  case ImportKind:        return "import";
+  case ImportFromKind:    return "import-from";
+  case IfKind:            return "if";
+  case WhileKind:         return "while";
+  case ForKind:           return "for";
+  case TryExceptKind:     return "try-except";
+  case TryFinallyKind:    return "try-finally";
+  case WithKind:          return "with";
+  case FunctionDefKind:   return "def";
+  case ClassDefKind:      return "class";
+  case ModuleKind:        return "module";
+  }
+  return "unknown";
+}
+
+static const char *GetTokenSpelling(tok::TokenKind K) {
+  switch (K) {
+#define PUNCTUATOR(X,Y) case tok::X: return Y;
+#define KEYWORD(X,Y) case tok::kw_##X: return #X;
+#include "py/Lex/TokenKinds.def"
+  default:
+    return "?";
+  }
+}
+
+/// PrintChild - Print N after a space, or "()" if it is absent.
+static void PrintChild(raw_ostream &OS, const Node *N) {
+  OS << ' ';
+  if (N)
+    N->print(OS);
+  else
+    OS << "()";
+}
+
+template <typename T>
+static void PrintChildren(raw_ostream &OS, ArrayRef<T*> Children) {
+  OS << " (";
+  for (unsigned i = 0, e = Children.size(); i != e; ++i) {
+    if (i)
+      OS << ' ';
+    Children[i]->print(OS);
+  }
+  OS << ')';
+}
+
+static void PrintString(raw_ostream &OS, StringRef S) {
+  OS << '"';
+  OS.write_escaped(S);
+  OS << '"';
+}
+
+static void PrintArguments(raw_ostream &OS, const Arguments &A) {
+  PrintChildren(OS, A.Params);
+  PrintChildren(OS, A.Defaults);
+  OS << ' ';
+  PrintString(OS, A.VarArg);
+  OS << ' ';
+  PrintString(OS, A.KwArg);
+}
+
+void Node::print(raw_ostream &OS) const {
+  OS << '(' << GetKindName();
+
+  switch (GetKind()) {
+  case NameKind:
+    OS << ' ';
+    PrintString(OS, cast<Name>(this)->GetId().str());
+    break;
+  case NumberKind: {
+    const Number *N = cast<Number>(this);
+    if (N->IsFloatingPoint())
+      OS << ' ' << N->GetFloatValue();
+    else
+      OS << ' ' << N->GetIntValue();
+    break;
+  }
+  case StrKind:
+    OS << ' ';
+    PrintString(OS, cast<Str>(this)->GetValue());
+    break;
+  case TestListKind:
+    PrintChildren(OS, cast<TestList>(this)->GetElements());
+    break;
+  case ListKind:
+    PrintChildren(OS, cast<List>(this)->GetElements());
+    break;
+  case SetKind:
+    PrintChildren(OS, cast<Set>(this)->GetElements());
+    break;
+  case DictKind:
+    PrintChildren(OS, cast<Dict>(this)->GetKeys());
+    PrintChildren(OS, cast<Dict>(this)->GetValues());
+    break;
+  case YieldKind:
+    PrintChild(OS, cast<Yield>(this)->GetValue());
+    break;
+  case ComprehensionKind: {
+    const Comprehension *C = cast<Comprehension>(this);
+    PrintChild(OS, C->GetElement());
+    PrintChild(OS, C->GetTarget());
+    PrintChild(OS, C->GetIter());
+    PrintChild(OS, C->GetPredicate());
+    break;
+  }
+  case UnaryOpKind:
+    OS << ' ' << GetTokenSpelling(cast<UnaryOp>(this)->GetOp());
+    PrintChild(OS, cast<UnaryOp>(this)->GetOperand());
+    break;
+  case BinaryOpKind: {
+    const BinaryOp *B = cast<BinaryOp>(this);
+    OS << ' ' << GetTokenSpelling(B->GetOp());
+    PrintChild(OS, B->GetLHS());
+    PrintChild(OS, B->GetRHS());
+    break;
+  }
+  case BoolOpKind:
+    OS << ' ' << GetTokenSpelling(cast<BoolOp>(this)->GetOp());
+    PrintChildren(OS, cast<BoolOp>(this)->GetOperands());
+    break;
+  case CompareKind: {
+    const Compare *C = cast<Compare>(this);
+    OS << " (";
+    for (unsigned i = 0, e = C->GetOps().size(); i != e; ++i)
+      OS << (i ? " \"" : "\"") << Compare::GetOpSpelling(C->GetOps()[i])
+         << '"';
+    OS << ')';
+    PrintChildren(OS, C->GetOperands());
+    break;
+  }
+  case IfExpKind: {
+    const IfExp *I = cast<IfExp>(this);
+    PrintChild(OS, I->GetCond());
+    PrintChild(OS, I->GetThen());
+    PrintChild(OS, I->GetElse());
+    break;
+  }
+  case LambdaKind:
+    PrintArguments(OS, cast<Lambda>(this)->GetArgs());
+    PrintChild(OS, cast<Lambda>(this)->GetBody());
+    break;
+  case CallKind: {
+    const Call *C = cast<Call>(this);
+    PrintChild(OS, C->GetFunc());
+    PrintChildren(OS, C->GetArgs());
+    OS << " (";
+    for (unsigned i = 0, e = C->GetKeywords().size(); i != e; ++i) {
+      OS << (i ? " (" : "(");
+      PrintString(OS, C->GetKeywords()[i].Name);
+      PrintChild(OS, C->GetKeywords()[i].Value);
+      OS << ')';
+    }
+    OS << ')';
+    PrintChild(OS, C->GetStarArgs());
+    PrintChild(OS, C->GetKwArgs());
+    break;
+  }
+  case AttributeKind:
+    PrintChild(OS, cast<Attribute>(this)->GetValue());
+    OS << ' ';
+    PrintString(OS, cast<Attribute>(this)->GetAttr().str());
+    break;
+  case SubscriptKind:
+    PrintChild(OS, cast<Subscript>(this)->GetValue());
+    PrintChild(OS, cast<Subscript>(this)->GetIndex());
+    break;
+  case SliceKind: {
+    const Slice *S = cast<Slice>(this);
+    PrintChild(OS, S->GetLower());
+    PrintChild(OS, S->GetUpper());
+    PrintChild(OS, S->GetStep());
+    break;
+  }
+  case EllipsisKind:
+    break;
+  case ReprKind:
+    PrintChild(OS, cast<Repr>(this)->GetValue());
+    break;
+
+  case ExprStmtKind:
+    PrintChild(OS, cast<ExprStmt>(this)->GetValue());
+    break;
+  case AssignKind:
+    PrintChildren(OS, cast<Assign>(this)->GetTargets());
+    PrintChild(OS, cast<Assign>(this)->GetValue());
+    break;
+  case AugAssignKind: {
+    const AugAssign *A = cast<AugAssign>(this);
+    OS << ' ' << GetTokenSpelling(A->GetOp());
+    PrintChild(OS, A->GetTarget());
+    PrintChild(OS, A->GetValue());
+    break;
+  }
+  case PrintKind: {
+    const Print *P = cast<Print>(this);
+    PrintChild(OS, P->GetDest());
+    PrintChildren(OS, P->GetValues());
+    if (!P->HasNewLine())
+      OS << " nonl";
+    break;
+  }
+  case DelKind:
+    PrintChildren(OS, cast<Del>(this)->GetTargets());
+    break;
+  case PassKind:
+  case BreakKind:
+  case ContinueKind:
+    break;
+  case ReturnKind:
+    PrintChild(OS, cast<Return>(this)->GetValue());
+    break;
+  case RaiseKind: {
+    const Raise *R = cast<Raise>(this);
+    PrintChild(OS, R->GetType());
+    PrintChild(OS, R->GetInst());
+    PrintChild(OS, R->GetTBack());
+    break;
+  }
+  case GlobalKind: {
+    ArrayRef<Identifier> Names = cast<Global>(this)->GetNames();
+    for (unsigned i = 0, e = Names.size(); i != e; ++i) {
+      OS << ' ';
+      PrintString(OS, Names[i].str());
+    }
+    break;
+  }
+  case ExecKind: {
+    const Exec *E = cast<Exec>(this);
+    PrintChild(OS, E->GetBody());
+    PrintChild(OS, E->GetGlobals());
+    PrintChild(OS, E->GetLocals());
+    break;
+  }
+  case AssertKind:
+    PrintChild(OS, cast<Assert>(this)->GetCond());
+    PrintChild(OS, cast<Assert>(this)->GetMsg());
+    break;
+  case ImportKind:
+  case ImportFromKind: {
+    ArrayRef<Alias> Names;
+    if (const ImportFrom *I = dyn_cast<ImportFrom>(this)) {
+      OS << ' ' << I->GetLevel() << ' ';
+      PrintString(OS, I->GetModule());
+      Names = I->GetNames();
+    } else {
+      Names = cast<Import>(this)->GetNames();
+    }
+    for (unsigned i = 0, e = Names.size(); i != e; ++i) {
+      OS << " (";
+      PrintString(OS, Names[i].Name);
+      if (!Names[i].AsName.empty()) {
+        OS << ' ';
+        PrintString(OS, Names[i].AsName);
+      }
+      OS << ')';
+    }
+    break;
+  }
+  case IfKind:
+    PrintChild(OS, cast<If>(this)->GetCond());
+    PrintChildren(OS, cast<If>(this)->GetBody());
+    PrintChildren(OS, cast<If>(this)->GetOrElse());
+    break;
+  case WhileKind:
+    PrintChild(OS, cast<While>(this)->GetCond());
+    PrintChildren(OS, cast<While>(this)->GetBody());
+    PrintChildren(OS, cast<While>(this)->GetOrElse());
+    break;
+  case ForKind: {
+    const For *F = cast<For>(this);
+    PrintChild(OS, F->GetTarget());
+    PrintChild(OS, F->GetIter());
+    PrintChildren(OS, F->GetBody());
+    PrintChildren(OS, F->GetOrElse());
+    break;
+  }
+  case TryExceptKind: {
+    const TryExcept *T = cast<TryExcept>(this);
+    PrintChildren(OS, T->GetBody());
+    for (unsigned i = 0, e = T->GetHandlers().size(); i != e; ++i) {
+      const ExceptHandler &H = T->GetHandlers()[i];
+      OS << " (except";
+      PrintChild(OS, H.Type);
+      PrintChild(OS, H.Target);
+      PrintChildren(OS, H.Body);
+      OS << ')';
+    }
+    PrintChildren(OS, T->GetOrElse());
+    break;
+  }
+  case TryFinallyKind:
+    PrintChildren(OS, cast<TryFinally>(this)->GetBody());
+    PrintChildren(OS, cast<TryFinally>(this)->GetFinalBody());
+    break;
+  case WithKind: {
+    const With *W = cast<With>(this);
+    PrintChild(OS, W->GetContextExpr());
+    PrintChild(OS, W->GetVars());
+    PrintChildren(OS, W->GetBody());
+    break;
+  }
+  case FunctionDefKind: {
+    const FunctionDef *F = cast<FunctionDef>(this);
+    OS << ' ';
+    PrintString(OS, F->GetName());
+    PrintArguments(OS, F->GetArgs());
+    PrintChildren(OS, F->GetBody());
+    PrintChildren(OS, F->GetDecorators());
+    break;
+  }
+  case ClassDefKind: {
+    const ClassDef *C = cast<ClassDef>(this);
+    OS << ' ';
+    PrintString(OS, C->GetName());
+    PrintChildren(OS, C->GetBases());
+    PrintChildren(OS, C->GetBody());
+    PrintChildren(OS, C->GetDecorators());
+    break;
+  }
+  case ModuleKind:
+    PrintChildren(OS, cast<Module>(this)->GetBody());
+    break;
+  }
+
+  OS << ')';
+}
+
+void Node::dump() const {
+  print(errs());
+  errs() << '\n';
+}
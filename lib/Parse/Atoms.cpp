@@ -29,13 +29,14 @@ ast::Node *Parser::ParseAtom() {
 // .. testlist_comp: test ( comp_for | (',' test)* [','] )
 ast::Node *Parser::ParseYieldExprOrTestlistComp() {
   assert(T == tok::l_paren);
-  L.Lex(T);
+  Lex(T);
 
   if (T == tok::kw_yield) {
-    L.Lex(T);
+    SMLoc Loc = T.getLocation();
+    Lex(T);
     ast::TestList *TestList = ParseTestList();
     if (!TestList) return NULL;
-    return ast::Yield::Get(TestList);
+    return ast::Yield::Get(ASTCtx, Loc, TestList);
   }
 
   ast::Test *Test = ParseTest();
@@ -53,7 +54,8 @@ ast::Node *Parser::ParseYieldExprOrTestlistComp() {
 // .. comp_for: 'for' exprlist 'in' or_test [comp_iter]
 ast::Node *Parser::ParseCompFor(ast::Node *Test) {
   assert(T == tok::kw_for);
-  L.Lex(T);
+  SMLoc Loc = T.getLocation();
+  Lex(T);
 
   ast::Node *IndVar = ParseExprList();
   if (!IndVar) return NULL;
@@ -66,7 +68,8 @@ ast::Node *Parser::ParseCompFor(ast::Node *Test) {
   ast::Node *Container = ParseOrTest();
   if (!Container) return NULL;
 
-  ast::Node *N = ast::Comprehension::Get(Test, IndVar, Container);
+  ast::Node *N = ast::Comprehension::Get(ASTCtx, Loc, Test, IndVar,
+                                         Container);
   return ParseCompIter(N);
 }
 
@@ -75,7 +78,7 @@ ast::Node *Parser::ParseCompIf(ast::Node *N) {
   ast::Comprehension *C = llvm::cast<ast::Comprehension>(N);
 
   assert(T == tok::kw_if);
-  L.Lex(T);
+  Lex(T);
 
   ast::Test *T = ParseOldTest();
   if (!T) return NULL;
@@ -0,0 +1,272 @@
+//===--- ConstantFolder.cpp - Fold constant expressions -------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the ConstantFolder. Arithmetic follows Python 2:
+//  int / int floors, and // and % round towards negative infinity. Ints are
+//  64 bits here, so anything that would become a long is left alone.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Parse/ConstantFolder.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+
+using namespace py;
+using namespace py::ast;
+using namespace llvm;
+
+static const int64_t MaxInt = INT64_MAX, MinInt = INT64_MIN;
+
+/// FoldInt - Compute X Op Y into R. Returns false if the result isn't an
+/// int, or evaluating it would raise.
+static bool FoldInt(tok::TokenKind Op, int64_t X, int64_t Y, int64_t &R) {
+  switch (Op) {
+  case tok::plus:
+    if (Y > 0 ? X > MaxInt - Y : X < MinInt - Y)
+      return false;
+    R = X + Y;
+    return true;
+  case tok::minus:
+    if (Y > 0 ? X < MinInt + Y : X > MaxInt + Y)
+      return false;
+    R = X - Y;
+    return true;
+  case tok::star:
+    if (X > 0 ? (Y > 0 ? X > MaxInt / Y : Y < MinInt / X)
+              : X < 0 && (Y > 0 ? X < MinInt / Y : Y != 0 && X < MaxInt / Y))
+      return false;
+    R = X * Y;
+    return true;
+  case tok::slash:
+  case tok::slashslash:
+  case tok::percent: {
+    if (Y == 0 || (X == MinInt && Y == -1))
+      return false;
+    int64_t Q = X / Y, M = X % Y;
+    // C++ truncates; Python floors, and the remainder takes the sign of
+    // the divisor.
+    if (M != 0 && ((M < 0) != (Y < 0))) {
+      --Q;
+      M += Y;
+    }
+    R = Op == tok::percent ? M : Q;
+    return true;
+  }
+  case tok::lessless:
+    if (Y < 0 || Y >= 63 || X > (MaxInt >> Y) || X < (MinInt >> Y))
+      return false;
+    R = X * (int64_t(1) << Y);
+    return true;
+  case tok::greatergreater:
+    if (Y < 0)
+      return false;
+    R = X >> (Y >= 63 ? 63 : Y);
+    return true;
+  case tok::amp:   R = X & Y; return true;
+  case tok::pipe:  R = X | Y; return true;
+  case tok::caret: R = X ^ Y; return true;
+  case tok::starstar:
+    // A negative power is a float.
+    if (Y < 0)
+      return false;
+    if (X == 0 || X == 1 || (X == -1 && Y % 2 == 0)) {
+      R = Y == 0 ? 1 : X * X;
+      return true;
+    }
+    if (X == -1) {
+      R = -1;
+      return true;
+    }
+    // Any other base overflows long before this.
+    if (Y >= 64)
+      return false;
+    R = 1;
+    for (; Y != 0; --Y)
+      if (!FoldInt(tok::star, R, X, R))
+        return false;
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// FoldFloat - Compute X Op Y into R, as FoldInt.
+static bool FoldFloat(tok::TokenKind Op, double X, double Y, double &R) {
+  switch (Op) {
+  case tok::plus:  R = X + Y; return true;
+  case tok::minus: R = X - Y; return true;
+  case tok::star:  R = X * Y; return true;
+  case tok::slash:
+    if (Y == 0)
+      return false;
+    R = X / Y;
+    return true;
+  default:
+    // The rest either don't apply to floats or have corner cases (the
+    // sign of a zero remainder, say) not worth getting wrong here.
+    return false;
+  }
+}
+
+static double GetFloat(const Number *N) {
+  return N->IsFloatingPoint() ? N->GetFloatValue()
+                              : static_cast<double>(N->GetIntValue());
+}
+
+bool ConstantFolder::IsConstant(const Test *T) {
+  if (isa<Number>(T) || isa<Str>(T))
+    return true;
+  const TestList *L = dyn_cast<TestList>(T);
+  if (!L)
+    return false;
+  ArrayRef<Test*> Elts = L->GetElements();
+  for (unsigned i = 0, e = Elts.size(); i != e; ++i)
+    if (!IsConstant(Elts[i]))
+      return false;
+  return true;
+}
+
+Test *ConstantFolder::Fold(Test *T) {
+  switch (T->GetKind()) {
+  case Node::UnaryOpKind:  return FoldUnaryOp(cast<UnaryOp>(T));
+  case Node::BinaryOpKind: return FoldBinaryOp(cast<BinaryOp>(T));
+  case Node::TestListKind: return FoldTestList(cast<TestList>(T));
+  default:                 return T;
+  }
+}
+
+Test *ConstantFolder::FoldUnaryOp(UnaryOp *U) {
+  Number *N = dyn_cast<Number>(Fold(U->GetOperand()));
+  if (!N)
+    return U;
+
+  if (N->IsFloatingPoint()) {
+    double V = N->GetFloatValue();
+    switch (U->GetOp()) {
+    case tok::plus:  break;
+    case tok::minus: V = -V; break;
+    default:         return U;
+    }
+    ++NumFolded;
+    return Number::GetFloat(C, U->GetLoc(), V);
+  }
+
+  int64_t V = N->GetIntValue();
+  switch (U->GetOp()) {
+  case tok::plus:
+    break;
+  case tok::minus:
+    if (V == MinInt)
+      return U;
+    V = -V;
+    break;
+  case tok::tilde:
+    V = ~V;
+    break;
+  default:
+    return U;
+  }
+  ++NumFolded;
+  return Number::GetInt(C, U->GetLoc(), V);
+}
+
+Test *ConstantFolder::FoldBinaryOp(BinaryOp *B) {
+  Test *X = Fold(B->GetLHS()), *Y = Fold(B->GetRHS());
+  Number *NX = dyn_cast<Number>(X), *NY = dyn_cast<Number>(Y);
+  Test *Folded = NX && NY ? FoldNumbers(B, NX, NY) : FoldStrings(B, X, Y);
+  if (Folded) {
+    ++NumFolded;
+    return Folded;
+  }
+  if (X == B->GetLHS() && Y == B->GetRHS())
+    return B;
+  return BinaryOp::Get(C, B->GetLoc(), B->GetOp(), X, Y);
+}
+
+Test *ConstantFolder::FoldNumbers(BinaryOp *B, Number *X, Number *Y) {
+  if (!X->IsFloatingPoint() && !Y->IsFloatingPoint()) {
+    int64_t R;
+    if (!FoldInt(B->GetOp(), X->GetIntValue(), Y->GetIntValue(), R))
+      return 0;
+    return Number::GetInt(C, B->GetLoc(), R);
+  }
+  double R;
+  if (!FoldFloat(B->GetOp(), GetFloat(X), GetFloat(Y), R))
+    return 0;
+  return Number::GetFloat(C, B->GetLoc(), R);
+}
+
+Test *ConstantFolder::FoldStrings(BinaryOp *B, Test *X, Test *Y) {
+  if (B->GetOp() == tok::plus) {
+    Str *SX = dyn_cast<Str>(X), *SY = dyn_cast<Str>(Y);
+    if (!SX || !SY)
+      return 0;
+    Str *Strs[] = { SX, SY };
+    return Join(Strs);
+  }
+
+  if (B->GetOp() != tok::star)
+    return 0;
+  // Either operand may be the count.
+  Str *S = dyn_cast<Str>(X);
+  Number *N = dyn_cast<Number>(Y);
+  if (!S) {
+    S = dyn_cast<Str>(Y);
+    N = dyn_cast<Number>(X);
+  }
+  if (!S || !N || N->IsFloatingPoint())
+    return 0;
+  // Repeating nothing, or repeating anything no times or fewer, is empty
+  // however big the count; only then is the size bounded.
+  int64_t Count = N->GetIntValue();
+  StringRef V = S->GetValue();
+  if (V.empty() || Count <= 0)
+    return Str::Get(C, B->GetLoc(), StringRef(), S->IsUnicodeString());
+  if (uint64_t(Count) > MaxStringSize / V.size())
+    return 0;
+
+  SmallString<256> Buf;
+  for (int64_t i = 0; i != Count; ++i)
+    Buf.append(V.begin(), V.end());
+  return Str::Get(C, B->GetLoc(), C.CopyString(Buf.str()),
+                  S->IsUnicodeString());
+}
+
+Test *ConstantFolder::FoldTestList(TestList *L) {
+  ArrayRef<Test*> Elts = L->GetElements();
+  SmallVector<Test*, 8> Folded;
+  bool Changed = false;
+  for (unsigned i = 0, e = Elts.size(); i != e; ++i) {
+    Folded.push_back(Fold(Elts[i]));
+    Changed |= Folded.back() != Elts[i];
+  }
+  if (!Changed)
+    return L;
+  return TestList::Get(C, L->GetLoc(), Folded);
+}
+
+Str *ConstantFolder::Concat(ArrayRef<Str*> Strs) {
+  assert(!Strs.empty() && "No strings to join!");
+  if (Strs.size() == 1)
+    return Strs[0];
+  ++NumFolded;
+  return Join(Strs);
+}
+
+Str *ConstantFolder::Join(ArrayRef<Str*> Strs) {
+  // 'a' u'b' is a unicode string.
+  SmallString<256> Buf;
+  bool IsUnicode = false;
+  for (unsigned i = 0, e = Strs.size(); i != e; ++i) {
+    StringRef V = Strs[i]->GetValue();
+    Buf.append(V.begin(), V.end());
+    IsUnicode |= Strs[i]->IsUnicodeString();
+  }
+  return Str::Get(C, Strs[0]->GetLoc(), C.CopyString(Buf.str()), IsUnicode);
+}
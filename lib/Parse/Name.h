@@ -17,6 +17,7 @@
 
 #include "llvm/Value.h"
 #include "llvm/DerivedTypes.h"
+#include "py/Lex/IdentifierTable.h"
 
 using namespace llvm;
 namespace py {
@@ -40,13 +41,14 @@ const unsigned NameVal = llvm::Value::PseudoSourceValueVal;
 /// or AllocaInst and run replaceAllUsesWith().
 class Name : public Value {
 public:
-  Name(Runtime &R, StringRef N) :
+  Name(Runtime &R, Identifier N) :
     Value(R.GetObjectTyPtr(), NameVal), N(N) {
   }
   virtual ~Name() {
   }
 
-  StringRef GetName() const {return N;}
+  StringRef GetName() const {return N.str();}
+  Identifier GetIdentifier() const {return N;}
 
   static bool classof(const Value *V) {
     return true;
@@ -56,12 +58,12 @@ public:
   }
 
   virtual void printCustom(raw_ostream &OS) const {
-    OS << "$" << N;
+    OS << "$" << N.str();
   }
 
 private:
-  /// Name, as a string.
-  std::string N;
+  /// Name, interned in the Parser's IdentifierTable.
+  Identifier N;
 };
 
 }
@@ -0,0 +1,269 @@
+//===--- NameResolver.cpp - Resolving Names to storage --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements NameResolver. A placeholder is replaced by splitting
+// the block of its user just before the user, and emitting the load at the
+// end of the first half; for a PHI user, the load goes at the end of the
+// incoming block instead.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/IRBuilder.h"
+
+#include "py/Runtime/Runtime.h"
+#include "NameResolver.h"
+#include "Name.h"
+
+#include <utility>
+
+using namespace llvm;
+using namespace py;
+
+NameResolver::NameResolver(Runtime &R, Module &M, Function &F,
+                           const ast::Scope &S, Value *Closure)
+  : R(R), M(M), F(F), S(S), Locals(0) {
+  Names = BasicBlock::Create(M.getContext(), "names", &F,
+                             F.empty() ? 0 : &F.front());
+  IRBuilder<> IRB(Names);
+  Type *ObjectPtrTy = R.GetObjectTyPtr();
+  Globals = IRB.CreateCall(R.GetFunction(M, Runtime::GetGlobals), "globals");
+  if (!S.IsOptimized())
+    Locals = IRB.CreateCall(R.GetFunction(M, Runtime::GetLocals), "locals");
+
+  Constant *CellNew = M.getOrInsertFunction("py_cell_new", ObjectPtrTy, NULL);
+  ArrayRef<StringRef> Bound = S.GetBoundNames();
+  for (unsigned i = 0, e = Bound.size(); i != e; ++i) {
+    switch (S.Lookup(Bound[i])) {
+    case ast::Scope::Local:
+      // Left to the namespace dict, unless the scope is optimized.
+      if (S.IsOptimized()) {
+        AllocaInst *A = IRB.CreateAlloca(ObjectPtrTy, 0, Bound[i]);
+        IRB.CreateStore(Constant::getNullValue(ObjectPtrTy), A);
+        Storage[Bound[i]] = A;
+      }
+      break;
+    case ast::Scope::Cell:
+      Storage[Bound[i]] = IRB.CreateCall(CellNew, Bound[i]);
+      break;
+    case ast::Scope::Global:
+    case ast::Scope::Free:
+      break;
+    }
+  }
+
+  ArrayRef<StringRef> Free = S.GetFreeNames();
+  if (Free.empty())
+    return;
+  assert(Closure && "Free names without a closure!");
+  IntegerType *IntPtr = R.GetIntPtrTy(M);
+  Constant *Item = M.getOrInsertFunction("py_seq_item", ObjectPtrTy,
+                                         ObjectPtrTy, IntPtr, NULL);
+  // The closure keeps the cells alive.
+  for (unsigned i = 0, e = Free.size(); i != e; ++i)
+    Storage[Free[i]] = IRB.CreateCall2(Item, Closure,
+                                       ConstantInt::get(IntPtr, i), Free[i]);
+}
+
+/// GetCString - Return a pointer to a constant copy of Name, with a
+/// terminating zero.
+Value *NameResolver::GetCString(StringRef Name) {
+  Value *&P = CStrings[Name];
+  if (!P)
+    P = IRBuilder<>(Names).CreateGlobalStringPtr(Name, "name");
+  return P;
+}
+
+/// GetKey - Return the str of Name, made in the entry block. py_name only
+/// makes it the first time the function runs.
+Value *NameResolver::GetKey(StringRef Name) {
+  Value *&Key = Keys[Name];
+  if (Key)
+    return Key;
+  Type *ObjectPtrTy = R.GetObjectTyPtr();
+  GlobalVariable *Slot =
+    new GlobalVariable(M, ObjectPtrTy, false /*isConstant*/,
+                       GlobalValue::PrivateLinkage,
+                       Constant::getNullValue(ObjectPtrTy), "name.slot");
+  IntegerType *IntPtr = R.GetIntPtrTy(M);
+  Type *Params[] = { PointerType::get(ObjectPtrTy, 0), R.GetVoidTyPtr(),
+                     IntPtr };
+  Constant *Fn = M.getOrInsertFunction("py_name",
+                                       FunctionType::get(ObjectPtrTy, Params,
+                                                         false /*VarArg*/));
+  IRBuilder<> IRB(Names);
+  Key = IRB.CreateCall3(Fn, Slot, GetCString(Name),
+                        ConstantInt::get(IntPtr, Name.size()),
+                        Name + ".key");
+  return Key;
+}
+
+/// EmitCheckBound - Stop with py_unbound if V, the value of Name, is null.
+void NameResolver::EmitCheckBound(BasicBlock **BB, Value *V, StringRef Name) {
+  LLVMContext &C = M.getContext();
+  BasicBlock *Unbound = BasicBlock::Create(C, "name.unbound", &F);
+  BasicBlock *Bound = BasicBlock::Create(C, "name.bound", &F);
+  IRBuilder<> IRB(*BB);
+  IRB.CreateCondBr(IRB.CreateIsNull(V), Unbound, Bound);
+
+  IRB.SetInsertPoint(Unbound);
+  Constant *Fn = M.getOrInsertFunction("py_unbound", IRB.getVoidTy(),
+                                       R.GetVoidTyPtr(), NULL);
+  IRB.CreateCall(Fn, GetCString(Name));
+  IRB.CreateUnreachable();
+  *BB = Bound;
+}
+
+Value *NameResolver::EmitLoad(BasicBlock **BB, StringRef Name) {
+  Value *V = 0;
+  switch (S.Lookup(Name)) {
+  case ast::Scope::Local:
+    // A class's Local may have a cell in Storage too, which isn't its own.
+    if (S.IsOptimized()) {
+      V = IRBuilder<>(*BB).CreateLoad(Storage.lookup(Name), Name);
+    } else {
+      // The namespace, then the module's.
+      LLVMContext &C = M.getContext();
+      BasicBlock *GlobalBB = BasicBlock::Create(C, "name.global", &F);
+      BasicBlock *Done = BasicBlock::Create(C, "name.done", &F);
+      Value *Key = GetKey(Name);
+      Value *L = R.EmitCachedLookup(M, BB, Locals, Key);
+      BasicBlock *LocalBB = *BB;
+      IRBuilder<> IRB(LocalBB);
+      IRB.CreateCondBr(IRB.CreateIsNull(L), GlobalBB, Done);
+
+      Value *G = R.EmitCachedLookup(M, &GlobalBB, Globals, Key);
+      BranchInst::Create(Done, GlobalBB);
+      PHINode *P = PHINode::Create(R.GetObjectTyPtr(), 2, Name, Done);
+      P->addIncoming(L, LocalBB);
+      P->addIncoming(G, GlobalBB);
+      *BB = Done;
+      V = P;
+    }
+    break;
+  case ast::Scope::Cell:
+  case ast::Scope::Free: {
+    Constant *Fn = M.getOrInsertFunction("py_cell_get", R.GetObjectTyPtr(),
+                                         R.GetObjectTyPtr(), NULL);
+    V = IRBuilder<>(*BB).CreateCall(Fn, Storage.lookup(Name), Name);
+    break;
+  }
+  case ast::Scope::Global:
+    V = R.EmitCachedLookup(M, BB, Globals, GetKey(Name));
+    break;
+  }
+  EmitCheckBound(BB, V, Name);
+  return V;
+}
+
+void NameResolver::EmitStore(BasicBlock **BB, StringRef Name, Value *V) {
+  Type *VoidTy = Type::getVoidTy(M.getContext());
+  Type *ObjectPtrTy = R.GetObjectTyPtr();
+  IRBuilder<> IRB(*BB);
+  switch (S.Lookup(Name)) {
+  case ast::Scope::Local:
+    if (S.IsOptimized()) {
+      Value *A = Storage.lookup(Name);
+      Constant *IncRef = M.getOrInsertFunction("py_incref", VoidTy,
+                                               ObjectPtrTy, NULL);
+      Constant *XDecRef = M.getOrInsertFunction("py_xdecref", VoidTy,
+                                                ObjectPtrTy, NULL);
+      IRB.CreateCall(IncRef, V);
+      Value *Old = IRB.CreateLoad(A, "old");
+      IRB.CreateStore(V, A);
+      IRB.CreateCall(XDecRef, Old);
+      return;
+    }
+    IRB.CreateCall3(M.getOrInsertFunction("py_dict_set", VoidTy, ObjectPtrTy,
+                                          ObjectPtrTy, ObjectPtrTy, NULL),
+                    Locals, GetKey(Name), V);
+    return;
+  case ast::Scope::Cell:
+  case ast::Scope::Free:
+    IRB.CreateCall2(M.getOrInsertFunction("py_cell_set", VoidTy, ObjectPtrTy,
+                                          ObjectPtrTy, NULL),
+                    Storage.lookup(Name), V);
+    return;
+  case ast::Scope::Global:
+    IRB.CreateCall3(M.getOrInsertFunction("py_dict_set", VoidTy, ObjectPtrTy,
+                                          ObjectPtrTy, ObjectPtrTy, NULL),
+                    Globals, GetKey(Name), V);
+    return;
+  }
+}
+
+void NameResolver::EmitRelease(BasicBlock *BB) {
+  Type *VoidTy = Type::getVoidTy(M.getContext());
+  Type *ObjectPtrTy = R.GetObjectTyPtr();
+  Constant *DecRef = M.getOrInsertFunction("py_decref", VoidTy,
+                                           ObjectPtrTy, NULL);
+  Constant *XDecRef = M.getOrInsertFunction("py_xdecref", VoidTy,
+                                            ObjectPtrTy, NULL);
+  IRBuilder<> IRB(BB);
+  for (StringMap<Value*>::iterator I = Storage.begin(), E = Storage.end();
+       I != E; ++I) {
+    Value *V = I->getValue();
+    if (isa<AllocaInst>(V))
+      IRB.CreateCall(XDecRef, IRB.CreateLoad(V));
+    else if (S.Lookup(I->getKey()) == ast::Scope::Cell)
+      IRB.CreateCall(DecRef, V);
+    // Free cells are the closure's.
+  }
+  IRB.CreateCall(DecRef, Globals);
+  if (Locals)
+    IRB.CreateCall(DecRef, Locals);
+}
+
+void NameResolver::Resolve() {
+  // Find the uses first; replacing them splits blocks.
+  SmallVector<std::pair<Instruction*, unsigned>, 16> Uses;
+  SmallPtrSet<Value*, 16> Placeholders;
+  for (Function::iterator BB = F.begin(), BE = F.end(); BB != BE; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+      for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i)
+        if (I->getOperand(i)->getValueID() == NameVal) {
+          Uses.push_back(std::make_pair(&*I, i));
+          Placeholders.insert(I->getOperand(i));
+        }
+
+  for (unsigned i = 0, e = Uses.size(); i != e; ++i) {
+    Instruction *I = Uses[i].first;
+    unsigned OpNo = Uses[i].second;
+    Name *N = static_cast<Name*>(I->getOperand(OpNo));
+    BasicBlock *BB, *Tail;
+    if (PHINode *P = dyn_cast<PHINode>(I)) {
+      // The PHI now comes in from Tail, which BB falls into.
+      BB = P->getIncomingBlock(OpNo);
+      Tail = BB->splitBasicBlock(BB->getTerminator(), "name.phi");
+    } else {
+      BB = I->getParent();
+      Tail = BB->splitBasicBlock(I, "name.use");
+    }
+    BB->getTerminator()->eraseFromParent();
+    Value *V = EmitLoad(&BB, N->GetName());
+    BranchInst::Create(Tail, BB);
+    I->setOperand(OpNo, V);
+  }
+
+  for (SmallPtrSet<Value*, 16>::iterator I = Placeholders.begin(),
+       E = Placeholders.end(); I != E; ++I)
+    delete static_cast<Name*>(*I);
+
+  BasicBlock *Body = Names->getNextNode();
+  assert(Body && "Function has no body!");
+  BranchInst::Create(Body, Names);
+}
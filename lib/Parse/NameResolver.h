@@ -0,0 +1,94 @@
+//===--- NameResolver.h - Resolving Names to storage ------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines NameResolver, which gives each name of a function the
+//  storage its binding in the scope analysis calls for, and replaces the
+//  Name placeholders of the function with loads from it.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _PARSE_NAMERESOLVER_H
+#define _PARSE_NAMERESOLVER_H
+
+#include "llvm/ADT/StringMap.h"
+#include "py/Parse/Scope.h"
+
+namespace llvm {
+  class BasicBlock;
+  class Function;
+  class Module;
+  class Value;
+}
+
+namespace py {
+
+class Runtime;
+
+/// NameResolver - The names of one function (or module or class body).
+///
+/// Local names of an optimized scope are kept in allocas in the entry
+/// block, which mem2reg promotes to registers, so reading one is free.
+/// Cell and Free names are kept in cells shared with nested functions;
+/// Free ones come from the function's closure, a tuple of cells in the
+/// order Scope::GetFreeNames gives. Global names, and the Local names of
+/// a scope that isn't optimized, are looked up in their namespace dict
+/// through an inline cache, as before.
+///
+/// Loads return borrowed references; the storage owns a reference to
+/// what is stored in it.
+class NameResolver {
+  Runtime &R;
+  llvm::Module &M;
+  llvm::Function &F;
+  const ast::Scope &S;
+
+  /// The entry block, which sets up the storage. It is left open until
+  /// Resolve, so keys can be added to it as they are needed.
+  llvm::BasicBlock *Names;
+  /// py_getglobals(), and py_getlocals() if the scope isn't optimized.
+  llvm::Value *Globals, *Locals;
+  /// The alloca or cell of each Local, Cell and Free name, and the cell of
+  /// each name a class is free in.
+  llvm::StringMap<llvm::Value*> Storage;
+  /// The str of each name looked up in a dict, and the bytes of each name
+  /// that has them.
+  llvm::StringMap<llvm::Value*> Keys, CStrings;
+
+  llvm::Value *GetCString(llvm::StringRef Name);
+  llvm::Value *GetKey(llvm::StringRef Name);
+  void EmitCheckBound(llvm::BasicBlock **BB, llvm::Value *V,
+                      llvm::StringRef Name);
+
+public:
+  /// Creates the entry block of F, ahead of any blocks it already has, and
+  /// the storage of the names of S in it. Closure is the closure of F, if
+  /// S has Free names.
+  NameResolver(Runtime &R, llvm::Module &M, llvm::Function &F,
+               const ast::Scope &S, llvm::Value *Closure);
+
+  /// Emits a read of Name at the end of *BB, and returns the value,
+  /// borrowed. Reading a name that isn't bound stops with py_unbound.
+  /// Updates *BB to the block the read ends in.
+  llvm::Value *EmitLoad(llvm::BasicBlock **BB, llvm::StringRef Name);
+  /// Emits the binding of Name to V at the end of *BB.
+  void EmitStore(llvm::BasicBlock **BB, llvm::StringRef Name,
+                 llvm::Value *V);
+  /// Emits, at the end of BB, the release of everything the storage
+  /// holds. Each block that returns from F needs it.
+  void EmitRelease(llvm::BasicBlock *BB);
+
+  /// Replaces each use of a Name placeholder in F with a load of it, and
+  /// deletes the placeholders. Then ends the entry block with a branch to
+  /// the block after it, which F must have by now.
+  void Resolve();
+};
+
+}
+
+#endif
@@ -26,28 +26,34 @@ using namespace py;
 using namespace llvm;
 
 #define LEX(T) do {                             \
-    if (!L.Lex(T) && AreLexerErrors())          \
-      return PNode();                           \
+    Lex(T);                                     \
     if (T.getKind() == tok::eof)                \
       return PNode();                           \
   } while(0)
 
 Parser::Parser(Lexer &L, Runtime &R, LLVMContext &C, Module &M,
                llvm::raw_ostream &DS) :
-  L(L), R(R), Context(C), Mod(M), DebugStream(DS) {
+  L(L), Tokens(L.getReplay()), OwnTokens(L.getBuffer()), NextToken(0),
+  R(R), Context(C), Mod(M), Idents(L.getIdentifierTable()),
+  DebugStream(DS) {
+  // Share one table with the Lexer, so identifier tokens arrive interned.
+  if (!Idents) {
+    Idents = &OwnIdents;
+    L.setIdentifierTable(Idents);
+  }
+  // Lex the whole buffer in one pass, unless that was done ahead of time.
+  // The Lexer keeps its diagnostics, for the caller to report.
+  if (!Tokens) {
+    OwnTokens.tokenize(L);
+    Tokens = &OwnTokens;
+  }
 }
 
-bool Parser::AreLexerErrors() {
-  for (llvm::SmallVector<Diagnostic, 5>::iterator
-         it = L.getDiagnostics().begin(),
-         end = L.getDiagnostics().end();
-       it != end;
-       ++it) {
-    if (it->getSeverity() == Diagnostic::Error)
-      return true;
-  }
-  return false;
-}     
+Parser::~Parser() {
+  // The Lexer may outlive the Parser; don't leave it our table.
+  if (L.getIdentifierTable() == &OwnIdents)
+    L.setIdentifierTable(0);
+}
 
 bool Parser::ParseFile() {
   return ParseFileInput();
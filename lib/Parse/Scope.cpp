@@ -0,0 +1,474 @@
+//===--- Scope.cpp - Name scopes ------------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements ScopeAnalysis, in two passes. ScopeBuilder first
+//  walks the tree, noting which names each scope binds, uses and declares
+//  global. Then each scope, outermost first, resolves its names: a name
+//  used in a function but bound only in an enclosing function is Free
+//  there, and Free in every scope in between, and makes the binding a Cell.
+//  A class in between that binds the name itself keeps it Local, but still
+//  passes the cell on, as CPython's DEF_FREE_CLASS does.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Parse/Scope.h"
+
+using namespace py;
+using namespace py::ast;
+using namespace llvm;
+
+Scope::Binding Scope::Lookup(StringRef Name) const {
+  StringMap<Binding>::const_iterator I = Bindings.find(Name);
+  return I == Bindings.end() ? Global : I->getValue();
+}
+
+namespace py {
+namespace ast {
+/// ScopeBuilder - Walks a module, building its scopes.
+class ScopeBuilder {
+public:
+  enum FlagBits {
+    DefBound = 1 << 0,
+    DefUsed = 1 << 1,
+    DefGlobal = 1 << 2,
+    /// Bound in this class scope, and Free in a function nested in it.
+    DefFreeClass = 1 << 3
+  };
+
+private:
+  ScopeAnalysis &SA;
+  Scope *Cur;
+
+  void Note(StringRef Name, unsigned Flag);
+  void Push(Scope::ScopeKind K, const Node *N);
+
+  void VisitStmts(ArrayRef<Stmt*> Stmts);
+  void VisitStmt(const Stmt *S);
+  void VisitTests(ArrayRef<Test*> Tests);
+  void VisitTest(const Node *N);
+  void VisitTarget(const Node *N);
+  void VisitAlias(const Alias &A);
+  void VisitParams(const Arguments &Args);
+
+  static Scope *FindDefinition(Scope *S, StringRef Name);
+  void Resolve(Scope *S);
+
+public:
+  ScopeBuilder(ScopeAnalysis &SA) : SA(SA), Cur(0) {}
+
+  void Build(const Module *M);
+};
+}
+}
+
+void ScopeBuilder::Note(StringRef Name, unsigned Flag) {
+  // Keep the map's copy of the name, which lives as long as the scope.
+  StringMapEntry<unsigned> &E = Cur->Flags.GetOrCreateValue(Name, 0);
+  if ((Flag & DefBound) && !(E.getValue() & DefBound))
+    Cur->Bound.push_back(E.getKey());
+  E.setValue(E.getValue() | Flag);
+}
+
+void ScopeBuilder::Push(Scope::ScopeKind K, const Node *N) {
+  Scope *S = new Scope(K, N, Cur);
+  SA.Scopes.push_back(S);
+  SA.ScopeOf[N] = S;
+  if (Cur)
+    Cur->Children.push_back(S);
+  Cur = S;
+}
+
+void ScopeBuilder::Build(const Module *M) {
+  Push(Scope::ModuleScope, M);
+  VisitStmts(M->GetBody());
+  // Parents were created first, so are resolved first.
+  for (unsigned i = 0, e = SA.Scopes.size(); i != e; ++i)
+    Resolve(SA.Scopes[i]);
+}
+
+//===----------------------------------------------------------------------===//
+// Walking the tree
+//===----------------------------------------------------------------------===//
+
+void ScopeBuilder::VisitStmts(ArrayRef<Stmt*> Stmts) {
+  for (unsigned i = 0, e = Stmts.size(); i != e; ++i)
+    VisitStmt(Stmts[i]);
+}
+
+void ScopeBuilder::VisitTests(ArrayRef<Test*> Tests) {
+  for (unsigned i = 0, e = Tests.size(); i != e; ++i)
+    VisitTest(Tests[i]);
+}
+
+void ScopeBuilder::VisitAlias(const Alias &A) {
+  // 'import a.b' binds a.
+  if (!A.AsName.empty())
+    Note(A.AsName, DefBound);
+  else if (A.Name == "*")
+    Cur->Optimized = false;
+  else
+    Note(A.Name.split('.').first, DefBound);
+}
+
+/// VisitParams - Bind the parameters of a function in its own scope.
+void ScopeBuilder::VisitParams(const Arguments &Args) {
+  for (unsigned i = 0, e = Args.Params.size(); i != e; ++i)
+    VisitTarget(Args.Params[i]);
+  if (!Args.VarArg.empty())
+    Note(Args.VarArg, DefBound);
+  if (!Args.KwArg.empty())
+    Note(Args.KwArg, DefBound);
+}
+
+void ScopeBuilder::VisitStmt(const Stmt *S) {
+  switch (S->GetKind()) {
+  case Node::ExprStmtKind:
+    VisitTest(cast<ExprStmt>(S)->GetValue());
+    break;
+  case Node::AssignKind: {
+    const Assign *A = cast<Assign>(S);
+    VisitTest(A->GetValue());
+    ArrayRef<Test*> Targets = A->GetTargets();
+    for (unsigned i = 0, e = Targets.size(); i != e; ++i)
+      VisitTarget(Targets[i]);
+    break;
+  }
+  case Node::AugAssignKind: {
+    const AugAssign *A = cast<AugAssign>(S);
+    VisitTest(A->GetValue());
+    VisitTest(A->GetTarget());
+    VisitTarget(A->GetTarget());
+    break;
+  }
+  case Node::PrintKind:
+    VisitTest(cast<Print>(S)->GetDest());
+    VisitTests(cast<Print>(S)->GetValues());
+    break;
+  case Node::DelKind: {
+    ArrayRef<Test*> Targets = cast<Del>(S)->GetTargets();
+    for (unsigned i = 0, e = Targets.size(); i != e; ++i)
+      VisitTarget(Targets[i]);
+    break;
+  }
+  case Node::PassKind:
+  case Node::BreakKind:
+  case Node::ContinueKind:
+    break;
+  case Node::ReturnKind:
+    VisitTest(cast<Return>(S)->GetValue());
+    break;
+  case Node::RaiseKind: {
+    const Raise *R = cast<Raise>(S);
+    VisitTest(R->GetType());
+    VisitTest(R->GetInst());
+    VisitTest(R->GetTBack());
+    break;
+  }
+  case Node::GlobalKind: {
+    ArrayRef<Identifier> Names = cast<Global>(S)->GetNames();
+    for (unsigned i = 0, e = Names.size(); i != e; ++i)
+      Note(Names[i].str(), DefGlobal);
+    break;
+  }
+  case Node::ExecKind: {
+    const Exec *E = cast<Exec>(S);
+    VisitTest(E->GetBody());
+    VisitTest(E->GetGlobals());
+    VisitTest(E->GetLocals());
+    // An unqualified exec can bind any name in the current namespace.
+    if (!E->GetGlobals())
+      Cur->Optimized = false;
+    break;
+  }
+  case Node::AssertKind:
+    VisitTest(cast<Assert>(S)->GetCond());
+    VisitTest(cast<Assert>(S)->GetMsg());
+    break;
+  case Node::ImportKind: {
+    ArrayRef<Alias> Names = cast<Import>(S)->GetNames();
+    for (unsigned i = 0, e = Names.size(); i != e; ++i)
+      VisitAlias(Names[i]);
+    break;
+  }
+  case Node::ImportFromKind: {
+    ArrayRef<Alias> Names = cast<ImportFrom>(S)->GetNames();
+    for (unsigned i = 0, e = Names.size(); i != e; ++i)
+      VisitAlias(Names[i]);
+    break;
+  }
+  case Node::IfKind: {
+    const If *I = cast<If>(S);
+    VisitTest(I->GetCond());
+    VisitStmts(I->GetBody());
+    VisitStmts(I->GetOrElse());
+    break;
+  }
+  case Node::WhileKind: {
+    const While *W = cast<While>(S);
+    VisitTest(W->GetCond());
+    VisitStmts(W->GetBody());
+    VisitStmts(W->GetOrElse());
+    break;
+  }
+  case Node::ForKind: {
+    const For *F = cast<For>(S);
+    VisitTest(F->GetIter());
+    VisitTarget(F->GetTarget());
+    VisitStmts(F->GetBody());
+    VisitStmts(F->GetOrElse());
+    break;
+  }
+  case Node::TryExceptKind: {
+    const TryExcept *T = cast<TryExcept>(S);
+    VisitStmts(T->GetBody());
+    ArrayRef<ExceptHandler> Handlers = T->GetHandlers();
+    for (unsigned i = 0, e = Handlers.size(); i != e; ++i) {
+      VisitTest(Handlers[i].Type);
+      if (Handlers[i].Target)
+        VisitTarget(Handlers[i].Target);
+      VisitStmts(Handlers[i].Body);
+    }
+    VisitStmts(T->GetOrElse());
+    break;
+  }
+  case Node::TryFinallyKind:
+    VisitStmts(cast<TryFinally>(S)->GetBody());
+    VisitStmts(cast<TryFinally>(S)->GetFinalBody());
+    break;
+  case Node::WithKind: {
+    const With *W = cast<With>(S);
+    VisitTest(W->GetContextExpr());
+    if (W->GetVars())
+      VisitTarget(W->GetVars());
+    VisitStmts(W->GetBody());
+    break;
+  }
+  case Node::FunctionDefKind: {
+    // Decorators and defaults are evaluated where the def is.
+    const FunctionDef *F = cast<FunctionDef>(S);
+    VisitTests(F->GetDecorators());
+    VisitTests(F->GetArgs().Defaults);
+    Note(F->GetName(), DefBound);
+    Scope *Outer = Cur;
+    Push(Scope::FunctionScope, F);
+    VisitParams(F->GetArgs());
+    VisitStmts(F->GetBody());
+    Cur = Outer;
+    break;
+  }
+  case Node::ClassDefKind: {
+    const ClassDef *C = cast<ClassDef>(S);
+    VisitTests(C->GetDecorators());
+    VisitTests(C->GetBases());
+    Note(C->GetName(), DefBound);
+    Scope *Outer = Cur;
+    Push(Scope::ClassScope, C);
+    VisitStmts(C->GetBody());
+    Cur = Outer;
+    break;
+  }
+  default:
+    assert(0 && "Not a statement!");
+  }
+}
+
+void ScopeBuilder::VisitTest(const Node *N) {
+  if (!N)
+    return;
+  switch (N->GetKind()) {
+  case Node::NameKind:
+    Note(cast<Name>(N)->GetId().str(), DefUsed);
+    break;
+  case Node::NumberKind:
+  case Node::StrKind:
+  case Node::EllipsisKind:
+    break;
+  case Node::TestListKind:
+    VisitTests(cast<TestList>(N)->GetElements());
+    break;
+  case Node::ListKind:
+    VisitTests(cast<List>(N)->GetElements());
+    break;
+  case Node::SetKind:
+    VisitTests(cast<Set>(N)->GetElements());
+    break;
+  case Node::DictKind:
+    VisitTests(cast<Dict>(N)->GetKeys());
+    VisitTests(cast<Dict>(N)->GetValues());
+    break;
+  case Node::YieldKind:
+    VisitTest(cast<Yield>(N)->GetValue());
+    break;
+  case Node::ComprehensionKind: {
+    const Comprehension *C = cast<Comprehension>(N);
+    VisitTest(C->GetIter());
+    VisitTarget(C->GetTarget());
+    VisitTest(C->GetPredicate());
+    VisitTest(C->GetElement());
+    break;
+  }
+  case Node::UnaryOpKind:
+    VisitTest(cast<UnaryOp>(N)->GetOperand());
+    break;
+  case Node::BinaryOpKind:
+    VisitTest(cast<BinaryOp>(N)->GetLHS());
+    VisitTest(cast<BinaryOp>(N)->GetRHS());
+    break;
+  case Node::BoolOpKind:
+    VisitTests(cast<BoolOp>(N)->GetOperands());
+    break;
+  case Node::CompareKind:
+    VisitTests(cast<Compare>(N)->GetOperands());
+    break;
+  case Node::IfExpKind:
+    VisitTest(cast<IfExp>(N)->GetCond());
+    VisitTest(cast<IfExp>(N)->GetThen());
+    VisitTest(cast<IfExp>(N)->GetElse());
+    break;
+  case Node::LambdaKind: {
+    const Lambda *L = cast<Lambda>(N);
+    VisitTests(L->GetArgs().Defaults);
+    Scope *Outer = Cur;
+    Push(Scope::FunctionScope, L);
+    VisitParams(L->GetArgs());
+    VisitTest(L->GetBody());
+    Cur = Outer;
+    break;
+  }
+  case Node::CallKind: {
+    const Call *C = cast<Call>(N);
+    VisitTest(C->GetFunc());
+    VisitTests(C->GetArgs());
+    ArrayRef<Keyword> Keywords = C->GetKeywords();
+    for (unsigned i = 0, e = Keywords.size(); i != e; ++i)
+      VisitTest(Keywords[i].Value);
+    VisitTest(C->GetStarArgs());
+    VisitTest(C->GetKwArgs());
+    break;
+  }
+  case Node::AttributeKind:
+    VisitTest(cast<Attribute>(N)->GetValue());
+    break;
+  case Node::SubscriptKind:
+    VisitTest(cast<Subscript>(N)->GetValue());
+    VisitTest(cast<Subscript>(N)->GetIndex());
+    break;
+  case Node::SliceKind:
+    VisitTest(cast<Slice>(N)->GetLower());
+    VisitTest(cast<Slice>(N)->GetUpper());
+    VisitTest(cast<Slice>(N)->GetStep());
+    break;
+  case Node::ReprKind:
+    VisitTest(cast<Repr>(N)->GetValue());
+    break;
+  default:
+    assert(0 && "Not an expression!");
+  }
+}
+
+void ScopeBuilder::VisitTarget(const Node *N) {
+  switch (N->GetKind()) {
+  case Node::NameKind:
+    Note(cast<Name>(N)->GetId().str(), DefBound);
+    break;
+  case Node::TestListKind: {
+    ArrayRef<Test*> Elts = cast<TestList>(N)->GetElements();
+    for (unsigned i = 0, e = Elts.size(); i != e; ++i)
+      VisitTarget(Elts[i]);
+    break;
+  }
+  case Node::ListKind: {
+    ArrayRef<Test*> Elts = cast<List>(N)->GetElements();
+    for (unsigned i = 0, e = Elts.size(); i != e; ++i)
+      VisitTarget(Elts[i]);
+    break;
+  }
+  default:
+    // a.b and a[b] bind nothing, but use a and b.
+    VisitTest(N);
+    break;
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Resolving names
+//===----------------------------------------------------------------------===//
+
+bool Scope::IsFreeInClass(StringRef Name) const {
+  StringMap<unsigned>::const_iterator I = Flags.find(Name);
+  return I != Flags.end() && (I->getValue() & ScopeBuilder::DefFreeClass);
+}
+
+/// FindDefinition - Return the innermost function scope around S that binds
+/// Name, or null if Name is global there. Class scopes don't enclose the
+/// functions in them, and a scope that declares Name global hides any
+/// binding further out.
+Scope *ScopeBuilder::FindDefinition(Scope *S, StringRef Name) {
+  for (Scope *Def = S->Parent; Def; Def = Def->Parent) {
+    StringMap<unsigned>::const_iterator I = Def->Flags.find(Name);
+    if (I == Def->Flags.end())
+      continue;
+    if (I->getValue() & DefGlobal)
+      return 0;
+    if (Def->Kind == Scope::FunctionScope && (I->getValue() & DefBound))
+      return Def;
+  }
+  return 0;
+}
+
+void ScopeBuilder::Resolve(Scope *S) {
+  for (StringMap<unsigned>::iterator I = S->Flags.begin(), E = S->Flags.end();
+       I != E; ++I) {
+    StringRef Name = I->getKey();
+    unsigned F = I->getValue();
+    if (S->Kind == Scope::ModuleScope || (F & DefGlobal)) {
+      S->Bindings[Name] = Scope::Global;
+      continue;
+    }
+    if (F & DefBound) {
+      S->Bindings[Name] = Scope::Local;
+      continue;
+    }
+
+    // Used but not bound: look in the enclosing functions.
+    Scope *Def = FindDefinition(S, Name);
+    if (!Def) {
+      S->Bindings[Name] = Scope::Global;
+      continue;
+    }
+    Def->Bindings[Name] = Scope::Cell;
+    // Every scope in between passes the cell on. A class that binds the
+    // name keeps its own Local, in its namespace, and passes the cell on
+    // beside it; only functions that bind it, which the search stopped at,
+    // have none to pass.
+    for (Scope *Inner = S; Inner != Def; Inner = Inner->Parent) {
+      StringMap<Scope::Binding>::iterator B = Inner->Bindings.find(Name);
+      if (B == Inner->Bindings.end()) {
+        Inner->Bindings[Name] = Scope::Free;
+        Inner->FreeNames.push_back(Name);
+      } else if (B->getValue() == Scope::Local) {
+        assert(Inner->Kind == Scope::ClassScope && "Passed a binding!");
+        unsigned &F = Inner->Flags[Name];
+        if (!(F & DefFreeClass)) {
+          F |= DefFreeClass;
+          Inner->FreeNames.push_back(Name);
+        }
+      }
+    }
+  }
+}
+
+ScopeAnalysis::ScopeAnalysis(const Module *M) {
+  ScopeBuilder(*this).Build(M);
+}
+
+ScopeAnalysis::~ScopeAnalysis() {
+  for (unsigned i = 0, e = Scopes.size(); i != e; ++i)
+    delete Scopes[i];
+}
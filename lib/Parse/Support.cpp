@@ -14,10 +14,12 @@
 
 #include "py/Parse/Parser.h"
 #include "py/Diagnostic.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/Support/IRBuilder.h"
 #include "llvm/Constants.h"
+#include "llvm/GlobalVariable.h"
 
 #include "GroupBlock.h"
 
@@ -31,133 +33,116 @@ void Parser::Diag(Token &T, const char *Str, Diagnostic::Severity Sev) {
   Diagnostics.push_back(d);
 }
 
+StringRef Parser::InternString(StringRef S, bool IsStable) {
+  return Idents->get(S, IsStable).str();
+}
+
 StringRef Parser::SanitizeString(StringRef S) {
-  // 1. Look for u/r/R leading chars.
-  
-  bool Unicode = false;
+  // 1. Look for u/r/b leading chars.
   bool Raw = false;
-  bool Fat = false;
-  char Quote;
-
-  const char *it = S.begin();
-
-  switch (*it) {
-  case 'u':
-  case 'U':
-    Unicode = true;
-    ++it;
-    break;
-  case 'r':
-  case 'R':
-    Raw = true;
-    ++it;
-    break;
-  default:
-    break;
-  }
-  
-  switch (*it) {
-  case 'u':
-  case 'U':
-    Unicode = true;
-    ++it;
-    break;
-  case 'r':
-  case 'R':
-    Raw = true;
-    ++it;
-    break;
-  default:
-    break;
+  unsigned Start = 0;
+  for (; Start != 2 && Start != S.size(); ++Start) {
+    char C = S[Start];
+    if (C == 'r' || C == 'R')
+      Raw = true;
+    else if (C != 'u' && C != 'U' && C != 'b' && C != 'B')
+      break;
   }
 
   // 2. Find quote type.
-  assert((*it == '\'' || *it == '"')  &&
+  assert(Start != S.size() && (S[Start] == '\'' || S[Start] == '"') &&
          "Bad quote type!");
-  
-  Quote = *it++;
-  // Handle the fat string case.
-  // > 5 because: 3 quotes + possible 2 u/r qualifiers is 5 minimum length
-  // ignoring trailing quotes.
-  if (S.size() > 5 && it[0] == Quote && it[1] == Quote) {
-    Fat = true;
-    it += 2;
-  }
+  char Quote = S[Start];
+  // A fat string has at least six quotes; '' is just an empty string.
+  unsigned QuoteLen = 1;
+  if (S.size() - Start >= 6 && S[Start+1] == Quote && S[Start+2] == Quote)
+    QuoteLen = 3;
+  assert(S.size() >= Start + 2*QuoteLen &&
+         S.endswith(S.substr(Start, QuoteLen)) &&
+         "Unterminated string literal!");
+  StringRef Body = S.slice(Start + QuoteLen, S.size() - QuoteLen);
+
+  // 3. Most literals contain no escapes; use them straight from the buffer.
+  if (Raw || Body.find('\\') == StringRef::npos)
+    return InternString(Body, /*IsStable=*/true);
+
+  // 4. Process escape sequences.
+  SmallString<128> C;
+  for (const char *it = Body.begin(), *end = Body.end(); it != end; ++it) {
+    if (*it != '\\') {
+      C.push_back(*it);
+      continue;
+    }
 
-  // 3. Process escape sequences if not raw.
-
-  char *C = new char[S.size()];
-  unsigned C_it = 0;
-  for (; it != S.end(); ++it) {
-    if (!Raw && *it == '\\') {
-      ++it;
-      assert(it != S.end() &&
-             "Consistency error - string shouldn't be able to end with '\\'");
-      switch (*it) {
-        // From http://docs.python.org/reference/lexical_analysis.html
-      case '\n':
-        // Ignore
-        break;
-
-      case '\\': C[C_it++] = '\\'; break;
-
-      case '\'': C[C_it++] = '\''; break;
-      case '"': C[C_it++] = '"'; break;
-      case 'a': C[C_it++] = '\a'; break;
-      case 'b': C[C_it++] = '\b'; break;
-      case 'f': C[C_it++] = '\f'; break;
-      case 'n': C[C_it++] = '\n'; break;
-      case 'N': {
-        // \N{name} Character named named in the Unicode database
-        // (unicode only)
-        assert(0 && "Named Unicode entities not implemented!");
-        break;
-      }
-      case 'r': C[C_it++] = '\r'; break;
-      case 't': C[C_it++] = '\t'; break;
-      case 'u': {
-        // \uxxxx Character with 16-bit hex value xxxx (Unicode only)
-        assert(0 && "16-bit unicode entities not implemented!");
-        break;
-      }
-      case 'U': {
-        // \Uxxxxxxxx Character with 32-bit hex value (Unicode only)
-        assert(0 && "32-bit unicode entities not implemented!");
-        break;
-      }
-      case 'v': C[C_it++] = '\v'; break;
-      case '0': case '1': case '2': case '3': case '4':
-      case '5': case '6': case '7': {
-        assert (0 && "Octal entities not implemented!");
-        break;
-      }
-      case 'x': {
-        assert (0 && "Hex entities not implemented!");
-        break;
-      }
-      default:
-        // Unrecognised; put straight in the string
-        // NOTE: Backslash should be put in too (see page
-        // linked at start of switch statement)
-        C[C_it++] = '\\';
-        C[C_it++] = *it;
-      }
-
-    } else {
-      C[C_it++] = *it;
+    ++it;
+    assert(it != end &&
+           "Consistency error - string shouldn't be able to end with '\\'");
+    switch (*it) {
+      // From http://docs.python.org/reference/lexical_analysis.html
+    case '\n':
+      // Ignore
+      break;
+
+    case '\\': C.push_back('\\'); break;
+
+    case '\'': C.push_back('\''); break;
+    case '"': C.push_back('"'); break;
+    case 'a': C.push_back('\a'); break;
+    case 'b': C.push_back('\b'); break;
+    case 'f': C.push_back('\f'); break;
+    case 'n': C.push_back('\n'); break;
+    case 'N': {
+      // \N{name} Character named named in the Unicode database
+      // (unicode only)
+      assert(0 && "Named Unicode entities not implemented!");
+      break;
+    }
+    case 'r': C.push_back('\r'); break;
+    case 't': C.push_back('\t'); break;
+    case 'u': {
+      // \uxxxx Character with 16-bit hex value xxxx (Unicode only)
+      assert(0 && "16-bit unicode entities not implemented!");
+      break;
+    }
+    case 'U': {
+      // \Uxxxxxxxx Character with 32-bit hex value (Unicode only)
+      assert(0 && "32-bit unicode entities not implemented!");
+      break;
+    }
+    case 'v': C.push_back('\v'); break;
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': {
+      assert (0 && "Octal entities not implemented!");
+      break;
+    }
+    case 'x': {
+      assert (0 && "Hex entities not implemented!");
+      break;
+    }
+    default:
+      // Unrecognised; put straight in the string
+      // NOTE: Backslash should be put in too (see page
+      // linked at start of switch statement)
+      C.push_back('\\');
+      C.push_back(*it);
     }
   }
 
-  // 4. Strip quote from end.
-  assert(S.endswith(std::string(1, Quote)));
-  if (Fat)
-    assert(S.endswith(std::string(3, Quote)));
-
-  return StringRef(C, Fat ? C_it-3 : C_it-1);
+  return InternString(C.str(), /*IsStable=*/false);
 }
 
-Constant *Parser::GetConstantString(const Twine &T) {
-  return ConstantArray::get(Context, T.str());
+GlobalVariable *Parser::GetConstantString(const Twine &T) {
+  SmallString<64> Buf;
+  StringRef S = T.toStringRef(Buf);
+  GlobalVariable *&GV = StringPool[S];
+  if (!GV) {
+    Constant *Init = ConstantArray::get(Context, S);
+    GV = new GlobalVariable(Mod, Init->getType(), true /*isConstant*/,
+                            GlobalValue::PrivateLinkage, Init, "str");
+    // Nothing compares their addresses, so LLVM may merge them further.
+    GV->setUnnamedAddr(true);
+  }
+  return GV;
 }
 
 llvm::Value *Parser::MakeTuple(const std::vector<PNode> &List,
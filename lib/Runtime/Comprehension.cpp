@@ -0,0 +1,219 @@
+//===--- Comprehension.cpp - Comprehension loop nests ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements ComprehensionBuilder. Each loop is a header, which
+// tests for the end and falls into the body, and a latch, which advances
+// and goes back to the header. A loop's exit goes to the latch of the loop
+// around it, so the whole nest has one exit.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Intrinsics.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Support/IRBuilder.h"
+
+#include "py/Runtime/Comprehension.h"
+#include "py/Runtime/Runtime.h"
+
+using namespace llvm;
+using namespace py;
+
+ComprehensionBuilder::ComprehensionBuilder(Runtime &R, Module &M,
+                                           BasicBlock *BB)
+  : R(R), M(M), F(BB->getParent()), Preheader(BB), Body(BB), TripCount(0),
+    NumFilters(0) {
+  Exit = BasicBlock::Create(M.getContext(), "comp.done", F);
+}
+
+BasicBlock *ComprehensionBuilder::GetOuterLatch() const {
+  return Loops.empty() ? Exit : Loops.back().Latch;
+}
+
+/// EmitCountedLoop - Emit a loop from Start while less than Stop (greater,
+/// for a negative Step), in Steps, and return the induction variable. If
+/// ReloadStop is set, Stop is the size of Seq, which is read again on each
+/// iteration in case the body changes it.
+Value *ComprehensionBuilder::EmitCountedLoop(Value *Start, Value *Stop,
+                                             int64_t Step, bool ReloadStop,
+                                             Value *Seq) {
+  assert(Step != 0 && "range() step must not be zero!");
+  LLVMContext &C = M.getContext();
+  BasicBlock *Header = BasicBlock::Create(C, "comp.header", F);
+  BasicBlock *Next = BasicBlock::Create(C, "comp.body", F);
+  BasicBlock *Latch = BasicBlock::Create(C, "comp.latch", F);
+
+  IRBuilder<> IRB(Body);
+  Type *I64 = IRB.getInt64Ty();
+  // |Step|, which for INT64_MIN only fits unsigned.
+  uint64_t AbsStep = Step > 0 ? uint64_t(Step) : -uint64_t(Step);
+  if (Loops.empty() && Body == Preheader) {
+    // Span > 0 ? (Span - 1) / |Step| + 1 : 0, computed before the nest. The
+    // bounds are small ints, so Span can't overflow, and rounding up this
+    // way can't either.
+    Value *Span = Step > 0 ? IRB.CreateSub(Stop, Start)
+                           : IRB.CreateSub(Start, Stop);
+    Value *Count = IRB.CreateUDiv(IRB.CreateSub(Span, IRB.getInt64(1)),
+                                  IRB.getInt64(AbsStep));
+    Count = IRB.CreateAdd(Count, IRB.getInt64(1));
+    TripCount = IRB.CreateSelect(IRB.CreateICmpSGT(Span, IRB.getInt64(0)),
+                                 Count, IRB.getInt64(0), "trip.count");
+  }
+  IRB.CreateBr(Header);
+
+  IRB.SetInsertPoint(Header);
+  PHINode *I = IRB.CreatePHI(I64, 2, "comp.i");
+  I->addIncoming(Start, Body);
+  if (ReloadStop)
+    Stop = EmitSeqSize(Header, Seq);
+  Value *More = Step > 0 ? IRB.CreateICmpSLT(I, Stop)
+                         : IRB.CreateICmpSGT(I, Stop);
+  IRB.CreateCondBr(More, Next, GetOuterLatch());
+
+  // Every I is a small int, within 2^62 of zero, so I + Step can only
+  // overflow an i64 for a bigger step. That overflow ends the loop: the
+  // next I would be past Stop.
+  IRB.SetInsertPoint(Latch);
+  Value *INext;
+  if (AbsStep <= (uint64_t(1) << 62)) {
+    INext = IRB.CreateAdd(I, IRB.getInt64(Step), "comp.i.next");
+    IRB.CreateBr(Header);
+  } else {
+    Value *Pair = IRB.CreateCall2(
+        Intrinsic::getDeclaration(&M, Intrinsic::sadd_with_overflow, I64),
+        I, IRB.getInt64(Step));
+    INext = IRB.CreateExtractValue(Pair, 0, "comp.i.next");
+    IRB.CreateCondBr(IRB.CreateExtractValue(Pair, 1), GetOuterLatch(),
+                     Header);
+  }
+  I->addIncoming(INext, Latch);
+
+  Loop L = { Latch };
+  Loops.push_back(L);
+  Body = Next;
+  return I;
+}
+
+/// EmitSeqSize - Emit py_seq_size(Seq) at the end of BB, as an i64.
+Value *ComprehensionBuilder::EmitSeqSize(BasicBlock *BB, Value *Seq) {
+  IRBuilder<> IRB(BB);
+  Constant *Size = M.getOrInsertFunction("py_seq_size", R.GetIntPtrTy(M),
+                                         R.GetObjectTyPtr(), NULL);
+  return IRB.CreateZExtOrBitCast(IRB.CreateCall(Size, Seq), IRB.getInt64Ty(),
+                                 "size");
+}
+
+Value *ComprehensionBuilder::AddRange(Value *Start, Value *Stop,
+                                      int64_t Step) {
+  return EmitCountedLoop(Start, Stop, Step, false, 0);
+}
+
+Value *ComprehensionBuilder::AddSequence(Value *Seq) {
+  Type *I64 = Type::getInt64Ty(M.getContext());
+  Type *IntPtr = R.GetIntPtrTy(M);
+  Constant *Item = M.getOrInsertFunction("py_seq_item", R.GetObjectTyPtr(),
+                                         R.GetObjectTyPtr(), IntPtr, NULL);
+  Value *Stop = EmitSeqSize(Body, Seq);
+  Value *I = EmitCountedLoop(ConstantInt::get(I64, 0), Stop, 1, true, Seq);
+  IRBuilder<> IRB(Body);
+  return IRB.CreateCall2(Item, Seq, IRB.CreateTruncOrBitCast(I, IntPtr),
+                         "comp.item");
+}
+
+Value *ComprehensionBuilder::AddIterable(Value *Iterable) {
+  LLVMContext &C = M.getContext();
+  Constant *DecRef = M.getOrInsertFunction("py_decref", Type::getVoidTy(C),
+                                           R.GetObjectTyPtr(), NULL);
+  BasicBlock *Header = BasicBlock::Create(C, "comp.header", F);
+  BasicBlock *Next = BasicBlock::Create(C, "comp.body", F);
+  BasicBlock *Latch = BasicBlock::Create(C, "comp.latch", F);
+  BasicBlock *Done = BasicBlock::Create(C, "comp.end", F);
+
+  IRBuilder<> IRB(Body);
+  Value *It = IRB.CreateCall(R.GetFunction(M, Runtime::StartIteration),
+                             Iterable, "comp.iter");
+  IRB.CreateBr(Header);
+
+  IRB.SetInsertPoint(Header);
+  Value *Item = IRB.CreateCall(R.GetFunction(M, Runtime::NextIteration), It,
+                               "comp.item");
+  IRB.CreateCondBr(IRB.CreateIsNull(Item), Done, Next);
+
+  // The loop owns each item until the next.
+  IRB.SetInsertPoint(Latch);
+  IRB.CreateCall(DecRef, Item);
+  IRB.CreateBr(Header);
+
+  IRB.SetInsertPoint(Done);
+  IRB.CreateCall(DecRef, It);
+  IRB.CreateBr(GetOuterLatch());
+
+  Loop L = { Latch };
+  Loops.push_back(L);
+  Body = Next;
+  return Item;
+}
+
+void ComprehensionBuilder::AddFilter(Value *Cond) {
+  assert(!Loops.empty() && "An if clause must follow a for clause!");
+  BasicBlock *Pass = BasicBlock::Create(M.getContext(), "comp.if", F);
+  IRBuilder<>(Body).CreateCondBr(Cond, Pass, Loops.back().Latch);
+  Body = Pass;
+  ++NumFilters;
+}
+
+Value *ComprehensionBuilder::EmitNewList() {
+  Type *IntPtr = R.GetIntPtrTy(M);
+  Constant *New = M.getOrInsertFunction("py_list_new", R.GetObjectTyPtr(),
+                                        IntPtr, NULL);
+  IRBuilder<> IRB(Preheader);
+  if (TerminatorInst *T = Preheader->getTerminator())
+    IRB.SetInsertPoint(T);
+  // With an if clause, the trip count would only be a bound. It fits a
+  // size_t: range() bounds are small ints, which are narrower still.
+  Value *Capacity = TripCount && !NumFilters
+    ? IRB.CreateTruncOrBitCast(TripCount, IntPtr)
+    : ConstantInt::get(IntPtr, 0);
+  return IRB.CreateCall(New, Capacity, "comp.list");
+}
+
+void ComprehensionBuilder::EmitAppend(Value *L, Value *V) {
+  Constant *Append = M.getOrInsertFunction("py_list_append",
+                                           Type::getVoidTy(M.getContext()),
+                                           R.GetObjectTyPtr(),
+                                           R.GetObjectTyPtr(), NULL);
+  IRBuilder<>(Body).CreateCall2(Append, L, V);
+}
+
+Value *ComprehensionBuilder::EmitNewDict() {
+  Constant *New = M.getOrInsertFunction("py_dict_new", R.GetObjectTyPtr(),
+                                        NULL);
+  IRBuilder<> IRB(Preheader);
+  if (TerminatorInst *T = Preheader->getTerminator())
+    IRB.SetInsertPoint(T);
+  return IRB.CreateCall(New, "comp.dict");
+}
+
+void ComprehensionBuilder::EmitSetItem(Value *D, Value *K, Value *V) {
+  Constant *Set = M.getOrInsertFunction("py_dict_set",
+                                        Type::getVoidTy(M.getContext()),
+                                        R.GetObjectTyPtr(), R.GetObjectTyPtr(),
+                                        R.GetObjectTyPtr(), NULL);
+  IRBuilder<>(Body).CreateCall3(Set, D, K, V);
+}
+
+BasicBlock *ComprehensionBuilder::Finish() {
+  IRBuilder<>(Body).CreateBr(GetOuterLatch());
+  Body = Exit;
+  return Exit;
+}
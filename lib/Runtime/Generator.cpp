@@ -0,0 +1,183 @@
+//===--- Generator.cpp - Generators as state machines ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements GeneratorBuilder. The frame is { i32 State, Slots },
+// where State is 0 before the first resume, N after the Nth yield, and -1
+// once the generator has returned.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/IRBuilder.h"
+
+#include "py/Runtime/Generator.h"
+#include "py/Runtime/Runtime.h"
+
+#include <vector>
+
+using namespace llvm;
+using namespace py;
+
+enum {
+  StateField = 0,
+  FirstSlotField = 1
+};
+
+static const int FinishedState = -1;
+
+GeneratorBuilder::GeneratorBuilder(Runtime &R, Module &M, const Twine &Name,
+                                   ArrayRef<Type*> Slots)
+  : R(R), M(M), NumYields(0) {
+  LLVMContext &C = M.getContext();
+  std::vector<Type*> Fields;
+  Fields.push_back(Type::getInt32Ty(C));
+  Fields.insert(Fields.end(), Slots.begin(), Slots.end());
+  FrameTy = StructType::create(C, Fields, (Name + ".frame").str());
+
+  Resume = Function::Create(FunctionType::get(R.GetObjectTyPtr(),
+                                              R.GetVoidTyPtr(),
+                                              false /*VarArg*/),
+                            GlobalValue::InternalLinkage, Name + ".resume",
+                            &M);
+  Destroy = CreateDestroy(Name);
+
+  BasicBlock *Entry = BasicBlock::Create(C, "entry", Resume);
+  Body = BasicBlock::Create(C, "body", Resume);
+  Done = BasicBlock::Create(C, "done", Resume);
+
+  // Go to where the last resume stopped.
+  IRBuilder<> IRB(Entry);
+  Frame = IRB.CreateBitCast(Resume->arg_begin(),
+                            PointerType::get(FrameTy, 0), "frame");
+  Value *State = IRB.CreateLoad(IRB.CreateStructGEP(Frame, StateField),
+                                "state");
+  Dispatch = IRB.CreateSwitch(State, Done, 1);
+  Dispatch->addCase(IRB.getInt32(0), Body);
+
+  IRB.SetInsertPoint(Done);
+  IRB.CreateRet(Constant::getNullValue(R.GetObjectTyPtr()));
+}
+
+/// CreateDestroy - Create a function releasing the object slots of a frame,
+/// or return null if there are none.
+Function *GeneratorBuilder::CreateDestroy(const Twine &Name) {
+  std::vector<unsigned> ObjectSlots;
+  for (unsigned i = FirstSlotField, e = FrameTy->getNumElements(); i != e; ++i)
+    if (FrameTy->getElementType(i) == R.GetObjectTyPtr())
+      ObjectSlots.push_back(i);
+  if (ObjectSlots.empty())
+    return 0;
+
+  LLVMContext &C = M.getContext();
+  Function *F = Function::Create(FunctionType::get(Type::getVoidTy(C),
+                                                   R.GetVoidTyPtr(),
+                                                   false /*VarArg*/),
+                                 GlobalValue::InternalLinkage,
+                                 Name + ".destroy", &M);
+  Constant *DecRef =
+    M.getOrInsertFunction("py_decref", Type::getVoidTy(C), R.GetObjectTyPtr(),
+                          NULL);
+
+  BasicBlock *BB = BasicBlock::Create(C, "entry", F);
+  IRBuilder<> IRB(BB);
+  Value *Fr = IRB.CreateBitCast(F->arg_begin(), PointerType::get(FrameTy, 0));
+  for (unsigned i = 0, e = ObjectSlots.size(); i != e; ++i) {
+    Value *Slot = IRB.CreateLoad(IRB.CreateStructGEP(Fr, ObjectSlots[i]));
+    BasicBlock *Release = BasicBlock::Create(C, "release", F);
+    BasicBlock *Next = BasicBlock::Create(C, "next", F);
+    IRB.CreateCondBr(IRB.CreateIsNull(Slot), Next, Release);
+    IRB.SetInsertPoint(Release);
+    IRB.CreateCall(DecRef, Slot);
+    IRB.CreateBr(Next);
+    IRB.SetInsertPoint(Next);
+  }
+  IRB.CreateRetVoid();
+  return F;
+}
+
+Value *GeneratorBuilder::EmitSlot(BasicBlock *BB, unsigned I) {
+  IRBuilder<> IRB(BB);
+  return IRB.CreateStructGEP(Frame, FirstSlotField + I, "slot");
+}
+
+void GeneratorBuilder::EmitYield(BasicBlock **BB, Value *V) {
+  IRBuilder<> IRB(*BB);
+  unsigned State = ++NumYields;
+  IRB.CreateStore(IRB.getInt32(State), IRB.CreateStructGEP(Frame, StateField));
+  IRB.CreateRet(V);
+
+  BasicBlock *Next = BasicBlock::Create(M.getContext(),
+                                        "resume." + Twine(State), Resume);
+  Dispatch->addCase(IRB.getInt32(State), Next);
+  *BB = Next;
+}
+
+void GeneratorBuilder::EmitReturn(BasicBlock *BB) {
+  IRBuilder<> IRB(BB);
+  IRB.CreateStore(IRB.getInt32(FinishedState),
+                  IRB.CreateStructGEP(Frame, StateField));
+  IRB.CreateBr(Done);
+}
+
+Value *GeneratorBuilder::EmitStackFrame(BasicBlock *BB) {
+  // In the entry block, so that it can be promoted to registers.
+  BasicBlock &Entry = BB->getParent()->getEntryBlock();
+  IRBuilder<> Alloca(&Entry, Entry.begin());
+  Value *Fr = Alloca.CreateAlloca(FrameTy, 0, "frame");
+
+  IRBuilder<> IRB(BB);
+  IRB.CreateStore(Constant::getNullValue(FrameTy), Fr);
+  return IRB.CreateBitCast(Fr, R.GetVoidTyPtr());
+}
+
+Value *GeneratorBuilder::EmitHeapGenerator(BasicBlock *BB, Value **FrameOut) {
+  Type *PtrVoidTy = R.GetVoidTyPtr(), *PtrObjectTy = R.GetObjectTyPtr();
+  Type *IntPtr = R.GetIntPtrTy(M);
+  Constant *New =
+    M.getOrInsertFunction("py_generator_new", PtrObjectTy, PtrVoidTy,
+                          PtrVoidTy, IntPtr, NULL);
+  Constant *GetFrame =
+    M.getOrInsertFunction("py_generator_frame", PtrVoidTy, PtrObjectTy, NULL);
+
+  IRBuilder<> IRB(BB);
+  Value *DestroyFn = Destroy ? ConstantExpr::getBitCast(Destroy, PtrVoidTy)
+                             : Constant::getNullValue(PtrVoidTy);
+  Value *G = IRB.CreateCall3(New, ConstantExpr::getBitCast(Resume, PtrVoidTy),
+                             DestroyFn,
+                             ConstantExpr::getTruncOrBitCast(
+                               ConstantExpr::getSizeOf(FrameTy), IntPtr),
+                             "generator");
+  *FrameOut = IRB.CreateCall(GetFrame, G, "frame");
+  return G;
+}
+
+Value *GeneratorBuilder::EmitFrameSlot(BasicBlock *BB, Value *Fr,
+                                       unsigned I) {
+  IRBuilder<> IRB(BB);
+  Value *Typed = IRB.CreateBitCast(Fr, PointerType::get(FrameTy, 0));
+  return IRB.CreateStructGEP(Typed, FirstSlotField + I, "slot");
+}
+
+Value *GeneratorBuilder::EmitResume(BasicBlock *BB, Value *Fr) {
+  IRBuilder<> IRB(BB);
+  return IRB.CreateCall(Resume, Fr, "next");
+}
+
+void GeneratorBuilder::EmitDestroy(BasicBlock *BB, Value *Fr) {
+  if (!Destroy)
+    return;
+  IRBuilder<> IRB(BB);
+  IRB.CreateCall(Destroy, Fr);
+}
@@ -13,9 +13,15 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/LLVMContext.h"
+#include "llvm/Constants.h"
 #include "llvm/Function.h"
 #include "llvm/DerivedTypes.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/Intrinsics.h"
+#include "llvm/Module.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Target/TargetData.h"
 
 #include "py/Runtime/Runtime.h"
 
@@ -24,21 +30,34 @@
 using namespace llvm;
 using namespace py;
 
+// The native runtime (runtime/pyrt.h) defines these. They carry a prefix so
+// that none of them can resolve to a libc function such as bind().
 static const char *FunctionNames[] = {
-  "getlocals",
-  "getglobals",
+  "py_getlocals",
+  "py_getglobals",
   "", /* SentinelZero */
-  "startiteration",
-  "nextiteration",
-  "yield",
+  "py_startiteration",
+  "py_nextiteration",
+  "py_yield",
   "", /* SentinelOne */
-  "bind",
+  "py_bind",
+  "py_int_add",
+  "py_int_sub",
+  "py_int_mul",
+  "py_cmp",
   "", /* SentinelTwo */
-  "generatorfactory",
+  "py_generatorfactory",
   "", /* SentinelThree */
   "" /* End */
 };
 
+// Fields of the runtime's layouts that generated code reads.
+enum {
+  DictEntriesField = 6,  ///< DictObject::Entries
+  DictVersionField = 7,  ///< DictObject::Version
+  DictEntryValueField = 1 ///< DictEntry::Value
+};
+
 Runtime::Runtime(LLVMContext &Context) :
   Context(Context) {
   StructType *Ty = StructType::create(Context, "PythonObject");
@@ -48,6 +67,18 @@ Runtime::Runtime(LLVMContext &Context) :
   PtrObjectTy = PointerType::get(ObjectTy, 0);
   PtrVoidTy = PointerType::get(Type::getInt8Ty(Context), 0);
 
+  Type *I8 = Type::getInt8Ty(Context), *I16 = Type::getInt16Ty(Context);
+  Type *I32 = Type::getInt32Ty(Context), *I64 = Type::getInt64Ty(Context);
+  DictEntryTy = StructType::create(Context, "PythonDictEntry");
+  DictEntryTy->setBody(PtrObjectTy, PtrObjectTy, I32, NULL);
+  // The object header, then Size, Capacity, Entries and Version.
+  DictTy = StructType::create(Context, "PythonDict");
+  DictTy->setBody(I32, I16, I8, I8, I32, I32,
+                  PointerType::get(DictEntryTy, 0), I64, NULL);
+  StructType *WayTy = StructType::get(I64, I64, NULL);
+  LookupCacheTy = StructType::create(Context, "PythonLookupCache");
+  LookupCacheTy->setBody(ArrayType::get(WayTy, 4), NULL);
+
   memset(Functions, 0, sizeof(llvm::Function*) * SentinelEnd);
 }
 
@@ -76,3 +107,213 @@ Function *Runtime::Function(Fns Fn) {
   assert(F);
   return F;
 }
+
+const char *Runtime::GetFunctionName(Fns Fn) {
+  assert(Fn < SentinelEnd && "Invalid function index!");
+  return FunctionNames[Fn];
+}
+
+Constant *Runtime::GetFunction(Module &M, Fns Fn) {
+  return M.getOrInsertFunction(FunctionNames[Fn],
+                               Function(Fn)->getFunctionType());
+}
+
+Value *Runtime::EmitLookup(Module &M, BasicBlock **BB, Value *Dict,
+                           Value *Key) {
+  Type *Params[] = { PtrObjectTy, PtrObjectTy };
+  Constant *Fn = M.getOrInsertFunction("py_dict_lookup",
+                                       FunctionType::get(PtrObjectTy, Params,
+                                                         false /*VarArg*/));
+  IRBuilder<> IRB(*BB);
+  return IRB.CreateCall2(Fn, Dict, Key, "value");
+}
+
+Value *Runtime::EmitCachedLookup(Module &M, BasicBlock **BB, Value *Dict,
+                                 Value *Key) {
+  Type *Params[] = { PtrObjectTy, PtrObjectTy,
+                     PointerType::get(LookupCacheTy, 0) };
+  Constant *Miss = M.getOrInsertFunction("py_dict_lookup_cached",
+                                         FunctionType::get(PtrObjectTy, Params,
+                                                           false /*VarArg*/));
+  GlobalVariable *Cache =
+    new GlobalVariable(M, LookupCacheTy, false /*isConstant*/,
+                       GlobalValue::PrivateLinkage,
+                       Constant::getNullValue(LookupCacheTy), "lookup.cache");
+
+  llvm::Function *F = (*BB)->getParent();
+  BasicBlock *HitBB = BasicBlock::Create(Context, "lookup.hit", F);
+  BasicBlock *MissBB = BasicBlock::Create(Context, "lookup.miss", F);
+  BasicBlock *DoneBB = BasicBlock::Create(Context, "lookup.done", F);
+
+  // Compare the dict's version with that of the cache's first way.
+  IRBuilder<> IRB(*BB);
+  Value *D = IRB.CreateBitCast(Dict, PointerType::get(DictTy, 0));
+  Value *Version = IRB.CreateLoad(IRB.CreateStructGEP(D, DictVersionField),
+                                  "version");
+  Value *WayIdx[] = { IRB.getInt32(0), IRB.getInt32(0), IRB.getInt32(0) };
+  Value *Way = IRB.CreateInBoundsGEP(Cache, WayIdx);
+  Value *Cached = IRB.CreateLoad(IRB.CreateStructGEP(Way, 0),
+                                 "cached.version");
+  IRB.CreateCondBr(IRB.CreateICmpEQ(Version, Cached), HitBB, MissBB);
+
+  // Hit: the value is in the cached slot.
+  IRB.SetInsertPoint(HitBB);
+  Value *Entries = IRB.CreateLoad(IRB.CreateStructGEP(D, DictEntriesField),
+                                  "entries");
+  Value *SlotIdx[] = {
+    IRB.CreateLoad(IRB.CreateStructGEP(Way, 1), "slot"),
+    IRB.getInt32(DictEntryValueField)
+  };
+  Value *Hit = IRB.CreateLoad(IRB.CreateInBoundsGEP(Entries, SlotIdx),
+                              "value");
+  IRB.CreateBr(DoneBB);
+
+  // Miss: let the runtime look, and refill the cache.
+  IRB.SetInsertPoint(MissBB);
+  Value *Missed = IRB.CreateCall3(Miss, Dict, Key, Cache, "value");
+  IRB.CreateBr(DoneBB);
+
+  IRB.SetInsertPoint(DoneBB);
+  PHINode *PN = IRB.CreatePHI(PtrObjectTy, 2, "value");
+  PN->addIncoming(Hit, HitBB);
+  PN->addIncoming(Missed, MissBB);
+  *BB = DoneBB;
+  return PN;
+}
+
+IntegerType *Runtime::GetIntPtrTy(Module &M) const {
+  return TargetData(&M).getIntPtrType(Context);
+}
+
+/// GetModule - The Module BB is in.
+static Module &GetModule(BasicBlock *BB) {
+  return *BB->getParent()->getParent();
+}
+
+Value *Runtime::EmitIsSmallInt(BasicBlock *BB, Value *O) {
+  IRBuilder<> IRB(BB);
+  IntegerType *IntPtr = GetIntPtrTy(GetModule(BB));
+  Value *Tag = IRB.CreateAnd(IRB.CreatePtrToInt(O, IntPtr),
+                             ConstantInt::get(IntPtr, 1));
+  return IRB.CreateICmpNE(Tag, ConstantInt::get(IntPtr, 0), "is.small");
+}
+
+Value *Runtime::EmitUnboxSmallInt(BasicBlock *BB, Value *O) {
+  IRBuilder<> IRB(BB);
+  IntegerType *IntPtr = GetIntPtrTy(GetModule(BB));
+  Value *V = IRB.CreateAShr(IRB.CreatePtrToInt(O, IntPtr),
+                            ConstantInt::get(IntPtr, 1));
+  return IRB.CreateSExtOrBitCast(V, IRB.getInt64Ty(), "unboxed");
+}
+
+Value *Runtime::EmitBoxSmallInt(BasicBlock *BB, Value *V) {
+  IRBuilder<> IRB(BB);
+  IntegerType *IntPtr = GetIntPtrTy(GetModule(BB));
+  Value *One = ConstantInt::get(IntPtr, 1);
+  Value *Raw = IRB.CreateOr(IRB.CreateShl(IRB.CreateTruncOrBitCast(V, IntPtr),
+                                          One),
+                            One);
+  return IRB.CreateIntToPtr(Raw, PtrObjectTy, "boxed");
+}
+
+Value *Runtime::EmitIntArith(Module &M, BasicBlock **BB, Fns Op, Value *A,
+                             Value *B, BasicBlock **Slow) {
+  assert((Op == IntAdd || Op == IntSub || Op == IntMul) &&
+         "Not an int operation!");
+  Constant *SlowFn = GetFunction(M, Op);
+
+  llvm::Function *F = (*BB)->getParent();
+  BasicBlock *FastBB = BasicBlock::Create(Context, "int.fast", F);
+  BasicBlock *SlowBB = BasicBlock::Create(Context, "int.slow", F);
+  BasicBlock *DoneBB = BasicBlock::Create(Context, "int.done", F);
+
+  // Both are small ints if the low bit of both is set.
+  IRBuilder<> IRB(*BB);
+  IntegerType *IntPtr = GetIntPtrTy(M);
+  Value *One = ConstantInt::get(IntPtr, 1);
+  Value *RawA = IRB.CreatePtrToInt(A, IntPtr);
+  Value *RawB = IRB.CreatePtrToInt(B, IntPtr);
+  Value *Tags = IRB.CreateAnd(IRB.CreateAnd(RawA, RawB), One);
+  IRB.CreateCondBr(IRB.CreateICmpNE(Tags, ConstantInt::get(IntPtr, 0)),
+                   FastBB, SlowBB);
+
+  // Work on the encodings, 2a+1 and 2b+1, so that the result comes out
+  // encoded and the pointer-sized int overflows just when a small int
+  // would:
+  //   (2a+1) + (2b+1 - 1) = 2(a+b)+1
+  //   (2a+1) - (2b+1 - 1) = 2(a-b)+1
+  //   (2a+1 - 1) * ((2b+1) >> 1) + 1 = 2ab+1
+  IRB.SetInsertPoint(FastBB);
+  Intrinsic::ID ID;
+  Value *L = RawA, *R = IRB.CreateSub(RawB, One);
+  switch (Op) {
+  case IntAdd: ID = Intrinsic::sadd_with_overflow; break;
+  case IntSub: ID = Intrinsic::ssub_with_overflow; break;
+  default:
+    ID = Intrinsic::smul_with_overflow;
+    L = IRB.CreateSub(RawA, One);
+    R = IRB.CreateAShr(RawB, One);
+    break;
+  }
+  Type *Tys[] = { IntPtr };
+  Value *Pair = IRB.CreateCall2(Intrinsic::getDeclaration(&M, ID, Tys), L, R);
+  Value *Raw = IRB.CreateExtractValue(Pair, 0);
+  if (Op == IntMul)
+    Raw = IRB.CreateOr(Raw, One);
+  Value *Fast = IRB.CreateIntToPtr(Raw, PtrObjectTy, "int");
+  IRB.CreateCondBr(IRB.CreateExtractValue(Pair, 1), SlowBB, DoneBB);
+
+  // Slow: boxed ints, bools, or a result that needs boxing.
+  IRB.SetInsertPoint(SlowBB);
+  Value *SlowV = IRB.CreateCall2(SlowFn, A, B, "int");
+  IRB.CreateBr(DoneBB);
+
+  IRB.SetInsertPoint(DoneBB);
+  PHINode *PN = IRB.CreatePHI(PtrObjectTy, 2, "int");
+  PN->addIncoming(Fast, FastBB);
+  PN->addIncoming(SlowV, SlowBB);
+  *BB = DoneBB;
+  if (Slow)
+    *Slow = SlowBB;
+  return PN;
+}
+
+Value *Runtime::EmitCmp(Module &M, BasicBlock **BB, Value *A, Value *B,
+                        BasicBlock **Slow) {
+  llvm::Function *F = (*BB)->getParent();
+  BasicBlock *FastBB = BasicBlock::Create(Context, "cmp.fast", F);
+  BasicBlock *SlowBB = BasicBlock::Create(Context, "cmp.slow", F);
+  BasicBlock *DoneBB = BasicBlock::Create(Context, "cmp.done", F);
+
+  IRBuilder<> IRB(*BB);
+  IntegerType *IntPtr = GetIntPtrTy(M);
+  Value *RawA = IRB.CreatePtrToInt(A, IntPtr);
+  Value *RawB = IRB.CreatePtrToInt(B, IntPtr);
+  Value *Tags = IRB.CreateAnd(IRB.CreateAnd(RawA, RawB),
+                              ConstantInt::get(IntPtr, 1));
+  IRB.CreateCondBr(IRB.CreateICmpNE(Tags, ConstantInt::get(IntPtr, 0)),
+                   FastBB, SlowBB);
+
+  // The small ints -1, 0 and 1 are encoded as -1, 1 and 3.
+  IRB.SetInsertPoint(FastBB);
+  Value *Sign = IRB.CreateSelect(IRB.CreateICmpSGT(RawA, RawB),
+                                 ConstantInt::get(IntPtr, 3),
+                                 ConstantInt::get(IntPtr, 1));
+  Sign = IRB.CreateSelect(IRB.CreateICmpSLT(RawA, RawB),
+                          ConstantInt::getSigned(IntPtr, -1), Sign);
+  Value *Fast = IRB.CreateIntToPtr(Sign, PtrObjectTy, "cmp");
+  IRB.CreateBr(DoneBB);
+
+  IRB.SetInsertPoint(SlowBB);
+  Value *SlowV = IRB.CreateCall2(GetFunction(M, Cmp), A, B, "cmp");
+  IRB.CreateBr(DoneBB);
+
+  IRB.SetInsertPoint(DoneBB);
+  PHINode *PN = IRB.CreatePHI(PtrObjectTy, 2, "cmp");
+  PN->addIncoming(Fast, FastBB);
+  PN->addIncoming(SlowV, SlowBB);
+  *BB = DoneBB;
+  if (Slow)
+    *Slow = SlowBB;
+  return PN;
+}
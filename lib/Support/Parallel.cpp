@@ -0,0 +1,147 @@
+//===--- Parallel.cpp - Simple parallel loops -----------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements RunParallel and EventCount on top of pthreads.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Support/Parallel.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Atomic.h"
+#include <vector>
+
+#if defined(LLVM_MULTITHREADED) && LLVM_MULTITHREADED && !defined(_WIN32)
+#define PY_HAVE_PTHREADS 1
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+using namespace py;
+using namespace llvm;
+
+unsigned py::getHardwareConcurrency() {
+#if defined(PY_HAVE_PTHREADS) && defined(_SC_NPROCESSORS_ONLN)
+  long N = sysconf(_SC_NPROCESSORS_ONLN);
+  if (N > 0)
+    return (unsigned)N;
+#endif
+  return 1;
+}
+
+namespace {
+struct ParallelState {
+  void (*Fn)(void *Ctx, unsigned Idx);
+  void *Ctx;
+  unsigned NumTasks;
+  volatile sys::cas_flag Next;
+};
+}
+
+static void *ParallelWorker(void *Arg) {
+  ParallelState *S = static_cast<ParallelState*>(Arg);
+  while (true) {
+    unsigned Idx = sys::AtomicIncrement(&S->Next) - 1;
+    if (Idx >= S->NumTasks)
+      break;
+    S->Fn(S->Ctx, Idx);
+  }
+  return 0;
+}
+
+void py::RunParallel(unsigned NumTasks, unsigned NumThreads,
+                     void (*Fn)(void *Ctx, unsigned Idx), void *Ctx) {
+  ParallelState S;
+  S.Fn = Fn;
+  S.Ctx = Ctx;
+  S.NumTasks = NumTasks;
+  S.Next = 0;
+
+  if (NumThreads > NumTasks)
+    NumThreads = NumTasks;
+
+#ifdef PY_HAVE_PTHREADS
+  std::vector<pthread_t> Threads;
+  for (unsigned i = 1; i < NumThreads; ++i) {
+    pthread_t T;
+    // If we can't get another thread, the ones we have do the work.
+    if (pthread_create(&T, 0, ParallelWorker, &S) != 0)
+      break;
+    Threads.push_back(T);
+  }
+  ParallelWorker(&S);
+  for (unsigned i = 0, e = Threads.size(); i != e; ++i)
+    pthread_join(Threads[i], 0);
+#else
+  ParallelWorker(&S);
+#endif
+}
+
+namespace {
+struct EventCountImpl {
+  /// How many times notifyAll has been called.
+  unsigned Count;
+#ifdef PY_HAVE_PTHREADS
+  pthread_mutex_t Lock;
+  pthread_cond_t Changed;
+#endif
+};
+}
+
+EventCount::EventCount() {
+  EventCountImpl *E = new EventCountImpl();
+  E->Count = 0;
+#ifdef PY_HAVE_PTHREADS
+  pthread_mutex_init(&E->Lock, 0);
+  pthread_cond_init(&E->Changed, 0);
+#endif
+  Impl = E;
+}
+
+EventCount::~EventCount() {
+  EventCountImpl *E = static_cast<EventCountImpl*>(Impl);
+#ifdef PY_HAVE_PTHREADS
+  pthread_cond_destroy(&E->Changed);
+  pthread_mutex_destroy(&E->Lock);
+#endif
+  delete E;
+}
+
+unsigned EventCount::prepareWait() {
+  EventCountImpl *E = static_cast<EventCountImpl*>(Impl);
+#ifdef PY_HAVE_PTHREADS
+  pthread_mutex_lock(&E->Lock);
+  unsigned Key = E->Count;
+  pthread_mutex_unlock(&E->Lock);
+  return Key;
+#else
+  return E->Count;
+#endif
+}
+
+void EventCount::wait(unsigned Key) {
+#ifdef PY_HAVE_PTHREADS
+  EventCountImpl *E = static_cast<EventCountImpl*>(Impl);
+  pthread_mutex_lock(&E->Lock);
+  while (E->Count == Key)
+    pthread_cond_wait(&E->Changed, &E->Lock);
+  pthread_mutex_unlock(&E->Lock);
+#endif
+}
+
+void EventCount::notifyAll() {
+  EventCountImpl *E = static_cast<EventCountImpl*>(Impl);
+#ifdef PY_HAVE_PTHREADS
+  pthread_mutex_lock(&E->Lock);
+  ++E->Count;
+  pthread_cond_broadcast(&E->Changed);
+  pthread_mutex_unlock(&E->Lock);
+#else
+  ++E->Count;
+#endif
+}
@@ -0,0 +1,154 @@
+//===--- SourceFile.cpp - Loading source files for lexing -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements getSourceFile with mmap where it is available.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Support/SourceFile.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Process.h"
+#include <algorithm>
+#include <string>
+
+#if defined(LLVM_ON_UNIX)
+#define PY_HAVE_MMAP 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+using namespace py;
+using namespace llvm;
+
+#ifdef PY_HAVE_MMAP
+namespace {
+
+/// MappedSourceBuffer - A MemoryBuffer over a file mapping that extends at
+/// least one zero byte past the end of the file.
+class MappedSourceBuffer : public MemoryBuffer {
+  std::string Name;
+  void *Base;
+  size_t MapSize;
+
+public:
+  MappedSourceBuffer(StringRef Name, void *Base, size_t Size, size_t MapSize)
+    : Name(Name), Base(Base), MapSize(MapSize) {
+    const char *Start = static_cast<const char*>(Base);
+    init(Start, Start + Size, /*RequiresNullTerminator=*/true);
+  }
+
+  virtual ~MappedSourceBuffer() {
+    ::munmap(Base, MapSize);
+  }
+
+  virtual const char *getBufferIdentifier() const {
+    return Name.c_str();
+  }
+
+  virtual BufferKind getBufferKind() const {
+    return MemoryBuffer_MMap;
+  }
+};
+
+}
+
+/// MapFile - Map the regular file open on FD, Size bytes long, with a zero
+/// byte after it. Returns null and sets errno on failure.
+static void *MapFile(int FD, size_t Size, size_t &MapSize) {
+  size_t PageSize = sys::Process::GetPageSize();
+  // Round past the end of the file, so there is always at least one byte of
+  // zeros after it.
+  MapSize = (Size / PageSize + 1) * PageSize;
+
+  // Reserve the whole range as zero pages, then map the file over the front
+  // of it. The kernel zero-fills the part of the last file page past EOF;
+  // if the file ends on a page boundary, the reserved page after it is the
+  // sentinel.
+  void *Base = ::mmap(0, MapSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+                      -1, 0);
+  if (Base == MAP_FAILED)
+    return 0;
+  if (Size != 0 &&
+      ::mmap(Base, Size, PROT_READ, MAP_PRIVATE | MAP_FIXED, FD, 0)
+        == MAP_FAILED) {
+    int SavedErrno = errno;
+    ::munmap(Base, MapSize);
+    errno = SavedErrno;
+    return 0;
+  }
+#ifdef MADV_SEQUENTIAL
+  // The lexer reads front to back exactly once.
+  ::madvise(Base, MapSize, MADV_SEQUENTIAL);
+#endif
+  return Base;
+}
+#endif
+
+error_code py::getSourceFile(StringRef Filename,
+                             OwningPtr<MemoryBuffer> &Result) {
+#ifdef PY_HAVE_MMAP
+  if (Filename != "-") {
+    std::string Path(Filename);
+    int FD = ::open(Path.c_str(), O_RDONLY);
+    if (FD == -1)
+      return error_code(errno, posix_category());
+
+    struct stat Stat;
+    if (::fstat(FD, &Stat) == -1) {
+      int SavedErrno = errno;
+      ::close(FD);
+      return error_code(SavedErrno, posix_category());
+    }
+
+    // Pipes, devices and the like fall through to a plain read.
+    if (S_ISREG(Stat.st_mode)) {
+      size_t Size = static_cast<size_t>(Stat.st_size);
+      size_t MapSize;
+      if (void *Base = MapFile(FD, Size, MapSize)) {
+        ::close(FD);
+        Result.reset(new MappedSourceBuffer(Filename, Base, Size, MapSize));
+        return error_code::success();
+      }
+    }
+    ::close(FD);
+  }
+#endif
+  return MemoryBuffer::getFileOrSTDIN(Filename, Result);
+}
+
+error_code py::collectSourceFiles(StringRef Path,
+                                  std::vector<std::string> &Files) {
+  bool IsDirectory = false;
+  if (sys::fs::is_directory(Path, IsDirectory) || !IsDirectory) {
+    Files.push_back(Path.str());
+    return error_code::success();
+  }
+
+  size_t First = Files.size();
+  error_code ec;
+  for (sys::fs::recursive_directory_iterator I(Path, ec), E;
+       I != E && !ec; I.increment(ec)) {
+    StringRef File = I->path();
+    bool IsFile = false;
+    if (File.endswith(".py") && !sys::fs::is_regular_file(File, IsFile) &&
+        IsFile)
+      Files.push_back(File.str());
+  }
+  if (ec)
+    return ec;
+  std::sort(Files.begin() + First, Files.end());
+  return error_code::success();
+}
@@ -0,0 +1,171 @@
+//===--- HoistRuntimeCalls.cpp - Hoist loop-invariant runtime calls -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the py-licm pass. LICM leaves runtime calls alone,
+// since they are opaque. The ones hoisted here are known to return the same
+// thing every time through the loop, and hoisting them is safe even where
+// the loop body wouldn't have reached them:
+//
+//  - py_name returns a borrowed str, the same one for the same slot, so a
+//    call with invariant arguments just moves.
+//  - py_getlocals and py_getglobals return the same dict throughout an
+//    activation. The first of each in the loop moves to the preheader,
+//    later ones use it, and the releases in the loop go, replaced by one on
+//    each exit. That needs dedicated exits, which loop-simplify provides,
+//    and a loop that can only be left through them.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "py-licm"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/LoopPass.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Transforms/Scalar.h"
+
+#include "py/Transforms/Passes.h"
+#include "RuntimeCalls.h"
+
+using namespace llvm;
+using namespace py;
+
+STATISTIC(NumNamesHoisted, "Number of py_name calls hoisted");
+STATISTIC(NumNamespacesHoisted, "Number of namespace calls hoisted");
+STATISTIC(NumNamespacesMerged, "Number of namespace calls merged in loops");
+
+namespace {
+/// HoistRuntimeCalls - The py-licm pass.
+class HoistRuntimeCalls : public LoopPass {
+  bool hoistNamespaces(Loop *L, SmallVectorImpl<CallInst*> &Calls);
+
+public:
+  static char ID;
+  HoistRuntimeCalls() : LoopPass(ID) {
+    initializeHoistRuntimeCallsPass(*PassRegistry::getPassRegistry());
+  }
+
+  virtual bool runOnLoop(Loop *L, LPPassManager &LPM);
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.setPreservesCFG();
+    AU.addRequired<DominatorTree>();
+    AU.addRequired<LoopInfo>();
+    AU.addRequiredID(LoopSimplifyID);
+    AU.addPreserved<DominatorTree>();
+    AU.addPreserved<LoopInfo>();
+    AU.addPreservedID(LoopSimplifyID);
+  }
+};
+}
+
+char HoistRuntimeCalls::ID = 0;
+INITIALIZE_PASS_BEGIN(HoistRuntimeCalls, "py-licm",
+                      "Hoist loop-invariant Python runtime calls",
+                      false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTree)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_PASS_DEPENDENCY(LoopSimplify)
+INITIALIZE_PASS_END(HoistRuntimeCalls, "py-licm",
+                    "Hoist loop-invariant Python runtime calls",
+                    false, false)
+
+Pass *py::createHoistRuntimeCallsPass() {
+  return new HoistRuntimeCalls();
+}
+
+bool HoistRuntimeCalls::runOnLoop(Loop *L, LPPassManager &LPM) {
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!Preheader)
+    return false;
+
+  // Only the blocks of L itself; those of inner loops were done with them,
+  // so whatever could leave them already has.
+  LoopInfo &LI = getAnalysis<LoopInfo>();
+  SmallVector<CallInst*, 8> Namespaces;
+  bool Changed = false;
+  for (Loop::block_iterator BI = L->block_begin(), BE = L->block_end();
+       BI != BE; ++BI) {
+    if (LI.getLoopFor(*BI) != L)
+      continue;
+    for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end(); I != E;) {
+      Instruction *Inst = I++;
+      if (isNamespaceCall(Inst)) {
+        Namespaces.push_back(cast<CallInst>(Inst));
+      } else if (getRuntimeCallee(Inst) == "py_name" &&
+                 L->hasLoopInvariantOperands(Inst)) {
+        Inst->moveBefore(Preheader->getTerminator());
+        ++NumNamesHoisted;
+        Changed = true;
+      }
+    }
+  }
+
+  if (!Namespaces.empty())
+    Changed |= hoistNamespaces(L, Namespaces);
+  return Changed;
+}
+
+/// hoistNamespaces - Hoist the namespace calls Calls, made in L, if they
+/// can all be, and return whether they were.
+bool HoistRuntimeCalls::hoistNamespaces(Loop *L,
+                                        SmallVectorImpl<CallInst*> &Calls) {
+  if (!L->hasDedicatedExits())
+    return false;
+  // A loop that returns from inside would skip the releases on the exits.
+  // Leaving by unreachable is fine: that was py_unbound or the like.
+  for (Loop::block_iterator BI = L->block_begin(), BE = L->block_end();
+       BI != BE; ++BI) {
+    TerminatorInst *T = (*BI)->getTerminator();
+    if (T->getNumSuccessors() == 0 && !isa<UnreachableInst>(T))
+      return false;
+  }
+
+  SmallVector<SmallVector<CallInst*, 4>, 8> Releases(Calls.size());
+  for (unsigned i = 0, e = Calls.size(); i != e; ++i)
+    if (!findReleases(Calls[i], Releases[i]))
+      return false;
+
+  BasicBlock *Preheader = L->getLoopPreheader();
+  SmallVector<BasicBlock*, 4> Exits;
+  L->getUniqueExitBlocks(Exits);
+  Module *M = Preheader->getParent()->getParent();
+  Type *ObjectPtrTy = Calls[0]->getType();
+  Constant *DecRef = M->getOrInsertFunction("py_decref",
+                                            Type::getVoidTy(M->getContext()),
+                                            ObjectPtrTy, NULL);
+
+  // The call that now stands for all of those of its callee.
+  StringMap<CallInst*> Hoisted;
+  for (unsigned i = 0, e = Calls.size(); i != e; ++i) {
+    CallInst *C = Calls[i];
+    for (unsigned j = 0, je = Releases[i].size(); j != je; ++j)
+      Releases[i][j]->eraseFromParent();
+
+    CallInst *&H = Hoisted[getRuntimeCallee(C)];
+    if (H) {
+      C->replaceAllUsesWith(H);
+      C->eraseFromParent();
+      ++NumNamespacesMerged;
+      continue;
+    }
+    H = C;
+    C->moveBefore(Preheader->getTerminator());
+    for (unsigned j = 0, je = Exits.size(); j != je; ++j)
+      CallInst::Create(DecRef, C, "", Exits[j]->getFirstInsertionPt());
+    ++NumNamespacesHoisted;
+  }
+  return true;
+}
@@ -0,0 +1,113 @@
+//===--- NamespaceCalls.cpp - Remove redundant namespace calls ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the py-namespaces pass. Blocks are visited in depth
+// first order, so a call is seen after every call that dominates it. A call
+// is removed with its releases, which leaves the references of the calls
+// that stay balanced whatever paths the releases were on.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "py-namespaces"
+#include "llvm/Function.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/Dominators.h"
+
+#include "py/Transforms/Passes.h"
+#include "RuntimeCalls.h"
+
+using namespace llvm;
+using namespace py;
+
+STATISTIC(NumMerged, "Number of namespace calls merged with an earlier one");
+STATISTIC(NumDead, "Number of namespace calls only released");
+
+namespace {
+/// NamespaceCalls - The py-namespaces pass.
+class NamespaceCalls : public FunctionPass {
+public:
+  static char ID;
+  NamespaceCalls() : FunctionPass(ID) {
+    initializeNamespaceCallsPass(*PassRegistry::getPassRegistry());
+  }
+
+  virtual bool runOnFunction(Function &F);
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.setPreservesCFG();
+    AU.addRequired<DominatorTree>();
+  }
+};
+}
+
+char NamespaceCalls::ID = 0;
+INITIALIZE_PASS_BEGIN(NamespaceCalls, "py-namespaces",
+                      "Remove redundant Python namespace calls", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTree)
+INITIALIZE_PASS_END(NamespaceCalls, "py-namespaces",
+                    "Remove redundant Python namespace calls", false, false)
+
+FunctionPass *py::createNamespaceCallsPass() {
+  return new NamespaceCalls();
+}
+
+bool NamespaceCalls::runOnFunction(Function &F) {
+  DominatorTree &DT = getAnalysis<DominatorTree>();
+
+  SmallVector<CallInst*, 8> Calls;
+  for (df_iterator<BasicBlock*> BB = df_begin(&F.getEntryBlock()),
+       BE = df_end(&F.getEntryBlock()); BB != BE; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+      if (isNamespaceCall(I))
+        Calls.push_back(cast<CallInst>(I));
+  if (Calls.empty())
+    return false;
+
+  // The calls kept so far, by callee.
+  StringMap<SmallVector<CallInst*, 4> > Kept;
+  bool Changed = false;
+  for (unsigned i = 0, e = Calls.size(); i != e; ++i) {
+    CallInst *C = Calls[i];
+    SmallVector<CallInst*, 4> &Same = Kept[getRuntimeCallee(C)];
+
+    SmallVector<CallInst*, 4> Releases;
+    if (!findReleases(C, Releases)) {
+      Same.push_back(C);
+      continue;
+    }
+
+    CallInst *Dom = 0;
+    for (unsigned j = 0, je = Same.size(); j != je && !Dom; ++j)
+      if (DT.dominates(Same[j], C))
+        Dom = Same[j];
+    bool OnlyReleased = C->getNumUses() == Releases.size();
+    if (!Dom && !OnlyReleased) {
+      Same.push_back(C);
+      continue;
+    }
+
+    for (unsigned j = 0, je = Releases.size(); j != je; ++j)
+      Releases[j]->eraseFromParent();
+    if (Dom) {
+      C->replaceAllUsesWith(Dom);
+      ++NumMerged;
+    } else {
+      ++NumDead;
+    }
+    C->eraseFromParent();
+    Changed = true;
+  }
+  return Changed;
+}
@@ -0,0 +1,123 @@
+//===--- Pipeline.cpp - The passes run on generated code ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements Pipeline, and registers the Python passes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/InitializePasses.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/PassManager.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+
+#include "py/Transforms/Passes.h"
+#include "py/Transforms/Pipeline.h"
+
+using namespace llvm;
+using namespace py;
+
+void py::initializePyPasses(PassRegistry &Registry) {
+  initializeNamespaceCallsPass(Registry);
+  initializeHoistRuntimeCallsPass(Registry);
+  initializeStackObjectsPass(Registry);
+}
+
+/// InitializeRegistry - Register every pass a custom pipeline could name.
+static PassRegistry &InitializeRegistry() {
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeScalarOpts(Registry);
+  initializeIPO(Registry);
+  initializeAnalysis(Registry);
+  initializeIPA(Registry);
+  initializeTransformUtils(Registry);
+  initializeInstCombine(Registry);
+  initializeInstrumentation(Registry);
+  initializePyPasses(Registry);
+  return Registry;
+}
+
+bool Pipeline::parse(StringRef Spec, std::string &Err) {
+  PassRegistry &Registry = InitializeRegistry();
+  std::vector<const PassInfo*> Parsed;
+  while (!Spec.empty()) {
+    std::pair<StringRef, StringRef> Split = Spec.split(',');
+    StringRef Name = Split.first.trim();
+    Spec = Split.second;
+    if (Name.empty())
+      continue;
+    const PassInfo *PI = Registry.getPassInfo(Name);
+    if (!PI || !PI->getNormalCtor()) {
+      Err = "unknown pass '" + Name.str() + "'";
+      return false;
+    }
+    Parsed.push_back(PI);
+  }
+  if (Parsed.empty()) {
+    Err = "no passes given";
+    return false;
+  }
+  Passes.swap(Parsed);
+  return true;
+}
+
+static void AddNamespaceCalls(const PassManagerBuilder &Builder,
+                              PassManagerBase &PM) {
+  PM.add(createNamespaceCallsPass());
+}
+
+static void AddHoistRuntimeCalls(const PassManagerBuilder &Builder,
+                                 PassManagerBase &PM) {
+  PM.add(createHoistRuntimeCallsPass());
+}
+
+static void AddStackObjects(const PassManagerBuilder &Builder,
+                            PassManagerBase &PM) {
+  PM.add(createStackObjectsPass());
+}
+
+void Pipeline::run(Module &M) const {
+  if (isCustom()) {
+    PassManager PM;
+    for (unsigned i = 0, e = Passes.size(); i != e; ++i)
+      PM.add(Passes[i]->createPass());
+    PM.run(M);
+    return;
+  }
+  if (!OptLevel)
+    return;
+
+  PassManagerBuilder Builder;
+  Builder.OptLevel = OptLevel;
+  if (OptLevel > 1)
+    Builder.Inliner = createFunctionInliningPass(OptLevel > 2 ? 275 : 225);
+  Builder.addExtension(PassManagerBuilder::EP_EarlyAsPossible,
+                       AddNamespaceCalls);
+  Builder.addExtension(PassManagerBuilder::EP_LoopOptimizerEnd,
+                       AddHoistRuntimeCalls);
+  Builder.addExtension(PassManagerBuilder::EP_ScalarOptimizerLate,
+                       AddNamespaceCalls);
+  Builder.addExtension(PassManagerBuilder::EP_ScalarOptimizerLate,
+                       AddStackObjects);
+
+  FunctionPassManager FPM(&M);
+  Builder.populateFunctionPassManager(FPM);
+  FPM.doInitialization();
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    if (!F->isDeclaration())
+      FPM.run(*F);
+  FPM.doFinalization();
+
+  PassManager MPM;
+  Builder.populateModulePassManager(MPM);
+  MPM.run(M);
+}
@@ -0,0 +1,103 @@
+//===--- RuntimeCalls.cpp - What runtime calls do -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements what the Python passes know about runtime calls.
+// Every runtime function returning an object returns a new reference, and
+// borrows its arguments (runtime/pyrt.h).
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+
+#include "py/Runtime/Runtime.h"
+#include "RuntimeCalls.h"
+
+using namespace llvm;
+using namespace py;
+
+StringRef py::getRuntimeCallee(const Instruction *I) {
+  const CallInst *CI = dyn_cast<CallInst>(I);
+  if (!CI)
+    return StringRef();
+  const Function *F = CI->getCalledFunction();
+  if (!F || !F->isDeclaration() || !F->getName().startswith("py_"))
+    return StringRef();
+  return F->getName();
+}
+
+bool py::isNamespaceCall(const Instruction *I) {
+  StringRef Callee = getRuntimeCallee(I);
+  return Callee == Runtime::GetFunctionName(Runtime::GetLocals) ||
+         Callee == Runtime::GetFunctionName(Runtime::GetGlobals);
+}
+
+namespace {
+/// BorrowInfo - The arguments a runtime function only looks at.
+struct BorrowInfo {
+  const char *Name;
+  /// Bit I is set if argument I is borrowed.
+  unsigned Args;
+};
+}
+
+static const BorrowInfo Borrowers[] = {
+  { "py_seq_item", 1 },
+  { "py_seq_size", 1 },
+  { "py_int_value", 1 },
+  { "py_int_add", 3 },
+  { "py_int_sub", 3 },
+  { "py_int_mul", 3 },
+  { "py_cmp", 3 },
+  { "py_list_append", 1 },
+  { "py_cell_get", 1 },
+  { "py_dict_get", 3 },
+  { "py_dict_lookup", 3 },
+  { "py_dict_lookup_cached", 3 }
+};
+
+bool py::isBorrowedBy(const CallInst *CI, unsigned ArgNo) {
+  StringRef Callee = getRuntimeCallee(CI);
+  for (unsigned i = 0, e = sizeof(Borrowers) / sizeof(Borrowers[0]);
+       i != e; ++i)
+    if (Callee == Borrowers[i].Name)
+      return ArgNo < 32 && (Borrowers[i].Args & (1U << ArgNo));
+  return false;
+}
+
+bool py::findReleases(Value *V, SmallVectorImpl<CallInst*> &Releases) {
+  // V itself, and pointers derived from it.
+  SmallVector<Value*, 8> Worklist(1, V);
+  while (!Worklist.empty()) {
+    Value *P = Worklist.pop_back_val();
+    for (Value::use_iterator UI = P->use_begin(), E = P->use_end();
+         UI != E; ++UI) {
+      Instruction *U = dyn_cast<Instruction>(*UI);
+      if (!U)
+        return false;
+      if (isa<BitCastInst>(U) || isa<GetElementPtrInst>(U)) {
+        Worklist.push_back(U);
+        continue;
+      }
+      if (isa<LoadInst>(U) || isa<ICmpInst>(U) || isa<PtrToIntInst>(U))
+        continue;
+      if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
+        if (SI->getValueOperand() == P)
+          return false;
+        continue;
+      }
+      StringRef Callee = getRuntimeCallee(U);
+      if (Callee.empty())
+        return false;
+      if (Callee == "py_decref" || Callee == "py_xdecref")
+        Releases.push_back(cast<CallInst>(U));
+    }
+  }
+  return true;
+}
@@ -0,0 +1,49 @@
+//===--- RuntimeCalls.h - What runtime calls do -----------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file declares what the Python passes know about calls to the
+//  runtime, by the names runtime/pyrt.h gives its functions.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _TRANSFORMS_RUNTIMECALLS_H
+#define _TRANSFORMS_RUNTIMECALLS_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+  class CallInst;
+  class Instruction;
+  class Value;
+}
+
+namespace py {
+
+/// getRuntimeCallee - If I is a direct call to a runtime function, return
+/// the function's name; otherwise return an empty string.
+llvm::StringRef getRuntimeCallee(const llvm::Instruction *I);
+
+/// isNamespaceCall - Whether I is a call to py_getlocals or py_getglobals.
+bool isNamespaceCall(const llvm::Instruction *I);
+
+/// isBorrowedBy - Whether the runtime call CI only looks at its argument
+/// ArgNo while it runs, neither keeping nor releasing a reference to it.
+bool isBorrowedBy(const llvm::CallInst *CI, unsigned ArgNo);
+
+/// findReleases - Collect into Releases the py_decref and py_xdecref calls
+/// of the new reference V. Returns false if V could end up owned by
+/// anything else: stored, returned, merged with another value, or passed
+/// to a function that isn't the runtime's, which borrows its arguments.
+bool findReleases(llvm::Value *V,
+                  llvm::SmallVectorImpl<llvm::CallInst*> &Releases);
+
+}
+
+#endif
@@ -0,0 +1,283 @@
+//===--- StackObjects.cpp - Keep short-lived objects off the heap ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the py-stack-objects pass. An object made by
+// py_int_new, py_tuple_new or py_list_new doesn't escape if everything that
+// uses it is a runtime call that borrows it (RuntimeCalls.h), a release, or
+// a comparison, of the object or of its masked address. Such an object
+// can't outlive the activation that made it: nothing but the activation
+// has a reference to it.
+//
+// An int only asked for its value, and a tuple of constant size only asked
+// for its size and for items at constant indices, are replaced by what
+// they hold. Any other object that doesn't escape is made in a slot of the
+// function's frame instead, by the runtime's py_*_init functions; releasing
+// its last reference then releases what it holds, and frees nothing.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "py-stack-objects"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/IRBuilder.h"
+
+#include "py/Transforms/Passes.h"
+#include "RuntimeCalls.h"
+#include "pyrt.h"
+
+using namespace llvm;
+using namespace py;
+
+STATISTIC(NumScalarized, "Number of objects replaced by what they hold");
+STATISTIC(NumOnStack, "Number of objects made in the stack frame");
+
+/// MaxStackTupleSize - The most items a tuple made in the frame can have.
+static const unsigned MaxStackTupleSize = 16;
+
+namespace {
+/// ObjectUses - The uses of an object that doesn't escape.
+struct ObjectUses {
+  /// The py_decref and py_xdecref calls.
+  SmallVector<CallInst*, 4> Releases;
+  /// The runtime calls that borrow it.
+  SmallVector<CallInst*, 8> Borrows;
+  /// Whether anything else, a comparison, looks at it.
+  bool Compared;
+
+  ObjectUses() : Compared(false) {}
+};
+
+/// StackObjects - The py-stack-objects pass.
+class StackObjects : public FunctionPass {
+  bool scalarizeInt(CallInst *C, ObjectUses &Uses);
+  bool scalarizeTuple(CallInst *C, ObjectUses &Uses);
+  void moveToStack(CallInst *C, StringRef InitName, unsigned Bytes);
+
+public:
+  static char ID;
+  StackObjects() : FunctionPass(ID) {
+    initializeStackObjectsPass(*PassRegistry::getPassRegistry());
+  }
+
+  virtual bool runOnFunction(Function &F);
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.setPreservesCFG();
+  }
+};
+}
+
+char StackObjects::ID = 0;
+INITIALIZE_PASS(StackObjects, "py-stack-objects",
+                "Keep short-lived Python objects off the heap", false, false)
+
+FunctionPass *py::createStackObjectsPass() {
+  return new StackObjects();
+}
+
+/// isOnlyCompared - Whether the address V, a ptrtoint of an object, only
+/// reaches comparisons, directly or through masks such as the small-int
+/// tag test's. Anything else could make a pointer of it again, or keep it.
+static bool isOnlyCompared(Value *V) {
+  for (Value::use_iterator UI = V->use_begin(), E = V->use_end();
+       UI != E; ++UI) {
+    if (isa<ICmpInst>(*UI))
+      continue;
+    BinaryOperator *BO = dyn_cast<BinaryOperator>(*UI);
+    if (!BO || BO->getOpcode() != Instruction::And || !isOnlyCompared(BO))
+      return false;
+  }
+  return true;
+}
+
+/// findUses - Collect the uses of the new object O into Uses. Returns false
+/// if O escapes.
+static bool findUses(CallInst *O, ObjectUses &Uses) {
+  for (Value::use_iterator UI = O->use_begin(), E = O->use_end();
+       UI != E; ++UI) {
+    if (isa<ICmpInst>(*UI)) {
+      Uses.Compared = true;
+      continue;
+    }
+    if (PtrToIntInst *P = dyn_cast<PtrToIntInst>(*UI)) {
+      if (!isOnlyCompared(P))
+        return false;
+      Uses.Compared = true;
+      continue;
+    }
+    CallInst *CI = dyn_cast<CallInst>(*UI);
+    if (!CI)
+      return false;
+    StringRef Callee = getRuntimeCallee(CI);
+    if (Callee == "py_decref" || Callee == "py_xdecref") {
+      Uses.Releases.push_back(CI);
+      continue;
+    }
+    for (unsigned i = 0, e = CI->getNumArgOperands(); i != e; ++i)
+      if (CI->getArgOperand(i) == O && !isBorrowedBy(CI, i))
+        return false;
+    // A call passing O twice is only recorded once.
+    if (Uses.Borrows.empty() || Uses.Borrows.back() != CI)
+      Uses.Borrows.push_back(CI);
+  }
+  return true;
+}
+
+bool StackObjects::scalarizeInt(CallInst *C, ObjectUses &Uses) {
+  if (Uses.Compared)
+    return false;
+  Value *V = C->getArgOperand(0);
+  for (unsigned i = 0, e = Uses.Borrows.size(); i != e; ++i) {
+    CallInst *B = Uses.Borrows[i];
+    if (getRuntimeCallee(B) != "py_int_value" || B->getType() != V->getType())
+      return false;
+  }
+
+  for (unsigned i = 0, e = Uses.Borrows.size(); i != e; ++i) {
+    Uses.Borrows[i]->replaceAllUsesWith(V);
+    Uses.Borrows[i]->eraseFromParent();
+  }
+  for (unsigned i = 0, e = Uses.Releases.size(); i != e; ++i)
+    Uses.Releases[i]->eraseFromParent();
+  C->eraseFromParent();
+  ++NumScalarized;
+  return true;
+}
+
+bool StackObjects::scalarizeTuple(CallInst *C, ObjectUses &Uses) {
+  ConstantInt *Size = dyn_cast<ConstantInt>(C->getArgOperand(0));
+  if (!Size || Uses.Compared)
+    return false;
+  uint64_t N = Size->getZExtValue();
+  if (N > MaxStackTupleSize)
+    return false;
+  Value *Items = C->getArgOperand(1);
+  for (unsigned i = 0, e = Uses.Borrows.size(); i != e; ++i) {
+    CallInst *B = Uses.Borrows[i];
+    StringRef Callee = getRuntimeCallee(B);
+    if (Callee == "py_seq_size")
+      continue;
+    if (Callee != "py_seq_item" || B->getType() != C->getType())
+      return false;
+    ConstantInt *Index = dyn_cast<ConstantInt>(B->getArgOperand(1));
+    if (!Index || Index->getZExtValue() >= N)
+      return false;
+  }
+
+  // The tuple's references to its items become the function's own.
+  Module *M = C->getParent()->getParent()->getParent();
+  Type *VoidTy = Type::getVoidTy(M->getContext());
+  Constant *IncRef = M->getOrInsertFunction("py_incref", VoidTy,
+                                            C->getType(), NULL);
+  Constant *DecRef = M->getOrInsertFunction("py_decref", VoidTy,
+                                            C->getType(), NULL);
+  IRBuilder<> IRB(C);
+  SmallVector<Value*, 8> Loaded;
+  for (unsigned i = 0; i != N; ++i) {
+    Value *Item = IRB.CreateLoad(IRB.CreateConstGEP1_32(Items, i), "item");
+    IRB.CreateCall(IncRef, Item);
+    Loaded.push_back(Item);
+  }
+
+  for (unsigned i = 0, e = Uses.Borrows.size(); i != e; ++i) {
+    CallInst *B = Uses.Borrows[i];
+    if (getRuntimeCallee(B) == "py_seq_size")
+      B->replaceAllUsesWith(ConstantInt::get(B->getType(), N));
+    else
+      B->replaceAllUsesWith(
+        Loaded[cast<ConstantInt>(B->getArgOperand(1))->getZExtValue()]);
+    B->eraseFromParent();
+  }
+  for (unsigned i = 0, e = Uses.Releases.size(); i != e; ++i) {
+    CallInst *R = Uses.Releases[i];
+    IRB.SetInsertPoint(R);
+    for (unsigned j = 0; j != N; ++j)
+      IRB.CreateCall(DecRef, Loaded[j]);
+    R->eraseFromParent();
+  }
+  C->eraseFromParent();
+  ++NumScalarized;
+  return true;
+}
+
+void StackObjects::moveToStack(CallInst *C, StringRef InitName,
+                               unsigned Bytes) {
+  Function *F = C->getParent()->getParent();
+  Module *M = F->getParent();
+  LLVMContext &Ctx = M->getContext();
+
+  // In the entry block, so that the slot is allocated once however often C
+  // runs: the object of one run is dead by the next, as nothing else has a
+  // reference to it.
+  Type *SlotTy = ArrayType::get(Type::getInt64Ty(Ctx), (Bytes + 7) / 8);
+  AllocaInst *Slot = new AllocaInst(SlotTy, "obj.slot",
+                                    &F->getEntryBlock().front());
+  Type *Int8PtrTy = Type::getInt8PtrTy(Ctx);
+  Value *Mem = new BitCastInst(Slot, Int8PtrTy, "", C);
+
+  SmallVector<Type*, 4> Params(1, Int8PtrTy);
+  SmallVector<Value*, 4> Args(1, Mem);
+  for (unsigned i = 0, e = C->getNumArgOperands(); i != e; ++i) {
+    Params.push_back(C->getArgOperand(i)->getType());
+    Args.push_back(C->getArgOperand(i));
+  }
+  Constant *Init = M->getOrInsertFunction(
+    InitName, FunctionType::get(C->getType(), Params, false /*VarArg*/));
+  CallInst *NewC = CallInst::Create(Init, Args, "", C);
+  NewC->takeName(C);
+  C->replaceAllUsesWith(NewC);
+  C->eraseFromParent();
+  ++NumOnStack;
+}
+
+bool StackObjects::runOnFunction(Function &F) {
+  SmallVector<CallInst*, 16> News;
+  for (Function::iterator BB = F.begin(), BE = F.end(); BB != BE; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+      StringRef Callee = getRuntimeCallee(I);
+      if (Callee == "py_int_new" || Callee == "py_tuple_new" ||
+          Callee == "py_list_new")
+        News.push_back(cast<CallInst>(I));
+    }
+
+  bool Changed = false;
+  for (unsigned i = 0, e = News.size(); i != e; ++i) {
+    CallInst *C = News[i];
+    ObjectUses Uses;
+    if (!findUses(C, Uses))
+      continue;
+
+    StringRef Callee = getRuntimeCallee(C);
+    if (Callee == "py_int_new") {
+      if (!scalarizeInt(C, Uses))
+        moveToStack(C, "py_int_init", PY_INT_STACK_BYTES);
+    } else if (Callee == "py_tuple_new") {
+      if (scalarizeTuple(C, Uses)) {
+        Changed = true;
+        continue;
+      }
+      ConstantInt *Size = dyn_cast<ConstantInt>(C->getArgOperand(0));
+      if (!Size || Size->getZExtValue() > MaxStackTupleSize)
+        continue;
+      moveToStack(C, "py_tuple_init",
+                  PY_TUPLE_STACK_BYTES(Size->getZExtValue()));
+    } else {
+      moveToStack(C, "py_list_init", PY_LIST_STACK_BYTES);
+    }
+    Changed = true;
+  }
+  return Changed;
+}
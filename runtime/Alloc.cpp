@@ -0,0 +1,189 @@
+//===--- Alloc.cpp - Object allocator and profiling counters --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Objects of up to MaxPooledSize bytes come from per-size-class free lists,
+// refilled a chunk at a time, so allocating or freeing one is a few
+// instructions. Larger objects go to malloc.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Object.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace pyrt;
+
+namespace {
+/// FreeBlock - A free block of a size class, threaded through its memory.
+struct FreeBlock {
+  FreeBlock *Next;
+};
+}
+
+static const size_t ClassSizes[] = { 16, 32, 48, 64, 96, 128, 192, 256 };
+static const unsigned NumClasses = sizeof(ClassSizes) / sizeof(ClassSizes[0]);
+static const size_t MaxPooledSize = 256;
+/// The SizeClass of objects that didn't come from a pool.
+static const uint8_t UnpooledClass = 0xFF;
+/// Memory is taken from malloc this much at a time and never given back.
+static const size_t ChunkSize = 64 * 1024;
+
+/// ClassForSize[(Size + 15) / 16] - The smallest class that fits Size bytes.
+static const uint8_t ClassForSize[MaxPooledSize / 16 + 1] = {
+  0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7
+};
+/// Unpooled objects are preceded by their size, padded to keep them aligned.
+static const size_t UnpooledHeader = 16;
+static FreeBlock *FreeLists[NumClasses];
+
+static py_counters Counters;
+static py_alloc_hook AllocHook;
+static void *AllocHookData;
+static py_call_hook CallHook;
+static void *CallHookData;
+static py_tier_hook TierHook;
+static void *TierHookData;
+
+void pyrt::fatal(const char *Fmt, ...) {
+  va_list Args;
+  va_start(Args, Fmt);
+  std::fputs("pyrt: ", stderr);
+  std::vfprintf(stderr, Fmt, Args);
+  std::fputc('\n', stderr);
+  va_end(Args);
+  std::abort();
+}
+
+/// refill - Carve a new chunk into blocks of class C.
+static void refill(unsigned C) {
+  size_t Size = ClassSizes[C];
+  char *Chunk = static_cast<char*>(std::malloc(ChunkSize));
+  if (!Chunk)
+    fatal("out of memory");
+  // Push the blocks in reverse, so they are handed out in address order.
+  for (size_t N = ChunkSize / Size; N != 0; --N) {
+    FreeBlock *B = reinterpret_cast<FreeBlock*>(Chunk + (N - 1) * Size);
+    B->Next = FreeLists[C];
+    FreeLists[C] = B;
+  }
+}
+
+PythonObject *pyrt::allocObject(TypeId T, size_t Size) {
+  PythonObject *O;
+  uint8_t C;
+  size_t Allocated;
+  if (Size <= MaxPooledSize) {
+    C = ClassForSize[(Size + 15) / 16];
+    if (!FreeLists[C])
+      refill(C);
+    FreeBlock *B = FreeLists[C];
+    FreeLists[C] = B->Next;
+    O = reinterpret_cast<PythonObject*>(B);
+    Allocated = ClassSizes[C];
+  } else {
+    char *P = static_cast<char*>(std::malloc(UnpooledHeader + Size));
+    if (!P)
+      fatal("out of memory");
+    *reinterpret_cast<size_t*>(P) = Size;
+    O = reinterpret_cast<PythonObject*>(P + UnpooledHeader);
+    C = UnpooledClass;
+    Allocated = Size;
+  }
+
+  O->RefCount = 1;
+  O->Type = T;
+  O->SizeClass = C;
+  O->Flags = 0;
+
+  ++Counters.allocations;
+  Counters.bytes_allocated += Allocated;
+  Counters.live_bytes += Allocated;
+  if (AllocHook)
+    AllocHook(AllocHookData, O, Allocated);
+  return O;
+}
+
+void pyrt::freeObject(PythonObject *O) {
+  uint8_t C = O->SizeClass;
+  ++Counters.frees;
+  if (C == UnpooledClass) {
+    char *P = reinterpret_cast<char*>(O) - UnpooledHeader;
+    Counters.live_bytes -= *reinterpret_cast<size_t*>(P);
+    std::free(P);
+    return;
+  }
+  Counters.live_bytes -= ClassSizes[C];
+  FreeBlock *B = reinterpret_cast<FreeBlock*>(O);
+  B->Next = FreeLists[C];
+  FreeLists[C] = B;
+}
+
+PythonObject *pyrt::initStackObject(void *Mem, TypeId T) {
+  PythonObject *O = static_cast<PythonObject*>(Mem);
+  O->RefCount = 1;
+  O->Type = T;
+  O->SizeClass = UnpooledClass;
+  O->Flags = OnStack;
+  ++Counters.stack_objects;
+  return O;
+}
+
+void pyrt::countCall(py_runtime_fn Fn) {
+  ++Counters.calls[Fn];
+  if (CallHook)
+    CallHook(CallHookData, Fn);
+}
+
+void pyrt::countCacheLookup(bool PolyHit) {
+  if (PolyHit)
+    ++Counters.cache_poly_hits;
+  else
+    ++Counters.cache_misses;
+}
+
+void py_read_counters(py_counters *C) {
+  *C = Counters;
+}
+
+void py_reset_counters(void) {
+  // Objects alive now are still alive.
+  unsigned long long Live = Counters.live_bytes;
+  std::memset(&Counters, 0, sizeof(Counters));
+  Counters.live_bytes = Live;
+}
+
+void py_set_alloc_hook(py_alloc_hook Hook, void *Data) {
+  AllocHook = Hook;
+  AllocHookData = Data;
+}
+
+void py_set_call_hook(py_call_hook Hook, void *Data) {
+  CallHook = Hook;
+  CallHookData = Data;
+}
+
+void py_set_tier_hook(py_tier_hook Hook, void *Data) {
+  TierHook = Hook;
+  TierHookData = Data;
+}
+
+void py_tier_up(void *Key) {
+  ++Counters.tier_ups;
+  if (TierHook)
+    TierHook(TierHookData, Key, PY_TIER_HOT, 0);
+}
+
+void py_deopt(void *Key, unsigned Site) {
+  ++Counters.deopts;
+  if (TierHook)
+    TierHook(TierHookData, Key, PY_TIER_DEOPT, Site);
+}
@@ -0,0 +1,292 @@
+//===--- Iteration.cpp - Iterators and generators -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A generator made by py_generatorfactory runs its function on a stack of
+// its own. py_yield switches from that stack back to whoever resumed the
+// generator, and resuming it switches back, so generated code calls
+// py_yield like any other function.
+//
+// A generator made by py_generator_new was compiled to a state machine that
+// keeps what it needs across a yield in a frame, so resuming it is just a
+// call.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Object.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <ucontext.h>
+
+using namespace pyrt;
+
+/// The stack each running generator gets.
+static const size_t GeneratorStackSize = 256 * 1024;
+
+namespace pyrt {
+/// Generator - What a generator needs to run, and to be suspended.
+struct Generator {
+  enum StateKind { Created, Suspended, Running, Finished };
+
+  StateKind State;
+  FunctionObject *Fn;
+  PythonObject *Args;
+  PythonObject *Closure;
+  /// The generator's own namespace.
+  PythonObject *Locals;
+  /// What the last py_yield handed over, owned until the resumer takes it.
+  PythonObject *Yielded;
+
+  char *Stack;
+  ucontext_t Context;
+  /// Where to go back to on py_yield, or when the function returns.
+  ucontext_t Resumer;
+  /// The generator that was running when this one was resumed.
+  Generator *Outer;
+};
+}
+
+/// The generator running now, or null in module code.
+static Generator *Current;
+
+PythonObject *pyrt::getCurrentLocals() {
+  return Current ? Current->Locals : 0;
+}
+
+//===----------------------------------------------------------------------===//
+// Sequence iterators
+//===----------------------------------------------------------------------===//
+
+static PythonObject *newSeqIter(PythonObject *Seq) {
+  SeqIterObject *I = static_cast<SeqIterObject*>(
+    allocObject(SeqIterType, sizeof(SeqIterObject)));
+  py_incref(Seq);
+  I->Seq = Seq;
+  I->Index = 0;
+  return I;
+}
+
+static PythonObject *nextSeqItem(SeqIterObject *I) {
+  PythonObject *Seq = I->Seq;
+  switch (getType(Seq)) {
+  case TupleType: {
+    TupleObject *T = static_cast<TupleObject*>(Seq);
+    if (I->Index == T->Size)
+      return 0;
+    PythonObject *Item = T->Items[I->Index++];
+    py_incref(Item);
+    return Item;
+  }
+  case ListType: {
+    // Items appended while iterating are seen, as in Python.
+    ListObject *L = static_cast<ListObject*>(Seq);
+    if (I->Index >= L->Size)
+      return 0;
+    PythonObject *Item = L->Items[I->Index++];
+    py_incref(Item);
+    return Item;
+  }
+  case StrType: {
+    StrObject *S = static_cast<StrObject*>(Seq);
+    if (I->Index == S->Length)
+      return 0;
+    return py_str_new(&S->Data[I->Index++], 1);
+  }
+  case DictType: {
+    // Iterate over the keys, in table order.
+    DictObject *D = static_cast<DictObject*>(Seq);
+    while (I->Index != D->Capacity) {
+      PythonObject *Key = D->Entries[I->Index++].Key;
+      if (Key) {
+        py_incref(Key);
+        return Key;
+      }
+    }
+    return 0;
+  }
+  default:
+    fatal("bad sequence iterator");
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Generators
+//===----------------------------------------------------------------------===//
+
+PythonObject *py_generatorfactory(PythonObject *Fn, PythonObject *Args,
+                                  PythonObject *Closure) {
+  countCall(PY_FN_GENERATORFACTORY);
+  if (getType(Fn) != FunctionType)
+    fatal("generator of an object that isn't a function");
+
+  Generator *G = new Generator();
+  G->State = Generator::Created;
+  G->Fn = static_cast<FunctionObject*>(Fn);
+  G->Args = Args;
+  G->Closure = Closure;
+  py_incref(Fn);
+  py_incref(Args);
+  py_incref(Closure);
+  G->Locals = py_dict_new();
+  G->Yielded = 0;
+  G->Stack = 0;
+  G->Outer = 0;
+
+  GeneratorObject *O = static_cast<GeneratorObject*>(
+    allocObject(GeneratorType, sizeof(GeneratorObject)));
+  O->State = G;
+  return O;
+}
+
+/// runGenerator - The bottom of a generator's stack.
+static void runGenerator() {
+  Generator *G = Current;
+  PythonObject *Result = G->Fn->Code(G->Args, G->Closure);
+  if (Result)
+    py_decref(Result);
+  G->State = Generator::Finished;
+  // Returning resumes G->Resumer, through uc_link.
+}
+
+/// resume - Run G until it yields or returns. Returns what it yielded, or
+/// null once it has returned.
+static PythonObject *resume(Generator *G) {
+  switch (G->State) {
+  case Generator::Finished:
+    return 0;
+  case Generator::Running:
+    fatal("generator already running");
+  case Generator::Created:
+    G->Stack = static_cast<char*>(std::malloc(GeneratorStackSize));
+    if (!G->Stack)
+      fatal("out of memory");
+    getcontext(&G->Context);
+    G->Context.uc_stack.ss_sp = G->Stack;
+    G->Context.uc_stack.ss_size = GeneratorStackSize;
+    G->Context.uc_link = &G->Resumer;
+    makecontext(&G->Context, runGenerator, 0);
+    break;
+  case Generator::Suspended:
+    break;
+  }
+
+  G->State = Generator::Running;
+  G->Outer = Current;
+  Current = G;
+  swapcontext(&G->Resumer, &G->Context);
+  Current = G->Outer;
+
+  if (G->State == Generator::Finished) {
+    std::free(G->Stack);
+    G->Stack = 0;
+    return 0;
+  }
+  G->State = Generator::Suspended;
+  PythonObject *Value = G->Yielded;
+  G->Yielded = 0;
+  return Value;
+}
+
+PythonObject *py_yield(PythonObject *Value) {
+  countCall(PY_FN_YIELD);
+  Generator *G = Current;
+  if (!G)
+    fatal("yield outside a generator");
+  py_incref(Value);
+  G->Yielded = Value;
+  swapcontext(&G->Context, &G->Resumer);
+  return py_none();
+}
+
+void pyrt::destroyGenerator(GeneratorObject *O) {
+  Generator *G = O->State;
+  if (G->State == Generator::Running)
+    fatal("destroying a running generator");
+  // A generator destroyed while suspended never finishes; whatever its
+  // frames still hold is leaked along with them, as pyrt.h documents and
+  // unittests/Runtime pins.
+  std::free(G->Stack);
+  py_decref(G->Fn);
+  py_decref(G->Args);
+  py_decref(G->Closure);
+  py_decref(G->Locals);
+  delete G;
+}
+
+//===----------------------------------------------------------------------===//
+// State machine generators
+//===----------------------------------------------------------------------===//
+
+PythonObject *py_generator_new(py_resume_fn Resume, py_frame_fn Destroy,
+                               size_t FrameSize) {
+  FrameGeneratorObject *G = static_cast<FrameGeneratorObject*>(
+    allocObject(FrameGeneratorType, sizeof(FrameGeneratorObject) + FrameSize));
+  G->Resume = Resume;
+  G->Destroy = Destroy;
+  G->Finished = false;
+  std::memset(G->Frame, 0, FrameSize);
+  return G;
+}
+
+void *py_generator_frame(PythonObject *O) {
+  if (getType(O) != FrameGeneratorType)
+    fatal("expected a compiled generator");
+  return static_cast<FrameGeneratorObject*>(O)->Frame;
+}
+
+static PythonObject *resumeFrame(FrameGeneratorObject *G) {
+  if (G->Finished)
+    return 0;
+  PythonObject *Value = G->Resume(G->Frame);
+  if (!Value)
+    G->Finished = true;
+  return Value;
+}
+
+void pyrt::destroyFrameGenerator(FrameGeneratorObject *G) {
+  if (G->Destroy)
+    G->Destroy(G->Frame);
+}
+
+//===----------------------------------------------------------------------===//
+// The iteration protocol
+//===----------------------------------------------------------------------===//
+
+PythonObject *py_startiteration(PythonObject *Iterable) {
+  countCall(PY_FN_STARTITERATION);
+  switch (getType(Iterable)) {
+  case TupleType:
+  case ListType:
+  case StrType:
+  case DictType:
+    return newSeqIter(Iterable);
+  case SeqIterType:
+  case GeneratorType:
+  case FrameGeneratorType:
+    // Already iterators.
+    py_incref(Iterable);
+    return Iterable;
+  default:
+    fatal("object is not iterable");
+  }
+}
+
+PythonObject *py_nextiteration(PythonObject *Iterator) {
+  countCall(PY_FN_NEXTITERATION);
+  switch (getType(Iterator)) {
+  case SeqIterType:
+    return nextSeqItem(static_cast<SeqIterObject*>(Iterator));
+  case GeneratorType:
+    return resume(static_cast<GeneratorObject*>(Iterator)->State);
+  case FrameGeneratorType:
+    return resumeFrame(static_cast<FrameGeneratorObject*>(Iterator));
+  default:
+    fatal("object is not an iterator");
+  }
+}
@@ -0,0 +1,207 @@
+//===--- Object.h - Layout of runtime objects -------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines how the runtime lays out objects, and the functions the
+//  parts of the runtime share. It is private to the runtime.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef PYRT_OBJECT_H
+#define PYRT_OBJECT_H
+
+#include "pyrt.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// PythonObject - The header every object starts with: one word, rather than
+/// a reference count and a type pointer of a word each.
+struct PythonObject {
+  uint32_t RefCount;
+  /// A pyrt::TypeId.
+  uint16_t Type;
+  /// The allocator size class the object came from; see Alloc.cpp.
+  uint8_t SizeClass;
+  /// pyrt::ObjectFlags.
+  uint8_t Flags;
+};
+
+namespace pyrt {
+
+enum TypeId {
+  NoneType,
+  BoolType,
+  IntType,
+  StrType,
+  TupleType,
+  ListType,
+  DictType,
+  FunctionType,
+  SeqIterType,
+  GeneratorType,
+  FrameGeneratorType,
+  CellType,
+  NumTypes
+};
+
+enum ObjectFlags {
+  /// The object is static and never freed; its RefCount means nothing.
+  Immortal = 1 << 0,
+  /// The object is in a frame of generated code, which owns its memory.
+  OnStack = 1 << 1
+};
+
+/// IntObject - An int too big to be a small int, or a bool.
+struct IntObject : PythonObject {
+  int64_t Value;
+};
+
+struct StrObject : PythonObject {
+  uint32_t Length;
+  uint32_t Hash;
+  /// Length bytes and a terminating zero.
+  char Data[1];
+};
+
+struct TupleObject : PythonObject {
+  uint32_t Size;
+  PythonObject *Items[1];
+};
+
+struct ListObject : PythonObject {
+  uint32_t Size;
+  uint32_t Capacity;
+  PythonObject **Items;
+};
+
+struct DictEntry {
+  PythonObject *Key;
+  PythonObject *Value;
+  uint32_t Hash;
+};
+
+/// DictObject - An open-addressed hash table with linear probing. Entries
+/// are never removed, so a null Key ends a probe.
+///
+/// py::Runtime::EmitCachedLookup emits code that reads Entries and Version
+/// directly; keep it in step with this layout.
+struct DictObject : PythonObject {
+  uint32_t Size;
+  /// A power of two.
+  uint32_t Capacity;
+  DictEntry *Entries;
+  /// Changes, to a value no dict has had, whenever a key is added.
+  uint64_t Version;
+};
+
+struct FunctionObject : PythonObject {
+  py_code Code;
+};
+
+/// SeqIterObject - Iterates over the items of a tuple, list or str, or the
+/// keys of a dict.
+struct SeqIterObject : PythonObject {
+  PythonObject *Seq;
+  uint32_t Index;
+};
+
+struct Generator;
+
+/// GeneratorObject - A generator, whose state is kept out of line because
+/// it holds a whole machine context.
+struct GeneratorObject : PythonObject {
+  Generator *State;
+};
+
+/// FrameGeneratorObject - A generator compiled to a state machine, with its
+/// frame allocated along with it.
+struct FrameGeneratorObject : PythonObject {
+  py_resume_fn Resume;
+  py_frame_fn Destroy;
+  /// Set once Resume has returned null, after which it isn't called again.
+  bool Finished;
+  /// The frame, suitably aligned for anything generated code keeps in it.
+  union {
+    char Frame[1];
+    double AlignDouble;
+    void *AlignPointer;
+    int64_t AlignInt;
+  };
+};
+
+/// CellObject - A variable shared with nested functions.
+struct CellObject : PythonObject {
+  /// Null while the variable is unbound.
+  PythonObject *Value;
+};
+
+inline bool isSmallInt(const PythonObject *O) {
+  return PY_IS_SMALL_INT(O);
+}
+
+/// makeSmallInt - The small int V, which must be in range.
+inline PythonObject *makeSmallInt(int64_t V) {
+  return reinterpret_cast<PythonObject*>(
+    (static_cast<uintptr_t>(V) << 1) | PY_SMALL_INT_TAG);
+}
+
+inline TypeId getType(const PythonObject *O) {
+  return isSmallInt(O) ? IntType : static_cast<TypeId>(O->Type);
+}
+
+/// getIntValue - The value of an int or bool.
+inline int64_t getIntValue(const PythonObject *O) {
+  if (isSmallInt(O))
+    return static_cast<intptr_t>(reinterpret_cast<uintptr_t>(O)) >> 1;
+  return static_cast<const IntObject*>(O)->Value;
+}
+
+/// fatal - Report a runtime error that generated code can't handle, and
+/// stop.
+void fatal(const char *Fmt, ...)
+#if defined(__GNUC__)
+  __attribute__((noreturn, format(printf, 1, 2)))
+#endif
+  ;
+
+// Alloc.cpp
+
+/// allocObject - Allocate Size bytes for a new object of type T, with its
+/// header set up and a reference count of one.
+PythonObject *allocObject(TypeId T, size_t Size);
+/// freeObject - Return the memory of O, whose contents are already gone.
+void freeObject(PythonObject *O);
+/// initStackObject - Set up the header of a new object of type T in Mem,
+/// memory of generated code's, with a reference count of one.
+PythonObject *initStackObject(void *Mem, TypeId T);
+/// countCall - Count a call from generated code to Fn.
+void countCall(py_runtime_fn Fn);
+/// countCacheLookup - Count a cached lookup the inline check missed.
+void countCacheLookup(bool PolyHit);
+
+// Objects.cpp
+
+/// destroy - Release what O refers to, then free O.
+void destroy(PythonObject *O);
+uint32_t hash(PythonObject *O);
+bool equal(PythonObject *A, PythonObject *B);
+/// getGlobals - The module namespace, without a new reference.
+PythonObject *getGlobals();
+
+// Iteration.cpp
+
+void destroyGenerator(GeneratorObject *G);
+void destroyFrameGenerator(FrameGeneratorObject *G);
+/// getCurrentLocals - The namespace of the running generator, if any,
+/// without a new reference.
+PythonObject *getCurrentLocals();
+
+}
+
+#endif
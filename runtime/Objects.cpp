@@ -0,0 +1,552 @@
+//===--- Objects.cpp - Built-in object types ------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements reference counting and the built-in types other than
+// iterators and generators.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Object.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace pyrt;
+
+#define STATIC_OBJECT(Type) { 0, Type, 0, Immortal }
+
+// The sizes pyrt.h promises stack objects fit in. An array of negative size
+// fails to compile if one doesn't.
+typedef char IntFitsOnStack[sizeof(IntObject) <= PY_INT_STACK_BYTES ? 1 : -1];
+typedef char TupleFitsOnStack[
+  sizeof(TupleObject) <= PY_TUPLE_STACK_BYTES(1) ? 1 : -1];
+typedef char ListFitsOnStack[
+  sizeof(ListObject) <= PY_LIST_STACK_BYTES ? 1 : -1];
+
+namespace {
+/// StaticInt - Laid out like IntObject, but a POD that can be initialized
+/// statically.
+struct StaticInt {
+  PythonObject Header;
+  int64_t Value;
+};
+}
+
+static PythonObject None = STATIC_OBJECT(NoneType);
+static StaticInt False = { STATIC_OBJECT(BoolType), 0 };
+static StaticInt True = { STATIC_OBJECT(BoolType), 1 };
+
+/// The module namespace, created on first use.
+static PythonObject *Globals;
+
+void py_incref(PythonObject *O) {
+  if (!isSmallInt(O) && !(O->Flags & Immortal))
+    ++O->RefCount;
+}
+
+void py_decref(PythonObject *O) {
+  if (isSmallInt(O) || (O->Flags & Immortal))
+    return;
+  if (--O->RefCount == 0)
+    destroy(O);
+}
+
+void py_xdecref(PythonObject *O) {
+  if (O)
+    py_decref(O);
+}
+
+void pyrt::destroy(PythonObject *O) {
+  switch (getType(O)) {
+  case NoneType:
+  case BoolType:
+  case IntType:
+  case StrType:
+  case FunctionType:
+    break;
+  case TupleType: {
+    TupleObject *T = static_cast<TupleObject*>(O);
+    for (uint32_t i = 0; i != T->Size; ++i)
+      py_decref(T->Items[i]);
+    break;
+  }
+  case ListType: {
+    ListObject *L = static_cast<ListObject*>(O);
+    for (uint32_t i = 0; i != L->Size; ++i)
+      py_decref(L->Items[i]);
+    std::free(L->Items);
+    break;
+  }
+  case DictType: {
+    DictObject *D = static_cast<DictObject*>(O);
+    for (uint32_t i = 0; i != D->Capacity; ++i) {
+      if (!D->Entries[i].Key)
+        continue;
+      py_decref(D->Entries[i].Key);
+      py_decref(D->Entries[i].Value);
+    }
+    std::free(D->Entries);
+    break;
+  }
+  case SeqIterType:
+    py_decref(static_cast<SeqIterObject*>(O)->Seq);
+    break;
+  case GeneratorType:
+    destroyGenerator(static_cast<GeneratorObject*>(O));
+    break;
+  case FrameGeneratorType:
+    destroyFrameGenerator(static_cast<FrameGeneratorObject*>(O));
+    break;
+  case CellType:
+    py_xdecref(static_cast<CellObject*>(O)->Value);
+    break;
+  case NumTypes:
+    fatal("destroying an object of unknown type");
+  }
+  if (!(O->Flags & OnStack))
+    freeObject(O);
+}
+
+//===----------------------------------------------------------------------===//
+// Scalars
+//===----------------------------------------------------------------------===//
+
+PythonObject *py_none(void) {
+  return &None;
+}
+
+PythonObject *py_bool(int V) {
+  return reinterpret_cast<PythonObject*>(V ? &True : &False);
+}
+
+PythonObject *py_int_new(long long V) {
+  if (V >= PY_SMALL_INT_MIN && V <= PY_SMALL_INT_MAX)
+    return makeSmallInt(V);
+  IntObject *I = static_cast<IntObject*>(allocObject(IntType,
+                                                     sizeof(IntObject)));
+  I->Value = V;
+  return I;
+}
+
+PythonObject *py_int_init(void *Mem, long long V) {
+  if (V >= PY_SMALL_INT_MIN && V <= PY_SMALL_INT_MAX)
+    return makeSmallInt(V);
+  IntObject *I = static_cast<IntObject*>(initStackObject(Mem, IntType));
+  I->Value = V;
+  return I;
+}
+
+long long py_int_value(PythonObject *O) {
+  TypeId T = getType(O);
+  if (T != IntType && T != BoolType)
+    fatal("expected an int");
+  return getIntValue(O);
+}
+
+PythonObject *py_int_add(PythonObject *A, PythonObject *B) {
+  countCall(PY_FN_INT_ADD);
+  int64_t X = py_int_value(A), Y = py_int_value(B);
+  if (Y > 0 ? X > INT64_MAX - Y : X < INT64_MIN - Y)
+    fatal("integer overflow");
+  return py_int_new(X + Y);
+}
+
+PythonObject *py_int_sub(PythonObject *A, PythonObject *B) {
+  countCall(PY_FN_INT_SUB);
+  int64_t X = py_int_value(A), Y = py_int_value(B);
+  if (Y > 0 ? X < INT64_MIN + Y : X > INT64_MAX + Y)
+    fatal("integer overflow");
+  return py_int_new(X - Y);
+}
+
+PythonObject *py_int_mul(PythonObject *A, PythonObject *B) {
+  countCall(PY_FN_INT_MUL);
+  int64_t X = py_int_value(A), Y = py_int_value(B);
+  bool Overflow;
+  if (X > 0)
+    Overflow = Y > 0 ? X > INT64_MAX / Y : Y < INT64_MIN / X;
+  else if (X < 0)
+    Overflow = Y > 0 ? X < INT64_MIN / Y : Y != 0 && X < INT64_MAX / Y;
+  else
+    Overflow = false;
+  if (Overflow)
+    fatal("integer overflow");
+  return py_int_new(X * Y);
+}
+
+PythonObject *py_cmp(PythonObject *A, PythonObject *B) {
+  countCall(PY_FN_CMP);
+  TypeId TA = getType(A), TB = getType(B);
+  int C;
+  if ((TA == IntType || TA == BoolType) && (TB == IntType || TB == BoolType)) {
+    int64_t X = getIntValue(A), Y = getIntValue(B);
+    C = X < Y ? -1 : X > Y;
+  } else if (TA == StrType && TB == StrType) {
+    StrObject *SA = static_cast<StrObject*>(A), *SB = static_cast<StrObject*>(B);
+    uint32_t N = SA->Length < SB->Length ? SA->Length : SB->Length;
+    C = std::memcmp(SA->Data, SB->Data, N);
+    if (C == 0)
+      C = SA->Length < SB->Length ? -1 : SA->Length > SB->Length;
+    else
+      C = C < 0 ? -1 : 1;
+  } else {
+    fatal("can only compare two ints or two strs");
+  }
+  return makeSmallInt(C);
+}
+
+/// hashBytes - FNV-1a.
+static uint32_t hashBytes(const char *P, size_t N) {
+  uint32_t H = 2166136261u;
+  for (size_t i = 0; i != N; ++i) {
+    H ^= static_cast<unsigned char>(P[i]);
+    H *= 16777619u;
+  }
+  return H;
+}
+
+PythonObject *py_str_new(const char *S, size_t Length) {
+  if (Length > UINT32_MAX)
+    fatal("string of %lu bytes is too long", (unsigned long)Length);
+  StrObject *Str = static_cast<StrObject*>(
+    allocObject(StrType, sizeof(StrObject) + Length));
+  Str->Length = Length;
+  Str->Hash = hashBytes(S, Length);
+  std::memcpy(Str->Data, S, Length);
+  Str->Data[Length] = 0;
+  return Str;
+}
+
+PythonObject *py_function_new(py_code Code) {
+  FunctionObject *F = static_cast<FunctionObject*>(
+    allocObject(FunctionType, sizeof(FunctionObject)));
+  F->Code = Code;
+  return F;
+}
+
+//===----------------------------------------------------------------------===//
+// Tuples
+//===----------------------------------------------------------------------===//
+
+/// fillTuple - Set up O, a new tuple with room for Size items.
+static PythonObject *fillTuple(PythonObject *O, size_t Size,
+                               PythonObject *const *Items) {
+  TupleObject *T = static_cast<TupleObject*>(O);
+  T->Size = Size;
+  for (size_t i = 0; i != Size; ++i) {
+    py_incref(Items[i]);
+    T->Items[i] = Items[i];
+  }
+  return T;
+}
+
+PythonObject *py_tuple_new(size_t Size, PythonObject *const *Items) {
+  if (Size > UINT32_MAX)
+    fatal("tuple of %lu items is too long", (unsigned long)Size);
+  return fillTuple(allocObject(TupleType, sizeof(TupleObject) +
+                                          Size * sizeof(PythonObject*)),
+                   Size, Items);
+}
+
+PythonObject *py_tuple_init(void *Mem, size_t Size,
+                            PythonObject *const *Items) {
+  if (Size > UINT32_MAX)
+    fatal("tuple of %lu items is too long", (unsigned long)Size);
+  return fillTuple(initStackObject(Mem, TupleType), Size, Items);
+}
+
+//===----------------------------------------------------------------------===//
+// Lists
+//===----------------------------------------------------------------------===//
+
+/// fillList - Set up O, a new list, with room for Capacity items.
+static PythonObject *fillList(PythonObject *O, size_t Capacity) {
+  ListObject *L = static_cast<ListObject*>(O);
+  L->Size = 0;
+  L->Capacity = Capacity;
+  L->Items = 0;
+  if (Capacity) {
+    L->Items = static_cast<PythonObject**>(
+      std::malloc(Capacity * sizeof(PythonObject*)));
+    if (!L->Items)
+      fatal("out of memory");
+  }
+  return L;
+}
+
+PythonObject *py_list_new(size_t Capacity) {
+  if (Capacity > UINT32_MAX)
+    fatal("list of %lu items is too long", (unsigned long)Capacity);
+  return fillList(allocObject(ListType, sizeof(ListObject)), Capacity);
+}
+
+PythonObject *py_list_init(void *Mem, size_t Capacity) {
+  if (Capacity > UINT32_MAX)
+    fatal("list of %lu items is too long", (unsigned long)Capacity);
+  return fillList(initStackObject(Mem, ListType), Capacity);
+}
+
+void py_list_append(PythonObject *O, PythonObject *Item) {
+  if (getType(O) != ListType)
+    fatal("expected a list");
+  ListObject *L = static_cast<ListObject*>(O);
+  if (L->Size == L->Capacity) {
+    if (L->Capacity == UINT32_MAX)
+      fatal("list is too long");
+    uint64_t NewCapacity = L->Capacity ? uint64_t(L->Capacity) * 2 : 4;
+    if (NewCapacity > UINT32_MAX)
+      NewCapacity = UINT32_MAX;
+    PythonObject **Items = static_cast<PythonObject**>(
+      std::realloc(L->Items, NewCapacity * sizeof(PythonObject*)));
+    if (!Items)
+      fatal("out of memory");
+    L->Items = Items;
+    L->Capacity = NewCapacity;
+  }
+  py_incref(Item);
+  L->Items[L->Size++] = Item;
+}
+
+size_t py_seq_size(PythonObject *Seq) {
+  switch (getType(Seq)) {
+  case TupleType:
+    return static_cast<TupleObject*>(Seq)->Size;
+  case ListType:
+    return static_cast<ListObject*>(Seq)->Size;
+  default:
+    fatal("expected a tuple or list");
+  }
+}
+
+PythonObject *py_seq_item(PythonObject *Seq, size_t I) {
+  if (I >= py_seq_size(Seq))
+    fatal("index out of range");
+  if (getType(Seq) == TupleType)
+    return static_cast<TupleObject*>(Seq)->Items[I];
+  return static_cast<ListObject*>(Seq)->Items[I];
+}
+
+//===----------------------------------------------------------------------===//
+// Dicts
+//===----------------------------------------------------------------------===//
+
+uint32_t pyrt::hash(PythonObject *O) {
+  switch (getType(O)) {
+  case StrType:
+    return static_cast<StrObject*>(O)->Hash;
+  case BoolType:
+  case IntType: {
+    uint64_t V = getIntValue(O);
+    return static_cast<uint32_t>(V ^ (V >> 32)) * 2654435761u;
+  }
+  default: {
+    // Everything else compares by identity.
+    uintptr_t P = reinterpret_cast<uintptr_t>(O);
+    return static_cast<uint32_t>((P >> 4) ^ (P >> 32)) * 2654435761u;
+  }
+  }
+}
+
+bool pyrt::equal(PythonObject *A, PythonObject *B) {
+  if (A == B)
+    return true;
+  TypeId TA = getType(A), TB = getType(B);
+  if ((TA == IntType || TA == BoolType) && (TB == IntType || TB == BoolType))
+    return getIntValue(A) == getIntValue(B);
+  if (TA == StrType && TB == StrType) {
+    StrObject *SA = static_cast<StrObject*>(A), *SB = static_cast<StrObject*>(B);
+    return SA->Hash == SB->Hash && SA->Length == SB->Length &&
+           std::memcmp(SA->Data, SB->Data, SA->Length) == 0;
+  }
+  return false;
+}
+
+static const uint32_t InitialDictCapacity = 8;
+
+/// The next dict version tag. Zero is never used, so that an empty cache
+/// never matches.
+static uint64_t NextDictVersion = 1;
+
+PythonObject *py_dict_new(void) {
+  DictObject *D = static_cast<DictObject*>(allocObject(DictType,
+                                                       sizeof(DictObject)));
+  D->Size = 0;
+  D->Capacity = InitialDictCapacity;
+  D->Version = NextDictVersion++;
+  D->Entries = static_cast<DictEntry*>(
+    std::calloc(InitialDictCapacity, sizeof(DictEntry)));
+  if (!D->Entries)
+    fatal("out of memory");
+  return D;
+}
+
+static DictObject *asDict(PythonObject *O) {
+  if (getType(O) != DictType)
+    fatal("expected a dict");
+  return static_cast<DictObject*>(O);
+}
+
+/// lookup - Return the entry for Key, or the empty entry it would go in.
+static DictEntry *lookup(DictObject *D, PythonObject *Key, uint32_t H) {
+  uint32_t Mask = D->Capacity - 1;
+  for (uint32_t i = H & Mask;; i = (i + 1) & Mask) {
+    DictEntry *E = &D->Entries[i];
+    if (!E->Key || (E->Hash == H && equal(E->Key, Key)))
+      return E;
+  }
+}
+
+static void grow(DictObject *D) {
+  DictEntry *Old = D->Entries;
+  uint32_t OldCapacity = D->Capacity;
+  D->Capacity *= 2;
+  D->Entries = static_cast<DictEntry*>(std::calloc(D->Capacity,
+                                                   sizeof(DictEntry)));
+  if (!D->Entries)
+    fatal("out of memory");
+  for (uint32_t i = 0; i != OldCapacity; ++i)
+    if (Old[i].Key)
+      *lookup(D, Old[i].Key, Old[i].Hash) = Old[i];
+  std::free(Old);
+}
+
+PythonObject *py_dict_get(PythonObject *O, PythonObject *Key) {
+  DictObject *D = asDict(O);
+  DictEntry *E = lookup(D, Key, hash(Key));
+  if (!E->Key)
+    return 0;
+  py_incref(E->Value);
+  return E->Value;
+}
+
+void py_dict_set(PythonObject *O, PythonObject *Key, PythonObject *Value) {
+  DictObject *D = asDict(O);
+  uint32_t H = hash(Key);
+  DictEntry *E = lookup(D, Key, H);
+  py_incref(Value);
+  if (E->Key) {
+    py_decref(E->Value);
+    E->Value = Value;
+    return;
+  }
+
+  py_incref(Key);
+  E->Key = Key;
+  E->Value = Value;
+  E->Hash = H;
+  // Keep at most two thirds of the entries full, so probes stay short.
+  if (++D->Size * 3 >= D->Capacity * 2)
+    grow(D);
+  // Keys may have moved, and a cached miss of Key is now wrong.
+  D->Version = NextDictVersion++;
+}
+
+PythonObject *py_dict_lookup(PythonObject *O, PythonObject *Key) {
+  DictObject *D = asDict(O);
+  return lookup(D, Key, hash(Key))->Value;
+}
+
+PythonObject *py_dict_lookup_cached(PythonObject *O, PythonObject *Key,
+                                    py_lookup_cache *C) {
+  DictObject *D = asDict(O);
+  // Way 0 was checked inline.
+  for (unsigned i = 1; i != PY_LOOKUP_CACHE_WAYS; ++i) {
+    if (C->ways[i].version == D->Version) {
+      countCacheLookup(/*PolyHit=*/true);
+      return D->Entries[C->ways[i].slot].Value;
+    }
+  }
+
+  countCacheLookup(/*PolyHit=*/false);
+  DictEntry *E = lookup(D, Key, hash(Key));
+  // The newest entry goes in the way checked inline, pushing out the
+  // oldest. A dict that gained keys is then checked inline again at once.
+  for (unsigned i = PY_LOOKUP_CACHE_WAYS - 1; i != 0; --i)
+    C->ways[i] = C->ways[i - 1];
+  C->ways[0].version = D->Version;
+  C->ways[0].slot = E - D->Entries;
+  return E->Value;
+}
+
+//===----------------------------------------------------------------------===//
+// Namespaces
+//===----------------------------------------------------------------------===//
+
+PythonObject *pyrt::getGlobals() {
+  if (!Globals)
+    Globals = py_dict_new();
+  return Globals;
+}
+
+PythonObject *py_getglobals(void) {
+  countCall(PY_FN_GETGLOBALS);
+  PythonObject *G = getGlobals();
+  py_incref(G);
+  return G;
+}
+
+PythonObject *py_getlocals(void) {
+  countCall(PY_FN_GETLOCALS);
+  PythonObject *L = getCurrentLocals();
+  if (!L)
+    L = getGlobals();
+  py_incref(L);
+  return L;
+}
+
+PythonObject *py_bind(PythonObject *Name, PythonObject *Value) {
+  countCall(PY_FN_BIND);
+  if (getType(Name) != StrType)
+    fatal("binding a name that isn't a str");
+  PythonObject *L = getCurrentLocals();
+  py_dict_set(L ? L : getGlobals(), Name, Value);
+  py_incref(Value);
+  return Value;
+}
+
+PythonObject *py_name(PythonObject **Slot, const char *S, size_t Length) {
+  if (!*Slot) {
+    // Kept for good; the slot holds the reference.
+    *Slot = py_str_new(S, Length);
+  }
+  return *Slot;
+}
+
+void py_unbound(const char *S) {
+  fatal("name '%s' is not defined", S);
+}
+
+//===----------------------------------------------------------------------===//
+// Cells
+//===----------------------------------------------------------------------===//
+
+static CellObject *asCell(PythonObject *O) {
+  if (getType(O) != CellType)
+    fatal("expected a cell");
+  return static_cast<CellObject*>(O);
+}
+
+PythonObject *py_cell_new(void) {
+  CellObject *C = static_cast<CellObject*>(
+    allocObject(CellType, sizeof(CellObject)));
+  C->Value = 0;
+  return C;
+}
+
+PythonObject *py_cell_get(PythonObject *Cell) {
+  return asCell(Cell)->Value;
+}
+
+void py_cell_set(PythonObject *Cell, PythonObject *Value) {
+  CellObject *C = asCell(Cell);
+  // Take the new reference first, in case Value is the old value.
+  py_incref(Value);
+  py_xdecref(C->Value);
+  C->Value = Value;
+}
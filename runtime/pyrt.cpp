@@ -0,0 +1,62 @@
+//===--- pyrt.cpp - Native Python runtime ---------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the table a JIT resolves runtime calls against.
+//
+//===----------------------------------------------------------------------===//
+
+#include "pyrt.h"
+
+#define SYMBOL(Name) { #Name, reinterpret_cast<void*>(&Name) }
+
+const py_symbol py_runtime_symbols[] = {
+  SYMBOL(py_getlocals),
+  SYMBOL(py_getglobals),
+  SYMBOL(py_startiteration),
+  SYMBOL(py_nextiteration),
+  SYMBOL(py_yield),
+  SYMBOL(py_bind),
+  SYMBOL(py_name),
+  SYMBOL(py_unbound),
+  SYMBOL(py_cell_new),
+  SYMBOL(py_cell_get),
+  SYMBOL(py_cell_set),
+  SYMBOL(py_generatorfactory),
+  SYMBOL(py_generator_new),
+  SYMBOL(py_generator_frame),
+  SYMBOL(py_int_add),
+  SYMBOL(py_int_sub),
+  SYMBOL(py_int_mul),
+  SYMBOL(py_cmp),
+  SYMBOL(py_tier_up),
+  SYMBOL(py_deopt),
+  SYMBOL(py_incref),
+  SYMBOL(py_decref),
+  SYMBOL(py_xdecref),
+  SYMBOL(py_none),
+  SYMBOL(py_bool),
+  SYMBOL(py_int_new),
+  SYMBOL(py_int_init),
+  SYMBOL(py_int_value),
+  SYMBOL(py_str_new),
+  SYMBOL(py_tuple_new),
+  SYMBOL(py_tuple_init),
+  SYMBOL(py_dict_new),
+  SYMBOL(py_list_new),
+  SYMBOL(py_list_init),
+  SYMBOL(py_list_append),
+  SYMBOL(py_seq_size),
+  SYMBOL(py_seq_item),
+  SYMBOL(py_dict_get),
+  SYMBOL(py_dict_set),
+  SYMBOL(py_dict_lookup),
+  SYMBOL(py_dict_lookup_cached),
+  SYMBOL(py_function_new),
+  { 0, 0 }
+};
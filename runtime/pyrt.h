@@ -0,0 +1,283 @@
+/*===--- pyrt.h - Native Python runtime -----------------------------*- C -*-===
+ *
+ *                     The LLVM Compiler Infrastructure
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ *===----------------------------------------------------------------------===
+ *
+ *  This file declares the functions generated code calls into, the ones
+ *  py::Runtime::Function refers to, with C linkage, and the functions that
+ *  embed and profile the runtime.
+ *
+ *  Every function returning a PythonObject returns a new reference, and
+ *  borrows its arguments. The runtime is not thread safe.
+ *
+ *===----------------------------------------------------------------------===*/
+
+#ifndef PYRT_H
+#define PYRT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* PythonObject - Every Python value. Generated code treats it as opaque. */
+typedef struct PythonObject PythonObject;
+
+/* py_code - The native code of a Python function. */
+typedef PythonObject *(*py_code)(PythonObject *Args, PythonObject *Closure);
+
+/*===----------------------------------------------------------------------===
+ * Called by generated code
+ *===----------------------------------------------------------------------===*/
+
+/* The namespace names are bound in: the running generator's own, or else
+ * the module's. Either outlives the code that asked for it, and every call
+ * from the same activation returns the same dict, which the passes of
+ * py/Transforms/Passes.h rely on. */
+PythonObject *py_getlocals(void);
+PythonObject *py_getglobals(void);
+
+/* Return an iterator over Iterable, and the next item of Iterator or null
+ * once it is exhausted. */
+PythonObject *py_startiteration(PythonObject *Iterable);
+PythonObject *py_nextiteration(PythonObject *Iterator);
+
+/* Suspend the running generator, handing Value to whoever resumed it.
+ * Returns None when the generator is resumed. */
+PythonObject *py_yield(PythonObject *Value);
+
+/* Bind the str Name to Value in the current namespace. Returns Value. */
+PythonObject *py_bind(PythonObject *Name, PythonObject *Value);
+
+/* The str of the Length bytes at S, made on the first call and kept in
+ * *Slot, a zeroed global of the call site's own, for the later ones.
+ * Returns a borrowed reference. */
+PythonObject *py_name(PythonObject **Slot, const char *S, size_t Length);
+/* Report that the name S was used before it was bound, and stop. */
+void py_unbound(const char *S);
+
+/* Cells - The variables a function shares with the functions nested in it;
+ * see py::NameResolver. A new cell is unbound. py_cell_get returns the
+ * value as a borrowed reference, or null while the cell is unbound. */
+PythonObject *py_cell_new(void);
+PythonObject *py_cell_get(PythonObject *Cell);
+void py_cell_set(PythonObject *Cell, PythonObject *Value);
+
+/* Return a generator that runs the function Fn on Args and Closure when it
+ * is first iterated. Freeing it while it is suspended frees its stack, but
+ * not what the frames on that stack hold: generated code can't be unwound
+ * from outside. Such references are leaked. */
+PythonObject *py_generatorfactory(PythonObject *Fn, PythonObject *Args,
+                                  PythonObject *Closure);
+
+/* py_resume_fn - A generator compiled to a state machine: runs from where
+ * its Frame says it stopped to the next yield, and returns the value
+ * yielded, or null once it has finished. py_frame_fn releases what a frame
+ * holds. py::GeneratorBuilder emits both. */
+typedef PythonObject *(*py_resume_fn)(void *Frame);
+typedef void (*py_frame_fn)(void *Frame);
+
+/* Return a generator that runs Resume on a frame of FrameSize zeroed bytes,
+ * and Destroy, if it isn't null, on the frame when it is freed. Resuming
+ * it is a direct call, with no stack switch. py_generator_frame returns the
+ * frame, for the caller to fill in before the first resume. */
+PythonObject *py_generator_new(py_resume_fn Resume, py_frame_fn Destroy,
+                               size_t FrameSize);
+void *py_generator_frame(PythonObject *G);
+
+/*===----------------------------------------------------------------------===
+ * Objects
+ *===----------------------------------------------------------------------===*/
+
+/* Small ints - An int from PY_SMALL_INT_MIN to PY_SMALL_INT_MAX is not
+ * allocated: its PythonObject pointer holds the value shifted left a bit,
+ * with the low bit set, which it never is in the address of an object.
+ * py_int_new returns one whenever the value fits, and every function takes
+ * one wherever it takes an int. py::Runtime emits the same encoding. */
+#define PY_SMALL_INT_TAG 1
+#define PY_SMALL_INT_MAX \
+  ((long long)(((unsigned long long)1 << (sizeof(void*) * 8 - 2)) - 1))
+#define PY_SMALL_INT_MIN (-PY_SMALL_INT_MAX - 1)
+#define PY_IS_SMALL_INT(O) (((size_t)(O) & PY_SMALL_INT_TAG) != 0)
+
+void py_incref(PythonObject *O);
+void py_decref(PythonObject *O);
+/* py_decref, unless O is null. */
+void py_xdecref(PythonObject *O);
+
+PythonObject *py_none(void);
+PythonObject *py_bool(int V);
+PythonObject *py_int_new(long long V);
+PythonObject *py_str_new(const char *S, size_t Length);
+/* A tuple of Size items, each of which gets a new reference. */
+PythonObject *py_tuple_new(size_t Size, PythonObject *const *Items);
+PythonObject *py_dict_new(void);
+/* An empty list with room for Capacity items before it has to grow. */
+PythonObject *py_list_new(size_t Capacity);
+void py_list_append(PythonObject *L, PythonObject *Item);
+PythonObject *py_function_new(py_code Code);
+
+/* Stack objects - The same objects, made in memory Mem of the caller's, for
+ * objects that py::createStackObjectsPass proved don't outlive the
+ * caller's frame. Mem must be 8-byte aligned and at least the size given
+ * below. They are reference counted as usual, and releasing the last
+ * reference releases what they hold, but leaves Mem alone. */
+#define PY_INT_STACK_BYTES 16
+#define PY_TUPLE_STACK_BYTES(Size) (24 + 8 * (Size))
+#define PY_LIST_STACK_BYTES 24
+PythonObject *py_int_init(void *Mem, long long V);
+PythonObject *py_tuple_init(void *Mem, size_t Size,
+                            PythonObject *const *Items);
+PythonObject *py_list_init(void *Mem, size_t Capacity);
+
+/* The number of items of the tuple or list Seq, and item I of it, which
+ * must be in range, as a borrowed reference. */
+size_t py_seq_size(PythonObject *Seq);
+PythonObject *py_seq_item(PythonObject *Seq, size_t I);
+
+/* The value of the int or bool O. */
+long long py_int_value(PythonObject *O);
+/* The sum, difference and product of the ints A and B; the slow paths of
+ * the small int arithmetic py::Runtime emits. */
+PythonObject *py_int_add(PythonObject *A, PythonObject *B);
+PythonObject *py_int_sub(PythonObject *A, PythonObject *B);
+PythonObject *py_int_mul(PythonObject *A, PythonObject *B);
+/* cmp(A, B) of two ints or two strs: the small int -1, 0 or 1. */
+PythonObject *py_cmp(PythonObject *A, PythonObject *B);
+
+/* Look Key up in the dict D; returns null if it isn't there. */
+PythonObject *py_dict_get(PythonObject *D, PythonObject *Key);
+void py_dict_set(PythonObject *D, PythonObject *Key, PythonObject *Value);
+
+/*===----------------------------------------------------------------------===
+ * Inline caches
+ *===----------------------------------------------------------------------===*/
+
+/* Every dict has a version tag, unique across all dicts, which changes
+ * whenever a key is added to it. Until then, each key stays in the same
+ * slot of the dict's table, so (tag, slot) pairs can be cached. A cached
+ * slot of a missing key stays empty, so misses are cached too. */
+
+#define PY_LOOKUP_CACHE_WAYS 4
+
+/* py_lookup_cache - The cache of one lookup site, which always looks up
+ * the same key, but maybe in different dicts. Generated code checks
+ * the first way inline (py::Runtime knows this layout), and calls
+ * py_dict_lookup_cached, which checks the others, when that misses. A
+ * zeroed cache is empty. */
+struct py_lookup_cache {
+  struct {
+    unsigned long long version;
+    unsigned long long slot;
+  } ways[PY_LOOKUP_CACHE_WAYS];
+};
+
+/* Look Key up in the dict D, returning a borrowed reference or null. */
+PythonObject *py_dict_lookup(PythonObject *D, PythonObject *Key);
+/* The same, through the cache C. */
+PythonObject *py_dict_lookup_cached(PythonObject *D, PythonObject *Key,
+                                    struct py_lookup_cache *C);
+
+/*===----------------------------------------------------------------------===
+ * Profiling
+ *===----------------------------------------------------------------------===*/
+
+/* py_runtime_fn - The functions generated code calls, as counted. */
+enum py_runtime_fn {
+  PY_FN_GETLOCALS,
+  PY_FN_GETGLOBALS,
+  PY_FN_STARTITERATION,
+  PY_FN_NEXTITERATION,
+  PY_FN_YIELD,
+  PY_FN_BIND,
+  PY_FN_GENERATORFACTORY,
+  PY_FN_INT_ADD,
+  PY_FN_INT_SUB,
+  PY_FN_INT_MUL,
+  PY_FN_CMP,
+  PY_NUM_RUNTIME_FNS
+};
+
+/* py_counters - Always-on counters, since the last py_reset_counters. */
+struct py_counters {
+  unsigned long long allocations;
+  unsigned long long frees;
+  /* Bytes handed out, rounded up to the allocator's size classes. */
+  unsigned long long bytes_allocated;
+  unsigned long long live_bytes;
+  unsigned long long calls[PY_NUM_RUNTIME_FNS];
+  /* Cached lookups that missed the inline check but hit another way of
+   * their cache, and ones that missed it altogether. */
+  unsigned long long cache_poly_hits;
+  unsigned long long cache_misses;
+  /* Functions found hot by their profiling tier, and failed type guards in
+   * optimized tiers; see py_tier_up. */
+  unsigned long long tier_ups;
+  unsigned long long deopts;
+  /* Objects made in generated code's own frame; see py_tuple_init. They
+   * aren't counted as allocations. */
+  unsigned long long stack_objects;
+};
+
+void py_read_counters(struct py_counters *C);
+void py_reset_counters(void);
+
+/* Hooks run on every allocation and on every call from generated code, in
+ * addition to the counters. Pass a null hook to remove one. */
+typedef void (*py_alloc_hook)(void *Data, const PythonObject *O,
+                              size_t Size);
+typedef void (*py_call_hook)(void *Data, enum py_runtime_fn Fn);
+
+void py_set_alloc_hook(py_alloc_hook Hook, void *Data);
+void py_set_call_hook(py_call_hook Hook, void *Data);
+
+/*===----------------------------------------------------------------------===
+ * Tiering
+ *===----------------------------------------------------------------------===*/
+
+/* py::TieredCompiler runs a function first in a profiling tier, then, once
+ * it is hot, in a tier optimized for the types the profile saw, guarded in
+ * case they change. Key identifies the function to the tier hook.
+ *
+ * The profiling tier calls py_tier_up when the function has been called
+ * often enough. The optimized tier calls py_deopt when the type guard of
+ * its site Site fails, then carries on with the generic code of the site;
+ * the hook may send later calls back to the profiling tier. */
+enum py_tier_event {
+  PY_TIER_HOT,
+  PY_TIER_DEOPT
+};
+
+void py_tier_up(void *Key);
+void py_deopt(void *Key, unsigned Site);
+
+/* Site is only meaningful for PY_TIER_DEOPT. */
+typedef void (*py_tier_hook)(void *Data, void *Key, enum py_tier_event Event,
+                             unsigned Site);
+
+void py_set_tier_hook(py_tier_hook Hook, void *Data);
+
+/*===----------------------------------------------------------------------===
+ * Linking
+ *===----------------------------------------------------------------------===*/
+
+/* py_symbol - A function of the runtime and the name the IR calls it by. */
+struct py_symbol {
+  const char *name;
+  void *address;
+};
+
+/* Every function generated code may call, ended by an entry with a null
+ * name, for a JIT to resolve calls in generated code against. */
+extern const struct py_symbol py_runtime_symbols[];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,18 @@
+# RUN: cat %s | %py-lex 2>&1 | FileCheck %s
+
+# Runs longer than a vector register, to exercise the SIMD scanners.
+
+a_very_long_identifier_that_spans_more_than_thirty_two_bytes_0123456789 = 1
+# CHECK: Identifier<a_very_long_identifier_that_spans_more_than_thirty_two_bytes_0123456789>
+# CHECK: =
+# CHECK: Number<1>
+
+if x:
+                                            y
+# CHECK: Indent
+# CHECK: Identifier<y>
+# CHECK: Dedent
+
+z # a comment that is long enough to need more than one block to skip over it
+# CHECK: Identifier<z>
+# CHECK-NOT: error
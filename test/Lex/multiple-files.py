@@ -0,0 +1,8 @@
+# RUN: %py-lex %s %s 2>&1 | FileCheck %s
+
+first = 1
+# CHECK: Identifier<first>
+# CHECK: Number<1>
+# CHECK: Identifier<first>
+# CHECK: Number<1>
+# CHECK-NOT: Identifier<first>
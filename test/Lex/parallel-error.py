@@ -0,0 +1,11 @@
+# RUN: %py-lex -j 4 -lex-chunk-size=16 -verify-parallel %s | FileCheck %s
+
+# An error can only be reproduced exactly by lexing the whole buffer again,
+# but the result still has to match.
+x = (1,
+     2)
+y = 3 ]
+z = 4
+
+# CHECK: parallel lex matches ({{[0-9]+}} tokens, {{[2-9]|[1-9][0-9]+}} chunks, {{[0-9]+}} relexed)
+# CHECK: note: the buffer was lexed sequentially
@@ -0,0 +1,42 @@
+# RUN: %py-lex -j 4 -lex-chunk-size=32 -verify-parallel %s | FileCheck %s
+# RUN: %py-lex -j 4 -lex-chunk-size=32 %s | FileCheck -check-prefix=TOKENS %s
+
+def f(a, b):
+    if a:
+        x = (a,
+             b)
+        return """one
+two"""
+    y = a + \
+        b
+    # a comment with an open ( bracket
+    return 'it\'s'
+
+class C:
+    def g(self):
+        pass
+z = 1
+
+# The cuts fall inside the brackets, the strings, the joined line and the
+# comment above as well as between statements, so some chunks start in the
+# wrong state and have to be picked up again where the one before stopped.
+# CHECK: parallel lex matches ({{[0-9]+}} tokens, {{[2-9]|[1-9][0-9]+}} chunks, {{[1-9][0-9]*}} relexed)
+# CHECK-NOT: sequentially
+
+# TOKENS: Def
+# TOKENS: Identifier<f>
+# TOKENS: Indent
+# TOKENS: If
+# TOKENS: Indent
+# TOKENS-NOT: Indent
+# TOKENS: Return
+# TOKENS: Dedent
+# TOKENS: Class
+# TOKENS: Indent
+# TOKENS: Def
+# TOKENS: Indent
+# TOKENS: Pass
+# TOKENS: Newline
+# TOKENS-NEXT: Dedent
+# TOKENS-NEXT: Dedent
+# TOKENS-NEXT: Identifier<z>
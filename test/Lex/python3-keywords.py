@@ -0,0 +1,14 @@
+# RUN: cat %s | %py-lex -python3 | FileCheck %s
+
+# CHECK: Identifier<print>
+print
+# CHECK: Identifier<exec>
+exec
+# CHECK: With
+with
+# CHECK: True
+True
+# CHECK: False
+False
+# CHECK: Identifier<Truex>
+Truex
@@ -0,0 +1,47 @@
+# Each edit is made at a marker, a comment line with a '^' under the place
+# in the line above where the edit goes. The input is this file 64 times over
+# and the markers are found in the first copy, so an edit near the start of
+# a large input must only relex the few lines after it.
+# RUN: cat %s %s %s %s %s %s %s %s > %t.8
+# RUN: cat %t.8 %t.8 %t.8 %t.8 %t.8 %t.8 %t.8 %t.8 > %t
+# Insert into an identifier.
+# RUN: %py-lex -verify-relex -edit-marker=ident -edit-text=x %t \
+# RUN:   | FileCheck -check-prefix=BOUNDED %s
+# Open a block, which the rest of the class body then ends up in.
+# RUN: %py-lex -verify-relex -edit-marker=block -edit-text='if y:\n        ' %t \
+# RUN:   | FileCheck -check-prefix=BOUNDED %s
+# Open a string that swallows the rest of the file (this copy of it only,
+# as the next one would close the string).
+# RUN: %py-lex -verify-relex -edit-marker=string -edit-length=1 \
+# RUN:   -edit-text='"""' %s | FileCheck %s
+# Delete across lines, including a bracket.
+# RUN: %py-lex -verify-relex -edit-marker=delete -edit-end-marker=delete-end \
+# RUN:   %t | FileCheck -check-prefix=BOUNDED %s
+
+def f(a, b):
+    x = [a,
+         b]
+    if a:
+        return x
+#              ^ident
+    return "b"
+
+class C:
+    def g(self):
+#   ^block
+        y = 1 + \
+            2
+        # comment (
+#       ^delete
+        return y
+
+def h():
+#   ^delete-end
+    pass
+
+z = f(1, 2)
+w = C().g()
+#^string
+
+# CHECK: relex matches
+# BOUNDED: relex matches ({{[0-9][0-9][0-9][0-9]+}} tokens, {{[0-9]?[0-9]?[0-9]}} relexed)
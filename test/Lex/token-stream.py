@@ -0,0 +1,33 @@
+# RUN: %py-lex -token-stream %s 2>&1 | FileCheck %s
+
+def f(a, b):
+    return "x" + a
+# CHECK: Def
+# CHECK: Identifier<f>
+# CHECK: (
+# CHECK: Identifier<a>
+# CHECK: ,
+# CHECK: Identifier<b>
+# CHECK: )
+# CHECK: :
+# CHECK: Newline
+# CHECK: Indent
+# CHECK: Return
+# CHECK: String<\"x\">
+# CHECK: +
+# CHECK: Identifier<a>
+# CHECK: Newline
+# CHECK: Dedent
+
+x = (1,
+     2)
+# CHECK: Identifier<x>
+# CHECK: =
+# CHECK: (
+# CHECK: Number<1>
+# CHECK: ,
+# CHECK-NOT: Indent
+# CHECK: Number<2>
+# CHECK: )
+# CHECK: Newline
+# CHECK-NOT: error
@@ -0,0 +1,9 @@
+# RUN: %py-parse -j2 -rule atom -print-tree %s %s 2>&1 | FileCheck %s
+
+Hello
+# CHECK: (name "Hello")
+
+World
+# CHECK: (name "World")
+# CHECK: (name "Hello")
+# CHECK: (name "World")
@@ -0,0 +1,10 @@
+# RUN: rm -rf %t
+# RUN: %py-parse -cache-dir %t -print-module %s 2>&1 | FileCheck %s
+# RUN: ls %t | FileCheck -check-prefix=ENTRY %s
+# RUN: %py-parse -cache-dir %t -print-module %s 2>&1 | FileCheck %s
+# RUN: %py-parse -cache-dir %t -j1 -scheduler-stats %s %s 2>&1 \
+# RUN:   | FileCheck -check-prefix=WARM %s
+
+# CHECK: ModuleID = '{{.*}}cache.py'
+# ENTRY: {{^[0-9a-f]{32}\.bc$}}
+# WARM: cache: 2 hits, 0 misses
@@ -0,0 +1,21 @@
+# RUN: %py-parse -passes=py-namespaces,py-licm,py-stack-objects \
+# RUN:   -debug-pass=Arguments %s 2>&1 \
+# RUN:   | FileCheck %s
+# RUN: %py-parse -O2 -time-passes %s 2>&1 | FileCheck -check-prefix=TIME %s
+# RUN: %py-parse -O3 -j2 -print-module %s %s 2>&1 \
+# RUN:   | FileCheck -check-prefix=BATCH %s
+# RUN: not %py-parse -passes=py-namespaces,no-such-pass %s 2>&1 \
+# RUN:   | FileCheck -check-prefix=UNKNOWN %s
+# RUN: not %py-parse -O4 %s 2>&1 | FileCheck -check-prefix=LEVEL %s
+
+# The Parser generates no code for this yet, so these only check how the
+# pipelines are built; unittests/Transforms/PipelineTest.cpp checks what
+# they do to a loop of runtime calls.
+x = 1
+
+# CHECK: Pass Arguments:{{.*}} -py-namespaces {{.*}}-py-licm {{.*}}-py-stack-objects
+# TIME: Pass execution timing report
+# BATCH: ModuleID = '{{.*}}passes.py'
+# BATCH: ModuleID = '{{.*}}passes.py'
+# UNKNOWN: -passes: unknown pass 'no-such-pass'
+# LEVEL: invalid optimization level -O4
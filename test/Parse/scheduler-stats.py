@@ -0,0 +1,7 @@
+# RUN: %py-parse -j2 -scheduler-stats %s %s %s 2>&1 | FileCheck %s
+
+x = 1
+# CHECK: stage {{ *}}tasks {{ *}}steals {{ *}}overlap
+# CHECK-NEXT: lex {{ *}}3
+# CHECK-NEXT: parse {{ *}}3
+# CHECK-NEXT: optimize {{ *}}3
@@ -0,0 +1,17 @@
+# RUN: not %py-compile -entry=nosuch %s -o %t 2>&1 | FileCheck %s
+# RUN: rm -f %t.o
+# RUN: %py-compile -c %s -o %t.o
+# RUN: nm %t.o | count 0
+# RUN: %py-compile -shared %s -o %t.so
+# RUN: not %py-run -load=%t.so -entry=nosuch 2>&1 \
+# RUN:   | FileCheck -check-prefix=ENTRY %s
+# RUN: not %py-run -load=%t.missing.so 2>&1 | FileCheck -check-prefix=LOAD %s
+
+# The Parser generates no code for this yet, so the object defines no
+# symbols, there is no entry function to link an executable around, and
+# the shared object is only loaded, not run.
+x = 1
+
+# CHECK: no function 'nosuch' in module
+# ENTRY: no function 'nosuch' in {{.*}}.so
+# LOAD: missing.so
@@ -0,0 +1,3 @@
+# RUN: not %py-run -entry=nosuch %s 2>&1 | FileCheck %s
+
+# CHECK: no function 'nosuch' in module
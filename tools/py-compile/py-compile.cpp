@@ -0,0 +1,219 @@
+//===--- py-compile.cpp - Ahead-of-time compiler --------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This utility compiles a Python file to an object file, and links that into
+// an executable, or a shared object for py-run -load, so that running it
+// needs no JIT.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/CodeGen/ObjectEmitter.h"
+#include "py/Driver/Scheduler.h"
+#include "py/Lex/Lexer.h"
+#include "py/Parse/Parser.h"
+#include "py/Runtime/Runtime.h"
+#include "py/Support/SourceFile.h"
+#include "py/Transforms/Pipeline.h"
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+using namespace llvm;
+using namespace py;
+
+static cl::opt<std::string>
+InputFilename(cl::Positional, cl::desc("<input file>"), cl::init("-"));
+
+static cl::opt<std::string>
+OutputFilename("o", cl::desc("Output filename (default: a.out, or the input's "
+                             "name with .o under -c)"),
+               cl::value_desc("filename"));
+
+static cl::opt<bool>
+CompileOnly("c", cl::desc("Write the object file, without linking it"));
+
+static cl::opt<bool>
+Shared("shared", cl::desc("Link a shared object, to be loaded by a process "
+                          "that has the runtime, instead of an executable"));
+
+static cl::opt<std::string>
+Entry("entry", cl::desc("Function the executable runs (default: main)"),
+      cl::value_desc("function"), cl::init("main"));
+
+static cl::opt<char>
+OptLevel("O", cl::desc("Optimization level: -O0, -O1, -O2 or -O3 "
+                       "(default -O2)"),
+         cl::Prefix, cl::ZeroOrMore, cl::init('2'));
+
+static cl::opt<std::string>
+Passes("passes", cl::desc("Run these passes, separated by commas, instead "
+                          "of those of the -O level"),
+       cl::value_desc("pass,..."));
+
+static cl::opt<std::string>
+TargetTriple("mtriple", cl::desc("Target triple (default: the host's)"));
+
+static cl::opt<std::string>
+TargetCPU("mcpu", cl::desc("Target CPU (default: generic)"),
+          cl::value_desc("cpu-name"));
+
+static cl::opt<std::string>
+Linker("linker", cl::desc("C++ compiler driver to link with"),
+       cl::value_desc("program"), cl::init("c++"));
+
+static cl::opt<std::string>
+RuntimeLib("runtime-lib", cl::desc("The runtime library to link executables "
+                                   "with (default: lib/libpyrt.a next to "
+                                   "this program's bin)"),
+           cl::value_desc("path"));
+
+static LangFeatures GetFeatures() {
+  LangFeatures features;
+  features.setAllowWith(true);
+  features.setSpecialPrint(true);
+  features.setSpecialExec(true);
+  return features;
+}
+
+/// GetOutputFilename - Return -o, or what it defaults to.
+static std::string GetOutputFilename() {
+  if (!OutputFilename.empty())
+    return OutputFilename;
+  if (!CompileOnly)
+    return "a.out";
+  if (InputFilename == "-")
+    return "a.o";
+  return sys::path::stem(InputFilename).str() + ".o";
+}
+
+/// GetRuntimeLibrary - Return -runtime-lib, or the libpyrt.a built with this
+/// program: the build puts tools in bin and libraries in lib.
+static std::string GetRuntimeLibrary(const char *Argv0) {
+  if (!RuntimeLib.empty())
+    return RuntimeLib;
+  sys::Path P = sys::Path::GetMainExecutable(
+    Argv0, reinterpret_cast<void*>(GetRuntimeLibrary));
+  P.eraseComponent();
+  P.eraseComponent();
+  P.appendComponent("lib");
+  P.appendComponent("libpyrt.a");
+  return P.str();
+}
+
+/// WriteObject - Emit M to the object file Path. Returns false, having
+/// reported why, if it couldn't be.
+static bool WriteObject(const char *ProgName, ObjectEmitter &E, Module &M,
+                        StringRef Path) {
+  std::string Err;
+  OwningPtr<tool_output_file> Out(
+    new tool_output_file(Path.str().c_str(), Err, raw_fd_ostream::F_Binary));
+  if (!Err.empty()) {
+    errs() << ProgName << ": " << Err << '\n';
+    return false;
+  }
+  if (!E.emit(M, Out->os(), Err)) {
+    errs() << ProgName << ": " << Err << '\n';
+    return false;
+  }
+  Out->keep();
+  return true;
+}
+
+int main(int argc, char **argv) {
+  llvm_shutdown_obj Y;
+  char *ProgName = argv[0];
+  cl::ParseCommandLineOptions(argc, argv, "python ahead-of-time compiler");
+
+  if (OptLevel < '0' || OptLevel > '3') {
+    errs() << ProgName << ": invalid optimization level -O" << OptLevel
+           << '\n';
+    return 1;
+  }
+  Pipeline P(OptLevel - '0');
+  std::string Err;
+  if (!Passes.empty() && !P.parse(Passes, Err)) {
+    errs() << ProgName << ": -passes: " << Err << '\n';
+    return 1;
+  }
+
+  OwningPtr<ObjectEmitter> Emitter(
+    ObjectEmitter::create(TargetTriple, TargetCPU, OptLevel - '0', Err));
+  if (!Emitter) {
+    errs() << ProgName << ": " << Err << '\n';
+    return 1;
+  }
+
+  OwningPtr<MemoryBuffer> BufferPtr;
+  if (error_code ec = getSourceFile(InputFilename, BufferPtr)) {
+    errs() << ProgName << ": " << InputFilename << ": " << ec.message()
+           << '\n';
+    return 1;
+  }
+  MemoryBuffer *Buffer = BufferPtr.take();
+  SourceMgr SrcMgr;
+  SrcMgr.AddNewSourceBuffer(Buffer, SMLoc());
+
+  LLVMContext C;
+  Runtime R(C);
+  Module M(Buffer->getBufferIdentifier(), C);
+  // The code is generated, and optimized, for the target's pointer width.
+  Emitter->setTarget(M);
+  {
+    Lexer lex(Buffer, GetFeatures());
+    Parser Parse(lex, R, C, M, nulls());
+    bool Errors = false;
+    Parse.ParseFile();
+    EmitDiagnostics(lex, Parse, SrcMgr, errs(), Errors);
+    if (Errors)
+      return 1;
+  }
+
+  // An executable needs its C entry point before anything runs over it, so
+  // that the entry function is kept.
+  bool Link = !CompileOnly;
+  if (Link && !Shared && !addMainFunction(M, Entry, Err)) {
+    errs() << ProgName << ": " << Err << '\n';
+    return 1;
+  }
+
+  if (verifyModule(M, ReturnStatusAction, &Err)) {
+    errs() << ProgName << ": " << M.getModuleIdentifier()
+           << ": invalid module: " << Err << '\n';
+    return 1;
+  }
+  P.run(M);
+
+  std::string Output = GetOutputFilename();
+  if (!Link)
+    return WriteObject(ProgName, *Emitter, M, Output) ? 0 : 1;
+
+  sys::Path Object(Output + ".o");
+  if (Object.createTemporaryFileOnDisk(false, &Err)) {
+    errs() << ProgName << ": " << Err << '\n';
+    return 1;
+  }
+  bool Linked = false;
+  if (WriteObject(ProgName, *Emitter, M, Object.str())) {
+    std::vector<std::string> Objects(1, Object.str());
+    Linked = linkNative(Linker, Objects, GetRuntimeLibrary(argv[0]), Output,
+                        Shared, Err);
+    if (!Linked)
+      errs() << ProgName << ": " << Err << '\n';
+  }
+  Object.eraseFromDisk();
+  return Linked ? 0 : 1;
+}
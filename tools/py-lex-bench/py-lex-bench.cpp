@@ -0,0 +1,436 @@
+#include "py/Lex/Lexer.h"
+#include "py/Lex/CharScan.h"
+#include "py/Support/SourceFile.h"
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(LLVM_ON_UNIX)
+#include <sys/resource.h>
+#endif
+using namespace llvm;
+using namespace py;
+
+static cl::list<std::string>
+InputFilenames(cl::Positional, cl::desc("<input files or directories>"),
+               cl::ZeroOrMore);
+
+static cl::opt<unsigned>
+Repeat("repeat", cl::desc("Number of times to lex each input"),
+       cl::value_desc("N"), cl::init(10));
+
+static cl::list<charscan::Implementation>
+Scanners("scanner", cl::desc("Scanner implementations to compare "
+                             "(default: all supported)"),
+         cl::CommaSeparated,
+         cl::values(clEnumValN(charscan::Table, "table",
+                               "A table lookup per byte, as the Lexer "
+                               "used to (the baseline)"),
+                    clEnumValN(charscan::Scalar, "scalar",
+                               "Range checks, one byte at a time"),
+                    clEnumValN(charscan::SSE2, "sse2", "16 bytes at a time"),
+                    clEnumValN(charscan::AVX2, "avx2", "32 bytes at a time"),
+                    clEnumValEnd));
+
+namespace {
+enum CorpusKind {
+  DeepIndent,
+  LongStrings,
+  DenseOperators,
+  LongIdentifiers
+};
+}
+
+static cl::list<CorpusKind>
+Generate("generate", cl::desc("Synthesize corpora to lex"),
+         cl::CommaSeparated,
+         cl::values(clEnumValN(DeepIndent, "deep-indent",
+                               "Blocks nested up to 100 levels deep"),
+                    clEnumValN(LongStrings, "long-strings",
+                               "Kilobyte strings, with and without escapes"),
+                    clEnumValN(DenseOperators, "dense-operators",
+                               "Expressions made mostly of operators"),
+                    clEnumValN(LongIdentifiers, "long-identifiers",
+                               "Identifiers of 64 to 255 characters"),
+                    clEnumValEnd));
+
+static cl::opt<unsigned>
+GenerateSize("generate-size",
+             cl::desc("Approximate size of each synthesized corpus"),
+             cl::value_desc("bytes"), cl::init(4 << 20));
+
+static cl::opt<bool>
+JSON("json", cl::desc("Print the results as JSON"));
+
+//===----------------------------------------------------------------------===//
+// Allocation counting.
+//===----------------------------------------------------------------------===//
+
+/// Number of calls to operator new since the program started. The benchmark
+/// is single threaded, so a plain counter will do.
+static uint64_t NumAllocations;
+
+void *operator new(size_t Size) throw(std::bad_alloc) {
+  ++NumAllocations;
+  void *P = std::malloc(Size ? Size : 1);
+  if (!P)
+    throw std::bad_alloc();
+  return P;
+}
+
+void operator delete(void *P) throw() {
+  std::free(P);
+}
+
+/// getPeakRSS - Return the peak resident set size of the process in
+/// kilobytes, or 0 if it isn't known.
+static uint64_t getPeakRSS() {
+#if defined(LLVM_ON_UNIX)
+  struct rusage Usage;
+  if (getrusage(RUSAGE_SELF, &Usage) != 0)
+    return 0;
+#if defined(__APPLE__)
+  // Darwin reports bytes, everyone else kilobytes.
+  return Usage.ru_maxrss / 1024;
+#else
+  return Usage.ru_maxrss;
+#endif
+#else
+  return 0;
+#endif
+}
+
+//===----------------------------------------------------------------------===//
+// Corpus generation.
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// CorpusWriter - Appends deterministic pseudo-random Python to a string.
+class CorpusWriter {
+  std::string &Out;
+  uint32_t Seed;
+
+public:
+  explicit CorpusWriter(std::string &Out) : Out(Out), Seed(12345) {}
+
+  /// Next - Return a pseudo-random number in [0, N).
+  unsigned Next(unsigned N) {
+    Seed = Seed * 1103515245 + 12345;
+    return (Seed >> 16) % N;
+  }
+
+  void Indent(unsigned Depth) { Out.append(Depth * 2, ' '); }
+
+  void Name(unsigned Length) {
+    static const char Chars[] =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+    Out += Chars[Next(53)];
+    for (unsigned i = 1; i < Length; ++i)
+      Out += Chars[Next(sizeof(Chars) - 1)];
+  }
+
+  CorpusWriter &operator<<(StringRef S) {
+    Out.append(S.begin(), S.end());
+    return *this;
+  }
+};
+}
+
+static void GenerateDeepIndent(CorpusWriter &W) {
+  // Nest one block per level down to a random depth, then come back out.
+  unsigned Depth = 1 + W.Next(100);
+  static const char *const Headers[] = {
+    "if x:\n", "for i in y:\n", "while z:\n"
+  };
+  for (unsigned d = 0; d != Depth; ++d) {
+    W.Indent(d);
+    W << Headers[d % 3];
+  }
+  for (unsigned d = Depth; d != 0; --d) {
+    W.Indent(d);
+    W << "a = b\n";
+  }
+}
+
+static void GenerateLongStrings(CorpusWriter &W) {
+  static const char Text[] = "lorem ipsum dolor sit amet ";
+  unsigned Length = 1024 + W.Next(3072);
+  switch (W.Next(3)) {
+  case 0:
+    W << "s = \"";
+    for (unsigned i = 0; i < Length; i += sizeof(Text) - 1)
+      W << Text;
+    W << "\"\n";
+    break;
+  case 1:
+    W << "s = 'escapes\\n";
+    for (unsigned i = 0; i < Length; i += 8)
+      W << "\\t\\x41\\'\\\\";
+    W << "'\n";
+    break;
+  default:
+    W << "s = \"\"\"\n";
+    for (unsigned i = 0; i < Length; i += 64)
+      W << "  a docstring line with \"quotes\" and 'apostrophes' in it\n";
+    W << "\"\"\"\n";
+    break;
+  }
+}
+
+static void GenerateDenseOperators(CorpusWriter &W) {
+  static const char *const Ops[] = {
+    "+", "-", "*", "/", "//", "%", "**", "<<", ">>", "&", "|", "^",
+    "<", ">", "<=", ">=", "==", "!="
+  };
+  static const char *const AugOps[] = {
+    "=", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "<<=", ">>="
+  };
+  W << "x" << AugOps[W.Next(sizeof(AugOps) / sizeof(AugOps[0]))];
+  unsigned Terms = 8 + W.Next(24);
+  for (unsigned i = 0; i != Terms; ++i) {
+    if (i)
+      W << Ops[W.Next(sizeof(Ops) / sizeof(Ops[0]))];
+    switch (W.Next(4)) {
+    case 0: W << "(a[i]-~b)"; break;
+    case 1: W << "f(c,d)"; break;
+    case 2: W << "-e.g"; break;
+    default: W << "1"; break;
+    }
+  }
+  W << "\n";
+}
+
+static void GenerateLongIdentifiers(CorpusWriter &W) {
+  W.Name(64 + W.Next(192));
+  W << " = ";
+  W.Name(64 + W.Next(192));
+  W << ".";
+  W.Name(64 + W.Next(192));
+  W << "(";
+  W.Name(64 + W.Next(192));
+  W << ")\n";
+}
+
+static const char *getCorpusName(CorpusKind K) {
+  switch (K) {
+  case DeepIndent: return "deep-indent";
+  case LongStrings: return "long-strings";
+  case DenseOperators: return "dense-operators";
+  case LongIdentifiers: return "long-identifiers";
+  }
+  return "unknown";
+}
+
+/// GenerateCorpus - Return a buffer of about Size bytes of synthesized Python
+/// of kind K.
+static MemoryBuffer *GenerateCorpus(CorpusKind K, unsigned Size) {
+  std::string Text;
+  Text.reserve(Size + 4096);
+  CorpusWriter W(Text);
+  while (Text.size() < Size) {
+    switch (K) {
+    case DeepIndent: GenerateDeepIndent(W); break;
+    case LongStrings: GenerateLongStrings(W); break;
+    case DenseOperators: GenerateDenseOperators(W); break;
+    case LongIdentifiers: GenerateLongIdentifiers(W); break;
+    }
+  }
+  return MemoryBuffer::getMemBufferCopy(Text, getCorpusName(K));
+}
+
+//===----------------------------------------------------------------------===//
+// Benchmark.
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Corpus - A named set of buffers that is timed as one unit.
+struct Corpus {
+  std::string Name;
+  std::vector<MemoryBuffer*> Buffers;
+  uint64_t Bytes;
+
+  explicit Corpus(StringRef Name) : Name(Name), Bytes(0) {}
+
+  void add(MemoryBuffer *B) {
+    Buffers.push_back(B);
+    Bytes += B->getBufferSize();
+  }
+};
+
+/// Result - The measurements of one corpus under one scanner.
+struct Result {
+  std::string Corpus;
+  charscan::Implementation Scanner;
+  uint64_t Bytes;
+  uint64_t Tokens;
+  uint64_t Allocations;
+  double Seconds;
+
+  double getMBs() const { return Bytes / Seconds / (1024 * 1024); }
+  double getTokensPerSecond() const { return Tokens / Seconds; }
+};
+}
+
+/// LexAll - Lex Buf to the end, returning the number of tokens seen.
+static uint64_t LexAll(const MemoryBuffer *Buf) {
+  LangFeatures Features;
+  Lexer L(Buf, Features);
+  Token T;
+  uint64_t NumTokens = 0;
+  while (L.Lex(T)) {
+    ++NumTokens;
+    if (T.getKind() == tok::eof)
+      break;
+  }
+  return NumTokens;
+}
+
+/// AddInput - Add Path to C, walking it for .py files if it is a directory.
+static bool AddInput(const char *ProgName, StringRef Path, Corpus &C) {
+  std::vector<std::string> Files;
+  if (error_code ec = collectSourceFiles(Path, Files)) {
+    errs() << ProgName << ": " << Path << ": " << ec.message() << '\n';
+    return false;
+  }
+
+  for (unsigned i = 0, e = Files.size(); i != e; ++i) {
+    OwningPtr<MemoryBuffer> BufferPtr;
+    if (error_code ec = getSourceFile(Files[i], BufferPtr)) {
+      errs() << ProgName << ": " << Files[i] << ": " << ec.message() << '\n';
+      return false;
+    }
+    C.add(BufferPtr.take());
+  }
+  return true;
+}
+
+/// Measure - Time Repeat passes of the lexer over C.
+static Result Measure(const Corpus &C, charscan::Implementation Impl) {
+  // One untimed pass to warm the caches.
+  for (unsigned b = 0, be = C.Buffers.size(); b != be; ++b)
+    LexAll(C.Buffers[b]);
+
+  Result R;
+  R.Corpus = C.Name;
+  R.Scanner = Impl;
+  R.Bytes = C.Bytes * Repeat;
+  R.Tokens = 0;
+  uint64_t AllocationsBefore = NumAllocations;
+  sys::TimeValue Start = sys::TimeValue::now();
+  for (unsigned r = 0; r != Repeat; ++r)
+    for (unsigned b = 0, be = C.Buffers.size(); b != be; ++b)
+      R.Tokens += LexAll(C.Buffers[b]);
+  sys::TimeValue Elapsed = sys::TimeValue::now() - Start;
+  R.Allocations = NumAllocations - AllocationsBefore;
+
+  R.Seconds = Elapsed.usec() / 1e6;
+  if (R.Seconds <= 0)
+    R.Seconds = 1e-6;
+  return R;
+}
+
+static void PrintJSON(const std::vector<Result> &Results, raw_ostream &OS) {
+  OS << "{\n  \"repeat\": " << Repeat << ",\n  \"results\": [";
+  for (unsigned i = 0, e = Results.size(); i != e; ++i) {
+    const Result &R = Results[i];
+    OS << (i ? ",\n" : "\n") << "    {\"corpus\": \"";
+    OS.write_escaped(R.Corpus);
+    OS << "\", \"scanner\": \"" << charscan::getName(R.Scanner)
+       << "\", \"bytes\": " << R.Bytes
+       << ", \"tokens\": " << R.Tokens
+       << ", \"allocations\": " << R.Allocations
+       << format(", \"seconds\": %.6f", R.Seconds)
+       << format(", \"mb_per_s\": %.2f", R.getMBs())
+       << format(", \"tokens_per_s\": %.0f", R.getTokensPerSecond())
+       << "}";
+  }
+  OS << "\n  ],\n  \"peak_rss_kb\": " << getPeakRSS() << "\n}\n";
+}
+
+int main(int argc, char **argv) {
+  char *ProgName = argv[0];
+  cl::ParseCommandLineOptions(argc, argv, "python lexer benchmark");
+
+  if (InputFilenames.empty() && Generate.empty()) {
+    errs() << ProgName << ": no input files or -generate corpora\n";
+    return 1;
+  }
+
+  std::vector<Corpus*> Corpora;
+  for (unsigned i = 0, e = Generate.size(); i != e; ++i) {
+    Corpus *C = new Corpus(getCorpusName(Generate[i]));
+    C->add(GenerateCorpus(Generate[i], GenerateSize));
+    Corpora.push_back(C);
+  }
+  if (!InputFilenames.empty()) {
+    Corpus *C = new Corpus("files");
+    Corpora.push_back(C);
+    for (unsigned i = 0, e = InputFilenames.size(); i != e; ++i)
+      if (!AddInput(ProgName, InputFilenames[i], *C))
+        return 1;
+  }
+
+  std::vector<charscan::Implementation> Impls(Scanners.begin(),
+                                              Scanners.end());
+  if (Impls.empty()) {
+    Impls.push_back(charscan::Table);
+    Impls.push_back(charscan::Scalar);
+    Impls.push_back(charscan::SSE2);
+    Impls.push_back(charscan::AVX2);
+  }
+
+  std::vector<Result> Results;
+  for (unsigned c = 0, ce = Corpora.size(); c != ce; ++c) {
+    const Corpus &C = *Corpora[c];
+    if (!JSON)
+      outs() << C.Name << " (" << C.Buffers.size() << " files, "
+             << format("%.1f", C.Bytes / (1024.0 * 1024)) << " MB)\n";
+
+    double BaselineMBs = 0;
+    for (unsigned i = 0, e = Impls.size(); i != e; ++i) {
+      if (!charscan::select(Impls[i])) {
+        if (!JSON)
+          outs() << format("  %-8s", charscan::getName(Impls[i]))
+                 << " unsupported on this host\n";
+        continue;
+      }
+
+      Result R = Measure(C, Impls[i]);
+      Results.push_back(R);
+      if (JSON)
+        continue;
+
+      if (Impls[i] == charscan::Table)
+        BaselineMBs = R.getMBs();
+      outs() << format("  %-8s %10.1f MB/s %12.0f tokens/s %8llu allocs",
+                       charscan::getName(Impls[i]), R.getMBs(),
+                       R.getTokensPerSecond(),
+                       (unsigned long long)R.Allocations);
+      if (BaselineMBs > 0 && Impls[i] != charscan::Table)
+        outs() << format("  (%.2fx table)", R.getMBs() / BaselineMBs);
+      outs() << '\n';
+    }
+  }
+
+  if (JSON)
+    PrintJSON(Results, outs());
+  else
+    outs() << "peak RSS " << getPeakRSS() << " KB\n";
+
+  for (unsigned c = 0, ce = Corpora.size(); c != ce; ++c) {
+    for (unsigned b = 0, be = Corpora[c]->Buffers.size(); b != be; ++b)
+      delete Corpora[c]->Buffers[b];
+    delete Corpora[c];
+  }
+  return 0;
+}
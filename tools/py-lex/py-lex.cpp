@@ -1,4 +1,7 @@
 #include "py/Lex/Lexer.h"
+#include "py/Lex/TokenStream.h"
+#include "py/Support/Parallel.h"
+#include "py/Support/SourceFile.h"
 
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/Support/CommandLine.h"
@@ -12,13 +15,161 @@
 using namespace llvm;
 using namespace py;
 
-static cl::opt<std::string>
-InputFilename(cl::Positional, cl::desc("<input file>"), cl::init("-"));
+static cl::list<std::string>
+InputFilenames(cl::Positional, cl::desc("<input files>"));
 
 static cl::opt<std::string>
 OutputFilename("o", cl::desc("Output filename"),
                cl::value_desc("filename"));
 
+static cl::opt<bool>
+Python3("python3", cl::desc("Lex with Python 3 keyword rules"));
+
+static cl::opt<bool>
+UseTokenStream("token-stream",
+               cl::desc("Lex the whole file into a TokenStream first"));
+
+static cl::opt<unsigned>
+NumThreads("j", cl::desc("Lex large files on N threads (implies "
+                         "-token-stream; 0 means one per CPU)"),
+           cl::value_desc("N"), cl::init(1), cl::Prefix);
+
+static cl::opt<unsigned>
+ChunkSize("lex-chunk-size",
+          cl::desc("Approximate bytes per chunk when lexing in parallel"),
+          cl::value_desc("bytes"), cl::init(TokenStream::DefaultChunkSize));
+
+static cl::opt<bool>
+VerifyParallel("verify-parallel",
+               cl::desc("Check that parallel lexing matches sequential "
+                        "lexing, then exit"));
+
+static cl::opt<bool>
+VerifyRelex("verify-relex",
+            cl::desc("Apply the -edit-* edit, relex incrementally, check that "
+                     "the result matches lexing the edited file, then exit"));
+
+static cl::opt<unsigned>
+EditOffset("edit-offset", cl::desc("Offset of the edit for -verify-relex"),
+           cl::init(0));
+
+static cl::opt<unsigned>
+EditLength("edit-length",
+           cl::desc("Number of bytes the edit for -verify-relex replaces"),
+           cl::init(0));
+
+static cl::opt<std::string>
+EditMarker("edit-marker",
+           cl::desc("Make the edit for -verify-relex at marker NAME instead "
+                    "of -edit-offset"),
+           cl::value_desc("NAME"));
+
+static cl::opt<std::string>
+EditEndMarker("edit-end-marker",
+              cl::desc("End the text the edit for -verify-relex replaces at "
+                       "marker NAME instead of after -edit-length bytes"),
+              cl::value_desc("NAME"));
+
+static cl::opt<std::string>
+EditText("edit-text",
+         cl::desc("Replacement text for -verify-relex ('\\n' and '\\t' "
+                  "are newline and tab)"));
+
+/// FindMarker - Return the offset marker Name in Text stands for, or -1 if
+/// there is none. A marker is a comment line of just '#', spaces and '^'
+/// followed by Name; it stands for the column of the '^' in the line above.
+static int FindMarker(StringRef Text, StringRef Name) {
+  std::string Caret = "^" + Name.str();
+  for (size_t P = Text.find(Caret); P != StringRef::npos;
+       P = Text.find(Caret, P + 1)) {
+    size_t End = P + Caret.size();
+    if (End < Text.size() && Text[End] != '\n' && Text[End] != '\r')
+      continue;
+    size_t LineStart = Text.rfind('\n', P) + 1;
+    StringRef Prefix = Text.slice(LineStart, P);
+    if (LineStart == 0 || !Prefix.startswith("#") ||
+        Prefix.find_first_not_of("# ") != StringRef::npos)
+      continue;
+    size_t AboveStart = Text.rfind('\n', LineStart - 1) + 1;
+    if (AboveStart + (P - LineStart) >= LineStart)
+      continue;
+    return AboveStart + (P - LineStart);
+  }
+  return -1;
+}
+
+/// VerifyRelexing - Apply the edit given on the command line to Buffer and
+/// check that relexing agrees with lexing the edited buffer from scratch.
+static int VerifyRelexing(const MemoryBuffer *Buffer, LangFeatures Features,
+                          raw_ostream &OS) {
+  StringRef Text = Buffer->getBuffer();
+  unsigned EditStart = EditOffset, EditSize = EditLength;
+  if (!EditMarker.empty()) {
+    int Offset = FindMarker(Text, EditMarker);
+    if (Offset < 0) {
+      errs() << "no marker '" << EditMarker << "' in the input\n";
+      return 1;
+    }
+    EditStart = Offset;
+  }
+  if (!EditEndMarker.empty()) {
+    int Offset = FindMarker(Text, EditEndMarker);
+    if (Offset < int(EditStart)) {
+      errs() << "no marker '" << EditEndMarker << "' after the edit\n";
+      return 1;
+    }
+    EditSize = Offset - EditStart;
+  }
+  if (EditStart > Text.size() || EditSize > Text.size() - EditStart) {
+    errs() << "edit is outside the input\n";
+    return 1;
+  }
+
+  std::string Replacement;
+  for (unsigned i = 0, e = EditText.size(); i != e; ++i) {
+    if (EditText[i] == '\\' && i + 1 != e &&
+        (EditText[i+1] == 'n' || EditText[i+1] == 't')) {
+      Replacement += EditText[++i] == 'n' ? '\n' : '\t';
+      continue;
+    }
+    Replacement += EditText[i];
+  }
+
+  std::string Edited = Text.substr(0, EditStart).str() + Replacement +
+    Text.substr(EditStart + EditSize).str();
+  OwningPtr<MemoryBuffer> NewBuffer(
+    MemoryBuffer::getMemBufferCopy(Edited, Buffer->getBufferIdentifier()));
+
+  TokenStream Old(Buffer), Relexed(NewBuffer.get()), Fresh(NewBuffer.get());
+  Lexer L1(Buffer, Features);
+  Old.tokenize(L1);
+  Lexer L2(NewBuffer.get(), Features);
+  unsigned NumLexed = 0;
+  L2.relex(Old, EditRange(EditStart, EditSize, Replacement.size()),
+           Relexed, &NumLexed);
+  Lexer L3(NewBuffer.get(), Features);
+  Fresh.tokenize(L3);
+
+  if (!Fresh.isEquivalentTo(Relexed, &OS))
+    return 1;
+  OS << "relex matches (" << Relexed.size() << " tokens, " << NumLexed
+     << " relexed)\n";
+  return 0;
+}
+
+/// NextToken - Get the next token, either straight from the Lexer or from a
+/// TokenStream that has already been filled.
+static bool NextToken(Lexer &L, TokenStream *S, unsigned &Idx, Token &T) {
+  if (!S)
+    return L.Lex(T);
+  if (Idx == S->size())
+    return false;
+  S->getToken(Idx++, T);
+  // A stream cut short by an error ends in a synthesized eof; report it the
+  // way Lexer::Lex reports the error.
+  return !(S->hasErrors() && Idx == S->size());
+}
+
 static tool_output_file *GetOutputStream() {
   if (OutputFilename == "")
     OutputFilename = "-";
@@ -35,134 +186,194 @@ static tool_output_file *GetOutputStream() {
   return Out;
 }
 
-int main(int argc, char **argv)  {
-  char *ProgName = argv[0];
-  cl::ParseCommandLineOptions(argc, argv,
-                              "python lexing playground");
-  
-  OwningPtr<MemoryBuffer> BufferPtr;
-  if (error_code ec = MemoryBuffer::getFileOrSTDIN(InputFilename, BufferPtr)) {
-    errs() << ProgName << ": " << ec.message() << '\n';
-    return 1;
-  }
-  MemoryBuffer *Buffer = BufferPtr.take();
-
-  SourceMgr SrcMgr;
-
-  // Tell SrcMgr about this buffer, which is what TGParser will pick up.
-  SrcMgr.AddNewSourceBuffer(Buffer, SMLoc());
+/// LexFile - Lex Buffer, which SrcMgr owns, and print its tokens (or check
+/// them, under -verify-*) to OS. Returns the exit code for this file.
+static int LexFile(MemoryBuffer *Buffer, SourceMgr &SrcMgr,
+                   const LangFeatures &features, unsigned Threads,
+                   raw_ostream &OS) {
+  if (VerifyRelex)
+    return VerifyRelexing(Buffer, features, OS);
 
-  OwningPtr<tool_output_file> Out(GetOutputStream());
-  if (!Out)
-    return 1;
+  if (VerifyParallel) {
+    TokenStream Sequential(Buffer), Parallel(Buffer);
+    Lexer L(Buffer, features);
+    Sequential.tokenize(L);
+    TokenStream::ParallelStats Stats;
+    Parallel.tokenizeParallel(features, Threads, ChunkSize, &Stats);
+    if (!Sequential.isEquivalentTo(Parallel, &OS))
+      return 1;
+    OS << "parallel lex matches (" << Parallel.size() << " tokens, "
+       << Stats.Chunks << " chunks, " << Stats.Relexed << " relexed)\n";
+    if (Stats.Chunks == 1 || Stats.Sequential)
+      OS << "note: the buffer was lexed sequentially\n";
+    return 0;
+  }
 
-  LangFeatures features;
-  
   Lexer lex(Buffer, features);
+  OwningPtr<TokenStream> Stream;
+  if (Threads > 1) {
+    Stream.reset(new TokenStream(Buffer));
+    Stream->tokenizeParallel(features, Threads, ChunkSize);
+  } else if (UseTokenStream) {
+    Stream.reset(new TokenStream(Buffer));
+    Stream->tokenize(lex);
+  }
+
   Token Result;
-  while (lex.Lex(Result)) {
+  unsigned NextIdx = 0;
+  bool ReachedEOF = false;
+  while (NextToken(lex, Stream.get(), NextIdx, Result)) {
+    if (Result.getKind() == tok::eof) {
+      ReachedEOF = true;
+      break;
+    }
+
     switch (Result.getKind()) {
-    case tok::eof:
-      return 0;
-    case tok::unknown: Out->os() << "Unknown"; break;
-    case tok::identifier: Out->os() << "Identifier"; break;
-    case tok::numeric_constant: Out->os() << "Number"; break;
-    case tok::string_constant: Out->os() << "String"; break;
-    case tok::newline: Out->os() << "Newline\n"; continue;
-    case tok::indent: Out->os() << "Indent\n"; continue;
-    case tok::dedent: Out->os() << "Dedent\n"; continue;
-
-    case tok::kw_and: Out->os() << "And\n"; continue;
-    case tok::kw_as: Out->os() << "As\n"; continue;
-    case tok::kw_assert: Out->os() << "Assert\n"; continue;
-    case tok::kw_break: Out->os() << "Break\n"; continue;
-    case tok::kw_class: Out->os() << "Class\n"; continue;
-    case tok::kw_continue: Out->os() << "Continue\n"; continue;
-    case tok::kw_def: Out->os() << "Def\n"; continue;
-    case tok::kw_del: Out->os() << "Del\n"; continue;
-    case tok::kw_elif: Out->os() << "Elif\n"; continue;
-    case tok::kw_else: Out->os() << "Else\n"; continue;
-    case tok::kw_except: Out->os() << "Except\n"; continue;
-    case tok::kw_exec: Out->os() << "Exec\n"; continue;
-    case tok::kw_finally: Out->os() << "Finally\n"; continue;
-    case tok::kw_for: Out->os() << "For\n"; continue;
-    case tok::kw_from: Out->os() << "From\n"; continue;
-    case tok::kw_global: Out->os() << "Global\n"; continue;
-    case tok::kw_if: Out->os() << "If\n"; continue;
-    case tok::kw_import: Out->os() << "Import\n"; continue;
-    case tok::kw_in: Out->os() << "In\n"; continue;
-    case tok::kw_is: Out->os() << "Is\n"; continue;
-    case tok::kw_lambda: Out->os() << "Lambda\n"; continue;
-    case tok::kw_not: Out->os() << "Not\n"; continue;
-    case tok::kw_or: Out->os() << "Or\n"; continue;
-    case tok::kw_pass: Out->os() << "Pass\n"; continue;
-    case tok::kw_print: Out->os() << "Print\n"; continue;
-    case tok::kw_raise: Out->os() << "Raise\n"; continue;
-    case tok::kw_return: Out->os() << "Return\n"; continue;
-    case tok::kw_try: Out->os() << "Try\n"; continue;
-    case tok::kw_while: Out->os() << "While\n"; continue;
-    case tok::kw_with: Out->os() << "With\n"; continue;
-    case tok::kw_yield: Out->os() << "Yield\n"; continue;
-
-    case tok::l_square: Out->os() << "[\n"; continue;
-    case tok::r_square: Out->os() << "]\n"; continue;
-    case tok::l_paren: Out->os() << "(\n"; continue;
-    case tok::r_paren: Out->os() << ")\n"; continue;
-    case tok::l_brace: Out->os() << "{\n"; continue;
-    case tok::r_brace: Out->os() << "}\n"; continue;
-
-    case tok::period: Out->os() << ".\n"; continue;
-    case tok::ellipsis: Out->os() << "...\n"; continue;
-    case tok::amp: Out->os() << "&\n"; continue;
-    case tok::ampequal: Out->os() << "&=\n"; continue;
-    case tok::star: Out->os() << "*\n"; continue;
-    case tok::starstar: Out->os() << "**\n"; continue;
-    case tok::starequal: Out->os() << "*=\n"; continue;
-    case tok::plus: Out->os() << "+\n"; continue;
-    case tok::plusequal: Out->os() << "+=\n"; continue;
-    case tok::minus: Out->os() << "-\n"; continue;
-    case tok::minusequal: Out->os() << "-=\n"; continue;
-    case tok::tilde: Out->os() << "~\n"; continue;
-    case tok::slash: Out->os() << "/\n"; continue;
-    case tok::slashslash: Out->os() << "//\n"; continue;
-    case tok::slashequal: Out->os() << "/=\n"; continue;
-    case tok::percent: Out->os() << "%\n"; continue;
-    case tok::percentequal: Out->os() << "%=\n"; continue;
-    case tok::less: Out->os() << "<\n"; continue;
-    case tok::lessless: Out->os() << "<<\n"; continue;
-    case tok::lessequal: Out->os() << "<=\n"; continue;
-    case tok::lesslessequal: Out->os() << "<<=\n"; continue;
-    case tok::greater: Out->os() << ">\n"; continue;
-    case tok::greaterequal: Out->os() << ">=\n"; continue;
-    case tok::greatergreater: Out->os() << ">>\n"; continue;
-    case tok::greatergreaterequal: Out->os() << ">>=\n"; continue;
-    case tok::caret: Out->os() << "^\n"; continue;
-    case tok::caretequal: Out->os() << "^=\n"; continue;
-    case tok::pipe: Out->os() << "|\n"; continue;
-    case tok::pipeequal: Out->os() << "|=\n"; continue;
-    case tok::colon: Out->os() << ":\n"; continue;
-    case tok::semi: Out->os() << ";\n"; continue;
-    case tok::equal: Out->os() << "=\n"; continue;
-    case tok::equalequal: Out->os() << "==\n"; continue;
-    case tok::comma: Out->os() << ",\n"; continue;
-    case tok::at: Out->os() << "@\n"; continue;
-    case tok::bangequal: Out->os() << "!=\n"; continue;
-    case tok::backtick: Out->os() << "`\n"; continue;
-
-    default: Out->os() << "UnhandledToken"; break;
+    case tok::unknown: OS << "Unknown"; break;
+    case tok::identifier: OS << "Identifier"; break;
+    case tok::numeric_constant: OS << "Number"; break;
+    case tok::string_constant: OS << "String"; break;
+    case tok::newline: OS << "Newline\n"; continue;
+    case tok::indent: OS << "Indent\n"; continue;
+    case tok::dedent: OS << "Dedent\n"; continue;
+
+    case tok::kw_and: OS << "And\n"; continue;
+    case tok::kw_as: OS << "As\n"; continue;
+    case tok::kw_assert: OS << "Assert\n"; continue;
+    case tok::kw_break: OS << "Break\n"; continue;
+    case tok::kw_class: OS << "Class\n"; continue;
+    case tok::kw_continue: OS << "Continue\n"; continue;
+    case tok::kw_def: OS << "Def\n"; continue;
+    case tok::kw_del: OS << "Del\n"; continue;
+    case tok::kw_elif: OS << "Elif\n"; continue;
+    case tok::kw_else: OS << "Else\n"; continue;
+    case tok::kw_except: OS << "Except\n"; continue;
+    case tok::kw_exec: OS << "Exec\n"; continue;
+    case tok::kw_finally: OS << "Finally\n"; continue;
+    case tok::kw_for: OS << "For\n"; continue;
+    case tok::kw_from: OS << "From\n"; continue;
+    case tok::kw_global: OS << "Global\n"; continue;
+    case tok::kw_if: OS << "If\n"; continue;
+    case tok::kw_import: OS << "Import\n"; continue;
+    case tok::kw_in: OS << "In\n"; continue;
+    case tok::kw_is: OS << "Is\n"; continue;
+    case tok::kw_lambda: OS << "Lambda\n"; continue;
+    case tok::kw_not: OS << "Not\n"; continue;
+    case tok::kw_or: OS << "Or\n"; continue;
+    case tok::kw_pass: OS << "Pass\n"; continue;
+    case tok::kw_print: OS << "Print\n"; continue;
+    case tok::kw_raise: OS << "Raise\n"; continue;
+    case tok::kw_return: OS << "Return\n"; continue;
+    case tok::kw_try: OS << "Try\n"; continue;
+    case tok::kw_while: OS << "While\n"; continue;
+    case tok::kw_with: OS << "With\n"; continue;
+    case tok::kw_yield: OS << "Yield\n"; continue;
+    case tok::kw_True: OS << "True\n"; continue;
+    case tok::kw_False: OS << "False\n"; continue;
+
+    case tok::l_square: OS << "[\n"; continue;
+    case tok::r_square: OS << "]\n"; continue;
+    case tok::l_paren: OS << "(\n"; continue;
+    case tok::r_paren: OS << ")\n"; continue;
+    case tok::l_brace: OS << "{\n"; continue;
+    case tok::r_brace: OS << "}\n"; continue;
+
+    case tok::period: OS << ".\n"; continue;
+    case tok::ellipsis: OS << "...\n"; continue;
+    case tok::amp: OS << "&\n"; continue;
+    case tok::ampequal: OS << "&=\n"; continue;
+    case tok::star: OS << "*\n"; continue;
+    case tok::starstar: OS << "**\n"; continue;
+    case tok::starequal: OS << "*=\n"; continue;
+    case tok::plus: OS << "+\n"; continue;
+    case tok::plusequal: OS << "+=\n"; continue;
+    case tok::minus: OS << "-\n"; continue;
+    case tok::minusequal: OS << "-=\n"; continue;
+    case tok::tilde: OS << "~\n"; continue;
+    case tok::slash: OS << "/\n"; continue;
+    case tok::slashslash: OS << "//\n"; continue;
+    case tok::slashequal: OS << "/=\n"; continue;
+    case tok::percent: OS << "%\n"; continue;
+    case tok::percentequal: OS << "%=\n"; continue;
+    case tok::less: OS << "<\n"; continue;
+    case tok::lessless: OS << "<<\n"; continue;
+    case tok::lessequal: OS << "<=\n"; continue;
+    case tok::lesslessequal: OS << "<<=\n"; continue;
+    case tok::greater: OS << ">\n"; continue;
+    case tok::greaterequal: OS << ">=\n"; continue;
+    case tok::greatergreater: OS << ">>\n"; continue;
+    case tok::greatergreaterequal: OS << ">>=\n"; continue;
+    case tok::caret: OS << "^\n"; continue;
+    case tok::caretequal: OS << "^=\n"; continue;
+    case tok::pipe: OS << "|\n"; continue;
+    case tok::pipeequal: OS << "|=\n"; continue;
+    case tok::colon: OS << ":\n"; continue;
+    case tok::semi: OS << ";\n"; continue;
+    case tok::equal: OS << "=\n"; continue;
+    case tok::equalequal: OS << "==\n"; continue;
+    case tok::comma: OS << ",\n"; continue;
+    case tok::at: OS << "@\n"; continue;
+    case tok::bangequal: OS << "!=\n"; continue;
+    case tok::backtick: OS << "`\n"; continue;
+
+    default: OS << "UnhandledToken"; break;
     }
     
-    Out->os() << "<";
-    Out->os().write_escaped(Result.getString());
-    Out->os() << ">\n";
+    OS << "<";
+    OS.write_escaped(Result.getSpelling());
+    OS << ">\n";
   }
-  for (SmallVector<Diagnostic, 5>::iterator it = lex.getDiagnostics().begin(),
-         end = lex.getDiagnostics().end();
+  SmallVector<Diagnostic, 5> &Diags =
+    Stream ? Stream->getDiagnostics() : lex.getDiagnostics();
+  for (SmallVector<Diagnostic, 5>::iterator it = Diags.begin(),
+         end = Diags.end();
        it != end;
        ++it) {
     std::cerr << "About to print message: " << it->getMessage() << std::endl;
     SrcMgr.PrintMessage(it->getLoc(), it->getMessage(), it->getSeverityAsText());
   }
 
-  return 1;
+  return ReachedEOF ? 0 : 1;
+}
+
+int main(int argc, char **argv)  {
+  char *ProgName = argv[0];
+  cl::ParseCommandLineOptions(argc, argv,
+                              "python lexing playground");
+  if (InputFilenames.empty())
+    InputFilenames.push_back("-");
+
+  OwningPtr<tool_output_file> Out(GetOutputStream());
+  if (!Out)
+    return 1;
+
+  LangFeatures features;
+  features.setAllowWith(true);
+  features.setSpecialPrint(!Python3);
+  features.setSpecialExec(!Python3);
+  features.setBoolKeywords(Python3);
+
+  unsigned Threads = NumThreads ? NumThreads : getHardwareConcurrency();
+
+  int Ret = 0;
+  for (unsigned i = 0, e = InputFilenames.size(); i != e; ++i) {
+    OwningPtr<MemoryBuffer> BufferPtr;
+    if (error_code ec = getSourceFile(InputFilenames[i], BufferPtr)) {
+      errs() << ProgName << ": " << InputFilenames[i] << ": "
+             << ec.message() << '\n';
+      Ret = 1;
+      continue;
+    }
+
+    // A SourceMgr per file, so each file is unmapped as soon as it is done.
+    SourceMgr SrcMgr;
+    MemoryBuffer *Buffer = BufferPtr.take();
+    SrcMgr.AddNewSourceBuffer(Buffer, SMLoc());
+
+    if (LexFile(Buffer, SrcMgr, features, Threads, Out->os()))
+      Ret = 1;
+  }
+
+  Out->keep();
+  return Ret;
 }
@@ -0,0 +1,171 @@
+//===--- py-lookup-bench.cpp - Inline cache benchmark ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures name lookups emitted by py::Runtime, with and without an inline
+// cache, at a site that sees one dict (monomorphic), a few (polymorphic) or
+// more dicts than the cache has ways (megamorphic).
+//
+//===----------------------------------------------------------------------===//
+
+#include "pyrt.h"
+#include "py/JIT/JIT.h"
+#include "py/Runtime/Runtime.h"
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include <cstdio>
+#include <vector>
+using namespace llvm;
+using namespace py;
+
+static cl::opt<unsigned>
+Iterations("n", cl::desc("Lookups to time at each site"),
+           cl::value_desc("N"), cl::init(10000000));
+
+static cl::opt<unsigned>
+Keys("keys", cl::desc("Keys in each dict"), cl::value_desc("N"),
+     cl::init(64));
+
+/// LoopFn - A compiled loop that looks the same key up N times, in each of
+/// the NDicts dicts in turn, and returns how many lookups found it.
+typedef long long (*LoopFn)(PythonObject **Dicts, long long NDicts,
+                            PythonObject *Key, long long N);
+
+/// EmitLoop - Add the function Name, a LoopFn, to M.
+static void EmitLoop(Module &M, Runtime &R, StringRef Name, bool Cached) {
+  LLVMContext &C = M.getContext();
+  Type *I64 = Type::getInt64Ty(C);
+  Type *Params[] = { PointerType::get(R.GetObjectTyPtr(), 0), I64,
+                     R.GetObjectTyPtr(), I64 };
+  Function *F = Function::Create(FunctionType::get(I64, Params, false),
+                                 GlobalValue::ExternalLinkage, Name, &M);
+  Function::arg_iterator AI = F->arg_begin();
+  Value *Dicts = AI++, *NDicts = AI++, *Key = AI++, *N = AI++;
+
+  BasicBlock *Entry = BasicBlock::Create(C, "entry", F);
+  BasicBlock *Loop = BasicBlock::Create(C, "loop", F);
+  BasicBlock *Exit = BasicBlock::Create(C, "exit", F);
+  IRBuilder<> IRB(Entry);
+  IRB.CreateBr(Loop);
+
+  IRB.SetInsertPoint(Loop);
+  PHINode *I = IRB.CreatePHI(I64, 2, "i");
+  PHINode *Found = IRB.CreatePHI(I64, 2, "found");
+  Value *Dict = IRB.CreateLoad(IRB.CreateInBoundsGEP(Dicts,
+                                                     IRB.CreateURem(I, NDicts)),
+                               "dict");
+  BasicBlock *BB = Loop;
+  Value *V = Cached ? R.EmitCachedLookup(M, &BB, Dict, Key)
+                    : R.EmitLookup(M, &BB, Dict, Key);
+  IRB.SetInsertPoint(BB);
+  Value *NextFound = IRB.CreateAdd(Found,
+                                   IRB.CreateZExt(IRB.CreateIsNotNull(V), I64));
+  Value *NextI = IRB.CreateAdd(I, ConstantInt::get(I64, 1));
+  IRB.CreateCondBr(IRB.CreateICmpULT(NextI, N), Loop, Exit);
+  I->addIncoming(ConstantInt::get(I64, 0), Entry);
+  I->addIncoming(NextI, BB);
+  Found->addIncoming(ConstantInt::get(I64, 0), Entry);
+  Found->addIncoming(NextFound, BB);
+
+  IRB.SetInsertPoint(Exit);
+  IRB.CreateRet(NextFound);
+}
+
+/// MakeDict - A dict of Keys keys, among them "name", which each dict puts
+/// in a different slot.
+static PythonObject *MakeDict(unsigned Index) {
+  PythonObject *D = py_dict_new();
+  for (unsigned i = 0; i != Keys; ++i) {
+    char Buf[32];
+    int Len = std::snprintf(Buf, sizeof(Buf), "k%u_%u", Index, i);
+    PythonObject *K = py_str_new(Buf, Len);
+    PythonObject *V = py_int_new(i);
+    py_dict_set(D, K, V);
+    py_decref(K);
+    py_decref(V);
+  }
+  PythonObject *K = py_str_new("name", 4);
+  py_dict_set(D, K, py_none());
+  py_decref(K);
+  return D;
+}
+
+int main(int argc, char **argv) {
+  llvm_shutdown_obj Y;
+  char *ProgName = argv[0];
+  cl::ParseCommandLineOptions(argc, argv, "inline cache benchmark");
+
+  LLVMContext C;
+  Runtime R(C);
+  Module *M = new Module("lookup-bench", C);
+  EmitLoop(*M, R, "uncached", false);
+  EmitLoop(*M, R, "cached", true);
+
+  std::string Err;
+  OwningPtr<JIT> J(JIT::create(M, Err));
+  if (!J) {
+    errs() << ProgName << ": " << Err << '\n';
+    return 1;
+  }
+  for (const py_symbol *S = py_runtime_symbols; S->name; ++S)
+    J->addSymbol(S->name, S->address);
+  LoopFn Uncached = (LoopFn)J->getFunctionAddress("uncached", Err);
+  LoopFn Cached = Uncached ? (LoopFn)J->getFunctionAddress("cached", Err) : 0;
+  if (!Cached) {
+    errs() << ProgName << ": " << Err << '\n';
+    return 1;
+  }
+
+  static const unsigned Shapes[] = { 1, 2, 4, 8 };
+  std::vector<PythonObject*> Dicts;
+  for (unsigned i = 0; i != 8; ++i)
+    Dicts.push_back(MakeDict(i));
+  PythonObject *Key = py_str_new("name", 4);
+
+  outs() << "dicts      uncached/s       cached/s  speedup    poly hits"
+            "       misses\n";
+  for (unsigned s = 0; s != sizeof(Shapes) / sizeof(Shapes[0]); ++s) {
+    double Rates[2];
+    py_counters Counters;
+    for (unsigned c = 0; c != 2; ++c) {
+      LoopFn Fn = c ? Cached : Uncached;
+      py_reset_counters();
+      sys::TimeValue Start = sys::TimeValue::now();
+      long long Found = Fn(&Dicts[0], Shapes[s], Key, Iterations);
+      sys::TimeValue Elapsed = sys::TimeValue::now() - Start;
+      if (Found != Iterations) {
+        errs() << ProgName << ": found " << Found << " of " << Iterations
+               << '\n';
+        return 1;
+      }
+      double Seconds = Elapsed.usec() / 1e6;
+      Rates[c] = Iterations / (Seconds > 0 ? Seconds : 1e-6);
+      py_read_counters(&Counters);
+    }
+    outs() << format("%-6u %14.0f %14.0f %7.2fx", Shapes[s], Rates[0],
+                     Rates[1], Rates[1] / Rates[0])
+           << format(" %12llu %12llu\n", Counters.cache_poly_hits,
+                     Counters.cache_misses);
+  }
+
+  py_decref(Key);
+  for (unsigned i = 0, e = Dicts.size(); i != e; ++i)
+    py_decref(Dicts[i]);
+  return 0;
+}
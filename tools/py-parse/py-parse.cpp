@@ -1,8 +1,13 @@
+#include "py/Driver/BitcodeCache.h"
+#include "py/Driver/Scheduler.h"
 #include "py/Lex/Lexer.h"
 #include "py/Parse/Parser.h"
 #include "py/Runtime/Runtime.h"
+#include "py/Support/SourceFile.h"
+#include "py/Transforms/Pipeline.h"
 
 #include "llvm/ADT/OwningPtr.h"
+#include "llvm/Analysis/Verifier.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileUtilities.h"
 #include "llvm/Support/FormattedStream.h"
@@ -16,8 +21,18 @@
 using namespace llvm;
 using namespace py;
 
+static cl::list<std::string>
+InputFilenames(cl::Positional, cl::desc("<input files or directories>"));
+
 static cl::opt<std::string>
-InputFilename(cl::Positional, cl::desc("<input file>"), cl::init("-"));
+FileList("file-list", cl::desc("Also parse the files named in this file, "
+                               "one per line"),
+         cl::value_desc("filename"));
+
+static cl::opt<unsigned>
+NumThreads("j", cl::desc("Parse several inputs on N threads, lexing them "
+                         "on threads of their own (0 means one per CPU)"),
+           cl::value_desc("N"), cl::init(0), cl::Prefix);
 
 static cl::opt<std::string>
 OutputFilename("o", cl::desc("Output filename"),
@@ -31,11 +46,29 @@ static cl::opt<bool>
 PrintTree("print-tree", cl::desc("Print out the AST?"),
           cl::value_desc("print-tree"));
 
+static cl::opt<std::string>
+CacheDir("cache-dir", cl::desc("Reuse the Modules of unchanged files, "
+                               "keeping them in this directory"),
+         cl::value_desc("directory"));
+
+static cl::opt<bool>
+SchedulerStats("scheduler-stats",
+               cl::desc("Print per-stage queue and latency counters after "
+                        "parsing several inputs"));
+
 static cl::opt<bool>
 PrintModule("print-module", cl::desc("Print out the generated Module?"),
             cl::value_desc("print-module"));
 
-static void EmitDiagnostics(Lexer &lex, Parser &P, SourceMgr &SrcMgr);
+static cl::opt<char>
+OptLevel("O", cl::desc("Optimization level: -O0, -O1, -O2 or -O3 "
+                       "(default -O0)"),
+         cl::Prefix, cl::ZeroOrMore, cl::init('0'));
+
+static cl::opt<std::string>
+Passes("passes", cl::desc("Run these passes, separated by commas, instead "
+                          "of those of the -O level"),
+       cl::value_desc("pass,..."));
 
 static tool_output_file *GetOutputStream() {
   if (OutputFilename == "")
@@ -53,13 +86,178 @@ static tool_output_file *GetOutputStream() {
   return Out;
 }
 
+static LangFeatures GetFeatures() {
+  LangFeatures features;
+  features.setAllowWith(true);
+  features.setSpecialPrint(true);
+  features.setSpecialExec(true);
+  return features;
+}
+
+/// RunParser - Drive P the way the command line asks: rule by rule under
+/// -rule, printing diagnostics as it goes, or over the whole file.
+static bool RunParser(Lexer &lex, Parser &P, SourceMgr &SrcMgr,
+                      raw_ostream &OS, bool &Errors) {
+  bool Result = true;
+  if (Rule.length()) {
+    Token T;
+    while (true) {
+      P.Lex(T);
+      while (T.getKind() == tok::newline)
+        P.Lex(T);
+      if (T.getKind() == tok::eof) break;
+
+      Result = P.ParseRule(Rule, T);
+      EmitDiagnostics(lex, P, SrcMgr, OS, Errors);
+    }
+  } else {
+    Result = P.ParseFile();
+  }
+  return Result;
+}
+
+/// ParseBuffer - Parse Buffer, which SrcMgr owns, into M. Diagnostics, and
+/// the tree if asked for, are written to OS; Errors is set if any of them is
+/// an error. Returns what the Parser returned.
+static bool ParseBuffer(MemoryBuffer *Buffer, SourceMgr &SrcMgr, Runtime &R,
+                        Module &M, raw_ostream &OS, bool &Errors) {
+  Lexer lex(Buffer, GetFeatures());
+  Parser P(lex, R, M.getContext(), M, PrintTree ? OS : nulls());
+
+  bool Result = RunParser(lex, P, SrcMgr, OS, Errors);
+  EmitDiagnostics(lex, P, SrcMgr, OS, Errors);
+  return Result;
+}
+
+/// GetPipeline - Set P up as -O and -passes ask. Returns false, having
+/// reported why, if they ask for something that doesn't exist.
+static bool GetPipeline(const char *ProgName, Pipeline &P) {
+  if (OptLevel < '0' || OptLevel > '3') {
+    errs() << ProgName << ": invalid optimization level -O" << OptLevel
+           << '\n';
+    return false;
+  }
+  P = Pipeline(OptLevel - '0');
+  std::string Err;
+  if (!Passes.empty() && !P.parse(Passes, Err)) {
+    errs() << ProgName << ": -passes: " << Err << '\n';
+    return false;
+  }
+  return true;
+}
+
+/// GetCache - Return the cache named by -cache-dir, or null. A cached Module
+/// comes without the tree or the diagnostics of -rule, so those bypass it.
+static BitcodeCache *GetCache() {
+  if (CacheDir.empty() || PrintTree || !Rule.empty())
+    return 0;
+  return new BitcodeCache(CacheDir);
+}
+
+namespace {
+/// PyParseClient - Parses each file of a batch the way a single file is
+/// parsed, keeping what it prints with the file: the tree and diagnostics in
+/// its Output, the Module in its Result.
+class PyParseClient : public CompileClient {
+public:
+  virtual raw_ostream &getTreeStream(CompileJob &Job, raw_ostream &OS) {
+    return PrintTree ? OS : nulls();
+  }
+
+  virtual bool parse(CompileJob &Job, Lexer &L, Parser &P,
+                     SourceMgr &SrcMgr, raw_ostream &OS) {
+    return RunParser(L, P, SrcMgr, OS, Job.Failed);
+  }
+
+  virtual void finished(CompileJob &Job, Module &M, raw_ostream &OS) {
+    if (PrintModule) {
+      raw_string_ostream ResultOS(Job.Result);
+      M.print(ResultOS, 0);
+    }
+  }
+};
+}
+
+/// RunBatch - Parse every file in Files on the Scheduler's pool, then print
+/// what each one produced in the order the files were given, so the output
+/// doesn't depend on scheduling. Diagnostics go to stderr and Modules to Out.
+/// Returns the exit code.
+static int RunBatch(const std::vector<std::string> &Files, const Pipeline &P,
+                    tool_output_file &Out) {
+  PyParseClient Client;
+  OwningPtr<BitcodeCache> Cache(GetCache());
+  Scheduler S(GetFeatures(), NumThreads, P, Client);
+  S.setCache(Cache.get());
+  for (unsigned i = 0, e = Files.size(); i != e; ++i)
+    S.addFile(Files[i]);
+
+  bool Success = S.run();
+  for (unsigned i = 0, e = S.getNumJobs(); i != e; ++i) {
+    errs() << S.getJob(i).Output;
+    Out.os() << S.getJob(i).Result;
+  }
+  if (SchedulerStats)
+    S.printStats(errs());
+  Out.keep();
+  return Success ? 0 : 1;
+}
+
+/// ReadFileList - Append the non-empty lines of the file at Path to Files.
+static bool ReadFileList(const char *ProgName, StringRef Path,
+                         std::vector<std::string> &Files) {
+  OwningPtr<MemoryBuffer> List;
+  if (error_code ec = getSourceFile(Path, List)) {
+    errs() << ProgName << ": " << Path << ": " << ec.message() << '\n';
+    return false;
+  }
+  StringRef Rest = List->getBuffer();
+  while (!Rest.empty()) {
+    std::pair<StringRef, StringRef> Split = Rest.split('\n');
+    StringRef Line = Split.first.trim();
+    if (!Line.empty())
+      Files.push_back(Line.str());
+    Rest = Split.second;
+  }
+  return true;
+}
+
 int main(int argc, char **argv)  {
   char *ProgName = argv[0];
+  // Prints the report of -time-passes on the way out.
+  llvm_shutdown_obj Y;
   cl::ParseCommandLineOptions(argc, argv,
                               "python parsing playground");
-  
+
+  Pipeline P;
+  if (!GetPipeline(ProgName, P))
+    return 1;
+
+  std::vector<std::string> Files;
+  if (InputFilenames.empty() && FileList.empty())
+    InputFilenames.push_back("-");
+  for (unsigned i = 0, e = InputFilenames.size(); i != e; ++i) {
+    if (error_code ec = collectSourceFiles(InputFilenames[i], Files)) {
+      errs() << ProgName << ": " << InputFilenames[i] << ": "
+             << ec.message() << '\n';
+      return 1;
+    }
+  }
+  if (!FileList.empty() && !ReadFileList(ProgName, FileList, Files))
+    return 1;
+
+  OwningPtr<tool_output_file> Out(GetOutputStream());
+  if (!Out)
+    return 1;
+
+  // One input file (or stdin) is parsed right here. Several, or a directory
+  // or file list, make a batch that is parsed in parallel.
+  bool Batch = !FileList.empty() || Files.size() != 1 ||
+               Files[0] != InputFilenames[0];
+  if (Batch)
+    return RunBatch(Files, P, *Out);
+
   OwningPtr<MemoryBuffer> BufferPtr;
-  if (error_code ec = MemoryBuffer::getFileOrSTDIN(InputFilename, BufferPtr)) {
+  if (error_code ec = getSourceFile(Files[0], BufferPtr)) {
     errs() << ProgName << ": " << ec.message() << '\n';
     return 1;
   }
@@ -70,60 +268,44 @@ int main(int argc, char **argv)  {
   // Tell SrcMgr about this buffer, which is what TGParser will pick up.
   SrcMgr.AddNewSourceBuffer(Buffer, SMLoc());
 
-  OwningPtr<tool_output_file> Out(GetOutputStream());
-  if (!Out)
-    return 1;
-
-  LangFeatures features;
-  
   LLVMContext C;
-  Module M("py-parse playpen", C);
-
-  Lexer lex(Buffer, features);
   Runtime R(C);
-  Parser P(lex, R, C, M, PrintTree ? errs() : nulls());
-
-  bool Result = true;
-  if (Rule.length()) {
-    Token T;
-    while (lex.Peek(T) && T.getKind() != tok::eof) {
-      while (lex.Peek(T) && T.getKind() == tok::newline)
-        lex.Lex(T);
-      if (T.getKind() == tok::eof) break;
+  OwningPtr<BitcodeCache> Cache(GetCache());
+  CacheKey Key;
+  OwningPtr<Module> M;
+  if (Cache) {
+    Key = BitcodeCache::getKey(Buffer->getBuffer(), GetFeatures());
+    M.reset(Cache->load(Key, Buffer->getBufferIdentifier(), C));
+  }
 
-      lex.Lex(T);
-      Result = P.ParseRule(Rule, T);
-      EmitDiagnostics(lex, P, SrcMgr);
-//      if (!Result) {
-// /       lex.Lex(T);
-//      }
+  bool Result = false;
+  if (!M) {
+    M.reset(new Module(Buffer->getBufferIdentifier(), C));
+    bool Errors = false;
+    Result = ParseBuffer(Buffer, SrcMgr, R, *M, errs(), Errors);
+    if (Cache && !Errors) {
+      if (error_code ec = Cache->store(Key, *M))
+        errs() << ProgName << ": warning: can't write to the cache in '"
+               << CacheDir << "': " << ec.message() << '\n';
     }
-  } else {
-    Result = P.ParseFile();
   }
 
-  errs().flush();
+  if (!P.empty()) {
+    // As the Scheduler does: the passes assume valid IR.
+    std::string Err;
+    if (verifyModule(*M, ReturnStatusAction, &Err)) {
+      errs() << Buffer->getBufferIdentifier() << ": invalid module: " << Err
+             << '\n';
+      return 1;
+    }
+    P.run(*M);
+  }
 
   if (PrintModule)
-    M.dump();
+    M->print(Out->os(), 0);
+  Out->keep();
 
-  return Result ? 1 : 0;
-}
+  errs().flush();
 
-static void EmitDiagnostics(Lexer &lex, Parser &P, SourceMgr &SrcMgr) {
-  for (SmallVector<Diagnostic, 5>::iterator it = lex.getDiagnostics().begin(),
-         end = lex.getDiagnostics().end();
-       it != end;
-       ++it) {
-    SrcMgr.PrintMessage(it->getLoc(), it->getMessage(), it->getSeverityAsText());
-  }
-  for (SmallVector<Diagnostic, 5>::iterator it = P.getDiagnostics().begin(),
-         end = P.getDiagnostics().end();
-       it != end;
-       ++it) {
-    SrcMgr.PrintMessage(it->getLoc(), it->getMessage(), it->getSeverityAsText());
-  }
-  lex.getDiagnostics().clear();
-  P.getDiagnostics().clear();
+  return Result ? 1 : 0;
 }
-
@@ -0,0 +1,160 @@
+#include "pyrt.h"
+#include "py/Driver/Scheduler.h"
+#include "py/JIT/JIT.h"
+#include "py/JIT/TieredCompiler.h"
+#include "py/Lex/Lexer.h"
+#include "py/Parse/Parser.h"
+#include "py/Runtime/Runtime.h"
+#include "py/Support/SourceFile.h"
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+using namespace llvm;
+using namespace py;
+
+static cl::opt<std::string>
+InputFilename(cl::Positional, cl::desc("<input file>"), cl::init("-"));
+
+static cl::opt<std::string>
+Entry("entry", cl::desc("Function to run (default: main)"),
+      cl::value_desc("function"), cl::init("main"));
+
+static cl::opt<bool>
+PrintTimes("time", cl::desc("Print how long compiling and running took"));
+
+static cl::opt<unsigned>
+TierCalls("tier", cl::desc("Profile functions, and recompile them for the "
+                           "types they saw after this many calls"),
+          cl::value_desc("calls"), cl::init(0));
+
+static cl::opt<std::string>
+NativeLibrary("load", cl::desc("Run the entry function of this shared object, "
+                               "made by py-compile -shared, instead of "
+                               "compiling the input"),
+              cl::value_desc("shared object"));
+
+static LangFeatures GetFeatures() {
+  LangFeatures features;
+  features.setAllowWith(true);
+  features.setSpecialPrint(true);
+  features.setSpecialExec(true);
+  return features;
+}
+
+static double SecondsSince(sys::TimeValue Start) {
+  return (sys::TimeValue::now() - Start).usec() / 1e6;
+}
+
+/// RunNative - Run the entry function of the shared object -load names,
+/// whose calls into the runtime resolve to this process's. Returns the exit
+/// code.
+static int RunNative(const char *ProgName) {
+  std::string Err;
+  sys::TimeValue Start = sys::TimeValue::now();
+  sys::DynamicLibrary Lib =
+    sys::DynamicLibrary::getPermanentLibrary(NativeLibrary.c_str(), &Err);
+  if (!Lib.isValid()) {
+    errs() << ProgName << ": " << NativeLibrary << ": " << Err << '\n';
+    return 1;
+  }
+  void *Address = Lib.getAddressOfSymbol(Entry.c_str());
+  if (!Address) {
+    errs() << ProgName << ": no function '" << Entry << "' in "
+           << NativeLibrary << '\n';
+    return 1;
+  }
+  double LoadSeconds = SecondsSince(Start);
+
+  typedef PythonObject *(*EntryFn)(void);
+  EntryFn Fn = reinterpret_cast<EntryFn>(reinterpret_cast<intptr_t>(Address));
+  Start = sys::TimeValue::now();
+  py_xdecref(Fn());
+  double RunSeconds = SecondsSince(Start);
+
+  if (PrintTimes)
+    errs() << format("load:    %10.3f ms\n", LoadSeconds * 1000)
+           << format("run:     %10.3f ms\n", RunSeconds * 1000);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  llvm_shutdown_obj Y;
+  char *ProgName = argv[0];
+  cl::ParseCommandLineOptions(argc, argv, "python JIT runner");
+
+  if (!NativeLibrary.empty())
+    return RunNative(ProgName);
+
+  OwningPtr<MemoryBuffer> BufferPtr;
+  if (error_code ec = getSourceFile(InputFilename, BufferPtr)) {
+    errs() << ProgName << ": " << InputFilename << ": " << ec.message()
+           << '\n';
+    return 1;
+  }
+  MemoryBuffer *Buffer = BufferPtr.take();
+  SourceMgr SrcMgr;
+  SrcMgr.AddNewSourceBuffer(Buffer, SMLoc());
+
+  LLVMContext C;
+  Runtime R(C);
+  Module *M = new Module(Buffer->getBufferIdentifier(), C);
+  {
+    Lexer lex(Buffer, GetFeatures());
+    Parser P(lex, R, C, *M, nulls());
+    bool Errors = false;
+    P.ParseFile();
+    EmitDiagnostics(lex, P, SrcMgr, errs(), Errors);
+    if (Errors) {
+      delete M;
+      return 1;
+    }
+  }
+
+  std::string Err;
+  OwningPtr<JIT> J(JIT::create(M, Err));
+  if (!J) {
+    errs() << ProgName << ": " << Err << '\n';
+    return 1;
+  }
+  for (const py_symbol *S = py_runtime_symbols; S->name; ++S)
+    J->addSymbol(S->name, S->address);
+
+  OwningPtr<TieredCompiler> Tiers;
+  if (TierCalls) {
+    Tiers.reset(new TieredCompiler(*J, R, TierCalls));
+    Tiers->addAllFunctions();
+  }
+
+  GenericValue Result;
+  bool Ran = J->run(Entry, Result, Err);
+  if (!Ran)
+    errs() << ProgName << ": " << Err << '\n';
+
+  if (PrintTimes) {
+    const JITStats &S = J->getStats();
+    errs() << format("setup:   %10.3f ms\n", S.SetupSeconds * 1000)
+           << format("compile: %10.3f ms\n", S.CompileSeconds * 1000)
+           << format("run:     %10.3f ms\n", S.RunSeconds * 1000)
+           << "compiled " << S.FunctionsCompiled << " of "
+           << S.FunctionsDefined << " functions, " << S.CodeBytes
+           << " bytes\n";
+    if (Tiers) {
+      const TieringStats &T = Tiers->getStats();
+      errs() << "tiered " << T.FunctionsTiered << " functions: "
+             << T.Recompiles << " recompiled, " << T.SitesSpecialized
+             << " sites specialized, " << T.BranchesWeighted
+             << " branches weighted, " << T.Deopts << " deopts, "
+             << T.Invalidations << " invalidated\n";
+    }
+  }
+  return Ran ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+//===- unittests/Parse/ASTTest.cpp - AST and ASTContext tests -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Parse/AST.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <string>
+
+using namespace llvm;
+using namespace py;
+using namespace py::ast;
+
+namespace {
+
+// gtest has a Test class of its own, so the AST's is written ast::Test.
+
+/// Print - Return N printed as an S-expression.
+static std::string Print(const Node *N) {
+  std::string S;
+  raw_string_ostream OS(S);
+  N->print(OS);
+  return OS.str();
+}
+
+TEST(ASTTest, Construction) {
+  ASTContext C;
+  IdentifierTable Idents;
+  SMLoc Loc;
+
+  Number *One = Number::GetInt(C, Loc, 1);
+  EXPECT_FALSE(One->IsFloatingPoint());
+  EXPECT_EQ(1, One->GetIntValue());
+  Number *Half = Number::GetFloat(C, Loc, 0.5);
+  EXPECT_TRUE(Half->IsFloatingPoint());
+  EXPECT_EQ(0.5, Half->GetFloatValue());
+
+  Name *X = Name::Get(C, Loc, Idents.get("x"));
+  EXPECT_EQ(Idents.get("x"), X->GetId());
+  EXPECT_EQ("x", X->GetId().str());
+
+  BinaryOp *Add = BinaryOp::Get(C, Loc, tok::plus, X, One);
+  EXPECT_EQ(Node::BinaryOpKind, Add->GetKind());
+  EXPECT_EQ(tok::plus, Add->GetOp());
+  EXPECT_EQ(X, Add->GetLHS());
+  EXPECT_EQ(One, Add->GetRHS());
+  EXPECT_EQ("(binary + (name \"x\") (number 1))", Print(Add));
+
+  Stmt *Body[] = { Return::Get(C, Loc, Add) };
+  ast::Test *Params[] = { X };
+  Arguments Args = { Params, ArrayRef<ast::Test*>(), StringRef(),
+                     StringRef() };
+  FunctionDef *F = FunctionDef::Get(C, Loc, "f", Args, Body,
+                                    ArrayRef<ast::Test*>());
+  EXPECT_EQ("f", F->GetName());
+  ASSERT_EQ(1U, F->GetArgs().Params.size());
+  EXPECT_EQ(X, F->GetArgs().Params[0]);
+  ASSERT_EQ(1U, F->GetBody().size());
+  EXPECT_EQ(Body[0], F->GetBody()[0]);
+  EXPECT_TRUE(F->GetDecorators().empty());
+}
+
+TEST(ASTTest, Casting) {
+  ASTContext C;
+  SMLoc Loc;
+  Node *N = Number::GetInt(C, Loc, 42);
+  Node *S = Pass::Get(C, Loc);
+  Node *M = Module::Get(C, Loc, ArrayRef<Stmt*>());
+
+  EXPECT_TRUE(isa<ast::Test>(N));
+  EXPECT_FALSE(isa<Stmt>(N));
+  EXPECT_TRUE(isa<Number>(N));
+  EXPECT_EQ(N, dyn_cast<Number>(N));
+  EXPECT_EQ(0, dyn_cast<Str>(N));
+  EXPECT_EQ(42, cast<Number>(N)->GetIntValue());
+
+  EXPECT_TRUE(isa<Stmt>(S));
+  EXPECT_FALSE(isa<ast::Test>(S));
+  EXPECT_EQ(0, dyn_cast<Break>(S));
+  EXPECT_NE(static_cast<Pass*>(0), dyn_cast<Pass>(S));
+
+  // A Module is neither an expression nor a statement.
+  EXPECT_FALSE(isa<ast::Test>(M));
+  EXPECT_FALSE(isa<Stmt>(M));
+  EXPECT_TRUE(isa<Module>(M));
+}
+
+TEST(ASTTest, ArenaCopiesChildren) {
+  ASTContext C;
+  SMLoc Loc;
+  size_t Before = C.getTotalMemory();
+
+  SmallVector<ast::Test*, 4> Elts;
+  Elts.push_back(Number::GetInt(C, Loc, 1));
+  Elts.push_back(Number::GetInt(C, Loc, 2));
+  TestList *L = TestList::Get(C, Loc, Elts);
+  EXPECT_GT(C.getTotalMemory(), Before);
+
+  // The node keeps its own copy of the array, in the arena.
+  EXPECT_NE(Elts.data(), L->GetElements().data());
+  Elts[0] = Elts[1];
+  Elts.clear();
+  ASSERT_EQ(2U, L->GetElements().size());
+  EXPECT_EQ(1, cast<Number>(L->GetElements()[0])->GetIntValue());
+  EXPECT_EQ(2, cast<Number>(L->GetElements()[1])->GetIntValue());
+
+  // Empty arrays take no memory.
+  size_t Used = C.getTotalMemory();
+  EXPECT_TRUE(C.CopyArray(ArrayRef<ast::Test*>()).empty());
+  EXPECT_TRUE(C.CopyString(StringRef()).empty());
+  EXPECT_EQ(Used, C.getTotalMemory());
+
+  // Strings copied into the arena outlive the buffer they came from.
+  StringRef Copy;
+  {
+    std::string Source = "temporary";
+    Copy = C.CopyString(Source);
+    EXPECT_NE(Source.data(), Copy.data());
+  }
+  EXPECT_EQ("temporary", Copy);
+  EXPECT_EQ("(string \"temporary\")", Print(Str::Get(C, Loc, Copy)));
+}
+
+TEST(ASTTest, NodesAreAligned) {
+  ASTContext C;
+  SMLoc Loc;
+  // Odd-sized allocations in between must not misalign later nodes.
+  for (unsigned i = 0; i != 100; ++i) {
+    C.CopyString("abc");
+    Number *N = Number::GetFloat(C, Loc, i);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(N) % 8);
+    EXPECT_EQ(double(i), N->GetFloatValue());
+  }
+}
+
+}
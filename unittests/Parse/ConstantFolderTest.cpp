@@ -0,0 +1,141 @@
+//===- unittests/Parse/ConstantFolderTest.cpp - Constant folding tests ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Parse/ConstantFolder.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <string>
+
+using namespace llvm;
+using namespace py;
+using namespace py::ast;
+
+namespace {
+
+// gtest has a Test class of its own, so the AST's is written ast::Test.
+
+class ConstantFolderTest : public testing::Test {
+protected:
+  ConstantFolderTest() : F(C) {}
+
+  Number *Int(int64_t V) { return Number::GetInt(C, Loc, V); }
+  Number *Float(double V) { return Number::GetFloat(C, Loc, V); }
+  Str *String(StringRef V, bool IsUnicode = false) {
+    return Str::Get(C, Loc, V, IsUnicode);
+  }
+  ast::Test *Op(tok::TokenKind Op, ast::Test *X, ast::Test *Y) {
+    return BinaryOp::Get(C, Loc, Op, X, Y);
+  }
+
+  /// Print - Return N printed as an S-expression.
+  static std::string Print(const Node *N) {
+    std::string S;
+    raw_string_ostream OS(S);
+    N->print(OS);
+    return OS.str();
+  }
+
+  /// Fold - Return T folded and printed.
+  std::string Fold(ast::Test *T) { return Print(F.Fold(T)); }
+
+  ASTContext C;
+  ConstantFolder F;
+  SMLoc Loc;
+};
+
+TEST_F(ConstantFolderTest, Ints) {
+  EXPECT_EQ("(number 7)", Fold(Op(tok::plus, Int(3), Int(4))));
+  // Division and modulo floor, as in Python 2.
+  EXPECT_EQ("(number -4)", Fold(Op(tok::slashslash, Int(7), Int(-2))));
+  EXPECT_EQ("(number -4)", Fold(Op(tok::slash, Int(7), Int(-2))));
+  EXPECT_EQ("(number -1)", Fold(Op(tok::percent, Int(7), Int(-2))));
+  EXPECT_EQ("(number 1024)", Fold(Op(tok::starstar, Int(2), Int(10))));
+  EXPECT_EQ("(number -1)",
+            Fold(UnaryOp::Get(C, Loc, tok::tilde, Int(0))));
+  // Operands are folded first.
+  EXPECT_EQ("(number 10)",
+            Fold(Op(tok::star, Op(tok::plus, Int(2), Int(3)), Int(2))));
+
+  // What would raise, or become a long, is left alone.
+  ast::Test *Overflow = Op(tok::plus, Int(INT64_MAX), Int(1));
+  EXPECT_EQ(Overflow, F.Fold(Overflow));
+  ast::Test *DivZero = Op(tok::slash, Int(1), Int(0));
+  EXPECT_EQ(DivZero, F.Fold(DivZero));
+  ast::Test *Shift = Op(tok::lessless, Int(1), Int(-1));
+  EXPECT_EQ(Shift, F.Fold(Shift));
+  ast::Test *Neg = UnaryOp::Get(C, Loc, tok::minus, Int(INT64_MIN));
+  EXPECT_EQ(Neg, F.Fold(Neg));
+}
+
+TEST_F(ConstantFolderTest, Floats) {
+  EXPECT_EQ("(number 5.000000e-01)", Fold(Op(tok::slash, Int(1), Float(2))));
+  ast::Test *DivZero = Op(tok::slash, Float(1), Float(0));
+  EXPECT_EQ(DivZero, F.Fold(DivZero));
+  ast::Test *Mod = Op(tok::percent, Float(1), Float(2));
+  EXPECT_EQ(Mod, F.Fold(Mod));
+}
+
+TEST_F(ConstantFolderTest, Strings) {
+  EXPECT_EQ("(string \"abc\")", Fold(Op(tok::plus, String("ab"),
+                                        String("c"))));
+  // Either operand may be the count.
+  EXPECT_EQ("(string \"ababab\")", Fold(Op(tok::star, String("ab"), Int(3))));
+  EXPECT_EQ("(string \"ababab\")", Fold(Op(tok::star, Int(3), String("ab"))));
+  Str *S = cast<Str>(F.Fold(Op(tok::star, String("a", true), Int(2))));
+  EXPECT_TRUE(S->IsUnicodeString());
+
+  // No repetitions, or fewer, is empty.
+  EXPECT_EQ("(string \"\")", Fold(Op(tok::star, String("ab"), Int(0))));
+  EXPECT_EQ("(string \"\")", Fold(Op(tok::star, String("ab"), Int(-1))));
+  EXPECT_EQ("(string \"\")",
+            Fold(Op(tok::star, String("ab"), Int(INT64_MIN))));
+  // So is repeating nothing, however often: '' * 10**18.
+  EXPECT_EQ("(string \"\")",
+            Fold(Op(tok::star, String(""),
+                    Op(tok::starstar, Int(10), Int(18)))));
+  EXPECT_EQ("(string \"\")",
+            Fold(Op(tok::star, Int(INT64_MAX), String(""))));
+
+  // Strings are only built up to MaxStringSize.
+  std::string Max(ConstantFolder::MaxStringSize, 'a');
+  S = cast<Str>(F.Fold(Op(tok::star, String("a"),
+                          Int(ConstantFolder::MaxStringSize))));
+  EXPECT_EQ(Max, S->GetValue().str());
+  ast::Test *TooBig = Op(tok::star, String("ab"),
+                         Int(ConstantFolder::MaxStringSize));
+  EXPECT_EQ(TooBig, F.Fold(TooBig));
+  ast::Test *Huge = Op(tok::star, String("ab"), Int(INT64_MAX));
+  EXPECT_EQ(Huge, F.Fold(Huge));
+  ast::Test *ByFloat = Op(tok::star, String("ab"), Float(2));
+  EXPECT_EQ(ByFloat, F.Fold(ByFloat));
+}
+
+TEST_F(ConstantFolderTest, TuplesAndConcat) {
+  ast::Test *Elts[] = { Op(tok::plus, Int(1), Int(1)), String("a") };
+  ast::Test *T = F.Fold(TestList::Get(C, Loc, Elts));
+  EXPECT_EQ("(testlist ((number 2) (string \"a\")))", Print(T));
+  EXPECT_TRUE(ConstantFolder::IsConstant(T));
+  EXPECT_FALSE(ConstantFolder::IsConstant(Elts[0]));
+
+  Str *Strs[] = { String("a"), String("b", true), String("c") };
+  Str *S = F.Concat(Strs);
+  EXPECT_EQ("abc", S->GetValue().str());
+  EXPECT_TRUE(S->IsUnicodeString());
+  EXPECT_EQ(Strs[0], F.Concat(ArrayRef<Str*>(Strs, 1)));
+}
+
+TEST_F(ConstantFolderTest, CountsWhatItFolds) {
+  F.Fold(Op(tok::plus, Op(tok::plus, Int(1), Int(2)), Int(3)));
+  EXPECT_EQ(2U, F.GetNumFolded());
+  F.Fold(Op(tok::slash, Int(1), Int(0)));
+  F.Fold(Int(1));
+  EXPECT_EQ(2U, F.GetNumFolded());
+}
+
+}
@@ -0,0 +1,173 @@
+//===- unittests/Parse/ParserTest.cpp - Parser token and name tests -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Lex/Lexer.h"
+#include "py/Lex/TokenStream.h"
+#include "py/Parse/Parser.h"
+#include "py/Runtime/Runtime.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Constants.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace py;
+
+namespace {
+
+class ParserTest : public testing::Test {
+protected:
+  ParserTest() : R(Context), M("test", Context) {}
+
+  MemoryBuffer *GetBuffer(StringRef Text) {
+    Buffer.reset(MemoryBuffer::getMemBufferCopy(Text, "test"));
+    return Buffer.get();
+  }
+
+  LLVMContext Context;
+  Runtime R;
+  Module M;
+  OwningPtr<MemoryBuffer> Buffer;
+};
+
+TEST_F(ParserTest, ReadsTheTokenStream) {
+  Lexer L(GetBuffer("x = y\n"), LangFeatures());
+  Parser P(L, R, Context, M, nulls());
+  ASSERT_EQ(5U, P.getTokens().size());
+
+  Token T;
+  P.Peek(T);
+  EXPECT_EQ(tok::identifier, T.getKind());
+  P.Lex(T);
+  EXPECT_EQ(tok::identifier, T.getKind());
+  EXPECT_EQ("x", T.getSpelling());
+  P.Lex(T);
+  EXPECT_EQ(tok::equal, T.getKind());
+  P.Lex(T);
+  EXPECT_EQ("y", T.getSpelling());
+  P.Lex(T);
+  EXPECT_EQ(tok::newline, T.getKind());
+
+  // eof is returned for good once reached.
+  P.Lex(T);
+  EXPECT_EQ(tok::eof, T.getKind());
+  P.Lex(T);
+  EXPECT_EQ(tok::eof, T.getKind());
+}
+
+TEST_F(ParserTest, LexerOutlivesParser) {
+  MemoryBuffer *Buf = GetBuffer("a b c\n");
+  Lexer Ahead(Buf, LangFeatures());
+  TokenStream Tokens(Buf);
+  Tokens.tokenize(Ahead);
+
+  // The Parser reads the replayed stream without consuming the Lexer, and
+  // must leave nothing of its own behind in it.
+  Lexer L(Buf, LangFeatures());
+  L.replay(Tokens);
+  Token T;
+  {
+    Parser P(L, R, Context, M, nulls());
+    EXPECT_EQ(&Tokens, &P.getTokens());
+    // The stream was lexed without a table; the Parser interns as it reads.
+    P.Lex(T);
+    EXPECT_EQ(P.getIdentifierTable().get("a"), T.getIdentifier());
+  }
+  EXPECT_TRUE(L.getIdentifierTable() == 0);
+  ASSERT_TRUE(L.Lex(T));
+  EXPECT_EQ("a", T.getSpelling());
+  EXPECT_FALSE(T.getIdentifier().isValid());
+  ASSERT_TRUE(L.Lex(T));
+  EXPECT_EQ("b", T.getSpelling());
+}
+
+TEST_F(ParserTest, NamesAreInternedWhileLexing) {
+  Lexer L(GetBuffer("x = y + x\n"), LangFeatures());
+  Parser P(L, R, Context, M, nulls());
+  IdentifierTable &Idents = P.getIdentifierTable();
+  EXPECT_EQ(&Idents, L.getIdentifierTable());
+  // Both names are in the table before the Parser reads a token.
+  EXPECT_EQ(2U, Idents.size());
+
+  Token T;
+  P.Lex(T);
+  Identifier X = T.getIdentifier();
+  EXPECT_EQ(Idents.get("x"), X);
+  EXPECT_EQ(P.getTokens().getIdentifier(0), X);
+  P.Lex(T);
+  EXPECT_FALSE(T.getIdentifier().isValid());
+  P.Lex(T);
+  EXPECT_EQ(Idents.get("y"), T.getIdentifier());
+  P.Lex(T);
+  P.Lex(T);
+  EXPECT_EQ(X, T.getIdentifier());
+  EXPECT_EQ(2U, Idents.size());
+}
+
+TEST_F(ParserTest, CallerOwnsTheTable) {
+  IdentifierTable Idents;
+  Lexer L(GetBuffer("x\n"), LangFeatures());
+  L.setIdentifierTable(&Idents);
+  {
+    Parser P(L, R, Context, M, nulls());
+    EXPECT_EQ(&Idents, &P.getIdentifierTable());
+    EXPECT_EQ(1U, Idents.size());
+  }
+  // The table wasn't the Parser's to take back.
+  EXPECT_EQ(&Idents, L.getIdentifierTable());
+  EXPECT_TRUE(Idents.get("x").isValid());
+  EXPECT_EQ(1U, Idents.size());
+}
+
+TEST_F(ParserTest, EachParserHasItsOwnNames) {
+  MemoryBuffer *Buf = GetBuffer("x\n");
+  Lexer L1(Buf, LangFeatures());
+  Parser P1(L1, R, Context, M, nulls());
+  Lexer L2(Buf, LangFeatures());
+  Parser P2(L2, R, Context, M, nulls());
+
+  IdentifierTable &T1 = P1.getIdentifierTable();
+  IdentifierTable &T2 = P2.getIdentifierTable();
+  EXPECT_NE(&T1, &T2);
+  EXPECT_EQ(T1.get("x"), T1.get("x"));
+  EXPECT_NE(T1.get("x").getOpaqueValue(), T2.get("x").getOpaqueValue());
+  EXPECT_EQ(1U, T1.size());
+}
+
+
+TEST_F(ParserTest, StringConstantsArePooled) {
+  Lexer L(GetBuffer("\n"), LangFeatures());
+  Parser P(L, R, Context, M, nulls());
+  ASSERT_TRUE(M.global_empty());
+
+  GlobalVariable *GV = P.GetConstantString("spam");
+  EXPECT_EQ(GV, P.GetConstantString("spam"));
+  // Equal contents however they are put together.
+  EXPECT_EQ(GV, P.GetConstantString(Twine("sp") + "am"));
+  EXPECT_EQ(1U, M.global_size());
+  EXPECT_EQ(GV, &*M.global_begin());
+
+  EXPECT_TRUE(GV->isConstant());
+  EXPECT_TRUE(GV->hasPrivateLinkage());
+  EXPECT_TRUE(GV->hasUnnamedAddr());
+  ConstantArray *Init = dyn_cast<ConstantArray>(GV->getInitializer());
+  ASSERT_TRUE(Init != 0);
+  EXPECT_EQ("spam", Init->getAsCString());
+
+  GlobalVariable *Eggs = P.GetConstantString("eggs");
+  EXPECT_NE(GV, Eggs);
+  EXPECT_EQ(2U, M.global_size());
+}
+
+}
@@ -0,0 +1,233 @@
+//===- unittests/Parse/ScopeTest.cpp - Scope analysis tests ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Parse/Scope.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+using namespace llvm;
+using namespace py;
+using namespace py::ast;
+
+namespace {
+
+// gtest has a Test class of its own, so the AST's is written ast::Test.
+
+class ScopeTest : public testing::Test {
+protected:
+  Name *N(StringRef Id) { return Name::Get(C, Loc, Idents.get(Id)); }
+
+  /// Let - Target = Value.
+  Stmt *Let(StringRef Target, ast::Test *Value) {
+    ast::Test *Targets[] = { N(Target) };
+    return Assign::Get(C, Loc, Targets, Value);
+  }
+  Stmt *Let(StringRef Target, StringRef Value) {
+    return Let(Target, N(Value));
+  }
+  Stmt *Ret(StringRef Value) { return Return::Get(C, Loc, N(Value)); }
+  Stmt *DeclareGlobal(StringRef Id) {
+    Identifier Names[] = { Idents.get(Id) };
+    return Global::Get(C, Loc, Names);
+  }
+
+  /// Def - def Id(Params): Body, with Params a list of names.
+  FunctionDef *Def(StringRef Id, ArrayRef<StringRef> Params,
+                   ArrayRef<Stmt*> Body) {
+    std::vector<ast::Test*> Ps;
+    for (unsigned i = 0, e = Params.size(); i != e; ++i)
+      Ps.push_back(N(Params[i]));
+    Arguments Args = { C.CopyArray(ArrayRef<ast::Test*>(Ps)),
+                       ArrayRef<ast::Test*>(), StringRef(), StringRef() };
+    return FunctionDef::Get(C, Loc, Id, Args, Body, ArrayRef<ast::Test*>());
+  }
+  ClassDef *Class(StringRef Id, ArrayRef<Stmt*> Body) {
+    return ClassDef::Get(C, Loc, Id, ArrayRef<ast::Test*>(), Body,
+                         ArrayRef<ast::Test*>());
+  }
+
+  /// Analyze - Analyze a module of Body.
+  void Analyze(ArrayRef<Stmt*> Body) {
+    SA.reset(new ScopeAnalysis(Module::Get(C, Loc, Body)));
+  }
+  Scope *Get(const Node *N) { return SA->GetScope(N); }
+
+  static std::vector<std::string> Strings(ArrayRef<StringRef> Names) {
+    return std::vector<std::string>(Names.begin(), Names.end());
+  }
+  static std::vector<std::string> Strings(StringRef A) {
+    return std::vector<std::string>(1, A.str());
+  }
+
+  ASTContext C;
+  IdentifierTable Idents;
+  SMLoc Loc;
+  OwningPtr<ScopeAnalysis> SA;
+};
+
+TEST_F(ScopeTest, NestedFunctions) {
+  // def f(a):
+  //   b = a
+  //   def g():
+  //     def h(): return b
+  //     return h
+  //   return g
+  StringRef A = "a";
+  Stmt *HBody[] = { Ret("b") };
+  FunctionDef *H = Def("h", ArrayRef<StringRef>(), HBody);
+  Stmt *GBody[] = { H, Ret("h") };
+  FunctionDef *G = Def("g", ArrayRef<StringRef>(), GBody);
+  Stmt *FBody[] = { Let("b", "a"), G, Ret("g") };
+  FunctionDef *F = Def("f", A, FBody);
+  Stmt *Body[] = { F };
+  Analyze(Body);
+
+  Scope *Mod = SA->GetModuleScope();
+  EXPECT_EQ(Scope::ModuleScope, Mod->GetKind());
+  EXPECT_FALSE(Mod->IsOptimized());
+  EXPECT_EQ(Scope::Global, Mod->Lookup("f"));
+  ASSERT_EQ(1U, Mod->GetChildren().size());
+
+  // b is bound in f and used in h, so kept in a cell that g passes on.
+  Scope *FS = Get(F);
+  EXPECT_EQ(Mod, FS->GetParent());
+  EXPECT_TRUE(FS->IsOptimized());
+  EXPECT_EQ(Scope::Local, FS->Lookup("a"));
+  EXPECT_EQ(Scope::Cell, FS->Lookup("b"));
+  EXPECT_EQ(Scope::Local, FS->Lookup("g"));
+  StringRef FBound[] = { "a", "b", "g" };
+  EXPECT_EQ(Strings(FBound), Strings(FS->GetBoundNames()));
+  EXPECT_TRUE(FS->GetFreeNames().empty());
+
+  Scope *GS = Get(G);
+  EXPECT_EQ(Scope::Free, GS->Lookup("b"));
+  EXPECT_EQ(Scope::Local, GS->Lookup("h"));
+  EXPECT_EQ(Strings("b"), Strings(GS->GetFreeNames()));
+
+  Scope *HS = Get(H);
+  EXPECT_EQ(Scope::Free, HS->Lookup("b"));
+  EXPECT_EQ(Strings("b"), Strings(HS->GetFreeNames()));
+  EXPECT_TRUE(HS->GetBoundNames().empty());
+  // What is mentioned nowhere is the module's.
+  EXPECT_EQ(Scope::Global, HS->Lookup("len"));
+}
+
+TEST_F(ScopeTest, ClassesPassCellsOn) {
+  // def f():
+  //   x = 1
+  //   class C:
+  //     x = 2
+  //     def g(self): return x
+  StringRef Self = "self";
+  Stmt *GBody[] = { Ret("x") };
+  FunctionDef *G = Def("g", Self, GBody);
+  Stmt *CBody[] = { Let("x", Number::GetInt(C, Loc, 2)), G };
+  ClassDef *CD = Class("C", CBody);
+  Stmt *FBody[] = { Let("x", Number::GetInt(C, Loc, 1)), CD };
+  FunctionDef *F = Def("f", ArrayRef<StringRef>(), FBody);
+  Stmt *Body[] = { F };
+  Analyze(Body);
+
+  // g's x is f's, not C's: the class body doesn't enclose g.
+  EXPECT_EQ(Scope::Cell, Get(F)->Lookup("x"));
+  EXPECT_EQ(Scope::Free, Get(G)->Lookup("x"));
+  EXPECT_EQ(Strings("x"), Strings(Get(G)->GetFreeNames()));
+
+  // C keeps its own x in its namespace, but passes f's cell on to g.
+  Scope *CS = Get(CD);
+  EXPECT_EQ(Scope::ClassScope, CS->GetKind());
+  EXPECT_FALSE(CS->IsOptimized());
+  EXPECT_EQ(Scope::Local, CS->Lookup("x"));
+  EXPECT_TRUE(CS->IsFreeInClass("x"));
+  EXPECT_FALSE(CS->IsFreeInClass("g"));
+  EXPECT_EQ(Strings("x"), Strings(CS->GetFreeNames()));
+}
+
+TEST_F(ScopeTest, ClassesDontEnclose) {
+  // def f():
+  //   class C:
+  //     y = 1
+  //     def g(self): return y
+  //     def h(self): return y
+  StringRef Self = "self";
+  Stmt *GBody[] = { Ret("y") };
+  FunctionDef *G = Def("g", Self, GBody);
+  FunctionDef *H = Def("h", Self, GBody);
+  Stmt *CBody[] = { Let("y", Number::GetInt(C, Loc, 1)), G, H };
+  ClassDef *CD = Class("C", CBody);
+  Stmt *FBody[] = { CD };
+  FunctionDef *F = Def("f", ArrayRef<StringRef>(), FBody);
+  Stmt *Body[] = { F };
+  Analyze(Body);
+
+  EXPECT_EQ(Scope::Global, Get(G)->Lookup("y"));
+  EXPECT_EQ(Scope::Global, Get(H)->Lookup("y"));
+  EXPECT_TRUE(Get(G)->GetFreeNames().empty());
+  EXPECT_FALSE(Get(CD)->IsFreeInClass("y"));
+  EXPECT_TRUE(Get(CD)->GetFreeNames().empty());
+  EXPECT_EQ(Scope::Local, Get(F)->Lookup("C"));
+}
+
+TEST_F(ScopeTest, GlobalEndsTheSearch) {
+  // def f():
+  //   x = 1
+  //   def g():
+  //     global x
+  //     def h(): return x
+  //   class C:
+  //     global x
+  //     def k(self): return x
+  //   def l(): return x
+  StringRef Self = "self";
+  Stmt *HBody[] = { Ret("x") };
+  FunctionDef *H = Def("h", ArrayRef<StringRef>(), HBody);
+  Stmt *GBody[] = { DeclareGlobal("x"), H };
+  FunctionDef *G = Def("g", ArrayRef<StringRef>(), GBody);
+  FunctionDef *K = Def("k", Self, HBody);
+  Stmt *CBody[] = { DeclareGlobal("x"), K };
+  ClassDef *CD = Class("C", CBody);
+  FunctionDef *L = Def("l", ArrayRef<StringRef>(), HBody);
+  Stmt *FBody[] = { Let("x", Number::GetInt(C, Loc, 1)), G, CD, L };
+  FunctionDef *F = Def("f", ArrayRef<StringRef>(), FBody);
+  Stmt *Body[] = { F };
+  Analyze(Body);
+
+  // h and k see the global x that g and C declare, not f's.
+  EXPECT_EQ(Scope::Global, Get(G)->Lookup("x"));
+  EXPECT_EQ(Scope::Global, Get(H)->Lookup("x"));
+  EXPECT_TRUE(Get(G)->GetFreeNames().empty());
+  EXPECT_TRUE(Get(H)->GetFreeNames().empty());
+  EXPECT_EQ(Scope::Global, Get(CD)->Lookup("x"));
+  EXPECT_EQ(Scope::Global, Get(K)->Lookup("x"));
+
+  // l still closes over f's x.
+  EXPECT_EQ(Scope::Free, Get(L)->Lookup("x"));
+  EXPECT_EQ(Scope::Cell, Get(F)->Lookup("x"));
+}
+
+TEST_F(ScopeTest, GlobalBindings) {
+  // x = 1
+  // def f():
+  //   global y
+  //   y = x
+  Stmt *FBody[] = { DeclareGlobal("y"), Let("y", "x") };
+  FunctionDef *F = Def("f", ArrayRef<StringRef>(), FBody);
+  Stmt *Body[] = { Let("x", Number::GetInt(C, Loc, 1)), F };
+  Analyze(Body);
+
+  EXPECT_EQ(Scope::Global, SA->GetModuleScope()->Lookup("x"));
+  Scope *FS = Get(F);
+  EXPECT_EQ(Scope::Global, FS->Lookup("x"));
+  EXPECT_EQ(Scope::Global, FS->Lookup("y"));
+  EXPECT_TRUE(FS->GetFreeNames().empty());
+}
+
+}
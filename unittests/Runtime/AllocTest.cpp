@@ -0,0 +1,199 @@
+//===- unittests/Runtime/AllocTest.cpp - Allocator and counter tests ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Object.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+using namespace pyrt;
+
+namespace {
+
+/// ClassSize - The bytes the allocator hands out for an object of Size
+/// bytes: its size class, or the size itself past the largest class.
+static unsigned long long ClassSize(size_t Size) {
+  static const size_t Classes[] = { 16, 32, 48, 64, 96, 128, 192, 256 };
+  for (unsigned i = 0; i != sizeof(Classes) / sizeof(Classes[0]); ++i)
+    if (Size <= Classes[i])
+      return Classes[i];
+  return Size;
+}
+
+static py_counters ReadCounters() {
+  py_counters C;
+  py_read_counters(&C);
+  return C;
+}
+
+TEST(AllocTest, SizeClasses) {
+  std::vector<PythonObject*> Items(40, py_none());
+  // Tuples of 0 to 39 items cover every class, and unpooled sizes past them.
+  for (size_t N = 0; N != Items.size(); ++N) {
+    py_reset_counters();
+    unsigned long long Live = ReadCounters().live_bytes;
+    PythonObject *T = py_tuple_new(N, &Items[0]);
+    py_counters C = ReadCounters();
+    EXPECT_EQ(1ULL, C.allocations);
+    EXPECT_EQ(ClassSize(sizeof(TupleObject) + N * sizeof(PythonObject*)),
+              C.bytes_allocated) << N << " items";
+    EXPECT_EQ(Live + C.bytes_allocated, C.live_bytes);
+
+    py_decref(T);
+    C = ReadCounters();
+    EXPECT_EQ(1ULL, C.frees);
+    EXPECT_EQ(Live, C.live_bytes);
+  }
+}
+
+TEST(AllocTest, LiveBytes) {
+  unsigned long long Before = ReadCounters().live_bytes;
+  PythonObject *L = py_list_new(0);
+  PythonObject *S = py_str_new("", 0);
+  EXPECT_EQ(Before + ClassSize(sizeof(ListObject)) +
+            ClassSize(sizeof(StrObject)), ReadCounters().live_bytes);
+
+  // Resetting the counters forgets what was allocated, not what is alive.
+  py_reset_counters();
+  py_counters C = ReadCounters();
+  EXPECT_EQ(0ULL, C.allocations);
+  EXPECT_EQ(0ULL, C.bytes_allocated);
+  EXPECT_NE(0ULL, C.live_bytes);
+
+  py_decref(L);
+  py_decref(S);
+  EXPECT_EQ(Before, ReadCounters().live_bytes);
+}
+
+TEST(AllocTest, FreedBlocksAreReused) {
+  PythonObject *A = py_list_new(0);
+  py_decref(A);
+  // The next object of the same class gets the block just freed.
+  PythonObject *B = py_list_new(0);
+  EXPECT_EQ(A, B);
+  py_decref(B);
+
+  // One of another class doesn't.
+  PythonObject *Items[20] = { 0 };
+  for (unsigned i = 0; i != 20; ++i)
+    Items[i] = py_none();
+  PythonObject *T = py_tuple_new(20, Items);
+  EXPECT_NE(B, T);
+  py_decref(T);
+}
+
+TEST(AllocTest, StackObjectsAreNotAllocations) {
+  py_reset_counters();
+  // Big enough not to be a small int.
+  long long Big = PY_SMALL_INT_MAX;
+  ++Big;
+  union { char Bytes[PY_INT_STACK_BYTES]; double Align; } Mem;
+  PythonObject *I = py_int_init(Mem.Bytes, Big);
+  EXPECT_EQ(static_cast<void*>(Mem.Bytes), static_cast<void*>(I));
+  EXPECT_EQ(Big, py_int_value(I));
+  py_decref(I);
+
+  py_counters C = ReadCounters();
+  EXPECT_EQ(1ULL, C.stack_objects);
+  EXPECT_EQ(0ULL, C.allocations);
+  EXPECT_EQ(0ULL, C.frees);
+}
+
+TEST(AllocTest, ReleasingStackObjectsReleasesWhatTheyHold) {
+  PythonObject *S = py_str_new("x", 1);
+  union { char Bytes[PY_TUPLE_STACK_BYTES(1)]; double Align; } Mem;
+  PythonObject *T = py_tuple_init(Mem.Bytes, 1, &S);
+  py_decref(S);
+
+  py_reset_counters();
+  // The str goes with the tuple; the tuple's memory stays.
+  py_decref(T);
+  EXPECT_EQ(1ULL, ReadCounters().frees);
+}
+
+TEST(AllocTest, StackListsGrowOnTheHeap) {
+  const char Names[] = "abc";
+  PythonObject *Strs[3];
+  for (unsigned i = 0; i != 3; ++i)
+    Strs[i] = py_str_new(Names + i, 1);
+
+  py_reset_counters();
+  union { char Bytes[PY_LIST_STACK_BYTES]; double Align; } Mem;
+  PythonObject *L = py_list_init(Mem.Bytes, 1);
+  EXPECT_EQ(static_cast<void*>(Mem.Bytes), static_cast<void*>(L));
+  EXPECT_EQ(0U, py_seq_size(L));
+  // Past its capacity, the list's items move, but the list itself stays.
+  for (unsigned i = 0; i != 3; ++i) {
+    py_list_append(L, Strs[i]);
+    py_decref(Strs[i]);
+  }
+  EXPECT_EQ(3U, py_seq_size(L));
+  EXPECT_LE(3U, static_cast<ListObject*>(L)->Capacity);
+  for (unsigned i = 0; i != 3; ++i)
+    EXPECT_EQ(Strs[i], py_seq_item(L, i));
+  py_counters C = ReadCounters();
+  EXPECT_EQ(1ULL, C.stack_objects);
+  EXPECT_EQ(0ULL, C.allocations);
+
+  // Its items go with it, and only they are freed.
+  py_decref(L);
+  C = ReadCounters();
+  EXPECT_EQ(3ULL, C.frees);
+  EXPECT_EQ(0ULL, C.allocations);
+
+  // An empty one holds nothing.
+  L = py_list_init(Mem.Bytes, 0);
+  EXPECT_EQ(0U, py_seq_size(L));
+  py_decref(L);
+  EXPECT_EQ(3ULL, ReadCounters().frees);
+}
+
+struct HookLog {
+  unsigned Allocations;
+  size_t Bytes;
+  unsigned Calls[PY_NUM_RUNTIME_FNS];
+};
+
+static void LogAlloc(void *Data, const PythonObject *O, size_t Size) {
+  HookLog *Log = static_cast<HookLog*>(Data);
+  ++Log->Allocations;
+  Log->Bytes += Size;
+}
+
+static void LogCall(void *Data, py_runtime_fn Fn) {
+  ++static_cast<HookLog*>(Data)->Calls[Fn];
+}
+
+TEST(AllocTest, CountersAndHooks) {
+  HookLog Log = { 0, 0, { 0 } };
+  py_reset_counters();
+  py_set_alloc_hook(LogAlloc, &Log);
+  py_set_call_hook(LogCall, &Log);
+
+  PythonObject *D = py_dict_new();
+  py_decref(py_cmp(py_int_new(1), py_int_new(2)));
+  py_decref(py_int_add(py_int_new(1), py_int_new(2)));
+  py_decref(py_int_add(py_int_new(1), py_int_new(2)));
+
+  py_set_alloc_hook(0, 0);
+  py_set_call_hook(0, 0);
+  py_decref(py_int_add(py_int_new(1), py_int_new(2)));
+
+  py_counters C = ReadCounters();
+  EXPECT_EQ(1ULL, C.allocations);
+  EXPECT_EQ(1U, Log.Allocations);
+  EXPECT_EQ(C.bytes_allocated, Log.Bytes);
+  EXPECT_EQ(1ULL, C.calls[PY_FN_CMP]);
+  EXPECT_EQ(3ULL, C.calls[PY_FN_INT_ADD]);
+  EXPECT_EQ(1U, Log.Calls[PY_FN_CMP]);
+  EXPECT_EQ(2U, Log.Calls[PY_FN_INT_ADD]);
+  EXPECT_EQ(0ULL, C.calls[PY_FN_INT_MUL]);
+  py_decref(D);
+}
+
+}
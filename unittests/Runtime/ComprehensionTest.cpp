@@ -0,0 +1,167 @@
+//===- unittests/Runtime/ComprehensionTest.cpp - Comprehension loop tests -===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "EmitTest.h"
+#include "Object.h"
+#include "py/Runtime/Comprehension.h"
+#include "llvm/Constants.h"
+#include "llvm/Instructions.h"
+
+using namespace llvm;
+using namespace py;
+using pyrt::ListObject;
+
+namespace {
+
+class ComprehensionTest : public EmitTest {
+protected:
+  Constant *GetInt64(int64_t V) {
+    return ConstantInt::getSigned(Type::getInt64Ty(Context), V);
+  }
+
+  /// EmitRange - Emit a function Name returning
+  /// [x for x in range(Start, Stop, Step)].
+  void EmitRange(StringRef Name, int64_t Start, int64_t Stop, int64_t Step) {
+    ComprehensionBuilder CB(R, *M, NewFunction(Name, 0));
+    Value *X = CB.AddRange(GetInt64(Start), GetInt64(Stop), Step);
+    Value *L = CB.EmitNewList();
+    CB.EmitAppend(L, R.EmitBoxSmallInt(CB.GetBody(), X));
+    ReturnInst::Create(Context, L, CB.Finish());
+  }
+
+  /// Items - The small ints in the list L, which is released.
+  static std::vector<long long> Items(PythonObject *L) {
+    std::vector<long long> V;
+    for (size_t i = 0, e = py_seq_size(L); i != e; ++i)
+      V.push_back(py_int_value(py_seq_item(L, i)));
+    py_decref(L);
+    return V;
+  }
+
+  static std::vector<long long> List(long long A) {
+    return std::vector<long long>(1, A);
+  }
+};
+
+TEST_F(ComprehensionTest, Ranges) {
+  const long long Max = PY_SMALL_INT_MAX, Min = PY_SMALL_INT_MIN;
+  EmitRange("up", 0, 10, 3);
+  EmitRange("down", 10, 0, -3);
+  EmitRange("empty", 5, 0, 1);
+  EmitRange("huge", Max - 1, Max, INT64_MAX);
+  EmitRange("huge.down", Min + 1, Min, INT64_MIN);
+  ASSERT_TRUE(Compile());
+
+  typedef PythonObject *(*NullaryFn)();
+  PythonObject *L = GetFunction<NullaryFn>("up")();
+  // The list was made with room for every item.
+  EXPECT_EQ(4U, static_cast<ListObject*>(L)->Capacity);
+  long long Up[] = { 0, 3, 6, 9 };
+  EXPECT_EQ(std::vector<long long>(Up, Up + 4), Items(L));
+
+  L = GetFunction<NullaryFn>("down")();
+  EXPECT_EQ(4U, static_cast<ListObject*>(L)->Capacity);
+  long long Down[] = { 10, 7, 4, 1 };
+  EXPECT_EQ(std::vector<long long>(Down, Down + 4), Items(L));
+
+  L = GetFunction<NullaryFn>("empty")();
+  EXPECT_EQ(0U, static_cast<ListObject*>(L)->Capacity);
+  EXPECT_TRUE(Items(L).empty());
+
+  // Stepping past the end overflows an i64, which ends the loop rather than
+  // wrapping around.
+  L = GetFunction<NullaryFn>("huge")();
+  EXPECT_EQ(1U, static_cast<ListObject*>(L)->Capacity);
+  EXPECT_EQ(List(Max - 1), Items(L));
+  L = GetFunction<NullaryFn>("huge.down")();
+  EXPECT_EQ(1U, static_cast<ListObject*>(L)->Capacity);
+  EXPECT_EQ(List(Min + 1), Items(L));
+}
+
+TEST_F(ComprehensionTest, OnlyHugeStepsCheckForOverflow) {
+  EmitRange("small", 0, 10, 1);
+  EmitRange("large", 0, 10, int64_t(1) << 62);
+  EXPECT_FALSE(verifyModule(*M, ReturnStatusAction));
+  EXPECT_TRUE(M->getFunction("llvm.sadd.with.overflow.i64") == 0);
+
+  EmitRange("huge", 0, 10, (int64_t(1) << 62) + 1);
+  EmitRange("huge.down", 0, -10, -(int64_t(1) << 62) - 1);
+  EXPECT_FALSE(verifyModule(*M, ReturnStatusAction));
+  Function *Overflow = M->getFunction("llvm.sadd.with.overflow.i64");
+  ASSERT_TRUE(Overflow != 0);
+  EXPECT_EQ(2U, Overflow->getNumUses());
+
+  // Sizes go to the runtime as size_t.
+  Function *New = M->getFunction("py_list_new");
+  ASSERT_TRUE(New != 0);
+  EXPECT_TRUE(New->getFunctionType()->getParamType(0)
+                ->isIntegerTy(sizeof(size_t) * 8));
+}
+
+TEST_F(ComprehensionTest, SequencesAndFilters) {
+  // [x for x in Seq if x is a small int]
+  ComprehensionBuilder CB(R, *M, NewFunction("ints", 1));
+  Value *Seq = Arg(CB.GetBody(), 0);
+  Value *X = CB.AddSequence(Seq);
+  CB.AddFilter(R.EmitIsSmallInt(CB.GetBody(), X));
+  Value *L = CB.EmitNewList();
+  CB.EmitAppend(L, X);
+  ReturnInst::Create(Context, L, CB.Finish());
+  EXPECT_TRUE(M->getFunction("py_seq_size")->getReturnType()
+                ->isIntegerTy(sizeof(size_t) * 8));
+  ASSERT_TRUE(Compile());
+  UnaryFn Ints = GetFunction<UnaryFn>("ints");
+  ASSERT_TRUE(Ints != 0);
+
+  PythonObject *Str = py_str_new("a", 1);
+  PythonObject *In[] = { py_int_new(1), Str, py_int_new(2), py_none() };
+  PythonObject *T = py_tuple_new(4, In);
+  py_reset_counters();
+  PythonObject *Out = Ints(T);
+  // The tuple is indexed, not iterated over.
+  EXPECT_EQ(0ULL, ReadCounters().calls[PY_FN_NEXTITERATION]);
+  long long Expected[] = { 1, 2 };
+  EXPECT_EQ(std::vector<long long>(Expected, Expected + 2), Items(Out));
+  py_decref(T);
+  py_decref(Str);
+}
+
+TEST_F(ComprehensionTest, NestedLoopsOverIterables) {
+  // [x + y for x in range(0, 3, 1) for y in Iterable]
+  ComprehensionBuilder CB(R, *M, NewFunction("sums", 1));
+  Value *Iterable = Arg(CB.GetBody(), 0);
+  Value *X = CB.AddRange(GetInt64(0), GetInt64(3), 1);
+  Value *BoxedX = R.EmitBoxSmallInt(CB.GetBody(), X);
+  Value *Y = CB.AddIterable(Iterable);
+  Value *L = CB.EmitNewList();
+  BasicBlock *BB = CB.GetBody();
+  Value *Sum = R.EmitIntArith(*M, &BB, Runtime::IntAdd, BoxedX, Y);
+  CB.SetBody(BB);
+  CB.EmitAppend(L, Sum);
+  ReturnInst::Create(Context, L, CB.Finish());
+  ASSERT_TRUE(Compile());
+  UnaryFn Sums = GetFunction<UnaryFn>("sums");
+  ASSERT_TRUE(Sums != 0);
+
+  PythonObject *In[] = { py_int_new(10), py_int_new(20) };
+  PythonObject *T = py_tuple_new(2, In);
+  PythonObject *I = py_startiteration(T);
+  // An iterator is exhausted after the first x; each x starts the
+  // iteration over again.
+  py_reset_counters();
+  long long Once[] = { 10, 20 };
+  EXPECT_EQ(std::vector<long long>(Once, Once + 2), Items(Sums(I)));
+  long long Expected[] = { 10, 20, 11, 21, 12, 22 };
+  EXPECT_EQ(std::vector<long long>(Expected, Expected + 6), Items(Sums(T)));
+  EXPECT_EQ(6ULL, ReadCounters().calls[PY_FN_STARTITERATION]);
+  py_decref(I);
+  py_decref(T);
+}
+
+}
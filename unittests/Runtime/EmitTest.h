@@ -0,0 +1,114 @@
+//===- unittests/Runtime/EmitTest.h - Fixture for emitted runtime code ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// EmitTest is the fixture of the tests of code py::Runtime and its builders
+// emit: a Module laid out for the host, to emit into, and a JIT that runs it
+// against pyrt.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef UNITTESTS_RUNTIME_EMITTEST_H
+#define UNITTESTS_RUNTIME_EMITTEST_H
+
+#include "py/JIT/JIT.h"
+#include "py/Runtime/Runtime.h"
+#include "pyrt.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/Support/DataTypes.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+namespace py {
+
+class EmitTest : public testing::Test {
+protected:
+  EmitTest() : R(Context), M(new llvm::Module("test", Context)) {
+    M->setDataLayout(HostLayout());
+  }
+
+  /// HostLayout - A data layout with the host's pointers, which is all the
+  /// runtime's layouts depend on.
+  static const char *HostLayout() {
+    return sizeof(void*) == 4 ? "p:32:32:32" : "p:64:64:64";
+  }
+
+  /// NewFunction - Add a function Name to In, or M, taking NumParams objects
+  /// and returning one, and return its entry block.
+  llvm::BasicBlock *NewFunction(llvm::StringRef Name, unsigned NumParams,
+                                llvm::Module *In = 0) {
+    std::vector<llvm::Type*> Params(NumParams, R.GetObjectTyPtr());
+    llvm::Function *F =
+      llvm::Function::Create(llvm::FunctionType::get(R.GetObjectTyPtr(),
+                                                     Params,
+                                                     false /*VarArg*/),
+                             llvm::GlobalValue::ExternalLinkage, Name,
+                             In ? In : M.get());
+    return llvm::BasicBlock::Create(Context, "entry", F);
+  }
+
+  /// Arg - Argument I of the function BB is in.
+  static llvm::Value *Arg(llvm::BasicBlock *BB, unsigned I) {
+    llvm::Function::arg_iterator A = BB->getParent()->arg_begin();
+    while (I--)
+      ++A;
+    return A;
+  }
+
+  /// Compile - Verify M and hand it to the JIT, with pyrt's symbols.
+  /// Returns false on failure.
+  bool Compile() {
+    std::string Err;
+    if (llvm::verifyModule(*M, llvm::ReturnStatusAction, &Err)) {
+      ADD_FAILURE() << Err;
+      return false;
+    }
+    J.reset(JIT::create(M.take(), Err));
+    if (!J) {
+      ADD_FAILURE() << Err;
+      return false;
+    }
+    for (const py_symbol *S = py_runtime_symbols; S->name; ++S)
+      J->addSymbol(S->name, S->address);
+    return true;
+  }
+
+  /// GetFunction - The compiled function Name, as an FnTy, or null.
+  template<typename FnTy> FnTy GetFunction(llvm::StringRef Name) {
+    std::string Err;
+    void *Addr = J->getFunctionAddress(Name, Err);
+    if (!Addr)
+      ADD_FAILURE() << Err;
+    return reinterpret_cast<FnTy>(reinterpret_cast<intptr_t>(Addr));
+  }
+
+  static py_counters ReadCounters() {
+    py_counters C;
+    py_read_counters(&C);
+    return C;
+  }
+
+  typedef PythonObject *(*UnaryFn)(PythonObject*);
+  typedef PythonObject *(*BinaryFn)(PythonObject*, PythonObject*);
+
+  llvm::LLVMContext Context;
+  Runtime R;
+  /// Emitted into until Compile hands it to J.
+  llvm::OwningPtr<llvm::Module> M;
+  llvm::OwningPtr<JIT> J;
+};
+
+}
+
+#endif
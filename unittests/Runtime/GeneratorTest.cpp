@@ -0,0 +1,176 @@
+//===- unittests/Runtime/GeneratorTest.cpp - GeneratorBuilder tests -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "EmitTest.h"
+#include "py/Runtime/Generator.h"
+#include "llvm/Constants.h"
+#include "llvm/Instructions.h"
+#include "llvm/Support/IRBuilder.h"
+
+using namespace llvm;
+using namespace py;
+
+namespace {
+
+class GeneratorTest : public EmitTest {
+protected:
+  /// EmitCountFrom - Build a generator yielding slot 0, an i64, then one
+  /// more, and then finishing.
+  void EmitCountFrom(GeneratorBuilder &G) {
+    BasicBlock *BB = G.GetBody();
+    Value *N = new LoadInst(G.EmitSlot(BB, 0), "n", BB);
+    G.EmitYield(&BB, R.EmitBoxSmallInt(BB, N));
+    N = new LoadInst(G.EmitSlot(BB, 0), "n", BB);
+    N = BinaryOperator::CreateAdd(N, ConstantInt::get(N->getType(), 1), "n",
+                                  BB);
+    G.EmitYield(&BB, R.EmitBoxSmallInt(BB, N));
+    G.EmitReturn(BB);
+  }
+
+  /// EmitHolding - Build a generator that yields slot 0, an i64, and then
+  /// a new reference to slot 1, an object, which its frame owns.
+  void EmitHolding(GeneratorBuilder &G) {
+    BasicBlock *BB = G.GetBody();
+    Value *N = new LoadInst(G.EmitSlot(BB, 0), "n", BB);
+    G.EmitYield(&BB, R.EmitBoxSmallInt(BB, N));
+    Value *Held = new LoadInst(G.EmitSlot(BB, 1), "held", BB);
+    Constant *IncRef =
+      M->getOrInsertFunction("py_incref", Type::getVoidTy(Context),
+                             R.GetObjectTyPtr(), NULL);
+    CallInst::Create(IncRef, Held, "", BB);
+    G.EmitYield(&BB, Held);
+    G.EmitReturn(BB);
+  }
+};
+
+TEST_F(GeneratorTest, ResumeDispatchesOnTheState) {
+  Type *Slots[] = { Type::getInt64Ty(Context), R.GetObjectTyPtr() };
+  GeneratorBuilder G(R, *M, "gen", Slots);
+  EmitHolding(G);
+  EXPECT_FALSE(verifyModule(*M, ReturnStatusAction));
+
+  // The state is the first field of the frame, then the slots.
+  StructType *FrameTy = G.GetFrameType();
+  ASSERT_EQ(3U, FrameTy->getNumElements());
+  EXPECT_TRUE(FrameTy->getElementType(0)->isIntegerTy(32));
+
+  // One case for the start, and one for after each yield; anything else,
+  // as a finished generator's state, goes to the default, which returns
+  // null.
+  Function *Resume = G.GetResumeFunction();
+  EXPECT_EQ("gen.resume", Resume->getName().str());
+  SwitchInst *SI = cast<SwitchInst>(Resume->getEntryBlock().getTerminator());
+  EXPECT_EQ(4U, SI->getNumSuccessors());
+  EXPECT_EQ("done", SI->getDefaultDest()->getName().str());
+  EXPECT_EQ("resume.2", SI->getSuccessor(SI->getNumSuccessors() - 1)
+                          ->getName().str());
+
+  // The object slot gets a destroy function.
+  ASSERT_TRUE(G.GetDestroyFunction() != 0);
+  EXPECT_EQ("gen.destroy", G.GetDestroyFunction()->getName().str());
+
+  Type *Ints[] = { Type::getInt64Ty(Context) };
+  GeneratorBuilder NoObjects(R, *M, "ints", Ints);
+  EXPECT_TRUE(NoObjects.GetDestroyFunction() == 0);
+}
+
+TEST_F(GeneratorTest, HeapGenerators) {
+  Type *Slots[] = { Type::getInt64Ty(Context), R.GetObjectTyPtr() };
+  GeneratorBuilder G(R, *M, "gen", Slots);
+  EmitHolding(G);
+
+  // make(S) returns a generator holding a new reference to S.
+  BasicBlock *BB = NewFunction("make", 1);
+  Value *S = Arg(BB, 0);
+  Value *Frame;
+  Value *Gen = G.EmitHeapGenerator(BB, &Frame);
+  IRBuilder<> IRB(BB);
+  IRB.CreateStore(IRB.getInt64(42), G.EmitFrameSlot(BB, Frame, 0));
+  IRB.CreateCall(M->getOrInsertFunction("py_incref", IRB.getVoidTy(),
+                                        R.GetObjectTyPtr(), NULL), S);
+  IRB.CreateStore(S, G.EmitFrameSlot(BB, Frame, 1));
+  IRB.CreateRet(Gen);
+
+  ASSERT_TRUE(Compile());
+  UnaryFn Make = GetFunction<UnaryFn>("make");
+  ASSERT_TRUE(Make != 0);
+
+  // Run to the end, py_nextiteration resumes it directly, and once it is
+  // freed its frame releases S.
+  PythonObject *Str = py_str_new("held", 4);
+  py_reset_counters();
+  PythonObject *Generator = Make(Str);
+  EXPECT_EQ(py_int_new(42), py_nextiteration(Generator));
+  PythonObject *Held = py_nextiteration(Generator);
+  EXPECT_EQ(Str, Held);
+  py_decref(Held);
+  EXPECT_EQ(0, py_nextiteration(Generator));
+  EXPECT_EQ(0, py_nextiteration(Generator));
+  EXPECT_EQ(0ULL, ReadCounters().calls[PY_FN_YIELD]);
+  py_decref(Generator);
+  unsigned long long Frees = ReadCounters().frees;
+  py_decref(Str);
+  EXPECT_EQ(Frees + 1, ReadCounters().frees);
+
+  // Freed while suspended, it releases S too.
+  Str = py_str_new("held", 4);
+  Generator = Make(Str);
+  EXPECT_EQ(py_int_new(42), py_nextiteration(Generator));
+  py_decref(Generator);
+  Frees = ReadCounters().frees;
+  py_decref(Str);
+  EXPECT_EQ(Frees + 1, ReadCounters().frees);
+}
+
+TEST_F(GeneratorTest, StackFrames) {
+  Type *Slots[] = { Type::getInt64Ty(Context) };
+  GeneratorBuilder G(R, *M, "count", Slots);
+  EmitCountFrom(G);
+
+  // sum() adds up what a generator on its own stack yields, from 20.
+  BasicBlock *Entry = NewFunction("sum", 0);
+  Function *F = Entry->getParent();
+  BasicBlock *Header = BasicBlock::Create(Context, "header", F);
+  BasicBlock *Body = BasicBlock::Create(Context, "body", F);
+  BasicBlock *Exit = BasicBlock::Create(Context, "exit", F);
+  Value *Frame = G.EmitStackFrame(Entry);
+  IRBuilder<> IRB(Entry);
+  IRB.CreateStore(IRB.getInt64(20), G.EmitFrameSlot(Entry, Frame, 0));
+  Value *Zero = R.EmitBoxSmallInt(Entry, IRB.getInt64(0));
+  IRB.CreateBr(Header);
+
+  IRB.SetInsertPoint(Header);
+  PHINode *Sum = IRB.CreatePHI(R.GetObjectTyPtr(), 2, "sum");
+  Sum->addIncoming(Zero, Entry);
+  Value *Next = G.EmitResume(Header, Frame);
+  IRB.CreateCondBr(IRB.CreateIsNull(Next), Exit, Body);
+
+  BasicBlock *BB = Body;
+  Value *NewSum = R.EmitIntArith(*M, &BB, Runtime::IntAdd, Sum, Next);
+  Sum->addIncoming(NewSum, BB);
+  IRBuilder<>(BB).CreateBr(Header);
+
+  G.EmitDestroy(Exit, Frame);
+  IRB.SetInsertPoint(Exit);
+  IRB.CreateRet(Sum);
+
+  // Nothing is allocated for the generator.
+  EXPECT_TRUE(M->getFunction("py_generator_new") == 0);
+  ASSERT_TRUE(Compile());
+  typedef PythonObject *(*NullaryFn)();
+  NullaryFn SumFn = GetFunction<NullaryFn>("sum");
+  ASSERT_TRUE(SumFn != 0);
+  py_reset_counters();
+  EXPECT_EQ(py_int_new(41), SumFn());
+  py_counters C = ReadCounters();
+  EXPECT_EQ(0ULL, C.allocations);
+  EXPECT_EQ(0ULL, C.calls[PY_FN_INT_ADD]);
+}
+
+}
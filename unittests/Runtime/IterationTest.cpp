@@ -0,0 +1,219 @@
+//===- unittests/Runtime/IterationTest.cpp - Iterator and generator tests -===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "pyrt.h"
+#include "gtest/gtest.h"
+#include <cstring>
+
+namespace {
+
+static py_counters ReadCounters() {
+  py_counters C;
+  py_read_counters(&C);
+  return C;
+}
+
+TEST(IterationTest, Sequences) {
+  PythonObject *Items[] = { py_int_new(1), py_int_new(2) };
+  PythonObject *T = py_tuple_new(2, Items);
+  PythonObject *I = py_startiteration(T);
+  EXPECT_EQ(Items[0], py_nextiteration(I));
+  EXPECT_EQ(Items[1], py_nextiteration(I));
+  EXPECT_EQ(0, py_nextiteration(I));
+  EXPECT_EQ(0, py_nextiteration(I));
+  py_decref(I);
+  py_decref(T);
+
+  // Items appended to a list while it is iterated over are seen.
+  PythonObject *L = py_list_new(0);
+  py_list_append(L, py_int_new(1));
+  I = py_startiteration(L);
+  EXPECT_EQ(py_int_new(1), py_nextiteration(I));
+  py_list_append(L, py_int_new(2));
+  EXPECT_EQ(py_int_new(2), py_nextiteration(I));
+  EXPECT_EQ(0, py_nextiteration(I));
+  py_decref(I);
+  py_decref(L);
+
+  // An iterator is its own iterator.
+  PythonObject *S = py_str_new("ab", 2);
+  I = py_startiteration(S);
+  PythonObject *Same = py_startiteration(I);
+  EXPECT_EQ(I, Same);
+  py_decref(Same);
+  PythonObject *A = py_nextiteration(I);
+  EXPECT_EQ(py_int_new(-1), py_cmp(A, S));
+  py_decref(A);
+  py_decref(I);
+  py_decref(S);
+}
+
+/// CountDown - A generator function yielding N-1 down to 0, where N is the
+/// only item of Args.
+static PythonObject *CountDown(PythonObject *Args, PythonObject *Closure) {
+  long long N = py_int_value(py_seq_item(Args, 0));
+  while (N--)
+    py_decref(py_yield(py_int_new(N)));
+  return py_none();
+}
+
+static PythonObject *NewCountDown(long long N) {
+  PythonObject *Fn = py_function_new(CountDown);
+  PythonObject *Count = py_int_new(N);
+  PythonObject *Args = py_tuple_new(1, &Count);
+  PythonObject *G = py_generatorfactory(Fn, Args, py_none());
+  py_decref(Fn);
+  py_decref(Args);
+  return G;
+}
+
+TEST(IterationTest, GeneratorResumesAndIsExhausted) {
+  py_reset_counters();
+  PythonObject *G = NewCountDown(3);
+  // Nothing runs before the first resume.
+  EXPECT_EQ(0ULL, ReadCounters().calls[PY_FN_YIELD]);
+
+  PythonObject *I = py_startiteration(G);
+  EXPECT_EQ(G, I);
+  py_decref(I);
+  EXPECT_EQ(py_int_new(2), py_nextiteration(G));
+  EXPECT_EQ(py_int_new(1), py_nextiteration(G));
+  EXPECT_EQ(py_int_new(0), py_nextiteration(G));
+  EXPECT_EQ(3ULL, ReadCounters().calls[PY_FN_YIELD]);
+  EXPECT_EQ(0, py_nextiteration(G));
+  // And stays exhausted, without running again.
+  EXPECT_EQ(0, py_nextiteration(G));
+  EXPECT_EQ(3ULL, ReadCounters().calls[PY_FN_YIELD]);
+  py_decref(G);
+}
+
+TEST(IterationTest, NestedGenerators) {
+  PythonObject *Outer = NewCountDown(2);
+  PythonObject *Inner = NewCountDown(2);
+  EXPECT_EQ(py_int_new(1), py_nextiteration(Outer));
+  EXPECT_EQ(py_int_new(1), py_nextiteration(Inner));
+  EXPECT_EQ(py_int_new(0), py_nextiteration(Outer));
+  EXPECT_EQ(py_int_new(0), py_nextiteration(Inner));
+  EXPECT_EQ(0, py_nextiteration(Inner));
+  EXPECT_EQ(0, py_nextiteration(Outer));
+  py_decref(Inner);
+  py_decref(Outer);
+}
+
+/// BindsAndYields - A generator function that binds a name in its own
+/// namespace, and yields that namespace.
+static PythonObject *BindsAndYields(PythonObject *Args,
+                                    PythonObject *Closure) {
+  PythonObject *Name = py_str_new("local", 5);
+  py_decref(py_bind(Name, py_int_new(1)));
+  py_decref(Name);
+  PythonObject *Locals = py_getlocals();
+  py_decref(py_yield(Locals));
+  py_decref(Locals);
+  return py_none();
+}
+
+TEST(IterationTest, GeneratorsHaveTheirOwnNamespace) {
+  PythonObject *Fn = py_function_new(BindsAndYields);
+  PythonObject *G = py_generatorfactory(Fn, py_none(), py_none());
+  PythonObject *Locals = py_nextiteration(G);
+  PythonObject *Globals = py_getglobals();
+  EXPECT_NE(Globals, Locals);
+
+  PythonObject *Name = py_str_new("local", 5);
+  EXPECT_EQ(py_int_new(1), py_dict_lookup(Locals, Name));
+  EXPECT_EQ(0, py_dict_lookup(Globals, Name));
+  // Module code binds in the globals.
+  PythonObject *ModuleLocals = py_getlocals();
+  EXPECT_EQ(Globals, ModuleLocals);
+
+  EXPECT_EQ(0, py_nextiteration(G));
+  py_decref(ModuleLocals);
+  py_decref(Name);
+  py_decref(Globals);
+  py_decref(Locals);
+  py_decref(G);
+  py_decref(Fn);
+}
+
+/// HoldsAStr - A generator function that keeps a reference to a str of its
+/// own across its only yield.
+static PythonObject *HoldsAStr(PythonObject *Args, PythonObject *Closure) {
+  PythonObject *S = py_str_new("held", 4);
+  py_decref(py_yield(py_none()));
+  py_decref(S);
+  return py_none();
+}
+
+TEST(IterationTest, GeneratorFreedWhileSuspendedLeaksItsFrame) {
+  PythonObject *Fn = py_function_new(HoldsAStr);
+
+  // Run to the end, the str is released.
+  py_reset_counters();
+  PythonObject *G = py_generatorfactory(Fn, py_none(), py_none());
+  EXPECT_EQ(py_none(), py_nextiteration(G));
+  EXPECT_EQ(0, py_nextiteration(G));
+  py_decref(G);
+  py_counters C = ReadCounters();
+  EXPECT_EQ(C.allocations, C.frees);
+
+  // Freed while suspended, the generator's own objects are released, but
+  // what its function's frame holds is not: the str is leaked. This is the
+  // documented behaviour of py_generatorfactory.
+  py_reset_counters();
+  G = py_generatorfactory(Fn, py_none(), py_none());
+  EXPECT_EQ(py_none(), py_nextiteration(G));
+  py_decref(G);
+  C = ReadCounters();
+  EXPECT_EQ(C.allocations, C.frees + 1);
+
+  py_decref(Fn);
+}
+
+/// Frame - The frame of the state machine generator below.
+struct Frame {
+  long long Next;
+  long long End;
+  bool *Destroyed;
+};
+
+static PythonObject *ResumeFrame(void *F) {
+  Frame *Fr = static_cast<Frame*>(F);
+  if (Fr->Next == Fr->End)
+    return 0;
+  return py_int_new(Fr->Next++);
+}
+
+static void DestroyFrame(void *F) {
+  *static_cast<Frame*>(F)->Destroyed = true;
+}
+
+TEST(IterationTest, FrameGenerators) {
+  bool Destroyed = false;
+  PythonObject *G = py_generator_new(ResumeFrame, DestroyFrame, sizeof(Frame));
+  Frame *F = static_cast<Frame*>(py_generator_frame(G));
+  // The frame starts zeroed.
+  EXPECT_EQ(0, F->Next);
+  EXPECT_EQ(0, F->End);
+  F->End = 2;
+  F->Destroyed = &Destroyed;
+
+  EXPECT_EQ(py_int_new(0), py_nextiteration(G));
+  EXPECT_EQ(py_int_new(1), py_nextiteration(G));
+  EXPECT_EQ(0, py_nextiteration(G));
+  // Once finished, Resume isn't called again.
+  F->End = 3;
+  EXPECT_EQ(0, py_nextiteration(G));
+
+  EXPECT_FALSE(Destroyed);
+  py_decref(G);
+  EXPECT_TRUE(Destroyed);
+}
+
+}
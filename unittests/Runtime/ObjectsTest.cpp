@@ -0,0 +1,214 @@
+//===- unittests/Runtime/ObjectsTest.cpp - Built-in object type tests -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Object.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace pyrt;
+
+namespace {
+
+static PythonObject *Str(const char *S) {
+  return py_str_new(S, std::strlen(S));
+}
+
+static unsigned long long NumAllocations() {
+  py_counters C;
+  py_read_counters(&C);
+  return C.allocations;
+}
+
+TEST(ObjectsTest, SmallInts) {
+  py_reset_counters();
+  PythonObject *Small[] = {
+    py_int_new(0), py_int_new(-1), py_int_new(42),
+    py_int_new(PY_SMALL_INT_MAX), py_int_new(PY_SMALL_INT_MIN)
+  };
+  for (unsigned i = 0; i != sizeof(Small) / sizeof(Small[0]); ++i)
+    EXPECT_TRUE(PY_IS_SMALL_INT(Small[i]));
+  EXPECT_EQ(0ULL, NumAllocations());
+  EXPECT_EQ(42, py_int_value(Small[2]));
+  EXPECT_EQ(PY_SMALL_INT_MAX, py_int_value(Small[3]));
+  EXPECT_EQ(PY_SMALL_INT_MIN, py_int_value(Small[4]));
+  // Equal small ints are the same object.
+  EXPECT_EQ(py_int_new(42), Small[2]);
+
+  // Just out of range, ints are allocated.
+  PythonObject *Big = py_int_new(PY_SMALL_INT_MAX + 1);
+  PythonObject *Neg = py_int_new(PY_SMALL_INT_MIN - 1);
+  EXPECT_FALSE(PY_IS_SMALL_INT(Big));
+  EXPECT_FALSE(PY_IS_SMALL_INT(Neg));
+  EXPECT_EQ(2ULL, NumAllocations());
+  EXPECT_EQ(PY_SMALL_INT_MAX + 1, py_int_value(Big));
+  EXPECT_EQ(PY_SMALL_INT_MIN - 1, py_int_value(Neg));
+  py_decref(Big);
+  py_decref(Neg);
+}
+
+TEST(ObjectsTest, ArithmeticOverflowsSmallInts) {
+  PythonObject *Max = py_int_new(PY_SMALL_INT_MAX);
+  PythonObject *Min = py_int_new(PY_SMALL_INT_MIN);
+  PythonObject *One = py_int_new(1), *Two = py_int_new(2);
+
+  py_reset_counters();
+  PythonObject *Sum = py_int_add(Max, One);
+  PythonObject *Diff = py_int_sub(Min, One);
+  PythonObject *Prod = py_int_mul(Max, Two);
+  EXPECT_EQ(3ULL, NumAllocations());
+  EXPECT_FALSE(PY_IS_SMALL_INT(Sum));
+  EXPECT_EQ(PY_SMALL_INT_MAX + 1, py_int_value(Sum));
+  EXPECT_EQ(PY_SMALL_INT_MIN - 1, py_int_value(Diff));
+  EXPECT_EQ(PY_SMALL_INT_MAX * 2, py_int_value(Prod));
+
+  // Results back in range are small ints again.
+  PythonObject *Back = py_int_sub(Sum, One);
+  EXPECT_TRUE(PY_IS_SMALL_INT(Back));
+  EXPECT_EQ(Max, Back);
+  EXPECT_EQ(3ULL, NumAllocations());
+
+  // cmp sees no difference between the two encodings.
+  PythonObject *Same = py_int_new(PY_SMALL_INT_MAX + 1);
+  EXPECT_EQ(py_int_new(0), py_cmp(Sum, Same));
+  EXPECT_EQ(py_int_new(1), py_cmp(Sum, Max));
+  EXPECT_EQ(py_int_new(-1), py_cmp(Diff, Min));
+
+  py_decref(Sum);
+  py_decref(Diff);
+  py_decref(Prod);
+  py_decref(Same);
+}
+
+TEST(ObjectsTest, IntOverflowIsFatal) {
+  const long long Max = 0x7fffffffffffffffLL;
+  PythonObject *Big = py_int_new(Max);
+  EXPECT_DEATH(py_int_add(Big, py_int_new(1)), "integer overflow");
+  EXPECT_DEATH(py_int_sub(py_int_new(-2), Big), "integer overflow");
+  EXPECT_DEATH(py_int_mul(Big, py_int_new(2)), "integer overflow");
+  py_decref(Big);
+}
+
+TEST(ObjectsTest, DictSetGet) {
+  PythonObject *D = py_dict_new();
+  PythonObject *Key = Str("key");
+  PythonObject *Value = Str("value");
+  py_dict_set(D, Key, Value);
+
+  // Strs compare by content, so an equal str finds the entry.
+  PythonObject *Other = Str("key");
+  PythonObject *Got = py_dict_get(D, Other);
+  EXPECT_EQ(Value, Got);
+  py_decref(Got);
+  EXPECT_EQ(Value, py_dict_lookup(D, Other));
+  EXPECT_EQ(0, py_dict_get(D, py_int_new(1)));
+
+  // Setting it again replaces the value, and releases the old one.
+  py_reset_counters();
+  py_dict_set(D, Other, py_int_new(7));
+  py_counters C;
+  py_read_counters(&C);
+  EXPECT_EQ(0ULL, C.frees);
+  py_decref(Value);
+  py_read_counters(&C);
+  EXPECT_EQ(1ULL, C.frees);
+  EXPECT_EQ(py_int_new(7), py_dict_lookup(D, Key));
+
+  // Ints and bools with the same value are the same key.
+  py_dict_set(D, py_int_new(1), py_none());
+  EXPECT_EQ(py_none(), py_dict_lookup(D, py_bool(1)));
+
+  py_decref(Key);
+  py_decref(Other);
+  py_decref(D);
+}
+
+TEST(ObjectsTest, DictGrows) {
+  PythonObject *D = py_dict_new();
+  char Buf[16];
+  for (int i = 0; i != 1000; ++i) {
+    std::sprintf(Buf, "k%d", i);
+    PythonObject *Key = Str(Buf);
+    py_dict_set(D, Key, py_int_new(i));
+    py_decref(Key);
+  }
+  EXPECT_EQ(1000U, static_cast<DictObject*>(D)->Size);
+  for (int i = 0; i != 1000; ++i) {
+    std::sprintf(Buf, "k%d", i);
+    PythonObject *Key = Str(Buf);
+    EXPECT_EQ(py_int_new(i), py_dict_lookup(D, Key));
+    py_decref(Key);
+  }
+  py_decref(D);
+}
+
+/// Lookup - Look Key up in D through C, checking the first way first the
+/// way py::Runtime::EmitCachedLookup does inline.
+static PythonObject *Lookup(PythonObject *D, PythonObject *Key,
+                            py_lookup_cache &C) {
+  DictObject *Dict = static_cast<DictObject*>(D);
+  if (C.ways[0].version == Dict->Version)
+    return Dict->Entries[C.ways[0].slot].Value;
+  return py_dict_lookup_cached(D, Key, &C);
+}
+
+TEST(ObjectsTest, CachedLookup) {
+  PythonObject *Key = Str("x");
+  PythonObject *A = py_dict_new(), *B = py_dict_new();
+  py_dict_set(A, Key, py_int_new(1));
+  py_dict_set(B, Key, py_int_new(2));
+  py_lookup_cache C;
+  std::memset(&C, 0, sizeof(C));
+
+  py_reset_counters();
+  py_counters Counters;
+  EXPECT_EQ(py_int_new(1), Lookup(A, Key, C));
+  EXPECT_EQ(py_int_new(1), Lookup(A, Key, C));
+  py_read_counters(&Counters);
+  EXPECT_EQ(1ULL, Counters.cache_misses);
+  EXPECT_EQ(0ULL, Counters.cache_poly_hits);
+
+  // A second dict takes the inline way, and the first is found in another.
+  EXPECT_EQ(py_int_new(2), Lookup(B, Key, C));
+  EXPECT_EQ(py_int_new(1), Lookup(A, Key, C));
+  py_read_counters(&Counters);
+  EXPECT_EQ(2ULL, Counters.cache_misses);
+  EXPECT_EQ(1ULL, Counters.cache_poly_hits);
+
+  // Misses are cached too, until the key is added.
+  PythonObject *Missing = Str("y");
+  std::memset(&C, 0, sizeof(C));
+  EXPECT_EQ(0, Lookup(A, Missing, C));
+  EXPECT_EQ(0, Lookup(A, Missing, C));
+  py_dict_set(A, Missing, py_int_new(3));
+  EXPECT_EQ(py_int_new(3), Lookup(A, Missing, C));
+  py_read_counters(&Counters);
+  EXPECT_EQ(4ULL, Counters.cache_misses);
+
+  py_decref(Missing);
+  py_decref(Key);
+  py_decref(A);
+  py_decref(B);
+}
+
+TEST(ObjectsTest, Cells) {
+  PythonObject *Cell = py_cell_new();
+  EXPECT_EQ(0, py_cell_get(Cell));
+  PythonObject *S = Str("v");
+  py_cell_set(Cell, S);
+  py_decref(S);
+  EXPECT_EQ(S, py_cell_get(Cell));
+  // Setting a cell to its own value keeps the value alive.
+  py_cell_set(Cell, py_cell_get(Cell));
+  StrObject *V = static_cast<StrObject*>(py_cell_get(Cell));
+  EXPECT_EQ(0, std::strcmp("v", V->Data));
+  py_decref(Cell);
+}
+
+}
@@ -0,0 +1,196 @@
+//===- unittests/Runtime/RuntimeTest.cpp - Inline int and lookup tests ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "EmitTest.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/Instructions.h"
+#include "llvm/Support/InstIterator.h"
+
+using namespace llvm;
+using namespace py;
+
+namespace {
+
+class RuntimeTest : public EmitTest {
+protected:
+  /// EmitArith - Emit a function Name of In, or M, returning Op of its two
+  /// arguments through EmitIntArith.
+  void EmitArith(StringRef Name, Runtime::Fns Op, Module *In = 0) {
+    BasicBlock *BB = NewFunction(Name, 2, In);
+    Value *A = Arg(BB, 0), *B = Arg(BB, 1);
+    Value *V = R.EmitIntArith(In ? *In : *M, &BB, Op, A, B);
+    ReturnInst::Create(Context, V, BB);
+  }
+
+  /// EmitLookup - Emit a function Name returning its first argument, a
+  /// dict, looked up in its second through EmitCachedLookup.
+  void EmitLookup(StringRef Name) {
+    BasicBlock *BB = NewFunction(Name, 2);
+    Value *D = Arg(BB, 0), *K = Arg(BB, 1);
+    ReturnInst::Create(Context, R.EmitCachedLookup(*M, &BB, D, K), BB);
+  }
+};
+
+TEST_F(RuntimeTest, IntPtrTyFollowsTheDataLayout) {
+  Module Mod("layout", Context);
+  // Without a layout, pointers are taken to be 64 bits.
+  EXPECT_EQ(64U, R.GetIntPtrTy(Mod)->getBitWidth());
+  Mod.setDataLayout("p:32:32:32");
+  EXPECT_EQ(32U, R.GetIntPtrTy(Mod)->getBitWidth());
+  EXPECT_EQ(sizeof(void*) * 8, R.GetIntPtrTy(*M)->getBitWidth());
+}
+
+TEST_F(RuntimeTest, IntArithIsPointerSized) {
+  const char *Layouts[] = { "p:32:32:32", "p:64:64:64" };
+  const char *Overflow[] = { "llvm.sadd.with.overflow.i32",
+                             "llvm.sadd.with.overflow.i64" };
+  for (unsigned i = 0; i != 2; ++i) {
+    Module Mod("width", Context);
+    Mod.setDataLayout(Layouts[i]);
+    EmitArith("add", Runtime::IntAdd, &Mod);
+    EXPECT_FALSE(verifyModule(Mod, ReturnStatusAction));
+
+    // The tags are tested, and the sum taken, at the pointers' width, so
+    // the add overflows just where the target's small ints do.
+    unsigned Bits = i == 0 ? 32 : 64;
+    unsigned NumPtrToInt = 0;
+    Function *F = Mod.getFunction("add");
+    for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+      if (PtrToIntInst *P = dyn_cast<PtrToIntInst>(&*I)) {
+        EXPECT_EQ(Bits, cast<IntegerType>(P->getType())->getBitWidth());
+        ++NumPtrToInt;
+      }
+    EXPECT_EQ(2U, NumPtrToInt);
+    EXPECT_TRUE(Mod.getFunction(Overflow[i]) != 0) << Layouts[i];
+    EXPECT_TRUE(Mod.getFunction(Overflow[1 - i]) == 0) << Layouts[i];
+    EXPECT_TRUE(Mod.getFunction("py_int_add") != 0);
+  }
+}
+
+TEST_F(RuntimeTest, IntArithRuns) {
+  EmitArith("add", Runtime::IntAdd);
+  EmitArith("sub", Runtime::IntSub);
+  EmitArith("mul", Runtime::IntMul);
+  ASSERT_TRUE(Compile());
+  BinaryFn Add = GetFunction<BinaryFn>("add");
+  BinaryFn Sub = GetFunction<BinaryFn>("sub");
+  BinaryFn Mul = GetFunction<BinaryFn>("mul");
+  ASSERT_TRUE(Add && Sub && Mul);
+
+  // Small ints in, small ints out, without calling the runtime.
+  py_reset_counters();
+  EXPECT_EQ(py_int_new(5), Add(py_int_new(2), py_int_new(3)));
+  EXPECT_EQ(py_int_new(-1), Sub(py_int_new(2), py_int_new(3)));
+  EXPECT_EQ(py_int_new(-12), Mul(py_int_new(-4), py_int_new(3)));
+  EXPECT_EQ(py_int_new(0), Mul(py_int_new(0), py_int_new(PY_SMALL_INT_MAX)));
+  EXPECT_EQ(py_int_new(PY_SMALL_INT_MIN),
+            Sub(py_int_new(PY_SMALL_INT_MIN + 1), py_int_new(1)));
+  py_counters C = ReadCounters();
+  EXPECT_EQ(0ULL, C.calls[PY_FN_INT_ADD]);
+  EXPECT_EQ(0ULL, C.calls[PY_FN_INT_SUB]);
+  EXPECT_EQ(0ULL, C.calls[PY_FN_INT_MUL]);
+
+  // Results past the small ints are left to the runtime.
+  PythonObject *Max = py_int_new(PY_SMALL_INT_MAX);
+  PythonObject *Min = py_int_new(PY_SMALL_INT_MIN);
+  PythonObject *Sum = Add(Max, py_int_new(1));
+  PythonObject *Diff = Sub(Min, py_int_new(1));
+  PythonObject *Prod = Mul(Max, py_int_new(2));
+  PythonObject *Neg = Mul(Min, py_int_new(-1));
+  EXPECT_EQ(PY_SMALL_INT_MAX + 1, py_int_value(Sum));
+  EXPECT_EQ(PY_SMALL_INT_MIN - 1, py_int_value(Diff));
+  EXPECT_EQ(PY_SMALL_INT_MAX * 2, py_int_value(Prod));
+  EXPECT_EQ(-PY_SMALL_INT_MIN, py_int_value(Neg));
+  C = ReadCounters();
+  EXPECT_EQ(1ULL, C.calls[PY_FN_INT_ADD]);
+  EXPECT_EQ(1ULL, C.calls[PY_FN_INT_SUB]);
+  EXPECT_EQ(2ULL, C.calls[PY_FN_INT_MUL]);
+
+  // As are boxed ints, even when the result is small.
+  EXPECT_EQ(Max, Sub(Sum, py_int_new(1)));
+  EXPECT_EQ(2ULL, ReadCounters().calls[PY_FN_INT_SUB]);
+
+  py_decref(Sum);
+  py_decref(Diff);
+  py_decref(Prod);
+  py_decref(Neg);
+}
+
+TEST_F(RuntimeTest, CachedLookupCallsOnlyOnAMiss) {
+  EmitLookup("lookup");
+  EmitLookup("lookup2");
+  EXPECT_FALSE(verifyModule(*M, ReturnStatusAction));
+
+  // Each site has a cache of its own, which is passed to the runtime from
+  // the miss block, the only one with a call.
+  Function *Miss = M->getFunction("py_dict_lookup_cached");
+  ASSERT_TRUE(Miss != 0);
+  EXPECT_EQ(2U, Miss->getNumUses());
+  unsigned NumCaches = 0;
+  for (Module::global_iterator G = M->global_begin(), E = M->global_end();
+       G != E; ++G) {
+    EXPECT_TRUE(G->hasPrivateLinkage());
+    ++NumCaches;
+  }
+  EXPECT_EQ(2U, NumCaches);
+
+  Function *F = M->getFunction("lookup");
+  unsigned NumCalls = 0;
+  for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+    if (CallInst *CI = dyn_cast<CallInst>(&*I)) {
+      EXPECT_EQ(Miss, CI->getCalledFunction());
+      EXPECT_EQ("lookup.miss", CI->getParent()->getName().str());
+      EXPECT_TRUE(isa<GlobalVariable>(CI->getArgOperand(2)));
+      ++NumCalls;
+    }
+  EXPECT_EQ(1U, NumCalls);
+}
+
+TEST_F(RuntimeTest, CachedLookupRuns) {
+  EmitLookup("lookup");
+  ASSERT_TRUE(Compile());
+  BinaryFn Lookup = GetFunction<BinaryFn>("lookup");
+  ASSERT_TRUE(Lookup != 0);
+
+  PythonObject *Key = py_str_new("x", 1);
+  PythonObject *A = py_dict_new(), *B = py_dict_new();
+  py_dict_set(A, Key, py_int_new(1));
+  py_dict_set(B, Key, py_int_new(2));
+
+  // The first lookup fills the way checked inline, which reads pyrt's dict
+  // layout to find the value with no call.
+  py_reset_counters();
+  EXPECT_EQ(py_int_new(1), Lookup(A, Key));
+  EXPECT_EQ(py_int_new(1), Lookup(A, Key));
+  EXPECT_EQ(py_int_new(1), Lookup(A, Key));
+  py_counters C = ReadCounters();
+  EXPECT_EQ(1ULL, C.cache_misses);
+  EXPECT_EQ(0ULL, C.cache_poly_hits);
+
+  // Another dict pushes the first out of the inline way, into another.
+  EXPECT_EQ(py_int_new(2), Lookup(B, Key));
+  EXPECT_EQ(py_int_new(1), Lookup(A, Key));
+  C = ReadCounters();
+  EXPECT_EQ(2ULL, C.cache_misses);
+  EXPECT_EQ(1ULL, C.cache_poly_hits);
+
+  // A dict that changes is looked up again.
+  PythonObject *Other = py_str_new("y", 1);
+  py_dict_set(B, Other, py_none());
+  py_dict_set(B, Key, py_int_new(3));
+  EXPECT_EQ(py_int_new(3), Lookup(B, Key));
+  EXPECT_EQ(3ULL, ReadCounters().cache_misses);
+
+  py_decref(Other);
+  py_decref(Key);
+  py_decref(A);
+  py_decref(B);
+}
+
+}
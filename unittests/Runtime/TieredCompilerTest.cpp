@@ -0,0 +1,95 @@
+//===- unittests/Runtime/TieredCompilerTest.cpp - Tiering tests -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "EmitTest.h"
+#include "py/JIT/TieredCompiler.h"
+#include "llvm/Instructions.h"
+
+using namespace llvm;
+using namespace py;
+
+namespace {
+
+class TieredCompilerTest : public EmitTest {
+protected:
+  /// EmitAdd - Emit a function Name returning py_int_add of its two
+  /// arguments, a site for the tiers to specialize.
+  void EmitAdd(StringRef Name) {
+    BasicBlock *BB = NewFunction(Name, 2);
+    Value *Args[] = { Arg(BB, 0), Arg(BB, 1) };
+    Value *Sum = CallInst::Create(R.GetFunction(*M, Runtime::IntAdd), Args,
+                                  "sum", BB);
+    ReturnInst::Create(Context, Sum, BB);
+  }
+};
+
+TEST_F(TieredCompilerTest, OnlyFailedGuardsDeoptimize) {
+  EmitAdd("add");
+  ASSERT_TRUE(Compile());
+  TieredCompiler TC(*J, R, 2 /*HotCalls*/);
+  TC.addFunction(J->getModule().getFunction("add"));
+  BinaryFn Add = GetFunction<BinaryFn>("add");
+  ASSERT_TRUE(Add != 0);
+
+  // Small ints make the second call hot, and the site is specialized.
+  py_reset_counters();
+  EXPECT_EQ(py_int_new(3), Add(py_int_new(1), py_int_new(2)));
+  EXPECT_EQ(py_int_new(5), Add(py_int_new(2), py_int_new(3)));
+  EXPECT_EQ(1ULL, ReadCounters().tier_ups);
+  EXPECT_EQ(1U, TC.getStats().SitesSpecialized);
+  Function *Opt = J->getModule().getFunction("add.opt");
+  ASSERT_TRUE(Opt != 0);
+
+  // The optimized tier adds small ints inline.
+  unsigned long long Adds = ReadCounters().calls[PY_FN_INT_ADD];
+  EXPECT_EQ(py_int_new(7), Add(py_int_new(3), py_int_new(4)));
+  EXPECT_EQ(Adds, ReadCounters().calls[PY_FN_INT_ADD]);
+
+  // Small ints whose sum overflows pass the guard, so they call py_int_add
+  // without deoptimizing.
+  PythonObject *Max = py_int_new(PY_SMALL_INT_MAX);
+  PythonObject *Sum = Add(Max, py_int_new(1));
+  EXPECT_EQ(PY_SMALL_INT_MAX + 1, py_int_value(Sum));
+  py_counters C = ReadCounters();
+  EXPECT_EQ(Adds + 1, C.calls[PY_FN_INT_ADD]);
+  EXPECT_EQ(0ULL, C.deopts);
+  EXPECT_EQ(0U, TC.getStats().Deopts);
+
+  // A boxed int fails the guard, which deoptimizes, and is still added.
+  PythonObject *Twice = Add(Sum, py_int_new(1));
+  EXPECT_EQ(PY_SMALL_INT_MAX + 2, py_int_value(Twice));
+  C = ReadCounters();
+  EXPECT_EQ(Adds + 2, C.calls[PY_FN_INT_ADD]);
+  EXPECT_EQ(1ULL, C.deopts);
+  EXPECT_EQ(1U, TC.getStats().Deopts);
+
+  // The guard fails to a block of its own, which calls py_deopt and then
+  // the generic code that an overflow goes to directly.
+  Function *Deopt = J->getModule().getFunction("py_deopt");
+  Function *IntAdd = J->getModule().getFunction("py_int_add");
+  BasicBlock *DeoptBB = 0, *SlowBB = 0;
+  for (Function::iterator BB = Opt->begin(), E = Opt->end(); BB != E; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      if (CallInst *CI = dyn_cast<CallInst>(I)) {
+        if (CI->getCalledFunction() == Deopt) {
+          EXPECT_TRUE(DeoptBB == 0);
+          DeoptBB = BB;
+        } else if (CI->getCalledFunction() == IntAdd) {
+          SlowBB = BB;
+        }
+      }
+  ASSERT_TRUE(DeoptBB && SlowBB);
+  EXPECT_NE(DeoptBB, SlowBB);
+  EXPECT_EQ(SlowBB, DeoptBB->getTerminator()->getSuccessor(0));
+
+  py_decref(Sum);
+  py_decref(Twice);
+}
+
+}
@@ -0,0 +1,150 @@
+//===- unittests/Transforms/PipelineTest.cpp - Pipeline tests -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Runtime/Runtime.h"
+#include "py/Transforms/Pipeline.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/InstIterator.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+using namespace llvm;
+using namespace py;
+
+namespace {
+
+// The Parser doesn't generate code for loops yet, so the loops the
+// pipelines work on are built here, as the code generator will build them.
+
+class PipelineTest : public testing::Test {
+protected:
+  PipelineTest() : R(Context), M("test", Context) {}
+
+  /// EmitLoop - Emit f(List, Key, N), which appends globals[Key] to List N
+  /// times, getting the globals afresh each time round.
+  Function *EmitLoop() {
+    Type *ObjectPtrTy = R.GetObjectTyPtr();
+    Type *VoidTy = Type::getVoidTy(Context);
+    Type *Params[] = { ObjectPtrTy, ObjectPtrTy, Type::getInt64Ty(Context) };
+    Function *F = Function::Create(FunctionType::get(VoidTy, Params, false),
+                                   GlobalValue::ExternalLinkage, "f", &M);
+    Function::arg_iterator A = F->arg_begin();
+    Value *List = A++, *Key = A++, *N = A;
+
+    BasicBlock *Entry = BasicBlock::Create(Context, "entry", F);
+    BasicBlock *Loop = BasicBlock::Create(Context, "loop", F);
+    BasicBlock *Exit = BasicBlock::Create(Context, "exit", F);
+    IRBuilder<> IRB(Entry);
+    IRB.CreateBr(Loop);
+
+    IRB.SetInsertPoint(Loop);
+    PHINode *I = IRB.CreatePHI(IRB.getInt64Ty(), 2, "i");
+    I->addIncoming(IRB.getInt64(0), Entry);
+    Value *Globals = IRB.CreateCall(R.GetFunction(M, Runtime::GetGlobals),
+                                    "globals");
+    Value *V = IRB.CreateCall2(M.getOrInsertFunction("py_dict_lookup",
+                                                     ObjectPtrTy, ObjectPtrTy,
+                                                     ObjectPtrTy, NULL),
+                               Globals, Key, "v");
+    IRB.CreateCall2(M.getOrInsertFunction("py_list_append", VoidTy,
+                                          ObjectPtrTy, ObjectPtrTy, NULL),
+                    List, V);
+    IRB.CreateCall(M.getOrInsertFunction("py_decref", VoidTy, ObjectPtrTy,
+                                         NULL),
+                   Globals);
+    Value *Next = IRB.CreateAdd(I, IRB.getInt64(1), "i.next");
+    I->addIncoming(Next, Loop);
+    IRB.CreateCondBr(IRB.CreateICmpSLT(Next, N), Loop, Exit);
+
+    IRB.SetInsertPoint(Exit);
+    IRB.CreateRetVoid();
+    return F;
+  }
+
+  /// Calls - The calls in F to Callee.
+  static std::vector<CallInst*> Calls(Function *F, StringRef Callee) {
+    std::vector<CallInst*> Found;
+    for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+      if (CallInst *CI = dyn_cast<CallInst>(&*I))
+        if (CI->getCalledFunction() &&
+            CI->getCalledFunction()->getName() == Callee)
+          Found.push_back(CI);
+    return Found;
+  }
+
+  /// IsHoisted - Return true if the globals of the loop of F are got once,
+  /// outside the loop, and released once, outside it too.
+  static bool IsHoisted(Function *F) {
+    std::vector<CallInst*> Appends = Calls(F, "py_list_append");
+    std::vector<CallInst*> Gets = Calls(F, "py_getglobals");
+    std::vector<CallInst*> Releases = Calls(F, "py_decref");
+    if (Appends.size() != 1 || Gets.size() != 1 || Releases.size() != 1)
+      return false;
+    // The loop itself is one block, which appends.
+    BasicBlock *Loop = Appends[0]->getParent();
+    return Gets[0]->getParent() != Loop &&
+           Releases[0]->getParent() != Loop &&
+           Releases[0]->getArgOperand(0) == Gets[0];
+  }
+
+  /// Run - Run P over M, which must stay valid.
+  void Run(const Pipeline &P) {
+    EXPECT_FALSE(verifyModule(M, ReturnStatusAction));
+    P.run(M);
+    std::string Err;
+    EXPECT_FALSE(verifyModule(M, ReturnStatusAction, &Err)) << Err;
+  }
+
+  LLVMContext Context;
+  Runtime R;
+  Module M;
+};
+
+TEST_F(PipelineTest, NothingAtO0) {
+  Function *F = EmitLoop();
+  Pipeline P;
+  EXPECT_TRUE(P.empty());
+  Run(P);
+  EXPECT_FALSE(IsHoisted(F));
+}
+
+TEST_F(PipelineTest, LevelsHoistNamespaces) {
+  for (unsigned Level = 1; Level <= 3; ++Level) {
+    Function *F = EmitLoop();
+    Run(Pipeline(Level));
+    EXPECT_TRUE(IsHoisted(F)) << "-O" << Level;
+    F->eraseFromParent();
+  }
+}
+
+TEST_F(PipelineTest, CustomPipelines) {
+  Function *F = EmitLoop();
+  Pipeline P;
+  std::string Err;
+  ASSERT_TRUE(P.parse("py-licm", Err)) << Err;
+  EXPECT_TRUE(P.isCustom());
+  Run(P);
+  EXPECT_TRUE(IsHoisted(F));
+
+  EXPECT_FALSE(P.parse("py-licm,no-such-pass", Err));
+  EXPECT_EQ("unknown pass 'no-such-pass'", Err);
+  EXPECT_FALSE(P.parse(" , ", Err));
+  EXPECT_EQ("no passes given", Err);
+  // A failed parse leaves the pipeline as it was.
+  EXPECT_TRUE(P.isCustom());
+}
+
+}
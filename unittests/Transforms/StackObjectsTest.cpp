@@ -0,0 +1,139 @@
+//===- unittests/Transforms/StackObjectsTest.cpp - py-stack-objects tests -===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "py/Runtime/Runtime.h"
+#include "py/Transforms/Pipeline.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/InstIterator.h"
+#include "gtest/gtest.h"
+#include <string>
+
+using namespace llvm;
+using namespace py;
+
+namespace {
+
+class StackObjectsTest : public testing::Test {
+protected:
+  StackObjectsTest() : R(Context), M("test", Context), IRB(Context) {}
+
+  /// NewList - Start a function Name returning RetTy, and return a new
+  /// empty list made in it, which the caller is to use and release.
+  Value *NewList(StringRef Name, Type *RetTy) {
+    Function *F = Function::Create(FunctionType::get(RetTy, false),
+                                   GlobalValue::ExternalLinkage, Name, &M);
+    IRB.SetInsertPoint(BasicBlock::Create(Context, "entry", F));
+    Type *ObjectPtrTy = R.GetObjectTyPtr();
+    Constant *New = M.getOrInsertFunction("py_list_new", ObjectPtrTy,
+                                          R.GetIntPtrTy(M), NULL);
+    return IRB.CreateCall(New, ConstantInt::get(R.GetIntPtrTy(M), 0), "l");
+  }
+
+  void Release(Value *O) {
+    IRB.CreateCall(M.getOrInsertFunction("py_decref", IRB.getVoidTy(),
+                                         R.GetObjectTyPtr(), NULL),
+                   O);
+  }
+
+  /// CountCalls - The calls to Callee in the function Name.
+  unsigned CountCalls(StringRef Name, StringRef Callee) {
+    unsigned N = 0;
+    Function *F = M.getFunction(Name);
+    for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+      if (CallInst *CI = dyn_cast<CallInst>(&*I))
+        if (CI->getCalledFunction() &&
+            CI->getCalledFunction()->getName() == Callee)
+          ++N;
+    return N;
+  }
+
+  /// Run - Run py-stack-objects over M.
+  void Run() {
+    std::string Err;
+    EXPECT_FALSE(verifyModule(M, ReturnStatusAction, &Err)) << Err;
+    Pipeline P;
+    ASSERT_TRUE(P.parse("py-stack-objects", Err)) << Err;
+    P.run(M);
+    EXPECT_FALSE(verifyModule(M, ReturnStatusAction, &Err)) << Err;
+  }
+
+  LLVMContext Context;
+  Runtime R;
+  Module M;
+  IRBuilder<> IRB;
+};
+
+TEST_F(StackObjectsTest, TagTestsDontEscape) {
+  // The small-int tag test: (ptrtoint L) & 1 != 0.
+  Value *L = NewList("tag", IRB.getInt1Ty());
+  IntegerType *IntPtr = R.GetIntPtrTy(M);
+  Value *Tag = IRB.CreateAnd(IRB.CreatePtrToInt(L, IntPtr),
+                             ConstantInt::get(IntPtr, 1));
+  Value *IsInt = IRB.CreateICmpNE(Tag, ConstantInt::get(IntPtr, 0));
+  Release(L);
+  IRB.CreateRet(IsInt);
+
+  // As is comparing the addresses themselves.
+  L = NewList("same", IRB.getInt1Ty());
+  Value *Same = IRB.CreateICmpEQ(IRB.CreatePtrToInt(L, IntPtr),
+                                 ConstantInt::get(IntPtr, 0));
+  Release(L);
+  IRB.CreateRet(Same);
+
+  Run();
+  EXPECT_EQ(0U, CountCalls("tag", "py_list_new"));
+  EXPECT_EQ(1U, CountCalls("tag", "py_list_init"));
+  EXPECT_EQ(0U, CountCalls("same", "py_list_new"));
+  EXPECT_EQ(1U, CountCalls("same", "py_list_init"));
+}
+
+TEST_F(StackObjectsTest, AddressesThatAreKeptEscape) {
+  IntegerType *IntPtr = R.GetIntPtrTy(M);
+
+  // The address is stored.
+  Value *L = NewList("stored", IRB.getVoidTy());
+  GlobalVariable *Kept =
+    new GlobalVariable(M, IntPtr, false /*isConstant*/,
+                       GlobalValue::InternalLinkage,
+                       ConstantInt::get(IntPtr, 0), "kept");
+  IRB.CreateStore(IRB.CreatePtrToInt(L, IntPtr), Kept);
+  Release(L);
+  IRB.CreateRetVoid();
+
+  // The address, masked, is made a pointer again and returned.
+  L = NewList("returned", R.GetObjectTyPtr());
+  Value *Masked = IRB.CreateAnd(IRB.CreatePtrToInt(L, IntPtr),
+                                ConstantInt::getSigned(IntPtr, -2));
+  Value *Again = IRB.CreateIntToPtr(Masked, R.GetObjectTyPtr());
+  Release(L);
+  IRB.CreateRet(Again);
+
+  // The address is returned as an int.
+  L = NewList("int", IntPtr);
+  Value *Addr = IRB.CreatePtrToInt(L, IntPtr);
+  Release(L);
+  IRB.CreateRet(Addr);
+
+  Run();
+  const char *Names[] = { "stored", "returned", "int" };
+  for (unsigned i = 0; i != 3; ++i) {
+    EXPECT_EQ(1U, CountCalls(Names[i], "py_list_new")) << Names[i];
+    EXPECT_EQ(0U, CountCalls(Names[i], "py_list_init")) << Names[i];
+  }
+}
+
+}